@@ -0,0 +1,92 @@
+// Offline lightmap baker for the static cubes of the light casters scene; no GL context is needed.
+// Build with `make baker` and run ./baker from this directory. It writes lightmap.hdr, which the viewer picks up
+// on its next start. `./baker --scaling` bakes once per thread count, doubling up to the core count, and reports
+// how the bake time scales instead. `--threads N` caps the thread count, `--samples N` and `--bounces N` trade bake
+// time for noise.
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "lightmap.hpp"
+#include "scene.hpp"
+
+using std::vector;
+
+static double checksum(vector<glm::vec3> const &texels) {
+    double sum = 0.0;
+    for (size_t i = 0; i < texels.size(); i++) {
+        sum += (i % 7 + 1) * static_cast<double>(texels[i].r + 2.0f * texels[i].g + 3.0f * texels[i].b);
+    }
+    return sum;
+}
+
+int main(int argc, char **argv) {
+    LightmapSettings settings;
+    bool scaling = false;
+    unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--scaling") == 0) {
+            scaling = true;
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            cores = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            settings.Samples = static_cast<unsigned int>(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--bounces") == 0 && i + 1 < argc) {
+            settings.Bounces = static_cast<unsigned int>(std::atoi(argv[++i]));
+        } else {
+            std::printf("usage: %s [--scaling] [--threads N] [--samples N] [--bounces N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // the lightmap's size for the viewer's layout of the static cubes
+    unsigned int staticCubeCount = 0;
+    for (unsigned int i = 0; i < CUBE_COUNT; i++) {
+        staticCubeCount += IsDynamicCube(i) ? 0 : 1;
+    }
+    vector<glm::vec4> scaleOffsets;
+    glm::uvec2 size = PackLightmapInstances(staticCubeCount, LIGHTMAP_INSTANCE_RESOLUTION, scaleOffsets);
+
+    LightmapBaker baker;
+    BuildStaticScene(baker, AverageTextureColor("./textures/container2.png"));
+    std::printf("%u static cubes, %ux%u lightmap, %u paths per texel, %u bounces\n", staticCubeCount, size.x, size.y, settings.Samples,
+                settings.Bounces);
+
+    vector<glm::vec3> texels;
+    if (scaling) {
+        double baseline = 0.0, baselineChecksum = 0.0;
+        for (unsigned int threads = 1;; threads = std::min(threads * 2, cores)) {
+            settings.ThreadCount = threads;
+            LightmapStats stats = baker.Bake(size.x, size.y, settings, texels);
+            if (threads == 1) {
+                baseline = stats.Milliseconds;
+                baselineChecksum = checksum(texels);
+            }
+            std::printf("%2u threads | %9.1f ms | speed-up %5.2fx (%3.0f%% per core) | %6.2f M rays/s | %u of %u tiles stolen | %s\n", threads,
+                        stats.Milliseconds, baseline / stats.Milliseconds, 100.0 * baseline / stats.Milliseconds / threads,
+                        stats.Rays / stats.Milliseconds / 1000.0, stats.StolenTiles, stats.Tiles,
+                        checksum(texels) == baselineChecksum ? "same texels" : "TEXELS DIFFER");
+            if (threads == cores) {
+                break;
+            }
+        }
+        return 0;
+    }
+
+    settings.ThreadCount = cores;
+    LightmapStats stats = baker.Bake(size.x, size.y, settings, texels);
+    std::printf("%u texels in %u tiles on %u threads | %.1f ms | %llu rays (%.2f M rays/s) | %u tiles stolen\n", stats.Texels, stats.Tiles,
+                stats.Threads, stats.Milliseconds, stats.Rays, stats.Rays / stats.Milliseconds / 1000.0, stats.StolenTiles);
+    if (!WriteRadianceHdr(LIGHTMAP_PATH, size.x, size.y, texels)) {
+        std::printf("Unable to write %s\n", LIGHTMAP_PATH);
+        return 1;
+    }
+    std::printf("Wrote %s\n", LIGHTMAP_PATH);
+    return 0;
+}
@@ -0,0 +1,272 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+
+DynamicBvh::DynamicBvh(float margin) : root(NullNode), freeList(NullNode), leafCount(0), margin(margin) {
+}
+
+float DynamicBvh::area(AABB const &box) {
+    glm::vec3 size = box.Max - box.Min;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+AABB DynamicBvh::combine(AABB const &a, AABB const &b) {
+    return AABB { glm::min(a.Min, b.Min), glm::max(a.Max, b.Max) };
+}
+
+bool DynamicBvh::contains(AABB const &outer, AABB const &inner) {
+    return glm::all(glm::lessThanEqual(outer.Min, inner.Min)) && glm::all(glm::greaterThanEqual(outer.Max, inner.Max));
+}
+
+bool DynamicBvh::overlaps(AABB const &a, AABB const &b) {
+    return glm::all(glm::lessThanEqual(a.Min, b.Max)) && glm::all(glm::greaterThanEqual(a.Max, b.Min));
+}
+
+bool DynamicBvh::overlaps(AABB const &box, BoundingSphere const &sphere) {
+    glm::vec3 closest = glm::clamp(sphere.Center, box.Min, box.Max);
+    glm::vec3 offset = closest - sphere.Center;
+    return glm::dot(offset, offset) <= sphere.Radius * sphere.Radius;
+}
+
+AABB DynamicBvh::fatten(AABB const &box) const {
+    return AABB { box.Min - glm::vec3 { margin }, box.Max + glm::vec3 { margin } };
+}
+
+int DynamicBvh::allocateNode() {
+    if (freeList == NullNode) {
+        nodes.push_back(Node {});
+        freeList = static_cast<int>(nodes.size() - 1);
+        nodes[freeList].Parent = NullNode;
+    }
+    int node = freeList;
+    freeList = nodes[node].Parent;
+    nodes[node].Parent = NullNode;
+    nodes[node].Child1 = NullNode;
+    nodes[node].Child2 = NullNode;
+    nodes[node].Height = 0;
+    nodes[node].UserData = 0;
+    return node;
+}
+
+void DynamicBvh::freeNode(int node) {
+    nodes[node].Parent = freeList;
+    nodes[node].Height = -1;
+    freeList = node;
+}
+
+int DynamicBvh::Insert(AABB const &box, unsigned int userData) {
+    int leaf = allocateNode();
+    nodes[leaf].Box = fatten(box);
+    nodes[leaf].UserData = userData;
+    insertLeaf(leaf);
+    leafCount++;
+    return leaf;
+}
+
+void DynamicBvh::Remove(int proxy) {
+    removeLeaf(proxy);
+    freeNode(proxy);
+    leafCount--;
+}
+
+bool DynamicBvh::Move(int proxy, AABB const &box) {
+    if (contains(nodes[proxy].Box, box)) {
+        return false;
+    }
+    removeLeaf(proxy);
+    nodes[proxy].Box = fatten(box);
+    insertLeaf(proxy);
+    return true;
+}
+
+void DynamicBvh::SetLeafBounds(int proxy, AABB const &box) {
+    nodes[proxy].Box = fatten(box);
+}
+
+void DynamicBvh::Refit() {
+    if (root != NullNode) {
+        refitNode(root);
+    }
+}
+
+void DynamicBvh::refitNode(int node) {
+    Node &current = nodes[node];
+    if (current.IsLeaf()) {
+        return;
+    }
+    refitNode(current.Child1);
+    refitNode(current.Child2);
+    current.Box = combine(nodes[current.Child1].Box, nodes[current.Child2].Box);
+}
+
+void DynamicBvh::Clear() {
+    nodes.clear();
+    root = NullNode;
+    freeList = NullNode;
+    leafCount = 0;
+}
+
+void DynamicBvh::insertLeaf(int leaf) {
+    if (root == NullNode) {
+        root = leaf;
+        nodes[root].Parent = NullNode;
+        return;
+    }
+
+    // descend towards the sibling that minimizes the total surface area increase
+    AABB leafBox = nodes[leaf].Box;
+    int index = root;
+    while (!nodes[index].IsLeaf()) {
+        int child1 = nodes[index].Child1;
+        int child2 = nodes[index].Child2;
+
+        float nodeArea = area(nodes[index].Box);
+        float combinedArea = area(combine(nodes[index].Box, leafBox));
+        // cost of creating a new parent for this node and the new leaf
+        float cost = 2.0f * combinedArea;
+        // minimum cost of pushing the leaf further down the tree
+        float inheritanceCost = 2.0f * (combinedArea - nodeArea);
+
+        auto descendCost = [&](int child) {
+            AABB merged = combine(leafBox, nodes[child].Box);
+            if (nodes[child].IsLeaf()) {
+                return area(merged) + inheritanceCost;
+            }
+            return area(merged) - area(nodes[child].Box) + inheritanceCost;
+        };
+        float cost1 = descendCost(child1);
+        float cost2 = descendCost(child2);
+
+        if (cost < cost1 && cost < cost2) {
+            break;
+        }
+        index = cost1 < cost2 ? child1 : child2;
+    }
+    int sibling = index;
+
+    // create a new parent in place of the sibling
+    int oldParent = nodes[sibling].Parent;
+    int newParent = allocateNode();
+    nodes[newParent].Parent = oldParent;
+    nodes[newParent].Box = combine(leafBox, nodes[sibling].Box);
+    nodes[newParent].Height = nodes[sibling].Height + 1;
+    nodes[newParent].Child1 = sibling;
+    nodes[newParent].Child2 = leaf;
+    nodes[sibling].Parent = newParent;
+    nodes[leaf].Parent = newParent;
+    if (oldParent != NullNode) {
+        if (nodes[oldParent].Child1 == sibling) {
+            nodes[oldParent].Child1 = newParent;
+        } else {
+            nodes[oldParent].Child2 = newParent;
+        }
+    } else {
+        root = newParent;
+    }
+
+    // walk back up fixing heights and boxes
+    index = nodes[leaf].Parent;
+    while (index != NullNode) {
+        index = balance(index);
+        int child1 = nodes[index].Child1;
+        int child2 = nodes[index].Child2;
+        nodes[index].Height = 1 + std::max(nodes[child1].Height, nodes[child2].Height);
+        nodes[index].Box = combine(nodes[child1].Box, nodes[child2].Box);
+        index = nodes[index].Parent;
+    }
+}
+
+void DynamicBvh::removeLeaf(int leaf) {
+    if (leaf == root) {
+        root = NullNode;
+        return;
+    }
+
+    int parent = nodes[leaf].Parent;
+    int grandParent = nodes[parent].Parent;
+    int sibling = nodes[parent].Child1 == leaf ? nodes[parent].Child2 : nodes[parent].Child1;
+
+    if (grandParent == NullNode) {
+        root = sibling;
+        nodes[sibling].Parent = NullNode;
+        freeNode(parent);
+        return;
+    }
+
+    // the sibling takes over the parent's slot
+    if (nodes[grandParent].Child1 == parent) {
+        nodes[grandParent].Child1 = sibling;
+    } else {
+        nodes[grandParent].Child2 = sibling;
+    }
+    nodes[sibling].Parent = grandParent;
+    freeNode(parent);
+
+    int index = grandParent;
+    while (index != NullNode) {
+        index = balance(index);
+        int child1 = nodes[index].Child1;
+        int child2 = nodes[index].Child2;
+        nodes[index].Box = combine(nodes[child1].Box, nodes[child2].Box);
+        nodes[index].Height = 1 + std::max(nodes[child1].Height, nodes[child2].Height);
+        index = nodes[index].Parent;
+    }
+}
+
+// Performs a left or right rotation if node A is imbalanced and returns the new root of the subtree.
+int DynamicBvh::balance(int indexA) {
+    Node &a = nodes[indexA];
+    if (a.IsLeaf() || a.Height < 2) {
+        return indexA;
+    }
+
+    int indexB = a.Child1;
+    int indexC = a.Child2;
+    int imbalance = nodes[indexC].Height - nodes[indexB].Height;
+
+    // rotate the taller child up; the same steps apply to both sides with the roles of B and C swapped
+    auto rotate = [&](int indexUp, int indexOther, bool upIsChild2) {
+        Node &up = nodes[indexUp];
+        int indexF = up.Child1;
+        int indexG = up.Child2;
+
+        up.Child1 = indexA;
+        up.Parent = a.Parent;
+        a.Parent = indexUp;
+
+        if (up.Parent != NullNode) {
+            if (nodes[up.Parent].Child1 == indexA) {
+                nodes[up.Parent].Child1 = indexUp;
+            } else {
+                nodes[up.Parent].Child2 = indexUp;
+            }
+        } else {
+            root = indexUp;
+        }
+
+        // keep the taller grandchild under the rotated node, hand the other one to A
+        int keep = nodes[indexF].Height > nodes[indexG].Height ? indexF : indexG;
+        int give = keep == indexF ? indexG : indexF;
+        up.Child2 = keep;
+        if (upIsChild2) {
+            a.Child2 = give;
+        } else {
+            a.Child1 = give;
+        }
+        nodes[give].Parent = indexA;
+
+        a.Box = combine(nodes[indexOther].Box, nodes[give].Box);
+        up.Box = combine(a.Box, nodes[keep].Box);
+        a.Height = 1 + std::max(nodes[indexOther].Height, nodes[give].Height);
+        up.Height = 1 + std::max(a.Height, nodes[keep].Height);
+        return indexUp;
+    };
+
+    if (imbalance > 1) {
+        return rotate(indexC, indexB, true);
+    }
+    if (imbalance < -1) {
+        return rotate(indexB, indexC, false);
+    }
+    return indexA;
+}
@@ -0,0 +1,226 @@
+#pragma once
+
+#include "culling.hpp"
+
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Dynamic bounding volume hierarchy over object AABBs.
+// Leaves store a "fat" box (the tight box grown by a margin) so that small movements do not touch the tree at all.
+// Insertion picks the sibling with the cheapest surface area increase and the tree is kept height-balanced with
+// AVL-style rotations, so the depth stays logarithmic even when objects are inserted in spatial order.
+class DynamicBvh {
+    public:
+        static int const NullNode = -1;
+    private:
+        struct Node {
+            AABB Box;
+            int Parent; // next free node while the node is on the free list
+            int Child1;
+            int Child2;
+            int Height; // 0 for leaves, -1 for free nodes
+            unsigned int UserData;
+            bool IsLeaf() const { return Child1 == NullNode; }
+        };
+        static int const MAX_STACK = 128; // AVL balancing keeps the height well under this for any realistic count
+
+        std::vector<Node> nodes;
+        int root;
+        int freeList;
+        unsigned int leafCount;
+        float margin; // how much a leaf box is grown by so objects can move without reinsertion
+
+        int allocateNode();
+        void freeNode(int node);
+        void insertLeaf(int leaf);
+        void removeLeaf(int leaf);
+        int balance(int node);
+        void refitNode(int node);
+        AABB fatten(AABB const &box) const;
+
+        static float area(AABB const &box);
+        static AABB combine(AABB const &a, AABB const &b);
+        static bool contains(AABB const &outer, AABB const &inner);
+        static bool overlaps(AABB const &a, AABB const &b);
+        static bool overlaps(AABB const &box, BoundingSphere const &sphere);
+        template <typename Visitor>
+        void visitSubtree(int node, Visitor &visit) const;
+    public:
+        explicit DynamicBvh(float margin = 0.1f);
+        // Returns the proxy id of the new leaf. The user data is what the queries report back.
+        int Insert(AABB const &box, unsigned int userData);
+        void Remove(int proxy);
+        // Reinserts the leaf only if the box escaped its fat box. Returns true if the tree changed.
+        bool Move(int proxy, AABB const &box);
+        // Overwrites the leaf box without restructuring; call Refit once all moved leaves are updated.
+        // Cheaper than Move when many objects move a bounded amount every frame (e.g. rotating in place).
+        void SetLeafBounds(int proxy, AABB const &box);
+        // Recomputes every internal box bottom-up from the leaves.
+        void Refit();
+        void Clear();
+
+        // Frustum traversal: subtrees fully inside are accepted without further plane tests,
+        // subtrees fully outside are rejected and only straddling nodes are descended into.
+        template <typename Visitor>
+        void QueryFrustum(Frustum const &frustum, Visitor &&visit) const;
+        template <typename Visitor>
+        void QueryAABB(AABB const &box, Visitor &&visit) const;
+        template <typename Visitor>
+        void QuerySphere(BoundingSphere const &sphere, Visitor &&visit) const;
+
+        unsigned int GetUserData(int proxy) const { return nodes[proxy].UserData; }
+        AABB const &GetFatAABB(int proxy) const { return nodes[proxy].Box; }
+        unsigned int GetLeafCount() const { return leafCount; }
+        int GetHeight() const { return root == NullNode ? 0 : nodes[root].Height; }
+};
+
+template <typename Visitor>
+void DynamicBvh::visitSubtree(int node, Visitor &visit) const {
+    int stack[MAX_STACK];
+    int top = 0;
+    stack[top++] = node;
+    while (top > 0) {
+        Node const &current = nodes[stack[--top]];
+        if (current.IsLeaf()) {
+            visit(current.UserData);
+        } else {
+            stack[top++] = current.Child1;
+            stack[top++] = current.Child2;
+        }
+    }
+}
+
+template <typename Visitor>
+void DynamicBvh::QueryFrustum(Frustum const &frustum, Visitor &&visit) const {
+    if (root == NullNode) {
+        return;
+    }
+    // each entry carries the planes its parent still straddled; a plane the parent was fully inside of
+    // cannot cut any of its children, so it is dropped from the mask
+    struct Entry { int Node; unsigned int PlaneMask; };
+#if defined(__SSE2__)
+    // the six planes as two groups of four lanes, tested against a node without a branch per plane; the two
+    // spare lanes hold a plane everything lies in front of
+    __m128 planeX[2], planeY[2], planeZ[2], planeW[2], reachX[2], reachY[2], reachZ[2];
+    for (int group = 0; group < 2; group++) {
+        alignas(16) float x[4], y[4], z[4], w[4];
+        for (int lane = 0; lane < 4; lane++) {
+            int p = group * 4 + lane;
+            glm::vec4 plane = p < 6 ? frustum.Planes[p] : glm::vec4 { 0.0f, 0.0f, 0.0f, 1.0f };
+            x[lane] = plane.x;
+            y[lane] = plane.y;
+            z[lane] = plane.z;
+            w[lane] = plane.w;
+        }
+        planeX[group] = _mm_load_ps(x);
+        planeY[group] = _mm_load_ps(y);
+        planeZ[group] = _mm_load_ps(z);
+        planeW[group] = _mm_load_ps(w);
+        __m128 signBit = _mm_set1_ps(-0.0f);
+        reachX[group] = _mm_andnot_ps(signBit, planeX[group]);
+        reachY[group] = _mm_andnot_ps(signBit, planeY[group]);
+        reachZ[group] = _mm_andnot_ps(signBit, planeZ[group]);
+    }
+#endif
+    Entry stack[MAX_STACK];
+    int top = 0;
+    stack[top++] = Entry { root, 0x3Fu };
+    while (top > 0) {
+        Entry entry = stack[--top];
+        Node const &node = nodes[entry.Node];
+        glm::vec3 center = (node.Box.Min + node.Box.Max) * 0.5f;
+        glm::vec3 extent = (node.Box.Max - node.Box.Min) * 0.5f;
+#if defined(__SSE2__)
+        __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+        __m128 ex = _mm_set1_ps(extent.x), ey = _mm_set1_ps(extent.y), ez = _mm_set1_ps(extent.z);
+        unsigned int outsideMask = 0;
+        unsigned int mask = 0;
+        for (int group = 0; group < 2; group++) {
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[group], cx), _mm_mul_ps(planeY[group], cy)),
+                                     _mm_add_ps(_mm_mul_ps(planeZ[group], cz), planeW[group]));
+            __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(reachX[group], ex), _mm_mul_ps(reachY[group], ey)),
+                                      _mm_mul_ps(reachZ[group], ez));
+            outsideMask |= static_cast<unsigned int>(_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(dist, reach), _mm_setzero_ps()))) << (group * 4);
+            mask |= static_cast<unsigned int>(_mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(dist, reach), _mm_setzero_ps()))) << (group * 4);
+        }
+        if (outsideMask & entry.PlaneMask) {
+            continue;
+        }
+        mask &= entry.PlaneMask;
+#else
+        unsigned int mask = 0;
+        bool outside = false;
+        for (unsigned int p = 0; p < 6; p++) {
+            if (!(entry.PlaneMask & (1u << p))) {
+                continue;
+            }
+            glm::vec4 const &plane = frustum.Planes[p];
+            float dist = glm::dot(glm::vec3 { plane }, center) + plane.w;
+            float reach = glm::dot(glm::abs(glm::vec3 { plane }), extent);
+            if (dist + reach < 0.0f) {
+                outside = true;
+                break;
+            }
+            if (dist - reach < 0.0f) {
+                mask |= 1u << p;
+            }
+        }
+        if (outside) {
+            continue;
+        }
+#endif
+        if (mask == 0 || node.IsLeaf()) {
+            visitSubtree(entry.Node, visit);
+        } else {
+            stack[top++] = Entry { node.Child1, mask };
+            stack[top++] = Entry { node.Child2, mask };
+        }
+    }
+}
+
+template <typename Visitor>
+void DynamicBvh::QueryAABB(AABB const &box, Visitor &&visit) const {
+    if (root == NullNode) {
+        return;
+    }
+    int stack[MAX_STACK];
+    int top = 0;
+    stack[top++] = root;
+    while (top > 0) {
+        Node const &node = nodes[stack[--top]];
+        if (!overlaps(node.Box, box)) {
+            continue;
+        }
+        if (node.IsLeaf()) {
+            visit(node.UserData);
+        } else {
+            stack[top++] = node.Child1;
+            stack[top++] = node.Child2;
+        }
+    }
+}
+
+template <typename Visitor>
+void DynamicBvh::QuerySphere(BoundingSphere const &sphere, Visitor &&visit) const {
+    if (root == NullNode) {
+        return;
+    }
+    int stack[MAX_STACK];
+    int top = 0;
+    stack[top++] = root;
+    while (top > 0) {
+        Node const &node = nodes[stack[--top]];
+        if (!overlaps(node.Box, sphere)) {
+            continue;
+        }
+        if (node.IsLeaf()) {
+            visit(node.UserData);
+        } else {
+            stack[top++] = node.Child1;
+            stack[top++] = node.Child2;
+        }
+    }
+}
@@ -57,6 +57,13 @@ void Camera::ProcessMouseMovement(float xoffset, float yoffset, bool constrainPi
     updateCameraVectors();
 }
 
+void Camera::SetView(glm::vec3 position, float yaw, float pitch) {
+    Camera::position = position;
+    Camera::yaw = yaw;
+    Camera::pitch = pitch;
+    updateCameraVectors();
+}
+
 void Camera::ProcessMouseScroll(float yoffset) {
     mouseZoom -= yoffset;
     if (mouseZoom > 45.0f) {
@@ -2,6 +2,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "culling.hpp"
+
 float const YAW = -90.0f;
 float const PITCH = 0.0f;
 float const SPEED = 2.5f;
@@ -67,9 +69,14 @@ class Camera {
         void ProcessKeyboard(Movement direction, float deltaTime);
         void ProcessMouseMovement(float xoffset, float yoffset, bool constrainPitch = true);
         void ProcessMouseScroll(float yoffset);
+        // Places the camera directly, for scripted camera paths
+        void SetView(glm::vec3 position, float yaw, float pitch);
         float GetZoom() const { return glm::radians(mouseZoom); }
         glm::vec3 GetPosition() const { return position; }
         glm::vec3 GetDirection() const { return front; }
+        // Frustum planes in world space, used to reject bounds that cannot appear on screen
+        static Frustum ExtractFrustum(glm::mat4 const &projection, glm::mat4 const &view) { return Frustum::FromMatrix(projection * view); }
+        Frustum GetFrustum(glm::mat4 const &projection) const { return ExtractFrustum(projection, GetViewMatrix()); }
     protected:
         void updateCameraVectors();
 };
\ No newline at end of file
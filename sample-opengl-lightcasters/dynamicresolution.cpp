@@ -0,0 +1,228 @@
+#include "dynamicresolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+DynamicResolution::DynamicResolution(int windowWidth, int windowHeight) : DynamicResolution(windowWidth, windowHeight, Settings {}) {}
+
+DynamicResolution::DynamicResolution(int windowWidth, int windowHeight, Settings const &settings)
+    : settings { settings }, windowWidth { windowWidth }, windowHeight { windowHeight }, samples { 1 }, samplesResolved { true }, queryIndex { 0 },
+      frame { 0 }, enabled { true }, scale { settings.MaxScale }, averageMilliseconds { -1.0 }, lastMilliseconds { 0.0 }, cooldown { 0 }, log { nullptr } {
+    this->settings.CooldownFrames = std::max(this->settings.CooldownFrames, QUERY_FRAMES);
+    // the first frames compile shaders and upload textures
+    cooldown = this->settings.CooldownFrames;
+    glGenQueries(QUERY_FRAMES, queries);
+    std::fill(queryPending, queryPending + QUERY_FRAMES, false);
+    allocate();
+}
+
+DynamicResolution::~DynamicResolution() {
+    release();
+    glDeleteQueries(QUERY_FRAMES, queries);
+}
+
+namespace {
+    GLuint createTexture(int width, int height, GLint internalFormat, GLenum format, GLenum type, GLint filter) {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return texture;
+    }
+}
+
+void DynamicResolution::allocate() {
+    glm::ivec2 size = GetTargetSize();
+    colorTexture = createTexture(size.x, size.y, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_LINEAR);
+    velocityTexture = createTexture(size.x, size.y, GL_RG16F, GL_RG, GL_FLOAT, GL_NEAREST);
+    // the same format as the default framebuffer's, so the GPU culler can copy it into its depth pyramid
+    depthTexture = createTexture(size.x, size.y, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, GL_NEAREST);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, velocityTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+
+    // the same formats as the target's, as blits resolving samples can't convert
+    if (samples > 1) {
+        glGenRenderbuffers(1, &multisampleColor);
+        glBindRenderbuffer(GL_RENDERBUFFER, multisampleColor);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, size.x, size.y);
+        glGenRenderbuffers(1, &multisampleDepth);
+        glBindRenderbuffer(GL_RENDERBUFFER, multisampleDepth);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH24_STENCIL8, size.x, size.y);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glGenFramebuffers(1, &multisampleFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, multisampleFramebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, multisampleColor);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, multisampleDepth);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void DynamicResolution::release() {
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteTextures(1, &colorTexture);
+    glDeleteTextures(1, &velocityTexture);
+    glDeleteTextures(1, &depthTexture);
+    if (samples > 1) {
+        glDeleteFramebuffers(1, &multisampleFramebuffer);
+        glDeleteRenderbuffers(1, &multisampleColor);
+        glDeleteRenderbuffers(1, &multisampleDepth);
+    }
+}
+
+void DynamicResolution::Resize(int windowWidth, int windowHeight) {
+    if (windowWidth <= 0 || windowHeight <= 0 || (windowWidth == this->windowWidth && windowHeight == this->windowHeight)) {
+        return;
+    }
+    this->windowWidth = windowWidth;
+    this->windowHeight = windowHeight;
+    release();
+    allocate();
+}
+
+void DynamicResolution::SetEnabled(bool enabled) {
+    this->enabled = enabled;
+    // timings from before were taken at another scale
+    averageMilliseconds = -1.0;
+    cooldown = settings.CooldownFrames;
+}
+
+void DynamicResolution::SetScale(float scale) {
+    this->scale = std::clamp(scale, settings.MinScale, settings.MaxScale);
+    averageMilliseconds = -1.0;
+    cooldown = settings.CooldownFrames;
+}
+
+void DynamicResolution::SetSamples(int samples) {
+    GLint maxSamples = 1;
+    glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+    samples = std::clamp(samples, 1, std::max(1, static_cast<int>(maxSamples)));
+    if (samples == this->samples) {
+        return;
+    }
+    release();
+    this->samples = samples;
+    allocate();
+    // the cost per pixel changed
+    averageMilliseconds = -1.0;
+    cooldown = settings.CooldownFrames;
+}
+
+glm::ivec2 DynamicResolution::GetTargetSize() const {
+    return glm::ivec2 { std::max(1, static_cast<int>(std::ceil(windowWidth * settings.MaxScale))),
+                        std::max(1, static_cast<int>(std::ceil(windowHeight * settings.MaxScale))) };
+}
+
+glm::ivec2 DynamicResolution::GetRenderSize() const {
+    return glm::ivec2 { std::max(1, static_cast<int>(std::lround(windowWidth * scale))), std::max(1, static_cast<int>(std::lround(windowHeight * scale))) };
+}
+
+void DynamicResolution::collectQueries() {
+    // oldest first, so the average sees the timings in order
+    for (unsigned int i = 0; i < QUERY_FRAMES; i++) {
+        unsigned int index = (queryIndex + i) % QUERY_FRAMES;
+        if (!queryPending[index]) {
+            continue;
+        }
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            // later queries are not done either
+            break;
+        }
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(queries[index], GL_QUERY_RESULT, &nanoseconds);
+        queryPending[index] = false;
+        update(nanoseconds / 1e6);
+    }
+}
+
+void DynamicResolution::update(double milliseconds) {
+    lastMilliseconds = milliseconds;
+    // one stall, or a bogus first result from some drivers, must not swing the average far
+    milliseconds = std::min(milliseconds, settings.TargetMilliseconds * OUTLIER_FACTOR);
+    averageMilliseconds = averageMilliseconds < 0.0 ? milliseconds : averageMilliseconds + settings.Damping * (milliseconds - averageMilliseconds);
+    if (cooldown > 0) {
+        cooldown--;
+        // the queries still in flight measured the old scale, start the average over once they are through
+        if (cooldown == 0) {
+            averageMilliseconds = milliseconds;
+        }
+        return;
+    }
+    if (!enabled || std::abs(averageMilliseconds - settings.TargetMilliseconds) <= settings.Hysteresis * settings.TargetMilliseconds) {
+        return;
+    }
+
+    // the cost is taken to grow with the pixel count, i.e. with the square of the scale
+    float wanted = scale * static_cast<float>(std::sqrt(settings.TargetMilliseconds / std::max(averageMilliseconds, 1e-3)));
+    wanted = std::clamp(wanted, scale - settings.MaxStep, scale + settings.MaxStep);
+    wanted = std::clamp(wanted, settings.MinScale, settings.MaxScale);
+    // pinned at a bound
+    if (std::abs(wanted - scale) < 0.005f) {
+        return;
+    }
+    Decision decision { frame, averageMilliseconds, scale, wanted };
+    decisions.push_back(decision);
+    scale = wanted;
+    cooldown = settings.CooldownFrames;
+    if (log != nullptr) {
+        glm::ivec2 size = GetRenderSize();
+        *log << "dynamic resolution: frame " << decision.Frame << " gpu " << std::fixed << std::setprecision(2) << decision.GpuMilliseconds
+             << " ms (target " << settings.TargetMilliseconds << ") scale " << decision.PreviousScale << " -> " << decision.Scale << " ("
+             << size.x << "x" << size.y << ")" << std::defaultfloat << std::endl;
+    }
+}
+
+void DynamicResolution::Begin() {
+    collectQueries();
+    // every query is still in flight, skip timing this frame rather than wait
+    if (!queryPending[queryIndex]) {
+        glBeginQuery(GL_TIME_ELAPSED, queries[queryIndex]);
+    }
+    glm::ivec2 size = GetRenderSize();
+    glBindFramebuffer(GL_FRAMEBUFFER, samples > 1 ? multisampleFramebuffer : framebuffer);
+    glViewport(0, 0, size.x, size.y);
+    samplesResolved = samples == 1;
+}
+
+void DynamicResolution::ResolveSamples() {
+    if (samplesResolved) {
+        return;
+    }
+    glm::ivec2 size = GetRenderSize();
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, multisampleFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+    glBlitFramebuffer(0, 0, size.x, size.y, 0, 0, size.x, size.y, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    samplesResolved = true;
+}
+
+void DynamicResolution::End() {
+    ResolveSamples();
+    if (!queryPending[queryIndex]) {
+        glEndQuery(GL_TIME_ELAPSED);
+        queryPending[queryIndex] = true;
+        queryIndex = (queryIndex + 1) % QUERY_FRAMES;
+    }
+    frame++;
+}
+
+void DynamicResolution::Present(GLuint destination) const {
+    glm::ivec2 size = GetRenderSize();
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, destination);
+    glBlitFramebuffer(0, 0, size.x, size.y, 0, 0, windowWidth, windowHeight, GL_COLOR_BUFFER_BIT, size.x == windowWidth ? GL_NEAREST : GL_LINEAR);
+    glBindFramebuffer(GL_FRAMEBUFFER, destination);
+    glViewport(0, 0, windowWidth, windowHeight);
+}
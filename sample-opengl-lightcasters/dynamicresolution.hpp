@@ -0,0 +1,110 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <ostream>
+#include <vector>
+
+// Renders the scene offscreen at a fraction of the window's resolution and stretches it over the window, picking
+// the fraction from how long the GPU took for the last frames. The scene is timed with GL_TIME_ELAPSED queries
+// kept in a small ring, so results are read a few frames late and never wait on the GPU.
+//
+// The controller smooths the timings, leaves the scale alone while they are within a band around the target, and
+// otherwise moves it towards the scale that would hit the target assuming the cost follows the pixel count, by a
+// bounded step. After each change it waits for the queries still measuring the old scale to drain.
+//
+// The target is allocated once at the window size times the largest scale and only its lower-left corner is used,
+// so changing the scale never reallocates anything. Besides color and depth it has a second color attachment for
+// the screen-space velocity the TemporalUpsampler reprojects with; draws only go to the first one unless asked.
+//
+// With multisampling on, the scene is drawn into multisampled color and depth renderbuffers instead, which are
+// resolved into the target's color and depth textures inside the timed span, so the timings include the resolve.
+class DynamicResolution {
+    public:
+        static constexpr unsigned int QUERY_FRAMES = 4;
+        // timings are clamped to this many times the target before they are averaged
+        static constexpr double OUTLIER_FACTOR = 2.0;
+        struct Settings {
+            double TargetMilliseconds = 14.0; // GPU time of the scene, leaving room for the rest of a 60 Hz frame
+            float MinScale = 0.5f;
+            float MaxScale = 1.0f;
+            float Damping = 0.2f; // weight of the newest timing in the running average
+            float Hysteresis = 0.1f; // fraction of the target the average may stray by before the scale changes
+            float MaxStep = 0.1f; // largest change of the scale per decision
+            unsigned int CooldownFrames = 8; // timings ignored after a change, at least QUERY_FRAMES
+        };
+        struct Decision {
+            unsigned long long Frame;
+            double GpuMilliseconds; // the average that led to it
+            float PreviousScale;
+            float Scale;
+        };
+    private:
+        Settings settings;
+        int windowWidth, windowHeight;
+        GLuint framebuffer, colorTexture, velocityTexture, depthTexture;
+        int samples; // 1 without multisampling
+        GLuint multisampleFramebuffer, multisampleColor, multisampleDepth;
+        bool samplesResolved;
+        GLuint queries[QUERY_FRAMES];
+        bool queryPending[QUERY_FRAMES];
+        unsigned int queryIndex;
+        unsigned long long frame;
+        bool enabled;
+        float scale;
+        double averageMilliseconds; // negative until the first timing arrives
+        double lastMilliseconds;
+        unsigned int cooldown;
+        std::vector<Decision> decisions;
+        std::ostream *log;
+
+        void allocate();
+        void release();
+        void collectQueries();
+        void update(double milliseconds);
+    public:
+        DynamicResolution(int windowWidth, int windowHeight);
+        DynamicResolution(int windowWidth, int windowHeight, Settings const &settings);
+        ~DynamicResolution();
+        DynamicResolution(DynamicResolution const &) = delete;
+        DynamicResolution &operator=(DynamicResolution const &) = delete;
+
+        // Reallocates the target when the window's framebuffer size changed
+        void Resize(int windowWidth, int windowHeight);
+        // Holds the scale where it is while disabled
+        void SetEnabled(bool enabled);
+        // Sets the scale within the bounds, for holding it somewhere in particular while disabled
+        void SetScale(float scale);
+        // Draws the scene with this many samples per pixel from the next frame on, 1 to turn multisampling off. The
+        // count is clamped to what the context supports.
+        void SetSamples(int samples);
+        // Every decision is written here as one line, nullptr to stop
+        void SetLog(std::ostream *log) { this->log = log; }
+
+        // Binds the target with the viewport at the current scale and starts timing
+        void Begin();
+        // Resolves the multisampled scene into the target and binds the target. Call before anything reads the
+        // target's depth or draws into its velocity attachment; End does it otherwise.
+        void ResolveSamples();
+        // Stops timing
+        void End();
+        // Stretches the target over the given framebuffer, the default one unless a post-process chain follows
+        void Present(GLuint destination = 0) const;
+
+        GLuint GetFramebuffer() const { return framebuffer; }
+        GLuint GetColorTexture() const { return colorTexture; }
+        GLuint GetVelocityTexture() const { return velocityTexture; }
+        GLuint GetDepthTexture() const { return depthTexture; }
+        // the textures' size; only the render size of it is drawn to
+        glm::ivec2 GetTargetSize() const;
+        glm::ivec2 GetRenderSize() const;
+        glm::ivec2 GetWindowSize() const { return glm::ivec2 { windowWidth, windowHeight }; }
+        float GetScale() const { return scale; }
+        int GetSamples() const { return samples; }
+        bool IsEnabled() const { return enabled; }
+        // latest timing and its running average, in milliseconds
+        double GetGpuMilliseconds() const { return lastMilliseconds; }
+        double GetAverageGpuMilliseconds() const { return averageMilliseconds; }
+        std::vector<Decision> const &GetDecisions() const { return decisions; }
+};
@@ -0,0 +1,267 @@
+#include "framebenchmark.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "camera.hpp"
+
+using std::endl;
+using std::string;
+using std::vector;
+
+namespace {
+    // a loop from the default viewpoint around and through the cubes, back to where it started
+    vector<FrameBenchmark::Keyframe> const DEFAULT_CAMERA_PATH = {
+        { 0.0f, glm::vec3 { 0.5f, 1.0f, 5.0f }, -90.0f, 0.0f },
+        { 3.0f, glm::vec3 { 3.0f, 2.0f, 0.0f }, -110.0f, -10.0f },
+        { 6.0f, glm::vec3 { 0.0f, 0.5f, -6.0f }, -60.0f, 5.0f },
+        { 9.0f, glm::vec3 { -3.0f, 1.5f, -2.0f }, -30.0f, -5.0f },
+        { 12.0f, glm::vec3 { 0.5f, 1.0f, 5.0f }, -90.0f, 0.0f },
+    };
+
+    void writeArray(std::ostream &out, vector<double> const &values) {
+        out << "[";
+        for (size_t i = 0; i < values.size(); i++) {
+            out << (i == 0 ? "" : ", ") << values[i];
+        }
+        out << "]";
+    }
+
+    void writeSummary(std::ostream &out, FrameBenchmark::Summary const &summary) {
+        out << "{ \"mean\": " << summary.Mean << ", \"min\": " << summary.Min << ", \"p50\": " << summary.P50 << ", \"p95\": " << summary.P95
+            << ", \"p99\": " << summary.P99 << ", \"max\": " << summary.Max << " }";
+    }
+
+    // the numbers of the array under the key, enough of JSON for the files Report writes
+    bool readArray(string const &text, string const &key, vector<double> &values) {
+        size_t position = text.find("\"" + key + "\"");
+        if (position == string::npos || (position = text.find('[', position)) == string::npos) {
+            return false;
+        }
+        char const *cursor = text.c_str() + position + 1;
+        while (true) {
+            while (*cursor == ' ' || *cursor == ',' || *cursor == '\n') {
+                cursor++;
+            }
+            if (*cursor == ']') {
+                return true;
+            }
+            char *end;
+            double value = std::strtod(cursor, &end);
+            if (end == cursor) {
+                return false;
+            }
+            values.push_back(value);
+            cursor = end;
+        }
+    }
+}
+
+FrameBenchmark::FrameBenchmark(Settings const &settings) : settings { settings }, frame { 0 } {
+    if (this->settings.CameraPath.empty()) {
+        this->settings.CameraPath = DEFAULT_CAMERA_PATH;
+    }
+    queries.resize(2 * static_cast<size_t>(settings.Frames));
+    glGenQueries(static_cast<GLsizei>(queries.size()), queries.data());
+    cpuMilliseconds.reserve(settings.Frames);
+}
+
+FrameBenchmark::~FrameBenchmark() {
+    glDeleteQueries(static_cast<GLsizei>(queries.size()), queries.data());
+}
+
+bool FrameBenchmark::LoadCameraPath(string const &path, vector<Keyframe> &keyframes) {
+    std::ifstream file { path };
+    if (!file) {
+        return false;
+    }
+    keyframes.clear();
+    string line;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields { line };
+        Keyframe keyframe;
+        if (fields >> keyframe.Time >> keyframe.Position.x >> keyframe.Position.y >> keyframe.Position.z >> keyframe.Yaw >> keyframe.Pitch) {
+            keyframes.push_back(keyframe);
+        }
+    }
+    return !keyframes.empty() && std::is_sorted(keyframes.begin(), keyframes.end(), [](Keyframe const &a, Keyframe const &b) { return a.Time < b.Time; });
+}
+
+FrameBenchmark::Summary FrameBenchmark::Summarize(vector<double> values) {
+    if (values.empty()) {
+        return Summary { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+    }
+    std::sort(values.begin(), values.end());
+    // interpolated between the closest ranks
+    auto percentile = [&](double p) {
+        double rank = p * (values.size() - 1);
+        size_t below = static_cast<size_t>(rank);
+        size_t above = std::min(below + 1, values.size() - 1);
+        return values[below] + (rank - below) * (values[above] - values[below]);
+    };
+    double sum = 0.0;
+    for (double value : values) {
+        sum += value;
+    }
+    return Summary { sum / values.size(), values.front(), percentile(0.5), percentile(0.95), percentile(0.99), values.back() };
+}
+
+double FrameBenchmark::SlowerPValue(vector<double> const &samples, vector<double> const &baseline) {
+    // rank the frames' differences by size, ties sharing their average rank; frames that took exactly as long
+    // say nothing either way
+    vector<double> differences;
+    for (size_t i = 0; i < std::min(samples.size(), baseline.size()); i++) {
+        if (samples[i] != baseline[i]) {
+            differences.push_back(samples[i] - baseline[i]);
+        }
+    }
+    if (differences.empty()) {
+        return 1.0;
+    }
+    std::sort(differences.begin(), differences.end(), [](double a, double b) { return std::abs(a) < std::abs(b); });
+    double slowerRanks = 0.0;
+    double tieCorrection = 0.0;
+    for (size_t i = 0; i < differences.size();) {
+        size_t j = i;
+        while (j < differences.size() && std::abs(differences[j]) == std::abs(differences[i])) {
+            j++;
+        }
+        double rank = 0.5 * (i + 1 + j);
+        for (size_t k = i; k < j; k++) {
+            if (differences[k] > 0.0) {
+                slowerRanks += rank;
+            }
+        }
+        double ties = static_cast<double>(j - i);
+        tieCorrection += ties * ties * ties - ties;
+        i = j;
+    }
+
+    double n = static_cast<double>(differences.size());
+    double mean = n * (n + 1.0) / 4.0;
+    double variance = n * (n + 1.0) * (2.0 * n + 1.0) / 24.0 - tieCorrection / 48.0;
+    if (variance <= 0.0) {
+        return 1.0;
+    }
+    double z = (slowerRanks - mean - 0.5) / std::sqrt(variance);
+    return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+void FrameBenchmark::PlaceCamera(Camera &camera) const {
+    vector<Keyframe> const &path = settings.CameraPath;
+    float duration = path.back().Time - path.front().Time;
+    float time = path.front().Time + (duration > 0.0f ? std::fmod(GetTime(), duration) : 0.0f);
+    size_t next = 1;
+    while (next < path.size() && path[next].Time <= time) {
+        next++;
+    }
+    if (next == path.size()) {
+        camera.SetView(path.back().Position, path.back().Yaw, path.back().Pitch);
+        return;
+    }
+    Keyframe const &a = path[next - 1];
+    Keyframe const &b = path[next];
+    float t = (time - a.Time) / std::max(b.Time - a.Time, 1e-6f);
+    camera.SetView(glm::mix(a.Position, b.Position, t), glm::mix(a.Yaw, b.Yaw, t), glm::mix(a.Pitch, b.Pitch, t));
+}
+
+void FrameBenchmark::BeginFrame() {
+    frameStart = Clock::now();
+    if (isTimed()) {
+        glQueryCounter(queries[2 * (frame - settings.WarmupFrames)], GL_TIMESTAMP);
+    }
+}
+
+void FrameBenchmark::EndFrame() {
+    if (isTimed()) {
+        glQueryCounter(queries[2 * (frame - settings.WarmupFrames) + 1], GL_TIMESTAMP);
+        cpuMilliseconds.push_back(std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count());
+    }
+    frame++;
+}
+
+void FrameBenchmark::writeJson(std::ostream &out, string const &renderer, int width, int height) const {
+    out << std::fixed << std::setprecision(4);
+    out << "{\n";
+    out << "  \"sample\": \"lightcasters\",\n";
+    out << "  \"renderer\": \"" << renderer << "\",\n";
+    out << "  \"width\": " << width << ",\n";
+    out << "  \"height\": " << height << ",\n";
+    out << "  \"frames\": " << settings.Frames << ",\n";
+    out << "  \"warmup_frames\": " << settings.WarmupFrames << ",\n";
+    out << "  \"cpu_ms\": ";
+    writeSummary(out, Summarize(cpuMilliseconds));
+    out << ",\n  \"gpu_ms\": ";
+    writeSummary(out, Summarize(gpuMilliseconds));
+    out << ",\n  \"cpu_frame_ms\": ";
+    writeArray(out, cpuMilliseconds);
+    out << ",\n  \"gpu_frame_ms\": ";
+    writeArray(out, gpuMilliseconds);
+    out << "\n}\n";
+}
+
+int FrameBenchmark::compare(std::ostream &log) const {
+    std::ifstream file { settings.Baseline };
+    std::stringstream text;
+    text << file.rdbuf();
+    vector<double> baselineCpu, baselineGpu;
+    if (!file || !readArray(text.str(), "cpu_frame_ms", baselineCpu) || !readArray(text.str(), "gpu_frame_ms", baselineGpu)) {
+        log << "benchmark: can't read the baseline " << settings.Baseline << endl;
+        return 2;
+    }
+    // the frames are compared pairwise, which only works when both runs flew the same frames
+    if (baselineCpu.size() != cpuMilliseconds.size() || baselineGpu.size() != gpuMilliseconds.size()) {
+        log << "benchmark: the baseline timed " << baselineCpu.size() << " frames, not " << cpuMilliseconds.size() << endl;
+        return 2;
+    }
+
+    bool regressed = false;
+    auto check = [&](char const *name, vector<double> const &samples, vector<double> const &baseline) {
+        double median = Summarize(samples).P50;
+        double baselineMedian = Summarize(baseline).P50;
+        double change = baselineMedian > 0.0 ? median / baselineMedian - 1.0 : 0.0;
+        double p = SlowerPValue(samples, baseline);
+        bool regression = change > settings.MaxRegression && p < settings.Significance;
+        regressed = regressed || regression;
+        log << "benchmark: " << name << " p50 " << std::fixed << std::setprecision(3) << median << " ms against " << baselineMedian << " ms ("
+            << std::showpos << change * 100.0 << std::noshowpos << "%), p = " << std::scientific << std::setprecision(2) << p
+            << (regression ? " REGRESSION" : "") << std::defaultfloat << endl;
+    };
+    check("cpu", cpuMilliseconds, baselineCpu);
+    check("gpu", gpuMilliseconds, baselineGpu);
+    return regressed ? 1 : 0;
+}
+
+int FrameBenchmark::Report(std::ostream &log, int width, int height) {
+    glFinish();
+    gpuMilliseconds.clear();
+    for (size_t i = 0; i + 1 < queries.size() && i / 2 < cpuMilliseconds.size(); i += 2) {
+        GLuint64 start = 0, end = 0;
+        glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(queries[i + 1], GL_QUERY_RESULT, &end);
+        gpuMilliseconds.push_back((end - start) / 1e6);
+    }
+
+    char const *renderer = reinterpret_cast<char const *>(glGetString(GL_RENDERER));
+    std::ofstream output { settings.Output };
+    writeJson(output, renderer != nullptr ? renderer : "unknown", width, height);
+    Summary cpu = Summarize(cpuMilliseconds);
+    Summary gpu = Summarize(gpuMilliseconds);
+    log << "benchmark: " << cpuMilliseconds.size() << " frames, cpu p50/p95/p99 " << std::fixed << std::setprecision(3) << cpu.P50 << "/" << cpu.P95
+        << "/" << cpu.P99 << " ms, gpu p50/p95/p99 " << gpu.P50 << "/" << gpu.P95 << "/" << gpu.P99 << " ms" << std::defaultfloat << endl;
+    if (!output) {
+        log << "benchmark: can't write " << settings.Output << endl;
+        return 2;
+    }
+    log << "benchmark: written to " << settings.Output << endl;
+
+    if (settings.Baseline.empty()) {
+        return 0;
+    }
+    return compare(log);
+}
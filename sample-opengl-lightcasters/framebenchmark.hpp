@@ -0,0 +1,86 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class Camera;
+
+// Reproducible frame timings, run with `./main --benchmark`, usually together with --headless. The camera follows a
+// scripted path instead of the mouse and keyboard, the scene's clock advances a fixed step per frame, and after a
+// few warmup frames a fixed number of frames is timed:
+//
+// - CPU time from the start of the frame until it is handed to the swap, on a steady clock.
+// - GPU time between GL_TIMESTAMP queries written at the same two points. Timestamps rather than GL_TIME_ELAPSED,
+//   since the scene already times parts of the frame with those and they can't nest.
+//
+// The results are written as JSON with the percentiles and every frame's timings, and can be compared against such
+// a file from an earlier run with the same frames. As both runs drew the same images frame by frame, the frames are
+// compared in pairs: a metric regressed when its median grew by more than MaxRegression and a one-sided Wilcoxon
+// signed-rank test over the pairs says the frames are slower with a p-value below Significance. Runs on the same
+// machine still drift by a few percent, which MaxRegression has to cover.
+class FrameBenchmark {
+    public:
+        // the scene's clock advances this much per frame, whatever the frame took
+        static constexpr float FRAME_TIME = 1.0f / 60.0f;
+        struct Keyframe {
+            float Time; // seconds
+            glm::vec3 Position;
+            float Yaw, Pitch;
+        };
+        struct Settings {
+            unsigned int Frames = 600;
+            unsigned int WarmupFrames = 60;
+            std::vector<Keyframe> CameraPath; // a loop through the scene when empty
+            std::string Output = "./benchmark.json";
+            std::string Baseline; // no comparison when empty
+            double Significance = 0.01;
+            double MaxRegression = 0.05; // growth of the median tolerated, as a fraction
+        };
+        struct Summary {
+            double Mean, Min, P50, P95, P99, Max;
+        };
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        Settings settings;
+        unsigned int frame;
+        Clock::time_point frameStart;
+        std::vector<GLuint> queries; // a start and an end timestamp per timed frame
+        std::vector<double> cpuMilliseconds;
+        std::vector<double> gpuMilliseconds;
+
+        bool isTimed() const { return frame >= settings.WarmupFrames && frame < settings.WarmupFrames + settings.Frames; }
+        void writeJson(std::ostream &out, std::string const &renderer, int width, int height) const;
+        // 0 when nothing regressed, 1 when something did, 2 without a usable baseline
+        int compare(std::ostream &log) const;
+    public:
+        explicit FrameBenchmark(Settings const &settings);
+        ~FrameBenchmark();
+        FrameBenchmark(FrameBenchmark const &) = delete;
+        FrameBenchmark &operator=(FrameBenchmark const &) = delete;
+
+        // Reads a camera path of "time x y z yaw pitch" lines, in seconds and degrees, sorted by time; # starts a
+        // comment. The path loops after its last keyframe.
+        static bool LoadCameraPath(std::string const &path, std::vector<Keyframe> &keyframes);
+        static Summary Summarize(std::vector<double> values);
+        // Probability of seeing samples this much slower than the baseline's same frames by chance, one-sided
+        // Wilcoxon signed-rank with the normal approximation
+        static double SlowerPValue(std::vector<double> const &samples, std::vector<double> const &baseline);
+
+        // the scene's clock, which only depends on the frame
+        float GetTime() const { return frame * FRAME_TIME; }
+        void PlaceCamera(Camera &camera) const;
+        bool IsFinished() const { return frame >= settings.WarmupFrames + settings.Frames; }
+
+        void BeginFrame();
+        // Call before swapping buffers
+        void EndFrame();
+        // Waits for the GPU, writes the results and compares them with the baseline; returns the process exit code,
+        // 1 for a regression and 2 when a file couldn't be read or written
+        int Report(std::ostream &log, int width, int height);
+};
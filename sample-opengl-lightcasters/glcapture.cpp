@@ -0,0 +1,487 @@
+#include "glcapture.hpp"
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+#include "glentrypoints.hpp"
+#include "gltrace.hpp"
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+namespace {
+    int const MAX_ARGUMENTS = 16;
+
+    // where the data behind a pointer argument is and how much of it there is
+    struct Extent {
+        bool InBuffer; // the pointer is an offset into the bound buffer
+        std::uint64_t Size;
+    };
+    using SizeRule = Extent (*)(std::uint64_t const *arguments);
+
+    struct EntryPoint {
+        char const *Name;
+        bool Declared;
+        GlObject Names[MAX_ARGUMENTS];
+        SizeRule Sizes[MAX_ARGUMENTS];
+        int StringCount; // argument with the number of strings, for arrays of them
+        int StringLengths; // argument with their lengths, folded into the strings, -1 if there is none
+        void (*Observe)(std::uint64_t const *arguments);
+        bool Warned;
+    };
+
+    struct PixelStore {
+        std::uint64_t Alignment = 4;
+        std::uint64_t RowLength = 0;
+        std::uint64_t ImageHeight = 0;
+        std::uint64_t Buffer = 0; // pixel pack or unpack buffer
+    };
+
+    vector<EntryPoint> entryPoints;
+    std::ofstream trace;
+    std::uint64_t bytesWritten = 0;
+    unsigned int frameCount = 0;
+    PixelStore unpack, pack;
+    // the names a glGen* call is writing, recorded after it returned
+    GLuint const *generated = nullptr;
+    std::uint32_t generatedCount = 0;
+
+    template <typename T>
+    void write(T value) {
+        trace.write(reinterpret_cast<char const *>(&value), sizeof(T));
+        bytesWritten += sizeof(T);
+    }
+
+    void writeBytes(void const *data, std::uint64_t size) {
+        trace.write(static_cast<char const *>(data), static_cast<std::streamsize>(size));
+        bytesWritten += size;
+    }
+
+    void warn(EntryPoint &entryPoint, char const *what) {
+        if (!entryPoint.Warned) {
+            cout << "capture: " << entryPoint.Name << " " << what << ", the replay will differ" << endl;
+            entryPoint.Warned = true;
+        }
+    }
+
+    std::uint64_t pixelSize(GLenum format, GLenum type) {
+        std::uint64_t components = 4;
+        switch (format) {
+            case GL_RED: case GL_GREEN: case GL_BLUE: case GL_RED_INTEGER: case GL_DEPTH_COMPONENT: case GL_STENCIL_INDEX:
+                components = 1;
+                break;
+            case GL_RG: case GL_RG_INTEGER: case GL_DEPTH_STENCIL:
+                components = 2;
+                break;
+            case GL_RGB: case GL_BGR: case GL_RGB_INTEGER: case GL_BGR_INTEGER:
+                components = 3;
+                break;
+        }
+        switch (type) {
+            case GL_UNSIGNED_BYTE: case GL_BYTE:
+                return components;
+            case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT:
+                return 2 * components;
+            case GL_UNSIGNED_INT: case GL_INT: case GL_FLOAT:
+                return 4 * components;
+            case GL_UNSIGNED_BYTE_3_3_2: case GL_UNSIGNED_BYTE_2_3_3_REV:
+                return 1;
+            case GL_UNSIGNED_SHORT_5_6_5: case GL_UNSIGNED_SHORT_5_6_5_REV: case GL_UNSIGNED_SHORT_4_4_4_4:
+            case GL_UNSIGNED_SHORT_4_4_4_4_REV: case GL_UNSIGNED_SHORT_5_5_5_1: case GL_UNSIGNED_SHORT_1_5_5_5_REV:
+                return 2;
+            case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+                return 8;
+            default: // the packed 32-bit types
+                return 4;
+        }
+    }
+
+    // Bytes the pixel store reads or writes for an image; the last row isn't padded to the alignment
+    Extent image(PixelStore const &store, std::uint64_t width, std::uint64_t height, std::uint64_t depth, std::uint64_t format, std::uint64_t type) {
+        if (width == 0 || height == 0 || depth == 0) {
+            return Extent { store.Buffer != 0, 0 };
+        }
+        std::uint64_t pixel = pixelSize(static_cast<GLenum>(format), static_cast<GLenum>(type));
+        std::uint64_t row = (store.RowLength > 0 ? store.RowLength : width) * pixel;
+        row = (row + store.Alignment - 1) / store.Alignment * store.Alignment;
+        std::uint64_t slice = row * (store.ImageHeight > 0 ? store.ImageHeight : height);
+        return Extent { store.Buffer != 0, slice * (depth - 1) + row * (height - 1) + width * pixel };
+    }
+
+    // one value, or four for the colors
+    Extent parameters(std::uint64_t name, std::uint64_t valueSize) {
+        bool color = name == GL_TEXTURE_BORDER_COLOR || name == GL_TEXTURE_SWIZZLE_RGBA;
+        return Extent { false, (color ? 4 : 1) * valueSize };
+    }
+
+    template <std::uint64_t Bytes>
+    Extent perCount(std::uint64_t const *arguments) {
+        return Extent { false, arguments[1] * Bytes };
+    }
+
+    Extent inElementOrArrayBuffer(std::uint64_t const *) {
+        return Extent { true, 0 };
+    }
+
+    struct SizeRuleEntry {
+        char const *EntryPoint;
+        int Argument;
+        SizeRule Size;
+    };
+
+    GLint textureLevel(std::uint64_t const *arguments, GLenum parameter);
+
+    // The sizes of the pointer arguments the GL 3.3 core functions read or write, when it isn't small
+    SizeRuleEntry const SIZE_RULES[] = {
+        { "glBufferData", 2, [](std::uint64_t const *a) { return Extent { false, a[1] }; } },
+        { "glBufferSubData", 3, [](std::uint64_t const *a) { return Extent { false, a[2] }; } },
+        { "glGetBufferSubData", 3, [](std::uint64_t const *a) { return Extent { false, a[2] }; } },
+        { "glTexImage1D", 7, [](std::uint64_t const *a) { return image(unpack, a[3], 1, 1, a[5], a[6]); } },
+        { "glTexImage2D", 8, [](std::uint64_t const *a) { return image(unpack, a[3], a[4], 1, a[6], a[7]); } },
+        { "glTexImage3D", 9, [](std::uint64_t const *a) { return image(unpack, a[3], a[4], a[5], a[7], a[8]); } },
+        { "glTexSubImage1D", 6, [](std::uint64_t const *a) { return image(unpack, a[3], 1, 1, a[4], a[5]); } },
+        { "glTexSubImage2D", 8, [](std::uint64_t const *a) { return image(unpack, a[4], a[5], 1, a[6], a[7]); } },
+        { "glTexSubImage3D", 10, [](std::uint64_t const *a) { return image(unpack, a[5], a[6], a[7], a[8], a[9]); } },
+        { "glCompressedTexImage1D", 6, [](std::uint64_t const *a) { return Extent { unpack.Buffer != 0, a[5] }; } },
+        { "glCompressedTexImage2D", 7, [](std::uint64_t const *a) { return Extent { unpack.Buffer != 0, a[6] }; } },
+        { "glCompressedTexImage3D", 8, [](std::uint64_t const *a) { return Extent { unpack.Buffer != 0, a[7] }; } },
+        { "glCompressedTexSubImage1D", 6, [](std::uint64_t const *a) { return Extent { unpack.Buffer != 0, a[5] }; } },
+        { "glCompressedTexSubImage2D", 8, [](std::uint64_t const *a) { return Extent { unpack.Buffer != 0, a[7] }; } },
+        { "glCompressedTexSubImage3D", 10, [](std::uint64_t const *a) { return Extent { unpack.Buffer != 0, a[9] }; } },
+        { "glReadPixels", 6, [](std::uint64_t const *a) { return image(pack, a[2], a[3], 1, a[4], a[5]); } },
+        { "glGetTexImage", 4, [](std::uint64_t const *a) {
+            return image(pack, textureLevel(a, GL_TEXTURE_WIDTH), textureLevel(a, GL_TEXTURE_HEIGHT), textureLevel(a, GL_TEXTURE_DEPTH), a[2], a[3]);
+        } },
+        { "glGetCompressedTexImage", 2, [](std::uint64_t const *a) {
+            return Extent { pack.Buffer != 0, static_cast<std::uint64_t>(textureLevel(a, GL_TEXTURE_COMPRESSED_IMAGE_SIZE)) };
+        } },
+        { "glVertexAttribPointer", 5, inElementOrArrayBuffer },
+        { "glVertexAttribIPointer", 4, inElementOrArrayBuffer },
+        { "glDrawElements", 3, inElementOrArrayBuffer },
+        { "glDrawElementsInstanced", 3, inElementOrArrayBuffer },
+        { "glDrawElementsBaseVertex", 3, inElementOrArrayBuffer },
+        { "glDrawElementsInstancedBaseVertex", 3, inElementOrArrayBuffer },
+        { "glDrawRangeElements", 5, inElementOrArrayBuffer },
+        { "glDrawRangeElementsBaseVertex", 5, inElementOrArrayBuffer },
+        { "glClearBufferiv", 2, [](std::uint64_t const *a) { return Extent { false, a[0] == GL_COLOR ? 16u : 4u }; } },
+        { "glClearBufferuiv", 2, [](std::uint64_t const *a) { return Extent { false, a[0] == GL_COLOR ? 16u : 4u }; } },
+        { "glClearBufferfv", 2, [](std::uint64_t const *a) { return Extent { false, a[0] == GL_COLOR ? 16u : 4u }; } },
+        { "glDrawBuffers", 1, [](std::uint64_t const *a) { return Extent { false, a[0] * sizeof(GLenum) }; } },
+        { "glTexParameterfv", 2, [](std::uint64_t const *a) { return parameters(a[1], sizeof(GLfloat)); } },
+        { "glTexParameteriv", 2, [](std::uint64_t const *a) { return parameters(a[1], sizeof(GLint)); } },
+        { "glTexParameterIiv", 2, [](std::uint64_t const *a) { return parameters(a[1], sizeof(GLint)); } },
+        { "glTexParameterIuiv", 2, [](std::uint64_t const *a) { return parameters(a[1], sizeof(GLuint)); } },
+        { "glSamplerParameterfv", 2, [](std::uint64_t const *a) { return parameters(a[1], sizeof(GLfloat)); } },
+        { "glSamplerParameteriv", 2, [](std::uint64_t const *a) { return parameters(a[1], sizeof(GLint)); } },
+        { "glSamplerParameterIiv", 2, [](std::uint64_t const *a) { return parameters(a[1], sizeof(GLint)); } },
+        { "glSamplerParameterIuiv", 2, [](std::uint64_t const *a) { return parameters(a[1], sizeof(GLuint)); } },
+        { "glGetShaderInfoLog", 3, [](std::uint64_t const *a) { return Extent { false, a[1] }; } },
+        { "glGetProgramInfoLog", 3, [](std::uint64_t const *a) { return Extent { false, a[1] }; } },
+        { "glGetShaderSource", 3, [](std::uint64_t const *a) { return Extent { false, a[1] }; } },
+        { "glGetActiveAttrib", 6, [](std::uint64_t const *a) { return Extent { false, a[2] }; } },
+        { "glGetActiveUniform", 6, [](std::uint64_t const *a) { return Extent { false, a[2] }; } },
+        { "glGetActiveUniformName", 4, [](std::uint64_t const *a) { return Extent { false, a[2] }; } },
+        { "glGetActiveUniformBlockName", 4, [](std::uint64_t const *a) { return Extent { false, a[2] }; } },
+        { "glUniform1fv", 2, perCount<sizeof(GLfloat)> },
+        { "glUniform2fv", 2, perCount<2 * sizeof(GLfloat)> },
+        { "glUniform3fv", 2, perCount<3 * sizeof(GLfloat)> },
+        { "glUniform4fv", 2, perCount<4 * sizeof(GLfloat)> },
+        { "glUniform1iv", 2, perCount<sizeof(GLint)> },
+        { "glUniform2iv", 2, perCount<2 * sizeof(GLint)> },
+        { "glUniform3iv", 2, perCount<3 * sizeof(GLint)> },
+        { "glUniform4iv", 2, perCount<4 * sizeof(GLint)> },
+        { "glUniform1uiv", 2, perCount<sizeof(GLuint)> },
+        { "glUniform2uiv", 2, perCount<2 * sizeof(GLuint)> },
+        { "glUniform3uiv", 2, perCount<3 * sizeof(GLuint)> },
+        { "glUniform4uiv", 2, perCount<4 * sizeof(GLuint)> },
+        { "glUniformMatrix2fv", 3, perCount<4 * sizeof(GLfloat)> },
+        { "glUniformMatrix3fv", 3, perCount<9 * sizeof(GLfloat)> },
+        { "glUniformMatrix4fv", 3, perCount<16 * sizeof(GLfloat)> },
+        { "glUniformMatrix2x3fv", 3, perCount<6 * sizeof(GLfloat)> },
+        { "glUniformMatrix3x2fv", 3, perCount<6 * sizeof(GLfloat)> },
+        { "glUniformMatrix2x4fv", 3, perCount<8 * sizeof(GLfloat)> },
+        { "glUniformMatrix4x2fv", 3, perCount<8 * sizeof(GLfloat)> },
+        { "glUniformMatrix3x4fv", 3, perCount<12 * sizeof(GLfloat)> },
+        { "glUniformMatrix4x3fv", 3, perCount<12 * sizeof(GLfloat)> },
+    };
+
+    struct StringRuleEntry {
+        char const *EntryPoint;
+        int Count, Lengths;
+    };
+
+    StringRuleEntry const STRING_RULES[] = {
+        { "glShaderSource", 1, 3 },
+        { "glTransformFeedbackVaryings", 1, -1 },
+        { "glGetUniformIndices", 1, -1 },
+    };
+
+    // the state the sizes depend on
+    void observePixelStore(std::uint64_t const *arguments) {
+        switch (arguments[0]) {
+            case GL_UNPACK_ALIGNMENT: unpack.Alignment = arguments[1]; break;
+            case GL_UNPACK_ROW_LENGTH: unpack.RowLength = arguments[1]; break;
+            case GL_UNPACK_IMAGE_HEIGHT: unpack.ImageHeight = arguments[1]; break;
+            case GL_PACK_ALIGNMENT: pack.Alignment = arguments[1]; break;
+            case GL_PACK_ROW_LENGTH: pack.RowLength = arguments[1]; break;
+            case GL_PACK_IMAGE_HEIGHT: pack.ImageHeight = arguments[1]; break;
+        }
+    }
+
+    void observeBindBuffer(std::uint64_t const *arguments) {
+        if (arguments[0] == GL_PIXEL_UNPACK_BUFFER) {
+            unpack.Buffer = arguments[1];
+        } else if (arguments[0] == GL_PIXEL_PACK_BUFFER) {
+            pack.Buffer = arguments[1];
+        }
+    }
+
+    template <typename T>
+    std::uint64_t toInteger(T value) {
+        if constexpr (std::is_pointer_v<T>) {
+            return reinterpret_cast<std::uintptr_t>(value);
+        } else if constexpr (std::is_integral_v<T>) {
+            return static_cast<std::uint64_t>(value);
+        } else {
+            return 0;
+        }
+    }
+
+    void writeString(GLchar const *string) {
+        if (string == nullptr) {
+            write(GlPayload::Null);
+            return;
+        }
+        std::uint32_t size = static_cast<std::uint32_t>(std::strlen(string) + 1);
+        write(GlPayload::Data);
+        write(size);
+        writeBytes(string, size);
+    }
+
+    void writeStrings(EntryPoint const &entryPoint, GLchar const *const *strings, std::uint64_t const *arguments) {
+        if (strings == nullptr || entryPoint.StringCount < 0) {
+            write(GlPayload::Null);
+            return;
+        }
+        std::uint32_t count = static_cast<std::uint32_t>(arguments[entryPoint.StringCount]);
+        GLint const *lengths = entryPoint.StringLengths < 0 ? nullptr : reinterpret_cast<GLint const *>(arguments[entryPoint.StringLengths]);
+        write(GlPayload::Strings);
+        write(count);
+        for (std::uint32_t i = 0; i < count; i++) {
+            std::uint32_t length = static_cast<std::uint32_t>(lengths != nullptr && lengths[i] >= 0 ? lengths[i] : std::strlen(strings[i]));
+            write(length);
+            writeBytes(strings[i], length);
+        }
+    }
+
+    void writePointer(EntryPoint &entryPoint, int index, void const *pointer, bool input, std::uint64_t const *arguments) {
+        // the lengths of strings are folded into them
+        if (pointer == nullptr || index == entryPoint.StringLengths) {
+            write(GlPayload::Null);
+            return;
+        }
+        if (entryPoint.Names[index] != GlObject::None) {
+            std::uint32_t count = static_cast<std::uint32_t>(arguments[0]);
+            write(input ? GlPayload::Names : GlPayload::Generated);
+            write(count);
+            if (input) {
+                writeBytes(pointer, count * sizeof(GLuint));
+            } else {
+                generated = static_cast<GLuint const *>(pointer);
+                generatedCount = count;
+            }
+            return;
+        }
+        SizeRule size = entryPoint.Sizes[index];
+        if (size == nullptr) {
+            // outputs without a rule are the few values of the glGet*v functions
+            if (input) {
+                warn(entryPoint, "reads data of unknown size");
+                write(GlPayload::Null);
+            } else {
+                write(GlPayload::Output);
+                write(std::uint32_t { 0 });
+            }
+            return;
+        }
+        Extent extent = size(arguments);
+        if (extent.InBuffer) {
+            write(GlPayload::Offset);
+            write(static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(pointer)));
+        } else if (input) {
+            write(GlPayload::Data);
+            write(static_cast<std::uint32_t>(extent.Size));
+            writeBytes(pointer, extent.Size);
+        } else {
+            write(GlPayload::Output);
+            write(static_cast<std::uint32_t>(extent.Size));
+        }
+    }
+
+    template <typename T>
+    void writeArgument(EntryPoint &entryPoint, int index, T value, std::uint64_t const *arguments) {
+        if constexpr (std::is_same_v<T, GLsync>) {
+            write(static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(value)));
+        } else if constexpr (std::is_same_v<T, GLchar const *const *>) {
+            writeStrings(entryPoint, value, arguments);
+        } else if constexpr (std::is_same_v<T, GLchar const *>) {
+            writeString(value);
+        } else if constexpr (std::is_pointer_v<T>) {
+            writePointer(entryPoint, index, value, std::is_const_v<std::remove_pointer_t<T>>, arguments);
+        } else {
+            write(value);
+        }
+    }
+
+    void writeGenerated() {
+        if (generated != nullptr) {
+            writeBytes(generated, generatedCount * sizeof(GLuint));
+            generated = nullptr;
+        }
+    }
+
+    template <auto *Slot, typename Proc = std::remove_pointer_t<decltype(Slot)>>
+    struct Hook;
+
+    template <auto *Slot, typename R, typename... Args>
+    struct Hook<Slot, R (APIENTRYP)(Args...)> {
+        static_assert(sizeof...(Args) <= MAX_ARGUMENTS);
+        inline static R (APIENTRYP real)(Args...) = nullptr;
+        inline static std::uint16_t id = 0;
+
+        static R APIENTRY Call(Args... args) {
+            EntryPoint &entryPoint = entryPoints[id];
+            std::uint64_t arguments[sizeof...(Args) + 1] = { toInteger(args)... };
+            if (entryPoint.Observe != nullptr) {
+                entryPoint.Observe(arguments);
+            }
+            if (!entryPoint.Declared) {
+                std::uint16_t length = static_cast<std::uint16_t>(std::strlen(entryPoint.Name));
+                write(GL_TRACE_DECLARE);
+                write(id);
+                write(length);
+                writeBytes(entryPoint.Name, length);
+                entryPoint.Declared = true;
+            }
+            write(id);
+            [[maybe_unused]] int index = 0;
+            (writeArgument(entryPoint, index++, args, arguments), ...);
+            if constexpr (std::is_void_v<R>) {
+                real(args...);
+                writeGenerated();
+            } else {
+                R result = real(args...);
+                writeGenerated();
+                // the pointers glGetString and glMapBuffer return aren't the replay's business
+                if constexpr (std::is_same_v<R, GLsync>) {
+                    write(static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(result)));
+                } else if constexpr (!std::is_pointer_v<R>) {
+                    write(result);
+                }
+                return result;
+            }
+        }
+
+        static void Install(char const *name) {
+            if (*Slot == nullptr) {
+                return;
+            }
+            EntryPoint entryPoint { name, false, {}, {}, -1, -1, nullptr, false };
+            for (int i = 0; i < static_cast<int>(sizeof...(Args)); i++) {
+                entryPoint.Names[i] = GetNameArgument(name, i);
+            }
+            for (auto const &rule : SIZE_RULES) {
+                if (std::strcmp(rule.EntryPoint, name) == 0) {
+                    entryPoint.Sizes[rule.Argument] = rule.Size;
+                }
+            }
+            for (auto const &rule : STRING_RULES) {
+                if (std::strcmp(rule.EntryPoint, name) == 0) {
+                    entryPoint.StringCount = rule.Count;
+                    entryPoint.StringLengths = rule.Lengths;
+                }
+            }
+            if (std::strcmp(name, "glPixelStorei") == 0) {
+                entryPoint.Observe = observePixelStore;
+            } else if (std::strcmp(name, "glBindBuffer") == 0) {
+                entryPoint.Observe = observeBindBuffer;
+            } else if (std::strncmp(name, "glMapBuffer", 11) == 0) {
+                entryPoint.Observe = [](std::uint64_t const *) { warn(entryPoints[id], "writes through a mapping that aren't recorded"); };
+            }
+            real = *Slot;
+            id = static_cast<std::uint16_t>(entryPoints.size());
+            entryPoints.push_back(entryPoint);
+            *Slot = &Call;
+        }
+
+        static void Uninstall() {
+            if (real != nullptr) {
+                *Slot = real;
+                real = nullptr;
+            }
+        }
+    };
+
+    // size of the texture level glGetTexImage reads, asked from the driver past the capture
+    GLint textureLevel(std::uint64_t const *arguments, GLenum parameter) {
+        GLint value = 0;
+        Hook<&glad_glGetTexLevelParameteriv>::real(static_cast<GLenum>(arguments[0]), static_cast<GLint>(arguments[1]), parameter, &value);
+        return value;
+    }
+}
+
+bool GlCapture::Install(string const &path, int width, int height) {
+    trace.open(path, std::ios::binary);
+    if (!trace) {
+        return false;
+    }
+    bytesWritten = 0;
+    frameCount = 0;
+    write(GL_TRACE_MAGIC);
+    write(GL_TRACE_VERSION);
+    write(static_cast<std::uint32_t>(width));
+    write(static_cast<std::uint32_t>(height));
+    entryPoints.clear();
+#define INSTALL_HOOK(name) Hook<&glad_##name>::Install(#name);
+    GL_ENTRY_POINTS(INSTALL_HOOK)
+#undef INSTALL_HOOK
+    return true;
+}
+
+bool GlCapture::IsInstalled() {
+    return trace.is_open();
+}
+
+void GlCapture::EndFrame() {
+    if (IsInstalled()) {
+        write(GL_TRACE_FRAME);
+        frameCount++;
+    }
+}
+
+bool GlCapture::Finish() {
+    if (!IsInstalled()) {
+        return false;
+    }
+#define UNINSTALL_HOOK(name) Hook<&glad_##name>::Uninstall();
+    GL_ENTRY_POINTS(UNINSTALL_HOOK)
+#undef UNINSTALL_HOOK
+    write(GL_TRACE_END);
+    trace.close();
+    return !trace.fail();
+}
+
+unsigned int GlCapture::GetFrameCount() {
+    return frameCount;
+}
+
+std::uint64_t GlCapture::GetBytesWritten() {
+    return bytesWritten;
+}
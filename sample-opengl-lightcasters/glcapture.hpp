@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Records every GL call the sample makes into a trace (see gltrace.hpp) that ./replay can issue again without the
+// sample or its assets, run with `./main --capture FILE`. Like GlIntercept it swaps glad's function pointers for
+// wrappers, which write each call with the data its pointers point to: buffer and texture contents, shader sources,
+// uniform values and so on. The sizes come from the arguments and the pixel store state the wrappers follow; a
+// pointer whose size isn't known is recorded as null, with a warning.
+//
+// The trace starts with the context, so it holds everything the frames depend on. Writes through mapped buffers and
+// the few functions GpuCuller loads itself aren't seen, so the capture leaves GPU culling off.
+class GlCapture {
+    public:
+        // Opens the trace and wraps glad's function pointers; call right after gladLoadGLLoader, before any other
+        // GL call. width and height are the default framebuffer's. False when the file can't be written.
+        static bool Install(std::string const &path, int width, int height);
+        static bool IsInstalled();
+        // Marks the end of a frame; call once the frame is handed to the swap
+        static void EndFrame();
+        // Ends and closes the trace, false when writing it failed
+        static bool Finish();
+
+        static unsigned int GetFrameCount();
+        static std::uint64_t GetBytesWritten();
+};
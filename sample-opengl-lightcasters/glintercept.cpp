@@ -0,0 +1,279 @@
+#include "glintercept.hpp"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "glentrypoints.hpp"
+
+using std::string;
+using std::vector;
+
+namespace {
+    struct EntryPoint {
+        char const *Name;
+        bool Stalls; // every call waits for the GPU
+        unsigned int Calls, Redundant, Stalled; // this frame's
+    };
+
+    // the binds the redundancy check follows
+    struct BindState {
+        GLuint Program = 0;
+        GLuint VertexArray = 0;
+        GLenum ActiveTexture = GL_TEXTURE0;
+        std::unordered_map<std::uint64_t, GLuint> Textures; // by unit and target
+        GLuint PixelPackBuffer = 0;
+        std::unordered_set<GLuint> AvailableQueries; // results that can be read without waiting
+    };
+
+    vector<EntryPoint> entryPoints;
+    BindState state;
+    std::ofstream summary;
+    unsigned long long frame = 0;
+
+    bool stallsByName(char const *name) {
+        return std::strncmp(name, "glGet", 5) == 0 || std::strcmp(name, "glFinish") == 0 || std::strcmp(name, "glClientWaitSync") == 0;
+    }
+
+    // A wrapper for the glad pointer at Slot, with the driver's function and the entry point it counts under
+    template <auto *Slot, typename Proc = std::remove_pointer_t<decltype(Slot)>>
+    struct Hook;
+
+    template <auto *Slot, typename R, typename... Args>
+    struct Hook<Slot, R (APIENTRYP)(Args...)> {
+        inline static R (APIENTRYP real)(Args...) = nullptr;
+        inline static unsigned int id = 0;
+
+        static R APIENTRY Call(Args... args) {
+            EntryPoint &entryPoint = entryPoints[id];
+            entryPoint.Calls++;
+            entryPoint.Stalled += entryPoint.Stalls;
+            return real(args...);
+        }
+        static void Install(char const *name) {
+            // functions the context doesn't have stay null
+            if (*Slot == nullptr) {
+                return;
+            }
+            real = *Slot;
+            id = static_cast<unsigned int>(entryPoints.size());
+            entryPoints.push_back(EntryPoint { name, stallsByName(name), 0, 0, 0 });
+            *Slot = &Call;
+        }
+    };
+
+    // Counts a call whose arguments decide whether it is redundant or stalls, instead of its name
+    template <auto *Slot>
+    void count(bool redundant, bool stalls) {
+        EntryPoint &entryPoint = entryPoints[Hook<Slot>::id];
+        entryPoint.Calls++;
+        entryPoint.Redundant += redundant;
+        entryPoint.Stalled += stalls;
+    }
+
+    std::uint64_t textureKey(GLenum unit, GLenum target) {
+        return static_cast<std::uint64_t>(unit) << 32 | target;
+    }
+
+    void APIENTRY useProgram(GLuint program) {
+        count<&glad_glUseProgram>(program == state.Program, false);
+        state.Program = program;
+        Hook<&glad_glUseProgram>::real(program);
+    }
+
+    void APIENTRY bindVertexArray(GLuint array) {
+        count<&glad_glBindVertexArray>(array == state.VertexArray, false);
+        state.VertexArray = array;
+        Hook<&glad_glBindVertexArray>::real(array);
+    }
+
+    void APIENTRY activeTexture(GLenum texture) {
+        count<&glad_glActiveTexture>(false, false);
+        state.ActiveTexture = texture;
+        Hook<&glad_glActiveTexture>::real(texture);
+    }
+
+    void APIENTRY bindTexture(GLenum target, GLuint texture) {
+        // an unknown binding is 0, which it is on a new context
+        GLuint &bound = state.Textures[textureKey(state.ActiveTexture, target)];
+        count<&glad_glBindTexture>(texture == bound, false);
+        bound = texture;
+        Hook<&glad_glBindTexture>::real(target, texture);
+    }
+
+    void APIENTRY bindBuffer(GLenum target, GLuint buffer) {
+        count<&glad_glBindBuffer>(false, false);
+        if (target == GL_PIXEL_PACK_BUFFER) {
+            state.PixelPackBuffer = buffer;
+        }
+        Hook<&glad_glBindBuffer>::real(target, buffer);
+    }
+
+    // deleting a bound object unbinds it, and a new object may get its name
+    void APIENTRY deleteProgram(GLuint program) {
+        count<&glad_glDeleteProgram>(false, false);
+        if (program == state.Program) {
+            state.Program = 0;
+        }
+        Hook<&glad_glDeleteProgram>::real(program);
+    }
+
+    void APIENTRY deleteVertexArrays(GLsizei n, GLuint const *arrays) {
+        count<&glad_glDeleteVertexArrays>(false, false);
+        if (std::find(arrays, arrays + n, state.VertexArray) != arrays + n) {
+            state.VertexArray = 0;
+        }
+        Hook<&glad_glDeleteVertexArrays>::real(n, arrays);
+    }
+
+    void APIENTRY deleteTextures(GLsizei n, GLuint const *textures) {
+        count<&glad_glDeleteTextures>(false, false);
+        for (auto &[key, bound] : state.Textures) {
+            if (std::find(textures, textures + n, bound) != textures + n) {
+                bound = 0;
+            }
+        }
+        Hook<&glad_glDeleteTextures>::real(n, textures);
+    }
+
+    void APIENTRY deleteBuffers(GLsizei n, GLuint const *buffers) {
+        count<&glad_glDeleteBuffers>(false, false);
+        if (std::find(buffers, buffers + n, state.PixelPackBuffer) != buffers + n) {
+            state.PixelPackBuffer = 0;
+        }
+        Hook<&glad_glDeleteBuffers>::real(n, buffers);
+    }
+
+    // into a pixel pack buffer the copy is queued like any other command
+    void APIENTRY readPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void *pixels) {
+        count<&glad_glReadPixels>(false, state.PixelPackBuffer == 0);
+        Hook<&glad_glReadPixels>::real(x, y, width, height, format, type, pixels);
+    }
+
+    void *APIENTRY mapBuffer(GLenum target, GLenum access) {
+        count<&glad_glMapBuffer>(false, true);
+        return Hook<&glad_glMapBuffer>::real(target, access);
+    }
+
+    void *APIENTRY mapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+        count<&glad_glMapBufferRange>(false, !(access & GL_MAP_UNSYNCHRONIZED_BIT));
+        return Hook<&glad_glMapBufferRange>::real(target, offset, length, access);
+    }
+
+    // a query started again has a new result on the way
+    void APIENTRY beginQuery(GLenum target, GLuint id) {
+        count<&glad_glBeginQuery>(false, false);
+        state.AvailableQueries.erase(id);
+        Hook<&glad_glBeginQuery>::real(target, id);
+    }
+
+    void APIENTRY queryCounter(GLuint id, GLenum target) {
+        count<&glad_glQueryCounter>(false, false);
+        state.AvailableQueries.erase(id);
+        Hook<&glad_glQueryCounter>::real(id, target);
+    }
+
+    // asking whether a result is available doesn't wait, reading the result does unless the answer was yes
+    template <auto *Slot, typename T>
+    void APIENTRY getQueryObject(GLuint id, GLenum pname, T *params) {
+        bool stalls = pname == GL_QUERY_RESULT && state.AvailableQueries.erase(id) == 0;
+        count<Slot>(false, stalls);
+        Hook<Slot>::real(id, pname, params);
+        if (pname == GL_QUERY_RESULT_AVAILABLE && *params) {
+            state.AvailableQueries.insert(id);
+        }
+    }
+
+    // Replaces the counting wrapper of a loaded entry point with one that looks at the arguments
+    template <auto *Slot>
+    void replace(std::remove_pointer_t<decltype(Slot)> wrapper) {
+        if (Hook<Slot>::real != nullptr) {
+            *Slot = wrapper;
+        }
+    }
+
+    // "glBindTexture 12, glUseProgram 3" by descending count
+    void writeCounts(char const *label, unsigned int EntryPoint::*field) {
+        vector<EntryPoint const *> counted;
+        for (auto const &entryPoint : entryPoints) {
+            if (entryPoint.*field > 0) {
+                counted.push_back(&entryPoint);
+            }
+        }
+        if (counted.empty()) {
+            return;
+        }
+        std::stable_sort(counted.begin(), counted.end(), [&](EntryPoint const *a, EntryPoint const *b) { return a->*field > b->*field; });
+        summary << "  " << label << ":";
+        for (size_t i = 0; i < counted.size(); i++) {
+            summary << (i == 0 ? " " : ", ") << counted[i]->Name << " " << counted[i]->*field;
+        }
+        summary << "\n";
+    }
+}
+
+bool GlIntercept::Install(string const &path) {
+    summary.open(path);
+    if (!summary) {
+        return false;
+    }
+    entryPoints.clear();
+#define INSTALL_HOOK(name) Hook<&glad_##name>::Install(#name);
+    GL_ENTRY_POINTS(INSTALL_HOOK)
+#undef INSTALL_HOOK
+    replace<&glad_glUseProgram>(useProgram);
+    replace<&glad_glBindVertexArray>(bindVertexArray);
+    replace<&glad_glActiveTexture>(activeTexture);
+    replace<&glad_glBindTexture>(bindTexture);
+    replace<&glad_glBindBuffer>(bindBuffer);
+    replace<&glad_glDeleteProgram>(deleteProgram);
+    replace<&glad_glDeleteVertexArrays>(deleteVertexArrays);
+    replace<&glad_glDeleteTextures>(deleteTextures);
+    replace<&glad_glDeleteBuffers>(deleteBuffers);
+    replace<&glad_glReadPixels>(readPixels);
+    replace<&glad_glMapBuffer>(mapBuffer);
+    replace<&glad_glMapBufferRange>(mapBufferRange);
+    replace<&glad_glBeginQuery>(beginQuery);
+    replace<&glad_glQueryCounter>(queryCounter);
+    replace<&glad_glGetQueryObjectiv>(getQueryObject<&glad_glGetQueryObjectiv, GLint>);
+    replace<&glad_glGetQueryObjectuiv>(getQueryObject<&glad_glGetQueryObjectuiv, GLuint>);
+    replace<&glad_glGetQueryObjecti64v>(getQueryObject<&glad_glGetQueryObjecti64v, GLint64>);
+    replace<&glad_glGetQueryObjectui64v>(getQueryObject<&glad_glGetQueryObjectui64v, GLuint64>);
+    state = BindState {};
+    frame = 0;
+    return true;
+}
+
+bool GlIntercept::IsInstalled() {
+    return summary.is_open();
+}
+
+void GlIntercept::EndFrame() {
+    if (!IsInstalled()) {
+        return;
+    }
+    unsigned int calls = 0, redundant = 0, stalled = 0;
+    for (auto const &entryPoint : entryPoints) {
+        calls += entryPoint.Calls;
+        redundant += entryPoint.Redundant;
+        stalled += entryPoint.Stalled;
+    }
+    // the first frame also has everything done before the loop
+    summary << "frame " << frame << (frame == 0 ? " (with startup)" : "") << ": " << calls << " calls, " << redundant << " redundant binds, "
+            << stalled << " stalls\n";
+    writeCounts("calls", &EntryPoint::Calls);
+    writeCounts("redundant", &EntryPoint::Redundant);
+    writeCounts("stalls", &EntryPoint::Stalled);
+    summary.flush();
+    for (auto &entryPoint : entryPoints) {
+        entryPoint.Calls = entryPoint.Redundant = entryPoint.Stalled = 0;
+    }
+    frame++;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+
+// Counts the GL calls the sample makes, run with `./main --gl-calls FILE`. Every GL function is called through one
+// of glad's function pointers, so Install swaps each loaded pointer for a wrapper that counts the call and then
+// calls the driver; nothing changes when it isn't installed. The few 4.3 functions GpuCuller loads itself bypass it.
+//
+// For every frame it writes the calls per entry point, plus two kinds of calls worth a look:
+// - redundant binds, a program, vertex array or texture bound again where it already was
+// - stalls, calls that wait for the GPU to catch up: glGet*, glFinish, glClientWaitSync, glReadPixels into client
+//   memory, glMapBuffer and glMapBufferRange without GL_MAP_UNSYNCHRONIZED_BIT, and query results read before
+//   GL_QUERY_RESULT_AVAILABLE said they're ready
+class GlIntercept {
+    public:
+        // Wraps glad's function pointers and opens the summary; call once after gladLoadGLLoader. False when the file
+        // can't be written.
+        static bool Install(std::string const &path);
+        static bool IsInstalled();
+        // Writes the frame's summary and starts counting the next one; call once the frame is handed to the swap
+        static void EndFrame();
+};
@@ -0,0 +1,123 @@
+#include "gltrace.hpp"
+
+#include <cstring>
+
+namespace {
+    struct NameArgument {
+        char const *EntryPoint;
+        int Argument; // -1 for the result
+        GlObject Object;
+    };
+
+    // the GL 3.3 core functions that take or make names
+    NameArgument const NAME_ARGUMENTS[] = {
+        { "glGenBuffers", 1, GlObject::Buffer },
+        { "glDeleteBuffers", 1, GlObject::Buffer },
+        { "glIsBuffer", 0, GlObject::Buffer },
+        { "glBindBuffer", 1, GlObject::Buffer },
+        { "glBindBufferBase", 2, GlObject::Buffer },
+        { "glBindBufferRange", 2, GlObject::Buffer },
+        { "glGenTextures", 1, GlObject::Texture },
+        { "glDeleteTextures", 1, GlObject::Texture },
+        { "glIsTexture", 0, GlObject::Texture },
+        { "glBindTexture", 1, GlObject::Texture },
+        { "glFramebufferTexture", 2, GlObject::Texture },
+        { "glFramebufferTexture1D", 3, GlObject::Texture },
+        { "glFramebufferTexture2D", 3, GlObject::Texture },
+        { "glFramebufferTexture3D", 3, GlObject::Texture },
+        { "glFramebufferTextureLayer", 2, GlObject::Texture },
+        { "glTexBuffer", 2, GlObject::Buffer },
+        { "glGenVertexArrays", 1, GlObject::VertexArray },
+        { "glDeleteVertexArrays", 1, GlObject::VertexArray },
+        { "glIsVertexArray", 0, GlObject::VertexArray },
+        { "glBindVertexArray", 0, GlObject::VertexArray },
+        { "glGenFramebuffers", 1, GlObject::Framebuffer },
+        { "glDeleteFramebuffers", 1, GlObject::Framebuffer },
+        { "glIsFramebuffer", 0, GlObject::Framebuffer },
+        { "glBindFramebuffer", 1, GlObject::Framebuffer },
+        { "glGenRenderbuffers", 1, GlObject::Renderbuffer },
+        { "glDeleteRenderbuffers", 1, GlObject::Renderbuffer },
+        { "glIsRenderbuffer", 0, GlObject::Renderbuffer },
+        { "glBindRenderbuffer", 1, GlObject::Renderbuffer },
+        { "glFramebufferRenderbuffer", 3, GlObject::Renderbuffer },
+        { "glGenQueries", 1, GlObject::Query },
+        { "glDeleteQueries", 1, GlObject::Query },
+        { "glIsQuery", 0, GlObject::Query },
+        { "glBeginQuery", 1, GlObject::Query },
+        { "glQueryCounter", 0, GlObject::Query },
+        { "glGetQueryObjectiv", 0, GlObject::Query },
+        { "glGetQueryObjectuiv", 0, GlObject::Query },
+        { "glGetQueryObjecti64v", 0, GlObject::Query },
+        { "glGetQueryObjectui64v", 0, GlObject::Query },
+        { "glBeginConditionalRender", 0, GlObject::Query },
+        { "glCreateShader", -1, GlObject::Program },
+        { "glDeleteShader", 0, GlObject::Program },
+        { "glIsShader", 0, GlObject::Program },
+        { "glShaderSource", 0, GlObject::Program },
+        { "glCompileShader", 0, GlObject::Program },
+        { "glGetShaderiv", 0, GlObject::Program },
+        { "glGetShaderInfoLog", 0, GlObject::Program },
+        { "glGetShaderSource", 0, GlObject::Program },
+        { "glCreateProgram", -1, GlObject::Program },
+        { "glDeleteProgram", 0, GlObject::Program },
+        { "glIsProgram", 0, GlObject::Program },
+        { "glAttachShader", 0, GlObject::Program },
+        { "glAttachShader", 1, GlObject::Program },
+        { "glDetachShader", 0, GlObject::Program },
+        { "glDetachShader", 1, GlObject::Program },
+        { "glLinkProgram", 0, GlObject::Program },
+        { "glValidateProgram", 0, GlObject::Program },
+        { "glUseProgram", 0, GlObject::Program },
+        { "glGetProgramiv", 0, GlObject::Program },
+        { "glGetProgramInfoLog", 0, GlObject::Program },
+        { "glGetAttachedShaders", 0, GlObject::Program },
+        { "glBindAttribLocation", 0, GlObject::Program },
+        { "glGetAttribLocation", 0, GlObject::Program },
+        { "glBindFragDataLocation", 0, GlObject::Program },
+        { "glBindFragDataLocationIndexed", 0, GlObject::Program },
+        { "glGetFragDataLocation", 0, GlObject::Program },
+        { "glGetActiveAttrib", 0, GlObject::Program },
+        { "glGetActiveUniform", 0, GlObject::Program },
+        { "glTransformFeedbackVaryings", 0, GlObject::Program },
+        { "glGetUniformLocation", 0, GlObject::Program },
+        { "glGetUniformLocation", -1, GlObject::UniformLocation },
+        { "glGetUniformfv", 0, GlObject::Program },
+        { "glGetUniformfv", 1, GlObject::UniformLocation },
+        { "glGetUniformiv", 0, GlObject::Program },
+        { "glGetUniformiv", 1, GlObject::UniformLocation },
+        { "glGetUniformuiv", 0, GlObject::Program },
+        { "glGetUniformuiv", 1, GlObject::UniformLocation },
+        { "glGetUniformBlockIndex", 0, GlObject::Program },
+        { "glGetUniformBlockIndex", -1, GlObject::UniformBlock },
+        { "glUniformBlockBinding", 0, GlObject::Program },
+        { "glUniformBlockBinding", 1, GlObject::UniformBlock },
+        { "glGetActiveUniformBlockiv", 0, GlObject::Program },
+        { "glGetActiveUniformBlockiv", 1, GlObject::UniformBlock },
+        { "glGenSamplers", 1, GlObject::Sampler },
+        { "glDeleteSamplers", 1, GlObject::Sampler },
+        { "glIsSampler", 0, GlObject::Sampler },
+        { "glBindSampler", 1, GlObject::Sampler },
+        { "glSamplerParameteri", 0, GlObject::Sampler },
+        { "glSamplerParameteriv", 0, GlObject::Sampler },
+        { "glSamplerParameterf", 0, GlObject::Sampler },
+        { "glSamplerParameterfv", 0, GlObject::Sampler },
+        { "glFenceSync", -1, GlObject::Sync },
+        { "glDeleteSync", 0, GlObject::Sync },
+        { "glIsSync", 0, GlObject::Sync },
+        { "glClientWaitSync", 0, GlObject::Sync },
+        { "glWaitSync", 0, GlObject::Sync },
+    };
+}
+
+GlObject GetNameArgument(char const *entryPoint, int argument) {
+    // every glUniform* call but the block binding sets a location of the program in use
+    if (argument == 0 && std::strncmp(entryPoint, "glUniform", 9) == 0 && std::strcmp(entryPoint, "glUniformBlockBinding") != 0) {
+        return GlObject::UniformLocation;
+    }
+    for (auto const &name : NAME_ARGUMENTS) {
+        if (name.Argument == argument && std::strcmp(name.EntryPoint, entryPoint) == 0) {
+            return name.Object;
+        }
+    }
+    return GlObject::None;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+
+// The binary trace `./main --capture FILE` writes and ./replay reads back, little-endian throughout. It starts with
+// a header of four uint32: "GLTR", the version and the size of the default framebuffer. Records follow, each
+// starting with a uint16 tag:
+//
+// - GL_TRACE_DECLARE: a uint16 id, a uint16 length and the name of an entry point, before the first call to it
+// - GL_TRACE_FRAME: the end of a frame
+// - GL_TRACE_END: the end of the trace
+// - any other tag is the id of the entry point called, followed by the call's arguments in order, then the names the
+//   call generated and then its result, if it has one
+//
+// Numbers are written as they are passed, GLsync handles as a uint64. Pointers start with a GlPayload byte saying
+// what follows. Object names are the capture's; the replay creates its own objects and translates the names.
+std::uint32_t const GL_TRACE_MAGIC = 0x52544c47; // "GLTR"
+std::uint32_t const GL_TRACE_VERSION = 1;
+std::uint16_t const GL_TRACE_DECLARE = 0xffff;
+std::uint16_t const GL_TRACE_FRAME = 0xfffe;
+std::uint16_t const GL_TRACE_END = 0xfffd;
+
+enum class GlPayload : std::uint8_t {
+    Null,      // a null pointer, or data the capture couldn't size
+    Offset,    // a uint64 offset into the bound buffer
+    Data,      // a uint32 size and the bytes the call reads
+    Strings,   // a uint32 count, then a uint32 length and the characters of each string
+    Names,     // a uint32 count and the names the call reads, a uint32 each
+    Output,    // a uint32 size the call writes, 0 when it is small as for glGet*v
+    Generated, // a uint32 count; the names the call wrote follow its arguments
+};
+
+// The namespaces the replay translates names in; shaders share the programs' one
+enum class GlObject : std::uint8_t {
+    None,
+    Buffer,
+    Texture,
+    VertexArray,
+    Framebuffer,
+    Renderbuffer,
+    Query,
+    Program,
+    Sampler,
+    Sync,
+    UniformLocation, // per program
+    UniformBlock,    // per program
+};
+
+// The namespace of the name an entry point takes as argument, or returns for -1. Pointer arguments with a
+// namespace are arrays of names, as the ones of glGen* and glDelete*, with the count in the first argument.
+GlObject GetNameArgument(char const *entryPoint, int argument);
@@ -0,0 +1,300 @@
+#include "gpuculling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_PARAMETER_BUFFER
+#define GL_PARAMETER_BUFFER 0x80EE
+#endif
+#ifndef GL_TEXTURE_FETCH_BARRIER_BIT
+#define GL_TEXTURE_FETCH_BARRIER_BIT 0x00000008
+#endif
+#ifndef GL_SHADER_IMAGE_ACCESS_BARRIER_BIT
+#define GL_SHADER_IMAGE_ACCESS_BARRIER_BIT 0x00000020
+#endif
+#ifndef GL_COMMAND_BARRIER_BIT
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#endif
+#ifndef GL_BUFFER_UPDATE_BARRIER_BIT
+#define GL_BUFFER_UPDATE_BARRIER_BIT 0x00000200
+#endif
+#ifndef GL_SHADER_STORAGE_BARRIER_BIT
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+#endif
+
+namespace {
+    // matches DrawArraysIndirectCommand
+    struct DrawCommand {
+        GLuint Count;
+        GLuint InstanceCount;
+        GLuint First;
+        GLuint BaseInstance;
+    };
+    GLuint const CULL_GROUP_SIZE = 64;
+    GLuint const PYRAMID_GROUP_SIZE = 8;
+}
+
+GpuCuller::DispatchComputeProc GpuCuller::dispatchCompute = nullptr;
+GpuCuller::MemoryBarrierProc GpuCuller::memoryBarrier = nullptr;
+GpuCuller::BindImageTextureProc GpuCuller::bindImageTexture = nullptr;
+GpuCuller::MultiDrawArraysIndirectProc GpuCuller::multiDrawArraysIndirect = nullptr;
+GpuCuller::MultiDrawArraysIndirectCountProc GpuCuller::multiDrawArraysIndirectCount = nullptr;
+
+bool GpuCuller::Load(GLADloadproc load) {
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major < 4 || (major == 4 && minor < 3)) {
+        return false;
+    }
+    dispatchCompute = (DispatchComputeProc)load("glDispatchCompute");
+    memoryBarrier = (MemoryBarrierProc)load("glMemoryBarrier");
+    bindImageTexture = (BindImageTextureProc)load("glBindImageTexture");
+    multiDrawArraysIndirect = (MultiDrawArraysIndirectProc)load("glMultiDrawArraysIndirect");
+
+    // the count variant is core in 4.6 and otherwise comes with ARB_indirect_parameters
+    bool indirectParameters = major > 4 || minor >= 6;
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint i = 0; i < extensionCount && !indirectParameters; i++) {
+        char const *extension = reinterpret_cast<char const *>(glGetStringi(GL_EXTENSIONS, i));
+        indirectParameters = std::strcmp(extension, "GL_ARB_indirect_parameters") == 0;
+    }
+    if (indirectParameters) {
+        multiDrawArraysIndirectCount = (MultiDrawArraysIndirectCountProc)load("glMultiDrawArraysIndirectCount");
+        if (!multiDrawArraysIndirectCount) {
+            multiDrawArraysIndirectCount = (MultiDrawArraysIndirectCountProc)load("glMultiDrawArraysIndirectCountARB");
+        }
+    }
+    return dispatchCompute && memoryBarrier && bindImageTexture && multiDrawArraysIndirect;
+}
+
+GpuCuller::GpuCuller(unsigned int maxObjects, unsigned int vertexCount) :
+    cullShader("./shaders/cull.comp"), pyramidShader("./shaders/depthpyramid.comp"),
+    maxObjects(maxObjects), objectCount(0), vertexCount(vertexCount), frameIndex(0), visibleCount(0),
+    zeroCommands(maxObjects * sizeof(DrawCommand), 0),
+    depthFramebuffer(0), depthTexture(0), pyramidTexture(0), pyramidWidth(0), pyramidHeight(0), pyramidLevels(0),
+    hasPyramid(false), pyramidViewProjection(1.0f) {
+    glGenBuffers(1, &objectBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, maxObjects * sizeof(GpuObject), nullptr, GL_DYNAMIC_DRAW);
+
+    glGenBuffers(1, &commandBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, zeroCommands.size(), zeroCommands.data(), GL_DYNAMIC_DRAW);
+
+    GLuint zero = 0;
+    glGenBuffers(1, &countBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), &zero, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // per-instance object index: the draw command's base instance selects the entry for each draw
+    std::vector<GLuint> ids(maxObjects);
+    for (unsigned int i = 0; i < maxObjects; i++) {
+        ids[i] = i;
+    }
+    glGenBuffers(1, &objectIdBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, objectIdBuffer);
+    glBufferData(GL_ARRAY_BUFFER, ids.size() * sizeof(GLuint), ids.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glGenBuffers(READBACK_FRAMES, readbackBuffers);
+    for (unsigned int i = 0; i < READBACK_FRAMES; i++) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, readbackBuffers[i]);
+        glBufferData(GL_COPY_WRITE_BUFFER, sizeof(GLuint), nullptr, GL_STREAM_READ);
+        readbackFences[i] = nullptr;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    glGenFramebuffers(1, &depthFramebuffer);
+}
+
+GpuCuller::~GpuCuller() {
+    for (unsigned int i = 0; i < READBACK_FRAMES; i++) {
+        if (readbackFences[i]) {
+            glDeleteSync(readbackFences[i]);
+        }
+    }
+    glDeleteBuffers(READBACK_FRAMES, readbackBuffers);
+    glDeleteBuffers(1, &objectBuffer);
+    glDeleteBuffers(1, &commandBuffer);
+    glDeleteBuffers(1, &countBuffer);
+    glDeleteBuffers(1, &objectIdBuffer);
+    glDeleteFramebuffers(1, &depthFramebuffer);
+    glDeleteTextures(1, &depthTexture);
+    glDeleteTextures(1, &pyramidTexture);
+}
+
+void GpuCuller::BindObjectIdAttribute(GLuint vao, GLuint location) const {
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, objectIdBuffer);
+    glVertexAttribIPointer(location, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+    glVertexAttribDivisor(location, 1);
+    glEnableVertexAttribArray(location);
+    glBindVertexArray(0);
+}
+
+void GpuCuller::SetObjects(GpuObject const *objects, unsigned int count) {
+    objectCount = std::min(count, maxObjects);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, objectCount * sizeof(GpuObject), objects);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void GpuCuller::collectReadbacks() {
+    // take the newest count whose copy has finished, without ever waiting for the GPU
+    for (unsigned int age = READBACK_FRAMES; age > 0; age--) {
+        unsigned int slot = (frameIndex + READBACK_FRAMES - age) % READBACK_FRAMES;
+        if (!readbackFences[slot]) {
+            continue;
+        }
+        GLenum status = glClientWaitSync(readbackFences[slot], 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            continue;
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, readbackBuffers[slot]);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(GLuint), &visibleCount);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glDeleteSync(readbackFences[slot]);
+        readbackFences[slot] = nullptr;
+    }
+}
+
+void GpuCuller::Cull(Frustum const &frustum) {
+    collectReadbacks();
+
+    // reset the counter, and the commands too when the plain indirect draw has to walk all of them
+    GLuint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &zero);
+    if (!multiDrawArraysIndirectCount) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, objectCount * sizeof(DrawCommand), zeroCommands.data());
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    cullShader.Use();
+    cullShader.SetInt("objectCount", static_cast<int>(objectCount));
+    cullShader.SetInt("vertexCount", static_cast<int>(vertexCount));
+    for (unsigned int i = 0; i < 6; i++) {
+        cullShader.SetFloatVec4("frustumPlanes[" + std::to_string(i) + "]", frustum.Planes[i]);
+    }
+    cullShader.SetBool("useOcclusion", hasPyramid);
+    if (hasPyramid) {
+        cullShader.SetFloatMatrix("pyramidViewProjection", pyramidViewProjection);
+        cullShader.SetInt("pyramidLevels", pyramidLevels);
+        cullShader.SetInt("depthPyramid", 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, objectBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, countBuffer);
+    dispatchCompute((objectCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+    memoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    // queue the count for readback in a later frame
+    unsigned int slot = frameIndex % READBACK_FRAMES;
+    if (readbackFences[slot]) {
+        glDeleteSync(readbackFences[slot]);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, countBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, readbackBuffers[slot]);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(GLuint));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    readbackFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    frameIndex++;
+}
+
+void GpuCuller::Draw() const {
+    // the vertex shader reads the objects from binding 0
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, objectBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    if (multiDrawArraysIndirectCount) {
+        glBindBuffer(GL_PARAMETER_BUFFER, countBuffer);
+        multiDrawArraysIndirectCount(GL_TRIANGLES, nullptr, 0, static_cast<GLsizei>(objectCount), sizeof(DrawCommand));
+        glBindBuffer(GL_PARAMETER_BUFFER, 0);
+    } else {
+        // culled slots keep an instance count of zero and cost next to nothing
+        multiDrawArraysIndirect(GL_TRIANGLES, nullptr, static_cast<GLsizei>(objectCount), sizeof(DrawCommand));
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void GpuCuller::resizePyramid(int width, int height) {
+    glDeleteTextures(1, &depthTexture);
+    glDeleteTextures(1, &pyramidTexture);
+    pyramidWidth = width;
+    pyramidHeight = height;
+    pyramidLevels = 1 + static_cast<int>(std::floor(std::log2(std::max(width, height))));
+
+    // must match the source framebuffer's depth format for the blit
+    glGenTextures(1, &depthTexture);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, depthFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glGenTextures(1, &pyramidTexture);
+    glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+    int levelWidth = width, levelHeight = height;
+    for (int level = 0; level < pyramidLevels; level++) {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, levelWidth, levelHeight, 0, GL_RED, GL_FLOAT, nullptr);
+        levelWidth = std::max(1, levelWidth / 2);
+        levelHeight = std::max(1, levelHeight / 2);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, pyramidLevels - 1);
+    // the culling shader takes the max of a few texels itself, filtering would mix in nearer depths
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    hasPyramid = false;
+}
+
+void GpuCuller::UpdateDepthPyramid(GLuint sourceFramebuffer, int width, int height, glm::mat4 const &viewProjection) {
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+    if (width != pyramidWidth || height != pyramidHeight) {
+        resizePyramid(width, height);
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, sourceFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, depthFramebuffer);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // level 0 is a copy of the depth buffer, every further level keeps the farthest depth below it
+    pyramidShader.Use();
+    pyramidShader.SetInt("source", 0);
+    glActiveTexture(GL_TEXTURE0);
+    int levelWidth = width, levelHeight = height;
+    for (int level = 0; level < pyramidLevels; level++) {
+        pyramidShader.SetInt("sourceLevel", level - 1);
+        pyramidShader.SetBool("copyDepth", level == 0);
+        glBindTexture(GL_TEXTURE_2D, level == 0 ? depthTexture : pyramidTexture);
+        bindImageTexture(0, pyramidTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        dispatchCompute((levelWidth + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, (levelHeight + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, 1);
+        memoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+        levelWidth = std::max(1, levelWidth / 2);
+        levelHeight = std::max(1, levelHeight / 2);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    pyramidViewProjection = viewProjection;
+    hasPyramid = true;
+}
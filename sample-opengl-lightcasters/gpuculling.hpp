@@ -0,0 +1,84 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "culling.hpp"
+#include "shader.h"
+
+// One entry of the object SSBO, laid out for std430
+struct GpuObject {
+    glm::mat4 Model;
+    glm::vec4 BoundsMin; // world-space AABB
+    glm::vec4 BoundsMax;
+    glm::uvec4 Extra; // x: point light mask
+};
+
+// GPU-driven culling for GL 4.3+. A compute shader tests every object's bounds against the frustum and against a
+// depth pyramid built from the previous frame, and appends a draw command for each survivor to an indirect buffer
+// that is consumed by glMultiDrawArraysIndirectCount (GL 4.6 / ARB_indirect_parameters) or, failing that, by
+// glMultiDrawArraysIndirect over a zero-filled buffer. The number of survivors is copied to a ring of readback
+// buffers guarded by fences and picked up a few frames later, so reading it never stalls the pipeline.
+//
+// Objects disoccluded this frame are drawn one frame late, since the pyramid lags by a frame.
+class GpuCuller {
+    public:
+        static unsigned int const READBACK_FRAMES = 3;
+    private:
+        typedef void (APIENTRYP DispatchComputeProc)(GLuint x, GLuint y, GLuint z);
+        typedef void (APIENTRYP MemoryBarrierProc)(GLbitfield barriers);
+        typedef void (APIENTRYP BindImageTextureProc)(GLuint unit, GLuint texture, GLint level, GLboolean layered, GLint layer, GLenum access, GLenum format);
+        typedef void (APIENTRYP MultiDrawArraysIndirectProc)(GLenum mode, void const *indirect, GLsizei drawCount, GLsizei stride);
+        typedef void (APIENTRYP MultiDrawArraysIndirectCountProc)(GLenum mode, void const *indirect, GLintptr drawCount, GLsizei maxDrawCount, GLsizei stride);
+        // glad only covers GL 3.3, so the 4.x entry points are loaded here
+        static DispatchComputeProc dispatchCompute;
+        static MemoryBarrierProc memoryBarrier;
+        static BindImageTextureProc bindImageTexture;
+        static MultiDrawArraysIndirectProc multiDrawArraysIndirect;
+        static MultiDrawArraysIndirectCountProc multiDrawArraysIndirectCount;
+
+        Shader cullShader;
+        Shader pyramidShader;
+        unsigned int maxObjects;
+        unsigned int objectCount;
+        unsigned int vertexCount;
+        GLuint objectBuffer, commandBuffer, countBuffer, objectIdBuffer;
+        GLuint readbackBuffers[READBACK_FRAMES];
+        GLsync readbackFences[READBACK_FRAMES];
+        unsigned int frameIndex;
+        unsigned int visibleCount;
+        std::vector<unsigned char> zeroCommands;
+
+        GLuint depthFramebuffer, depthTexture, pyramidTexture;
+        int pyramidWidth, pyramidHeight, pyramidLevels;
+        bool hasPyramid;
+        glm::mat4 pyramidViewProjection; // the matrices the pyramid was rendered with
+
+        void collectReadbacks();
+        void resizePyramid(int width, int height);
+    public:
+        // Loads the GL 4.3+ entry points and reports whether this context can run the GPU path
+        static bool Load(GLADloadproc load);
+
+        GpuCuller(unsigned int maxObjects, unsigned int vertexCount);
+        ~GpuCuller();
+        GpuCuller(GpuCuller const &) = delete;
+        GpuCuller &operator=(GpuCuller const &) = delete;
+
+        // Adds a per-instance object index attribute to the VAO; the vertex shader uses it to look up its object
+        void BindObjectIdAttribute(GLuint vao, GLuint location) const;
+        void SetObjects(GpuObject const *objects, unsigned int count);
+        void Cull(Frustum const &frustum);
+        // Draws the compacted commands with the currently bound program and VAO
+        void Draw() const;
+        // Call after the frame is rendered: copies the depth of the framebuffer the scene went to and rebuilds the
+        // max-depth pyramid. Its depth must be GL_DEPTH24_STENCIL8 like the default framebuffer's.
+        void UpdateDepthPyramid(GLuint sourceFramebuffer, int width, int height, glm::mat4 const &viewProjection);
+
+        // Survivors of the latest culling pass whose count has made it back to the CPU
+        unsigned int GetVisibleCount() const { return visibleCount; }
+        unsigned int GetObjectCount() const { return objectCount; }
+        bool HasIndirectCount() const { return multiDrawArraysIndirectCount != nullptr; }
+};
@@ -0,0 +1,85 @@
+#include "headless.hpp"
+
+#include <EGL/eglext.h>
+
+namespace {
+    EGLDisplay openDisplay() {
+        auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if (getPlatformDisplay != nullptr) {
+            EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+            if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr)) {
+                return display;
+            }
+        }
+        EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr)) {
+            return display;
+        }
+        return EGL_NO_DISPLAY;
+    }
+}
+
+HeadlessContext::HeadlessContext() : display { EGL_NO_DISPLAY }, surface { EGL_NO_SURFACE }, context { EGL_NO_CONTEXT }, width { 0 }, height { 0 } {}
+
+HeadlessContext::~HeadlessContext() {
+    if (display == EGL_NO_DISPLAY) {
+        return;
+    }
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context != EGL_NO_CONTEXT) {
+        eglDestroyContext(display, context);
+    }
+    if (surface != EGL_NO_SURFACE) {
+        eglDestroySurface(display, surface);
+    }
+    eglTerminate(display);
+}
+
+std::unique_ptr<HeadlessContext> HeadlessContext::Create(int width, int height) {
+    std::unique_ptr<HeadlessContext> headless { new HeadlessContext {} };
+    headless->display = openDisplay();
+    if (headless->display == EGL_NO_DISPLAY) {
+        return nullptr;
+    }
+
+    // the same channels as a window's default framebuffer
+    EGLint const configAttributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8, EGL_DEPTH_SIZE, 24, EGL_STENCIL_SIZE, 8,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(headless->display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+        return nullptr;
+    }
+    EGLint const surfaceAttributes[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+    headless->surface = eglCreatePbufferSurface(headless->display, config, surfaceAttributes);
+    if (headless->surface == EGL_NO_SURFACE || !eglBindAPI(EGL_OPENGL_API)) {
+        return nullptr;
+    }
+
+    // ask for 4.3 to get compute shaders and indirect draws, the sample itself only needs 3.3
+    EGLint const versions[][2] = { { 4, 3 }, { 3, 3 } };
+    for (auto const &version : versions) {
+        EGLint const contextAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, version[0], EGL_CONTEXT_MINOR_VERSION, version[1],
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        headless->context = eglCreateContext(headless->display, config, EGL_NO_CONTEXT, contextAttributes);
+        if (headless->context != EGL_NO_CONTEXT) {
+            break;
+        }
+    }
+    if (headless->context == EGL_NO_CONTEXT || !eglMakeCurrent(headless->display, headless->surface, headless->surface, headless->context)) {
+        return nullptr;
+    }
+    headless->width = width;
+    headless->height = height;
+    return headless;
+}
+
+void *HeadlessContext::GetProcAddress(char const *name) {
+    return reinterpret_cast<void *>(eglGetProcAddress(name));
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <EGL/egl.h>
+
+#include <memory>
+
+// An OpenGL core context without a window, for running the scripted modes on machines without a display or a GPU.
+// It asks EGL for Mesa's surfaceless platform first, which needs neither X nor a DRM device and works with llvmpipe,
+// and falls back to the default display. The context renders into a pbuffer of the given size, so the default
+// framebuffer exists as it does with a window and can be read back.
+class HeadlessContext {
+    private:
+        EGLDisplay display;
+        EGLSurface surface;
+        EGLContext context;
+        int width, height;
+
+        HeadlessContext();
+    public:
+        ~HeadlessContext();
+        HeadlessContext(HeadlessContext const &) = delete;
+        HeadlessContext &operator=(HeadlessContext const &) = delete;
+
+        // A current context of the highest of 4.3 and 3.3 available, nullptr if there is none
+        static std::unique_ptr<HeadlessContext> Create(int width, int height);
+        // For gladLoadGLLoader
+        static void *GetProcAddress(char const *name);
+
+        int GetWidth() const { return width; }
+        int GetHeight() const { return height; }
+};
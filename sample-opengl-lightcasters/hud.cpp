@@ -0,0 +1,236 @@
+#include "hud.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstddef>
+
+using std::string;
+using std::vector;
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // 5x7 pixels, a row per byte from the top, the leftmost pixel in bit 4
+    struct Glyph {
+        char Character;
+        std::uint8_t Rows[7];
+    };
+
+    Glyph const FONT[] = {
+        { '0', { 0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e } },
+        { '1', { 0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e } },
+        { '2', { 0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f } },
+        { '3', { 0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e } },
+        { '4', { 0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02 } },
+        { '5', { 0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e } },
+        { '6', { 0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e } },
+        { '7', { 0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 } },
+        { '8', { 0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e } },
+        { '9', { 0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c } },
+        { 'A', { 0x0e, 0x11, 0x11, 0x11, 0x1f, 0x11, 0x11 } },
+        { 'B', { 0x1e, 0x11, 0x11, 0x1e, 0x11, 0x11, 0x1e } },
+        { 'C', { 0x0e, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0e } },
+        { 'D', { 0x1c, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1c } },
+        { 'E', { 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x1f } },
+        { 'F', { 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x10 } },
+        { 'G', { 0x0e, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0f } },
+        { 'H', { 0x11, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11 } },
+        { 'I', { 0x0e, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e } },
+        { 'J', { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0c } },
+        { 'K', { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 } },
+        { 'L', { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1f } },
+        { 'M', { 0x11, 0x1b, 0x15, 0x15, 0x11, 0x11, 0x11 } },
+        { 'N', { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 } },
+        { 'O', { 0x0e, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e } },
+        { 'P', { 0x1e, 0x11, 0x11, 0x1e, 0x10, 0x10, 0x10 } },
+        { 'Q', { 0x0e, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0d } },
+        { 'R', { 0x1e, 0x11, 0x11, 0x1e, 0x14, 0x12, 0x11 } },
+        { 'S', { 0x0f, 0x10, 0x10, 0x0e, 0x01, 0x01, 0x1e } },
+        { 'T', { 0x1f, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 } },
+        { 'U', { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e } },
+        { 'V', { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0a, 0x04 } },
+        { 'W', { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0a } },
+        { 'X', { 0x11, 0x11, 0x0a, 0x04, 0x0a, 0x11, 0x11 } },
+        { 'Y', { 0x11, 0x11, 0x11, 0x0a, 0x04, 0x04, 0x04 } },
+        { 'Z', { 0x1f, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1f } },
+        { '.', { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c } },
+        { ',', { 0x00, 0x00, 0x00, 0x00, 0x0c, 0x04, 0x08 } },
+        { ':', { 0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x0c, 0x00 } },
+        { '/', { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 } },
+        { '%', { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 } },
+        { '-', { 0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00 } },
+        { '+', { 0x00, 0x04, 0x04, 0x1f, 0x04, 0x04, 0x00 } },
+        { '(', { 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 } },
+        { ')', { 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 } },
+    };
+
+    // the font texture has a 6x8 cell per character from ' ' on, 16 to a row
+    int const CELL_WIDTH = 6;
+    int const CELL_HEIGHT = 8;
+    int const COLUMNS = 16;
+    int const ROWS = 6;
+    int const FONT_WIDTH = COLUMNS * CELL_WIDTH;
+    int const FONT_HEIGHT = ROWS * CELL_HEIGHT;
+
+    // on screen, in pixels
+    float const SCALE = 2.0f;
+    float const MARGIN = 8.0f;
+    float const PADDING = 4.0f;
+    float const LINE_HEIGHT = 9.0f * SCALE;
+    float const BAR_WIDTH = 2.0f;
+    float const GRAPH_HEIGHT = 60.0f;
+    // the graph goes up to two 60 Hz frames, with a line at one
+    float const GRAPH_MILLISECONDS = 1000.0f / 30.0f;
+    float const BUDGET_MILLISECONDS = 1000.0f / 60.0f;
+
+    std::uint32_t const BACKGROUND = 0x000000a0;
+    std::uint32_t const CPU_COLOR = 0x50d050c0;
+    std::uint32_t const GPU_COLOR = 0xf0a030ff;
+    std::uint32_t const BUDGET_COLOR = 0xffffff60;
+    std::uint32_t const TEXT_COLOR = 0xffffffff;
+}
+
+Hud::Hud() : shader { "./shaders/hud.vs", "./shaders/hud.fs" }, maxQuads { 4096 }, cpuMilliseconds {}, gpuMilliseconds {}, next { 0 },
+             lastDrawMilliseconds { 0.0 } {
+    vector<std::uint8_t> pixels(FONT_WIDTH * FONT_HEIGHT, 0);
+    for (auto const &glyph : FONT) {
+        int cell = glyph.Character - ' ';
+        int left = cell % COLUMNS * CELL_WIDTH;
+        int top = cell / COLUMNS * CELL_HEIGHT;
+        for (int y = 0; y < 7; y++) {
+            for (int x = 0; x < 5; x++) {
+                if (glyph.Rows[y] & (0x10 >> x)) {
+                    pixels[(top + y) * FONT_WIDTH + left + x] = 255;
+                }
+            }
+        }
+    }
+    glGenTextures(1, &fontTexture);
+    glBindTexture(GL_TEXTURE_2D, fontTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, FONT_WIDTH, FONT_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // every quad is two triangles of its four vertices
+    vector<GLushort> indices;
+    indices.reserve(6 * maxQuads);
+    for (unsigned int quad = 0; quad < maxQuads; quad++) {
+        GLushort first = static_cast<GLushort>(4 * quad);
+        for (GLushort corner : { 0, 1, 2, 2, 1, 3 }) {
+            indices.push_back(static_cast<GLushort>(first + corner));
+        }
+    }
+    vertices.reserve(4 * maxQuads);
+    glGenVertexArrays(1, &vertexArray);
+    glGenBuffers(1, &vertexBuffer);
+    glGenBuffers(1, &indexBuffer);
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), indices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, 4 * maxQuads * sizeof(Vertex), nullptr, GL_STREAM_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void *>(offsetof(Vertex, X)));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void *>(offsetof(Vertex, U)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), reinterpret_cast<void *>(offsetof(Vertex, Color)));
+    glEnableVertexAttribArray(2);
+    glBindVertexArray(0);
+
+    shader.Use();
+    shader.SetInt("font", 0);
+}
+
+Hud::~Hud() {
+    glDeleteVertexArrays(1, &vertexArray);
+    glDeleteBuffers(1, &vertexBuffer);
+    glDeleteBuffers(1, &indexBuffer);
+    glDeleteTextures(1, &fontTexture);
+}
+
+void Hud::addQuad(float x, float y, float width, float height, float u, float v, std::uint32_t color) {
+    if (vertices.size() + 4 > 4 * maxQuads) {
+        return;
+    }
+    std::uint8_t r = color >> 24, g = (color >> 16) & 0xff, b = (color >> 8) & 0xff, a = color & 0xff;
+    // a solid quad has the same negative texture coordinates at every corner
+    float du = u < 0.0f ? 0.0f : static_cast<float>(CELL_WIDTH - 1) / FONT_WIDTH;
+    float dv = u < 0.0f ? 0.0f : static_cast<float>(CELL_HEIGHT - 1) / FONT_HEIGHT;
+    vertices.push_back(Vertex { x, y, u, v, { r, g, b, a } });
+    vertices.push_back(Vertex { x + width, y, u + du, v, { r, g, b, a } });
+    vertices.push_back(Vertex { x, y + height, u, v + dv, { r, g, b, a } });
+    vertices.push_back(Vertex { x + width, y + height, u + du, v + dv, { r, g, b, a } });
+}
+
+void Hud::addText(float x, float y, string const &text, std::uint32_t color) {
+    for (char character : text) {
+        int cell = std::toupper(static_cast<unsigned char>(character)) - ' ';
+        // spaces and anything outside the font only advance
+        if (cell > 0 && cell < COLUMNS * ROWS) {
+            float u = static_cast<float>(cell % COLUMNS * CELL_WIDTH) / FONT_WIDTH;
+            float v = static_cast<float>(cell / COLUMNS * CELL_HEIGHT) / FONT_HEIGHT;
+            addQuad(x, y, (CELL_WIDTH - 1) * SCALE, (CELL_HEIGHT - 1) * SCALE, u, v, color);
+        }
+        x += CELL_WIDTH * SCALE;
+    }
+}
+
+void Hud::AddFrame(double cpu, double gpu) {
+    cpuMilliseconds[next] = static_cast<float>(cpu);
+    gpuMilliseconds[next] = static_cast<float>(gpu);
+    next = (next + 1) % HISTORY;
+}
+
+void Hud::Draw(int width, int height, vector<string> const &lines) {
+    auto start = Clock::now();
+    vertices.clear();
+    size_t columns = 0;
+    for (auto const &line : lines) {
+        columns = std::max(columns, line.size());
+    }
+    float graphWidth = HISTORY * BAR_WIDTH;
+    float panelWidth = std::max(graphWidth, columns * CELL_WIDTH * SCALE) + 2.0f * PADDING;
+    float panelHeight = GRAPH_HEIGHT + lines.size() * LINE_HEIGHT + 3.0f * PADDING;
+    addQuad(MARGIN, MARGIN, panelWidth, panelHeight, -1.0f, -1.0f, BACKGROUND);
+
+    // the oldest frame on the left; the GPU bar is drawn over the wider CPU one
+    float left = MARGIN + PADDING;
+    float bottom = MARGIN + PADDING + GRAPH_HEIGHT;
+    for (unsigned int i = 0; i < HISTORY; i++) {
+        unsigned int frame = (next + i) % HISTORY;
+        float cpu = std::min(cpuMilliseconds[frame] / GRAPH_MILLISECONDS, 1.0f) * GRAPH_HEIGHT;
+        float gpu = std::min(gpuMilliseconds[frame] / GRAPH_MILLISECONDS, 1.0f) * GRAPH_HEIGHT;
+        addQuad(left + i * BAR_WIDTH, bottom - cpu, BAR_WIDTH, cpu, -1.0f, -1.0f, CPU_COLOR);
+        addQuad(left + i * BAR_WIDTH, bottom - gpu, BAR_WIDTH * 0.5f, gpu, -1.0f, -1.0f, GPU_COLOR);
+    }
+    addQuad(left, bottom - BUDGET_MILLISECONDS / GRAPH_MILLISECONDS * GRAPH_HEIGHT, graphWidth, 1.0f, -1.0f, -1.0f, BUDGET_COLOR);
+    for (size_t i = 0; i < lines.size(); i++) {
+        addText(left, bottom + PADDING + i * LINE_HEIGHT, lines[i], TEXT_COLOR);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, width, height);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    shader.Use();
+    shader.SetFloatVec2("screenSize", glm::vec2 { width, height });
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, fontTexture);
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    // orphan the storage the GPU may still read last frame's quads from instead of waiting for it
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STREAM_DRAW);
+    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(vertices.size() / 4 * 6), GL_UNSIGNED_SHORT, nullptr);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+    lastDrawMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
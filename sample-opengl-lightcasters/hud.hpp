@@ -0,0 +1,47 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "shader.h"
+
+// An overlay with a rolling graph of the CPU and GPU frame times and lines of text, drawn over the default
+// framebuffer in one draw call: every glyph and bar is a quad in one stream buffer, the glyphs cut from a built-in
+// 5x7 pixel font in a small texture. Only digits, capitals and a little punctuation are in the font, lowercase text
+// is drawn in capitals.
+class Hud {
+    public:
+        static constexpr unsigned int HISTORY = 120;
+    private:
+        struct Vertex {
+            float X, Y;
+            float U, V; // negative for a solid quad
+            std::uint8_t Color[4];
+        };
+        Shader shader;
+        GLuint vertexArray, vertexBuffer, indexBuffer, fontTexture;
+        unsigned int maxQuads;
+        std::vector<Vertex> vertices;
+        float cpuMilliseconds[HISTORY];
+        float gpuMilliseconds[HISTORY];
+        unsigned int next;
+        double lastDrawMilliseconds;
+
+        void addQuad(float x, float y, float width, float height, float u, float v, std::uint32_t color);
+        void addText(float x, float y, std::string const &text, std::uint32_t color);
+    public:
+        Hud();
+        ~Hud();
+        Hud(Hud const &) = delete;
+        Hud &operator=(Hud const &) = delete;
+
+        // Adds a frame to the graph
+        void AddFrame(double cpuMilliseconds, double gpuMilliseconds);
+        // Draws the graph and the lines below it into the top left corner of the default framebuffer
+        void Draw(int width, int height, std::vector<std::string> const &lines);
+        // CPU time of the last Draw
+        double GetDrawMilliseconds() const { return lastDrawMilliseconds; }
+};
@@ -0,0 +1,498 @@
+#include "lightmap.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <tuple>
+
+using std::vector;
+
+namespace {
+    float const PI = 3.14159265358979f;
+    // how far rays start off the surface, so they do not hit the triangle they leave
+    float const RAY_OFFSET = 1e-3f;
+    // triangles whose normals differ by more than this stay in separate charts
+    float const CHART_NORMAL_COSINE = 0.99f;
+
+    // PCG32, small and good enough to decorrelate the texels
+    struct Random {
+        unsigned long long state;
+
+        explicit Random(unsigned int seed) : state(seed * 6364136223846793005ull + 1442695040888963407ull) {}
+        float Next() {
+            unsigned long long old = state;
+            state = old * 6364136223846793005ull + 1442695040888963407ull;
+            unsigned int shifted = static_cast<unsigned int>(((old >> 18u) ^ old) >> 27u);
+            unsigned int rotation = static_cast<unsigned int>(old >> 59u);
+            unsigned int value = (shifted >> rotation) | (shifted << ((32 - rotation) & 31));
+            return (value >> 8) * (1.0f / 16777216.0f);
+        }
+    };
+
+    // any orthonormal pair perpendicular to n (Duff et al.)
+    void basis(glm::vec3 const &n, glm::vec3 &tangent, glm::vec3 &bitangent) {
+        float sign = n.z >= 0.0f ? 1.0f : -1.0f;
+        float a = -1.0f / (sign + n.z);
+        float b = n.x * n.y * a;
+        tangent = glm::vec3 { 1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x };
+        bitangent = glm::vec3 { b, sign + n.y * n.y * a, -n.y };
+    }
+
+    glm::vec3 cosineSample(glm::vec3 const &normal, Random &random) {
+        float r = std::sqrt(random.Next());
+        float phi = 2.0f * PI * random.Next();
+        glm::vec3 tangent, bitangent;
+        basis(normal, tangent, bitangent);
+        float z = std::sqrt(std::max(0.0f, 1.0f - r * r));
+        return glm::normalize(tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi)) + normal * z);
+    }
+
+    unsigned int hash(unsigned int x) {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    // a thread's share of the tiles; the owner works from the back and thieves take from the front
+    struct TileQueue {
+        std::mutex mutex;
+        std::deque<unsigned int> tiles;
+
+        bool Pop(unsigned int &tile, bool steal) {
+            std::lock_guard<std::mutex> lock { mutex };
+            if (tiles.empty()) {
+                return false;
+            }
+            if (steal) {
+                tile = tiles.front();
+                tiles.pop_front();
+            } else {
+                tile = tiles.back();
+                tiles.pop_back();
+            }
+            return true;
+        }
+    };
+}
+
+vector<glm::vec2> UnwrapLightmap(vector<glm::vec3> const &positions, vector<glm::vec3> const &normals, unsigned int resolution, unsigned int padding) {
+    size_t triangleCount = positions.size() / 3;
+    // weld equal positions, so triangle lists without indices still share edges
+    std::map<std::tuple<float, float, float>, unsigned int> welded;
+    vector<unsigned int> vertexIds(positions.size());
+    for (size_t i = 0; i < positions.size(); i++) {
+        auto key = std::make_tuple(positions[i].x, positions[i].y, positions[i].z);
+        vertexIds[i] = welded.emplace(key, static_cast<unsigned int>(welded.size())).first->second;
+    }
+    std::map<std::pair<unsigned int, unsigned int>, vector<unsigned int>> edgeTriangles;
+    for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+        for (int corner = 0; corner < 3; corner++) {
+            unsigned int a = vertexIds[triangle * 3 + corner];
+            unsigned int b = vertexIds[triangle * 3 + (corner + 1) % 3];
+            edgeTriangles[std::minmax(a, b)].push_back(static_cast<unsigned int>(triangle));
+        }
+    }
+    vector<glm::vec3> faceNormals(triangleCount);
+    for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+        glm::vec3 const *p = &positions[triangle * 3];
+        glm::vec3 n = glm::cross(p[1] - p[0], p[2] - p[0]);
+        glm::vec3 shading = normals[triangle * 3] + normals[triangle * 3 + 1] + normals[triangle * 3 + 2];
+        faceNormals[triangle] = glm::dot(n, n) > 0.0f ? glm::normalize(n) : glm::normalize(shading);
+    }
+
+    // grow charts from seed triangles across shared edges while the faces keep facing the seed's way
+    struct Chart {
+        vector<unsigned int> Triangles;
+        glm::vec3 Axis1, Axis2;
+        glm::vec2 Min, Max;
+        glm::vec2 Origin; // in texels, once packed
+    };
+    vector<Chart> charts;
+    vector<int> chartOf(triangleCount, -1);
+    for (size_t seed = 0; seed < triangleCount; seed++) {
+        if (chartOf[seed] >= 0) {
+            continue;
+        }
+        Chart chart;
+        glm::vec3 normal = faceNormals[seed];
+        vector<unsigned int> open { static_cast<unsigned int>(seed) };
+        chartOf[seed] = static_cast<int>(charts.size());
+        while (!open.empty()) {
+            unsigned int triangle = open.back();
+            open.pop_back();
+            chart.Triangles.push_back(triangle);
+            for (int corner = 0; corner < 3; corner++) {
+                unsigned int a = vertexIds[triangle * 3 + corner];
+                unsigned int b = vertexIds[triangle * 3 + (corner + 1) % 3];
+                for (unsigned int neighbour : edgeTriangles[std::minmax(a, b)]) {
+                    if (chartOf[neighbour] < 0 && glm::dot(faceNormals[neighbour], normal) > CHART_NORMAL_COSINE) {
+                        chartOf[neighbour] = static_cast<int>(charts.size());
+                        open.push_back(neighbour);
+                    }
+                }
+            }
+        }
+        basis(normal, chart.Axis1, chart.Axis2);
+        chart.Min = glm::vec2 { FLT_MAX };
+        chart.Max = glm::vec2 { -FLT_MAX };
+        for (unsigned int triangle : chart.Triangles) {
+            for (int corner = 0; corner < 3; corner++) {
+                glm::vec3 const &p = positions[triangle * 3 + corner];
+                glm::vec2 projected { glm::dot(p, chart.Axis1), glm::dot(p, chart.Axis2) };
+                chart.Min = glm::min(chart.Min, projected);
+                chart.Max = glm::max(chart.Max, projected);
+            }
+        }
+        charts.push_back(chart);
+    }
+
+    // shelves of charts sorted by height; the largest scale that still fits is found by bisection
+    vector<unsigned int> order(charts.size());
+    for (unsigned int i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+        return charts[a].Max.y - charts[a].Min.y > charts[b].Max.y - charts[b].Min.y;
+    });
+    auto pack = [&](float scale, bool place) {
+        float x = 0.0f, y = 0.0f, shelfHeight = 0.0f;
+        for (unsigned int i : order) {
+            Chart &chart = charts[i];
+            glm::vec2 size = glm::ceil((chart.Max - chart.Min) * scale) + 2.0f * padding;
+            if (x + size.x > resolution) {
+                x = 0.0f;
+                y += shelfHeight;
+                shelfHeight = 0.0f;
+            }
+            if (x + size.x > resolution || y + size.y > resolution) {
+                return false;
+            }
+            if (place) {
+                chart.Origin = glm::vec2 { x, y } + static_cast<float>(padding);
+            }
+            x += size.x;
+            shelfHeight = std::max(shelfHeight, size.y);
+        }
+        return true;
+    };
+    float largest = 0.0f;
+    for (auto const &chart : charts) {
+        largest = std::max({ largest, chart.Max.x - chart.Min.x, chart.Max.y - chart.Min.y });
+    }
+    float low = 0.0f, high = largest > 0.0f ? resolution / largest : 1.0f;
+    for (int iteration = 0; iteration < 24; iteration++) {
+        float middle = (low + high) * 0.5f;
+        (pack(middle, false) ? low : high) = middle;
+    }
+    pack(low, true);
+
+    vector<glm::vec2> coords(positions.size());
+    for (auto const &chart : charts) {
+        for (unsigned int triangle : chart.Triangles) {
+            for (int corner = 0; corner < 3; corner++) {
+                glm::vec3 const &p = positions[triangle * 3 + corner];
+                glm::vec2 projected { glm::dot(p, chart.Axis1), glm::dot(p, chart.Axis2) };
+                coords[triangle * 3 + corner] = (chart.Origin + (projected - chart.Min) * low) / static_cast<float>(resolution);
+            }
+        }
+    }
+    return coords;
+}
+
+glm::uvec2 PackLightmapInstances(unsigned int instanceCount, unsigned int instanceResolution, vector<glm::vec4> &scaleOffsets) {
+    unsigned int columns = std::max(1u, static_cast<unsigned int>(std::ceil(std::sqrt(static_cast<float>(instanceCount)))));
+    unsigned int rows = std::max(1u, (instanceCount + columns - 1) / columns);
+    glm::uvec2 size { columns * instanceResolution, rows * instanceResolution };
+    scaleOffsets.clear();
+    for (unsigned int i = 0; i < instanceCount; i++) {
+        glm::vec2 scale = glm::vec2 { static_cast<float>(instanceResolution) } / glm::vec2 { size };
+        scaleOffsets.push_back(glm::vec4 { scale, scale * glm::vec2 { static_cast<float>(i % columns), static_cast<float>(i / columns) } });
+    }
+    return size;
+}
+
+void LightmapBaker::AddMesh(vector<glm::vec3> const &positions, vector<glm::vec3> const &normals, vector<glm::vec2> const &lightmapCoords,
+                            glm::vec3 const &albedo) {
+    corners.insert(corners.end(), positions.begin(), positions.end());
+    cornerNormals.insert(cornerNormals.end(), normals.begin(), normals.end());
+    cornerCoords.insert(cornerCoords.end(), lightmapCoords.begin(), lightmapCoords.end());
+    triangleAlbedos.insert(triangleAlbedos.end(), positions.size() / 3, albedo);
+}
+
+glm::vec3 LightmapBaker::directLight(TriangleBvh const &bvh, glm::vec3 const &position, glm::vec3 const &normal, bool ambient,
+                                     unsigned long long &rays) const {
+    glm::vec3 light { 0.0f };
+    glm::vec3 origin = position + normal * RAY_OFFSET;
+    for (auto const &directional : directionalLights) {
+        if (ambient) {
+            light += directional.Ambient;
+        }
+        glm::vec3 toLight = -glm::normalize(directional.Direction);
+        float cosine = glm::dot(normal, toLight);
+        if (cosine > 0.0f) {
+            rays++;
+            if (!bvh.Occluded(Ray { origin, toLight }, FLT_MAX)) {
+                light += directional.Diffuse * cosine;
+            }
+        }
+    }
+    for (auto const &point : pointLights) {
+        glm::vec3 toLight = point.Position - origin;
+        float distance = glm::length(toLight);
+        float attenuation = 1.0f / (point.Constant + point.Linear * distance + point.Quadratic * distance * distance);
+        if (ambient) {
+            light += point.Ambient * attenuation;
+        }
+        toLight /= distance;
+        float cosine = glm::dot(normal, toLight);
+        if (cosine > 0.0f) {
+            rays++;
+            if (!bvh.Occluded(Ray { origin, toLight }, distance)) {
+                light += point.Diffuse * cosine * attenuation;
+            }
+        }
+    }
+    return light;
+}
+
+glm::vec3 LightmapBaker::hitNormal(RayHit const &hit) const {
+    unsigned int corner = hit.Triangle * 3;
+    return glm::normalize(cornerNormals[corner] * (1.0f - hit.U - hit.V) + cornerNormals[corner + 1] * hit.U + cornerNormals[corner + 2] * hit.V);
+}
+
+bool LightmapBaker::TraceRadiance(TriangleBvh const &bvh, Ray const &ray, glm::vec3 &radiance, unsigned long long &rays) const {
+    radiance = glm::vec3 { 0.0f };
+    RayHit hit;
+    rays++;
+    if (!bvh.Intersect(ray, FLT_MAX, hit)) {
+        return true;
+    }
+    glm::vec3 normal = hitNormal(hit);
+    if (glm::dot(normal, ray.Direction) > 0.0f) {
+        return false;
+    }
+    radiance = triangleAlbedos[hit.Triangle] * directLight(bvh, ray.Origin + ray.Direction * hit.Distance, normal, false, rays);
+    return true;
+}
+
+glm::vec3 LightmapBaker::AmbientLight(glm::vec3 const &position) const {
+    glm::vec3 light { 0.0f };
+    for (auto const &directional : directionalLights) {
+        light += directional.Ambient;
+    }
+    for (auto const &point : pointLights) {
+        float distance = glm::length(point.Position - position);
+        light += point.Ambient / (point.Constant + point.Linear * distance + point.Quadratic * distance * distance);
+    }
+    return light;
+}
+
+glm::vec3 LightmapBaker::bakeTexel(TriangleBvh const &bvh, Texel const &texel, unsigned int seed, LightmapSettings const &settings,
+                                   unsigned long long &rays) const {
+    Random random { hash(seed) };
+    glm::vec3 direct = directLight(bvh, texel.Position, texel.Normal, true, rays);
+
+    // with cosine-weighted directions the 1/pi of the diffuse surface cancels against the sampling density, so the
+    // irradiance is the plain mean of what each path brings back
+    glm::vec3 indirect { 0.0f };
+    for (unsigned int sample = 0; sample < settings.Samples; sample++) {
+        glm::vec3 position = texel.Position;
+        glm::vec3 normal = texel.Normal;
+        glm::vec3 throughput { 1.0f };
+        for (unsigned int bounce = 0; bounce < settings.Bounces; bounce++) {
+            Ray ray { position + normal * RAY_OFFSET, cosineSample(normal, random) };
+            RayHit hit;
+            rays++;
+            if (!bvh.Intersect(ray, FLT_MAX, hit)) {
+                break;
+            }
+            glm::vec3 surfaceNormal = hitNormal(hit);
+            // the inside of a closed mesh, which only a ray leaving through an edge can see
+            if (glm::dot(surfaceNormal, ray.Direction) > 0.0f) {
+                break;
+            }
+            position = ray.Origin + ray.Direction * hit.Distance;
+            normal = surfaceNormal;
+            throughput *= triangleAlbedos[hit.Triangle];
+            // ambient terms are the samples' stand-in for bounced light, so only the texel itself gets them
+            indirect += throughput * directLight(bvh, position, normal, false, rays);
+        }
+    }
+    return direct + indirect / static_cast<float>(std::max(settings.Samples, 1u));
+}
+
+LightmapStats LightmapBaker::Bake(unsigned int width, unsigned int height, LightmapSettings const &settings, vector<glm::vec3> &texels) const {
+    auto start = std::chrono::steady_clock::now();
+    LightmapStats stats;
+    TriangleBvh bvh { corners };
+
+    // rasterize every triangle in lightmap space, keeping the surface point under each texel center
+    vector<Texel> surface(width * height);
+    vector<unsigned char> covered(width * height, 0);
+    for (size_t triangle = 0; triangle < corners.size() / 3; triangle++) {
+        glm::vec2 uv[3];
+        for (int corner = 0; corner < 3; corner++) {
+            uv[corner] = cornerCoords[triangle * 3 + corner] * glm::vec2 { width, height };
+        }
+        float area = (uv[1].x - uv[0].x) * (uv[2].y - uv[0].y) - (uv[2].x - uv[0].x) * (uv[1].y - uv[0].y);
+        if (std::abs(area) < 1e-12f) {
+            continue;
+        }
+        glm::vec2 low = glm::max(glm::floor(glm::min(uv[0], glm::min(uv[1], uv[2]))), glm::vec2 { 0.0f });
+        glm::vec2 high = glm::min(glm::ceil(glm::max(uv[0], glm::max(uv[1], uv[2]))), glm::vec2 { width - 1, height - 1 });
+        for (unsigned int y = static_cast<unsigned int>(low.y); y <= static_cast<unsigned int>(high.y); y++) {
+            for (unsigned int x = static_cast<unsigned int>(low.x); x <= static_cast<unsigned int>(high.x); x++) {
+                glm::vec2 p { x + 0.5f, y + 0.5f };
+                float w1 = ((p.x - uv[0].x) * (uv[2].y - uv[0].y) - (uv[2].x - uv[0].x) * (p.y - uv[0].y)) / area;
+                float w2 = ((uv[1].x - uv[0].x) * (p.y - uv[0].y) - (p.x - uv[0].x) * (uv[1].y - uv[0].y)) / area;
+                float w0 = 1.0f - w1 - w2;
+                if (w0 < -1e-4f || w1 < -1e-4f || w2 < -1e-4f) {
+                    continue;
+                }
+                glm::vec3 const *p3 = &corners[triangle * 3];
+                glm::vec3 const *n3 = &cornerNormals[triangle * 3];
+                surface[y * width + x] = Texel { p3[0] * w0 + p3[1] * w1 + p3[2] * w2, glm::normalize(n3[0] * w0 + n3[1] * w1 + n3[2] * w2) };
+                covered[y * width + x] = 1;
+            }
+        }
+    }
+
+    stats.Texels = static_cast<unsigned int>(std::count(covered.begin(), covered.end(), 1));
+
+    // only tiles with something to bake are scheduled
+    unsigned int tileSize = std::max(settings.TileSize, 1u);
+    unsigned int tilesX = (width + tileSize - 1) / tileSize;
+    unsigned int tilesY = (height + tileSize - 1) / tileSize;
+    vector<unsigned int> tiles;
+    for (unsigned int tile = 0; tile < tilesX * tilesY; tile++) {
+        unsigned int x0 = (tile % tilesX) * tileSize, y0 = (tile / tilesX) * tileSize;
+        bool any = false;
+        for (unsigned int y = y0; y < std::min(height, y0 + tileSize) && !any; y++) {
+            for (unsigned int x = x0; x < std::min(width, x0 + tileSize) && !any; x++) {
+                any = covered[y * width + x] != 0;
+            }
+        }
+        if (any) {
+            tiles.push_back(tile);
+        }
+    }
+
+    unsigned int threadCount = settings.ThreadCount ? settings.ThreadCount : std::max(1u, std::thread::hardware_concurrency());
+    // contiguous runs per thread keep neighbouring texels, which trace similar rays, on the same core
+    vector<TileQueue> queues(threadCount);
+    for (size_t i = 0; i < tiles.size(); i++) {
+        queues[i * threadCount / tiles.size()].tiles.push_back(tiles[i]);
+    }
+
+    texels.assign(width * height, glm::vec3 { 0.0f });
+    std::atomic<unsigned int> stolen { 0 };
+    std::atomic<unsigned long long> rays { 0 };
+    auto work = [&](unsigned int thread) {
+        unsigned long long localRays = 0;
+        unsigned int tile;
+        while (true) {
+            bool found = queues[thread].Pop(tile, false);
+            for (unsigned int offset = 1; offset < threadCount && !found; offset++) {
+                found = queues[(thread + offset) % threadCount].Pop(tile, true);
+                if (found) {
+                    stolen++;
+                }
+            }
+            if (!found) {
+                break;
+            }
+            unsigned int x0 = (tile % tilesX) * tileSize, y0 = (tile / tilesX) * tileSize;
+            for (unsigned int y = y0; y < std::min(height, y0 + tileSize); y++) {
+                for (unsigned int x = x0; x < std::min(width, x0 + tileSize); x++) {
+                    unsigned int index = y * width + x;
+                    if (covered[index]) {
+                        texels[index] = bakeTexel(bvh, surface[index], index, settings, localRays);
+                    }
+                }
+            }
+        }
+        rays += localRays;
+    };
+    vector<std::thread> threads;
+    for (unsigned int thread = 1; thread < threadCount; thread++) {
+        threads.emplace_back(work, thread);
+    }
+    work(0);
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    // spread the edges of every chart outwards, so bilinear filtering at chart borders reads baked texels
+    for (unsigned int pass = 0; pass < 2; pass++) {
+        vector<unsigned char> grown = covered;
+        for (unsigned int y = 0; y < height; y++) {
+            for (unsigned int x = 0; x < width; x++) {
+                if (covered[y * width + x]) {
+                    continue;
+                }
+                glm::vec3 sum { 0.0f };
+                unsigned int count = 0;
+                for (int dy = -1; dy <= 1; dy++) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        int nx = static_cast<int>(x) + dx, ny = static_cast<int>(y) + dy;
+                        if (nx >= 0 && ny >= 0 && nx < static_cast<int>(width) && ny < static_cast<int>(height) && covered[ny * width + nx]) {
+                            sum += texels[ny * width + nx];
+                            count++;
+                        }
+                    }
+                }
+                if (count > 0) {
+                    texels[y * width + x] = sum / static_cast<float>(count);
+                    grown[y * width + x] = 1;
+                }
+            }
+        }
+        covered.swap(grown);
+    }
+
+    stats.Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    stats.Threads = threadCount;
+    stats.Tiles = static_cast<unsigned int>(tiles.size());
+    stats.StolenTiles = stolen;
+    stats.Rays = rays;
+    return stats;
+}
+
+bool WriteRadianceHdr(char const *path, unsigned int width, unsigned int height, vector<glm::vec3> const &texels) {
+    FILE *file = std::fopen(path, "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    std::fprintf(file, "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y %u +X %u\n", height, width);
+    // the format stores the top row first, the texels start at the bottom
+    vector<unsigned char> row(width * 4);
+    for (unsigned int y = height; y-- > 0;) {
+        for (unsigned int x = 0; x < width; x++) {
+            glm::vec3 const &color = texels[y * width + x];
+            float largest = std::max({ color.r, color.g, color.b });
+            unsigned char *rgbe = &row[x * 4];
+            if (largest < 1e-32f) {
+                rgbe[0] = rgbe[1] = rgbe[2] = rgbe[3] = 0;
+                continue;
+            }
+            int exponent;
+            float scale = std::frexp(largest, &exponent) * 256.0f / largest;
+            rgbe[0] = static_cast<unsigned char>(std::max(0.0f, color.r) * scale);
+            rgbe[1] = static_cast<unsigned char>(std::max(0.0f, color.g) * scale);
+            rgbe[2] = static_cast<unsigned char>(std::max(0.0f, color.b) * scale);
+            rgbe[3] = static_cast<unsigned char>(exponent + 128);
+        }
+        std::fwrite(row.data(), 1, row.size(), file);
+    }
+    return std::fclose(file) == 0;
+}
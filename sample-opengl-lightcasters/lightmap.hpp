@@ -0,0 +1,95 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "trianglebvh.hpp"
+
+// Lightmap coordinates for a triangle list, one per vertex. Connected triangles facing the same way form a chart,
+// each chart is projected onto its plane and the charts are shelf-packed into the unit square at the largest scale
+// that fits, with `padding` texels around each at the given resolution so filtering never mixes two charts.
+std::vector<glm::vec2> UnwrapLightmap(std::vector<glm::vec3> const &positions, std::vector<glm::vec3> const &normals, unsigned int resolution,
+                                      unsigned int padding = 2);
+
+// Lays instances out as a grid of equal squares of instanceResolution texels in one lightmap, whose size is
+// returned. Each instance's scale (xy) and offset (zw) maps its unit-square coordinates into its square.
+glm::uvec2 PackLightmapInstances(unsigned int instanceCount, unsigned int instanceResolution, std::vector<glm::vec4> &scaleOffsets);
+
+struct LightmapSettings {
+    unsigned int Samples = 64; // indirect paths per texel
+    unsigned int Bounces = 2;
+    unsigned int TileSize = 16; // texels per side of a scheduling unit
+    unsigned int ThreadCount = 0; // 0 uses the hardware concurrency
+};
+
+struct LightmapStats {
+    double Milliseconds = 0.0;
+    unsigned int Threads = 0;
+    unsigned int Texels = 0; // covered by geometry
+    unsigned int Tiles = 0;
+    unsigned int StolenTiles = 0; // run by another thread than the one they were queued on
+    unsigned long long Rays = 0;
+};
+
+// Offline baker for the diffuse lighting of static lights on static geometry. Every covered texel gets the lights'
+// ambient terms, their direct light tested with shadow rays, and indirect light path-traced along cosine-weighted
+// directions for a few bounces, all ray queries going through a TriangleBvh. Texels hold what the samples' shaders
+// multiply the diffuse texture with, so a baked surface looks like the dynamic one plus shadows and bounced light.
+//
+// The lightmap is split into square tiles that are dealt out evenly to per-thread queues; a thread that runs out
+// steals from the front of another's queue, so the threads finish together however the work is spread. Every texel
+// seeds its own random numbers, so the result does not depend on the thread count.
+class LightmapBaker {
+    public:
+        struct DirectionalLight {
+            glm::vec3 Direction;
+            glm::vec3 Diffuse;
+            glm::vec3 Ambient;
+        };
+        struct PointLight {
+            glm::vec3 Position;
+            glm::vec3 Diffuse;
+            glm::vec3 Ambient;
+            float Constant, Linear, Quadratic;
+        };
+    private:
+        struct Texel {
+            glm::vec3 Position;
+            glm::vec3 Normal;
+        };
+
+        std::vector<glm::vec3> corners; // world space, three per triangle
+        std::vector<glm::vec3> cornerNormals;
+        std::vector<glm::vec2> cornerCoords; // in the lightmap
+        std::vector<glm::vec3> triangleAlbedos;
+        std::vector<DirectionalLight> directionalLights;
+        std::vector<PointLight> pointLights;
+
+        glm::vec3 directLight(TriangleBvh const &bvh, glm::vec3 const &position, glm::vec3 const &normal, bool ambient, unsigned long long &rays) const;
+        glm::vec3 hitNormal(RayHit const &hit) const;
+        glm::vec3 bakeTexel(TriangleBvh const &bvh, Texel const &texel, unsigned int seed, LightmapSettings const &settings,
+                            unsigned long long &rays) const;
+    public:
+        // A static triangle list in world space with its coordinates in the lightmap and the average color of its
+        // diffuse texture, which tints the light it bounces
+        void AddMesh(std::vector<glm::vec3> const &positions, std::vector<glm::vec3> const &normals, std::vector<glm::vec2> const &lightmapCoords,
+                     glm::vec3 const &albedo);
+        void AddDirectionalLight(DirectionalLight const &light) { directionalLights.push_back(light); }
+        void AddPointLight(PointLight const &light) { pointLights.push_back(light); }
+
+        // Fills width * height texels, rows from the bottom like GL textures
+        LightmapStats Bake(unsigned int width, unsigned int height, LightmapSettings const &settings, std::vector<glm::vec3> &texels) const;
+
+        // Ray queries against the meshes added so far, for TraceRadiance
+        TriangleBvh BuildBvh() const { return TriangleBvh { corners }; }
+        // Light the ray brings back from the first surface it hits: that surface's direct light tinted by its albedo,
+        // as one bounce of the bake sees it, or black when the ray leaves the scene. Returns false when the ray hits a
+        // surface from behind, which only happens from inside a closed mesh.
+        bool TraceRadiance(TriangleBvh const &bvh, Ray const &ray, glm::vec3 &radiance, unsigned long long &rays) const;
+        // The lights' ambient terms at a position, which the bake adds to every texel
+        glm::vec3 AmbientLight(glm::vec3 const &position) const;
+};
+
+// Radiance RGBE, which stb_image loads back as floats
+bool WriteRadianceHdr(char const *path, unsigned int width, unsigned int height, std::vector<glm::vec3> const &texels);
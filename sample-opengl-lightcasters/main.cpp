@@ -2,11 +2,42 @@
 
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 using std::cout;
 using std::endl;
 
+#include "bvh.hpp"
+#include "dynamicresolution.hpp"
+#include "framebenchmark.hpp"
+#include "glcapture.hpp"
+#include "glintercept.hpp"
+#include "gpuculling.hpp"
+#include "headless.hpp"
+#include "hud.hpp"
+#include "nullgl.hpp"
+#include "lightmap.hpp"
+#include "occlusion.hpp"
+#include "postprocess.hpp"
+#include "probegrid.hpp"
+#include "rendertargetpool.hpp"
+#include "renderstats.hpp"
+#include "scene.hpp"
+#include "shadowatlas.hpp"
+#include "temporalupsampler.hpp"
+#include "upsamplingtest.hpp"
+
 #include "shader.h"
+#include "stb_image.h"
 
 #include "texture.hpp"
 
@@ -19,6 +50,42 @@ float lastFrame = 0.0f;
 float lastX = WIDTH / 2.0f;
 float lastY = HEIGHT / 2.0f;
 bool firstMouse = true;
+// G switches the cubes between CPU culling and the GPU-driven path when the context supports it
+bool gpuCullingSupported = false;
+bool gpuCulling = false;
+bool gpuCullingKeyDown = false;
+// B switches the static cubes between the baked lightmap and dynamic lighting once ./baker has written one
+bool bakedLightingAvailable = false;
+bool bakedLighting = false;
+bool bakedLightingKeyDown = false;
+// P switches the rotating cubes between the probe grid's bounced light and the lights' flat ambient terms
+bool probeLighting = true;
+bool probeLightingKeyDown = false;
+// L switches the point lights on and off, and the probe grid rebakes for the change in the background; the lightmap
+// is baked offline and keeps them
+bool pointLights = true;
+bool pointLightsKeyDown = false;
+// R switches the scene between dynamic resolution and the window's full resolution
+bool dynamicResolution = true;
+bool dynamicResolutionKeyDown = false;
+// T switches between temporal upsampling and stretching the low resolution frame over the window
+bool temporalUpsampling = true;
+bool temporalUpsamplingKeyDown = false;
+// F cycles the anti-aliasing: none, FXAA over the finished frame, or 4x multisampling of the scene
+enum class AntiAliasing { Off, Fxaa, Msaa };
+AntiAliasing antiAliasing = AntiAliasing::Off;
+bool antiAliasingKeyDown = false;
+// H shows the frame times and render counters over the scene
+bool hudVisible = false;
+bool hudKeyDown = false;
+
+char const *antiAliasingName(AntiAliasing mode) {
+    switch (mode) {
+        case AntiAliasing::Fxaa: return "FXAA";
+        case AntiAliasing::Msaa: return "MSAA 4x";
+        default: return "off";
+    }
+}
 
 void processInput(GLFWwindow* window) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
@@ -36,108 +103,299 @@ void processInput(GLFWwindow* window) {
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
         camera.ProcessKeyboard(RIGHT, deltaTime);
     }
+    bool gpuCullingKey = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+    if (gpuCullingKey && !gpuCullingKeyDown && gpuCullingSupported) {
+        gpuCulling = !gpuCulling;
+        cout << "GPU culling " << (gpuCulling ? "on" : "off") << endl;
+    }
+    gpuCullingKeyDown = gpuCullingKey;
+    bool bakedLightingKey = glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS;
+    if (bakedLightingKey && !bakedLightingKeyDown && bakedLightingAvailable) {
+        bakedLighting = !bakedLighting;
+        cout << "Baked lighting " << (bakedLighting ? "on" : "off") << endl;
+    }
+    bakedLightingKeyDown = bakedLightingKey;
+    bool probeLightingKey = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+    if (probeLightingKey && !probeLightingKeyDown) {
+        probeLighting = !probeLighting;
+        cout << "Probe lighting " << (probeLighting ? "on" : "off") << endl;
+    }
+    probeLightingKeyDown = probeLightingKey;
+    bool pointLightsKey = glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS;
+    if (pointLightsKey && !pointLightsKeyDown) {
+        pointLights = !pointLights;
+        cout << "Point lights " << (pointLights ? "on" : "off") << endl;
+    }
+    pointLightsKeyDown = pointLightsKey;
+    bool dynamicResolutionKey = glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
+    if (dynamicResolutionKey && !dynamicResolutionKeyDown) {
+        dynamicResolution = !dynamicResolution;
+        cout << "Dynamic resolution " << (dynamicResolution ? "on" : "off") << endl;
+    }
+    dynamicResolutionKeyDown = dynamicResolutionKey;
+    bool temporalUpsamplingKey = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+    if (temporalUpsamplingKey && !temporalUpsamplingKeyDown) {
+        temporalUpsampling = !temporalUpsampling;
+        cout << "Temporal upsampling " << (temporalUpsampling ? "on" : "off") << endl;
+    }
+    temporalUpsamplingKeyDown = temporalUpsamplingKey;
+    bool antiAliasingKey = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
+    if (antiAliasingKey && !antiAliasingKeyDown) {
+        antiAliasing = static_cast<AntiAliasing>((static_cast<int>(antiAliasing) + 1) % 3);
+        cout << "Anti-aliasing " << antiAliasingName(antiAliasing) << endl;
+    }
+    antiAliasingKeyDown = antiAliasingKey;
+    bool hudKey = glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS;
+    if (hudKey && !hudKeyDown) {
+        hudVisible = !hudVisible;
+    }
+    hudKeyDown = hudKey;
+}
+
+// Solves constant + linear * d + quadratic * d^2 = threshold for the distance d at which the light
+// contribution is scaled down by 1 / threshold.
+float lightRange(float constant, float linear, float quadratic, float threshold) {
+    float c = constant - threshold;
+    return (-linear + std::sqrt(linear * linear - 4.0f * quadratic * c)) / (2.0f * quadratic);
 }
 
-int main() {
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+// The point lights' colors, black while they are switched off
+void setPointLightColors(Shader const &shader, unsigned int pointLightCount, bool on) {
+    shader.Use();
+    float scale = on ? 1.0f : 0.0f;
+    for ( unsigned int i = 0; i < pointLightCount; i++ ) {
+        std::string light = "pointLights[" + std::to_string(i) + "]";
+        shader.SetFloatVec3(light + ".ambient", POINT_LIGHT_AMBIENT * scale);
+        shader.SetFloatVec3(light + ".diffuse", POINT_LIGHT_DIFFUSE * scale);
+        shader.SetFloatVec3(light + ".specular", POINT_LIGHT_SPECULAR * scale);
+    }
+}
 
-    auto window = glfwCreateWindow(WIDTH, HEIGHT, "Light Casters", nullptr, nullptr);
-    if (window == nullptr) {
-        cout << "Failed to create GLFW window" << endl;
-        return -1;
+// Static material and light uniforms shared by the regular and the indirect cube programs
+void setCubeUniforms(Shader const &shader, int diffuseUnit, int specularUnit, unsigned int pointLightCount) {
+    shader.Use();
+    // material properties
+    shader.SetInt("material.diffuse", diffuseUnit);
+    shader.SetInt("material.specular", specularUnit);
+    shader.SetFloat("material.shininess", 32.0f);
+
+    // directional light properties
+    shader.SetFloatVec3("directionalLight.ambient", DIRECTIONAL_LIGHT_AMBIENT);
+    shader.SetFloatVec3("directionalLight.diffuse", DIRECTIONAL_LIGHT_DIFFUSE);
+    shader.SetFloatVec3("directionalLight.specular", DIRECTIONAL_LIGHT_SPECULAR);
+    // point light properties
+    setPointLightColors(shader, pointLightCount, pointLights);
+    for ( unsigned int i = 0; i < pointLightCount; i++ ) {
+        std::string light = "pointLights[" + std::to_string(i) + "]";
+        shader.SetFloat(light + ".constant", POINT_LIGHT_CONSTANT);
+        shader.SetFloat(light + ".linear", POINT_LIGHT_LINEAR);
+        shader.SetFloat(light + ".quadratic", POINT_LIGHT_QUADRATIC);
+    }
+    // spotlight properties
+    shader.SetFloatVec3("spotlight.ambient", glm::vec3 { 0.0f });
+    shader.SetFloatVec3("spotlight.diffuse", glm::vec3 { 1.0f });
+    shader.SetFloatVec3("spotlight.specular", POINT_LIGHT_SPECULAR);
+    shader.SetFloat("spotlight.constant", 1.0f);
+    shader.SetFloat("spotlight.linear", 0.09f);
+    shader.SetFloat("spotlight.quadratic", 0.032f);
+    shader.SetFloat("spotlight.innerCutOff", glm::cos(glm::radians(12.5f)));
+    shader.SetFloat("spotlight.outerCutOff", glm::cos(glm::radians(17.5f)));
+}
+
+// The cube shaders light in view space, so the light positions and directions follow the camera every frame
+void setViewSpaceLights(Shader const &shader, glm::mat4 const &view, glm::vec3 const &directionalDirection, glm::vec3 const *pointLightPositions,
+                        unsigned int pointLightCount, glm::vec3 const &spotPosition, glm::vec3 const &spotDirection) {
+    glm::mat3 rotation { view };
+    shader.SetFloatVec3("directionalLight.direction", rotation * directionalDirection);
+    for ( unsigned int i = 0; i < pointLightCount; i++ ) {
+        shader.SetFloatVec3("pointLights[" + std::to_string(i) + "].position", glm::vec3 { view * glm::vec4 { pointLightPositions[i], 1.0f } });
     }
+    shader.SetFloatVec3("spotlight.position", glm::vec3 { view * glm::vec4 { spotPosition, 1.0f } });
+    shader.SetFloatVec3("spotlight.direction", rotation * spotDirection);
+}
+
+// Loads the baker's float lightmap, or returns 0 if there is none or it was baked for another layout
+GLuint loadLightmap(char const *path, glm::uvec2 const &size) {
+    int width, height, channels;
+    stbi_set_flip_vertically_on_load(true);
+    float *data = stbi_loadf(path, &width, &height, &channels, 3);
+    stbi_set_flip_vertically_on_load(false);
+    if (data == nullptr) {
+        cout << "No lightmap at " << path << ", run ./baker to bake the static cubes" << endl;
+        return 0;
+    }
+    if (width != static_cast<int>(size.x) || height != static_cast<int>(size.y)) {
+        cout << "The lightmap at " << path << " is " << width << "x" << height << " instead of " << size.x << "x" << size.y << ", run ./baker again" << endl;
+        stbi_image_free(data);
+        return 0;
+    }
+    GLuint textureId;
+    glGenTextures(1, &textureId);
+    glBindTexture(GL_TEXTURE_2D, textureId);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, data);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    stbi_image_free(data);
+    return textureId;
+}
+
+void printUsage() {
+    cout << "usage: main [--headless | --null-gl] [--upsampling-test | --benchmark [--frames N] [--warmup N] [--camera-path FILE] [--output FILE]"
+         << " [--baseline FILE [--max-regression FRACTION]]] [--gl-calls FILE]"
+         << " [--capture FILE [--capture-frames N]]" << endl;
+}
 
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, [](GLFWwindow*, int width, int height) {
-        glViewport(0, 0, width, height);
-    });
-    glfwSetCursorPosCallback(window, [](GLFWwindow*, double xposin, double yposin) {
-        float xpos = static_cast<float>(xposin);
-        float ypos = static_cast<float>(yposin);
-        if (firstMouse) {
-            lastX = xpos;
-            lastY = ypos;
-            firstMouse = false;
-        }
-
-        float xoffset = xpos - lastX;
-        float yoffset = lastY - ypos;
-
-        lastX = xpos;
-        lastY = ypos;
-        camera.ProcessMouseMovement(xoffset, yoffset);
-    });
-    glfwSetScrollCallback(window, [](GLFWwindow*, double, double yoffset) {
-        camera.ProcessMouseScroll(static_cast<float>(yoffset));
-    });
-
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-        cout << "Unable to initialize GLAD" << endl;
+int main(int argc, char** argv) {
+    // --upsampling-test flies a fixed path and compares temporal upsampling against native resolution, then quits;
+    // --benchmark flies a scripted path and writes the frame timings; --headless runs either without a window;
+    // --null-gl runs the benchmark without a driver, to time the sample's own CPU work;
+    // --gl-calls writes every frame's GL calls, redundant binds and stalls; --capture records the GL calls of the
+    // startup and the first frames into a trace for ./replay, then quits
+    bool headless = false;
+    bool nullGl = false;
+    bool upsamplingTestRequested = false;
+    bool benchmarkRequested = false;
+    FrameBenchmark::Settings benchmarkSettings;
+    std::string glCallsPath;
+    std::string capturePath;
+    unsigned int captureFrames = 10;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "--headless") {
+            headless = true;
+        } else if (argument == "--null-gl") {
+            nullGl = true;
+        } else if (argument == "--upsampling-test") {
+            upsamplingTestRequested = true;
+        } else if (argument == "--benchmark") {
+            benchmarkRequested = true;
+        } else if (argument == "--frames" && hasValue) {
+            benchmarkSettings.Frames = static_cast<unsigned int>(std::max(1, std::atoi(argv[++i])));
+        } else if (argument == "--warmup" && hasValue) {
+            benchmarkSettings.WarmupFrames = static_cast<unsigned int>(std::max(0, std::atoi(argv[++i])));
+        } else if (argument == "--camera-path" && hasValue) {
+            std::string path = argv[++i];
+            if (!FrameBenchmark::LoadCameraPath(path, benchmarkSettings.CameraPath)) {
+                cout << "Can't read the camera path " << path << endl;
+                return -1;
+            }
+        } else if (argument == "--output" && hasValue) {
+            benchmarkSettings.Output = argv[++i];
+        } else if (argument == "--baseline" && hasValue) {
+            benchmarkSettings.Baseline = argv[++i];
+        } else if (argument == "--max-regression" && hasValue) {
+            benchmarkSettings.MaxRegression = std::atof(argv[++i]);
+        } else if (argument == "--gl-calls" && hasValue) {
+            glCallsPath = argv[++i];
+        } else if (argument == "--capture" && hasValue) {
+            capturePath = argv[++i];
+        } else if (argument == "--capture-frames" && hasValue) {
+            captureFrames = static_cast<unsigned int>(std::max(1, std::atoi(argv[++i])));
+        } else {
+            printUsage();
+            return -1;
+        }
+    }
+    if ((headless && !upsamplingTestRequested && !benchmarkRequested) || (upsamplingTestRequested && benchmarkRequested) ||
+        (nullGl && (headless || !benchmarkRequested))) {
+        printUsage();
         return -1;
     }
+    std::unique_ptr<UpsamplingTest> upsamplingTest;
+    if (upsamplingTestRequested) {
+        upsamplingTest = std::make_unique<UpsamplingTest>();
+    }
+    // nothing on the scripted paths reads the mouse or keyboard
+    bool scripted = upsamplingTestRequested || benchmarkRequested;
+    int exitCode = 0;
+
+    GLFWwindow* window = nullptr;
+    std::unique_ptr<HeadlessContext> headlessContext;
+    if (nullGl) {
+        NullGl::Load(WIDTH, HEIGHT);
+    } else if (headless) {
+        headlessContext = HeadlessContext::Create(WIDTH, HEIGHT);
+        if (headlessContext == nullptr) {
+            cout << "Failed to create a headless EGL context" << endl;
+            return -1;
+        }
+        if (!gladLoadGLLoader((GLADloadproc)HeadlessContext::GetProcAddress)) {
+            cout << "Unable to initialize GLAD" << endl;
+            return -1;
+        }
+    } else {
+        glfwInit();
+        // ask for 4.3 to get compute shaders and indirect draws, the sample itself only needs 3.3
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_VISIBLE, scripted ? GLFW_FALSE : GLFW_TRUE);
+
+        window = glfwCreateWindow(WIDTH, HEIGHT, "Light Casters", nullptr, nullptr);
+        if (window == nullptr) {
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+            window = glfwCreateWindow(WIDTH, HEIGHT, "Light Casters", nullptr, nullptr);
+        }
+        if (window == nullptr) {
+            cout << "Failed to create GLFW window" << endl;
+            return -1;
+        }
+
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, [](GLFWwindow*, int width, int height) {
+            glViewport(0, 0, width, height);
+        });
+        // the scripted modes place the camera themselves
+        if (!scripted) {
+            glfwSetCursorPosCallback(window, [](GLFWwindow*, double xposin, double yposin) {
+                float xpos = static_cast<float>(xposin);
+                float ypos = static_cast<float>(yposin);
+                if (firstMouse) {
+                    lastX = xpos;
+                    lastY = ypos;
+                    firstMouse = false;
+                }
+
+                float xoffset = xpos - lastX;
+                float yoffset = lastY - ypos;
+
+                lastX = xpos;
+                lastY = ypos;
+                camera.ProcessMouseMovement(xoffset, yoffset);
+            });
+            glfwSetScrollCallback(window, [](GLFWwindow*, double, double yoffset) {
+                camera.ProcessMouseScroll(static_cast<float>(yoffset));
+            });
+        }
 
-    // vertex for cube
-    GLfloat vertices[] = {
-    // positions          // normals           // texture coords
-    -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
-     0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
-     0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
-     0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
-    -0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
-    -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
-
-    -0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   0.0f, 0.0f,
-     0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   1.0f, 0.0f,
-     0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   1.0f, 1.0f,
-     0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   1.0f, 1.0f,
-    -0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   0.0f, 1.0f,
-    -0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   0.0f, 0.0f,
-
-    -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-    -0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
-    -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-    -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-    -0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
-    -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-
-     0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-     0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
-     0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-     0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-     0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
-     0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-
-    -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
-     0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 1.0f,
-     0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
-     0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
-    -0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 0.0f,
-    -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
-
-    -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f,
-     0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 1.0f,
-     0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
-     0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
-    -0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 0.0f,
-    -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f
-    };
-
-    // cube positions
-    glm::vec3 cubePositions[] = {
-        glm::vec3 { 0.0f,  0.0f,  0.0f },
-        glm::vec3 { 2.0f,  5.0f, -15.0f },
-        glm::vec3 { -1.5f, -2.2f, -2.5f },
-        glm::vec3 { -3.8f, -2.0f, -12.3f },
-        glm::vec3 { 2.4f, -0.4f, -3.5f },
-        glm::vec3 { -1.7f,  3.0f, -7.5f },
-        glm::vec3 { 1.3f, -2.0f, -2.5f },
-        glm::vec3 { 1.5f,  2.0f, -2.5f },
-        glm::vec3 { 1.5f,  0.2f, -1.5f },
-        glm::vec3 { -1.3f,  1.0f, -1.5f }
-    };
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+            cout << "Unable to initialize GLAD" << endl;
+            return -1;
+        }
+    }
+    if (!glCallsPath.empty() && !GlIntercept::Install(glCallsPath)) {
+        cout << "Can't write " << glCallsPath << endl;
+        return -1;
+    }
+    // the counters have to see every object made to know the memory in use
+    if (!scripted) {
+        RenderStats::Install();
+    }
+    if (!capturePath.empty()) {
+        int width = WIDTH, height = HEIGHT;
+        if (window != nullptr) {
+            glfwGetFramebufferSize(window, &width, &height);
+        }
+        if (!GlCapture::Install(capturePath, width, height)) {
+            cout << "Can't write " << capturePath << endl;
+            return -1;
+        }
+    }
 
     GLuint VAO, VBO;
     glGenVertexArrays(1, &VAO);
@@ -146,7 +404,7 @@ int main() {
     glBindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(CUBE_VERTICES), CUBE_VERTICES, GL_STATIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (void*)0);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (void*)(3 * sizeof(GLfloat)));
@@ -163,147 +421,570 @@ int main() {
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (void*) 0);
     glEnableVertexAttribArray(0);
 
+    // the cube's lightmap coordinates, unwrapped the same way the baker does; each static cube gets its own square
+    std::vector<glm::vec3> cubeVertexPositions, cubeVertexNormals;
+    for ( unsigned int i = 0; i < CUBE_VERTEX_COUNT; i++ ) {
+        float const *vertex = &CUBE_VERTICES[i * CUBE_VERTEX_STRIDE];
+        cubeVertexPositions.push_back(glm::vec3 { vertex[0], vertex[1], vertex[2] });
+        cubeVertexNormals.push_back(glm::vec3 { vertex[3], vertex[4], vertex[5] });
+    }
+    std::vector<glm::vec2> lightmapCoords = UnwrapLightmap(cubeVertexPositions, cubeVertexNormals, LIGHTMAP_INSTANCE_RESOLUTION);
+    GLuint lightmapVBO;
+    glGenBuffers(1, &lightmapVBO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, lightmapVBO);
+    glBufferData(GL_ARRAY_BUFFER, lightmapCoords.size() * sizeof(glm::vec2), lightmapCoords.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)0);
+    glEnableVertexAttribArray(4);
+    unsigned int lightmapInstances[CUBE_COUNT];
+    unsigned int staticCubeCount = 0;
+    for ( unsigned int i = 0; i < CUBE_COUNT; i++ ) {
+        lightmapInstances[i] = IsDynamicCube(i) ? ~0u : staticCubeCount++;
+    }
+    std::vector<glm::vec4> lightmapScaleOffsets;
+    glm::uvec2 lightmapSize = PackLightmapInstances(staticCubeCount, LIGHTMAP_INSTANCE_RESOLUTION, lightmapScaleOffsets);
+    GLuint lightmapTexture = loadLightmap(LIGHTMAP_PATH, lightmapSize);
+    bakedLightingAvailable = lightmapTexture != 0;
+    bakedLighting = bakedLightingAvailable;
+    int const LIGHTMAP_UNIT = 3;
+
     Texture diffuseMap { "./textures/container2.png", 0 };
     Texture specularMap { "./textures/container2_specular.png", 1 };
 
     Shader cubeShader { "./shaders/cubecombine.vs", "./shaders/cubecombine.fs" };
     Shader lightShader { "./shaders/light.vs", "./shaders/light.fs" };
+    Shader bakedShader { "./shaders/cubebaked.vs", "./shaders/cubebaked.fs" };
+
+    setCubeUniforms(cubeShader, diffuseMap.GetTextureUnit(), specularMap.GetTextureUnit(), 4);
+    setCubeUniforms(bakedShader, diffuseMap.GetTextureUnit(), specularMap.GetTextureUnit(), 0);
+    bakedShader.SetInt("lightmap", LIGHTMAP_UNIT);
+
+    // bounds of the unit cube in model space, shared by every cube and light cube
+    AABB cubeBounds { glm::vec3 { -0.5f }, glm::vec3 { 0.5f } };
+    BoundingSphere cubeSphere { glm::vec3 { 0.0f }, glm::length(glm::vec3 { 0.5f }) };
+    // cubes are indexed 0-9 in the scene BVH and the culling batch, and light cubes 10-13
+    DynamicBvh sceneBvh;
+    // a handful of objects is culled faster by the linear kernel than by walking the tree (see ./bench), so the
+    // camera and the shadow tiles go through the batch and the tree answers the light range queries
+    CullingBatch objectBatch;
+    int cubeProxies[CUBE_COUNT];
+    glm::mat4 cubeModels[CUBE_COUNT];
+    glm::mat4 lightModels[POINT_LIGHT_COUNT];
+    for ( unsigned int i = 0; i < CUBE_COUNT; i++ ) {
+        cubeModels[i] = glm::translate(glm::mat4 { 1.0f }, CUBE_POSITIONS[i]);
+        cubeProxies[i] = sceneBvh.Insert(TransformAABB(cubeBounds, cubeModels[i]), i);
+    }
+    for ( unsigned int i = 0; i < POINT_LIGHT_COUNT; i++ ) {
+        glm::mat4 model { 1.0f };
+        model = glm::translate(model, POINT_LIGHT_POSITIONS[i]);
+        model = glm::rotate(model, glm::radians(45.0f), glm::vec3 { 0.0f, 1.0f, 1.0f });
+        model = glm::scale(model, glm::vec3 { 0.2f } );
+        lightModels[i] = model;
+        sceneBvh.Insert(TransformAABB(cubeBounds, model), CUBE_COUNT + i);
+    }
+    // distance at which a point light's attenuation drops below 1/256, i.e. it no longer changes an 8-bit color
+    float pointLightRange = lightRange(POINT_LIGHT_CONSTANT, POINT_LIGHT_LINEAR, POINT_LIGHT_QUADRATIC, 256.0f);
+    unsigned int pointLightMasks[CUBE_COUNT];
+    std::vector<unsigned int> visibleObjects;
+    CullStats lastStats { ~0u, ~0u };
+    unsigned int lastOccluded = ~0u;
+
+    // the cubes double as occluders for everything behind them
+    glm::vec3 cubeTriangles[36];
+    for ( unsigned int i = 0; i < 36; i++ ) {
+        cubeTriangles[i] = glm::vec3 { CUBE_VERTICES[i * CUBE_VERTEX_STRIDE + 0], CUBE_VERTICES[i * CUBE_VERTEX_STRIDE + 1], CUBE_VERTICES[i * CUBE_VERTEX_STRIDE + 2] };
+    }
+    OcclusionBuffer occlusionBuffer { 256, 192 };
+    OcclusionStats occlusionStats;
+
+    std::unique_ptr<GpuCuller> gpuCuller;
+    std::unique_ptr<Shader> cubeIndirectShader;
+    GpuObject gpuObjects[CUBE_COUNT];
+    unsigned int lastGpuVisible = ~0u;
+    // the capture doesn't see the functions GpuCuller loads itself
+    gpuCullingSupported = !nullGl && !GlCapture::IsInstalled() && GpuCuller::Load(headless ? (GLADloadproc)HeadlessContext::GetProcAddress : (GLADloadproc)glfwGetProcAddress);
+    if (gpuCullingSupported) {
+        gpuCuller = std::make_unique<GpuCuller>(CUBE_COUNT, 36);
+        gpuCuller->BindObjectIdAttribute(VAO, 3);
+        cubeIndirectShader = std::make_unique<Shader>("./shaders/cubeindirect.vs", "./shaders/cubecombine.fs");
+        setCubeUniforms(*cubeIndirectShader, diffuseMap.GetTextureUnit(), specularMap.GetTextureUnit(), 4);
+        cout << "GPU culling available (G to toggle), indirect count: " << (gpuCuller->HasIndirectCount() ? "yes" : "no") << endl;
+    }
 
-    cubeShader.Use();
-    // material properties
-    cubeShader.SetInt("material.diffuse", diffuseMap.GetTextureUnit());
-    cubeShader.SetInt("material.specular", specularMap.GetTextureUnit());
-    cubeShader.SetFloat("material.shininess", 32.0f);
-
-    glm::vec3 lightColor { 1.0 };
-    glm::vec3 diffuseColor = lightColor * glm::vec3 { 0.8f };
-    glm::vec3 ambientColor = diffuseColor * glm::vec3 { 0.05f };
-    glm::vec3 specularColor = lightColor * glm::vec3 { 0.5f };
-    // directional light properties
-    cubeShader.SetFloatVec3("directionalLight.ambient", ambientColor);
-    cubeShader.SetFloatVec3("directionalLight.diffuse", diffuseColor);
-    cubeShader.SetFloatVec3("directionalLight.specular", specularColor);
-    cubeShader.SetFloatVec3("directionalLight.direction", glm::vec3 { -0.2f, -1.0f, -0.3f });
-    // point light properties
-    lightColor = glm::vec3 { 1.0, 0.0, 0.0 };
-    diffuseColor = lightColor * glm::vec3 { 0.3f };
-    ambientColor = diffuseColor * glm::vec3 { 0.05f };
-    specularColor = lightColor * glm::vec3 { 1.0f };
-    glm::vec3 pointLightPositions[] = {
-        glm::vec3( 0.7f,  0.2f,  2.0f),
-        glm::vec3( 2.3f, -3.3f, -4.0f),
-        glm::vec3(-4.0f,  2.0f, -12.0f),
-        glm::vec3( 0.0f,  0.0f, -3.0f)
-    };
-    cubeShader.SetFloatVec3("pointLights[0].ambient", ambientColor);
-    cubeShader.SetFloatVec3("pointLights[0].diffuse", diffuseColor);
-    cubeShader.SetFloatVec3("pointLights[0].specular", specularColor);
-    cubeShader.SetFloatVec3("pointLights[0].position", pointLightPositions[0]);
-    cubeShader.SetFloat("pointLights[0].constant", 1.0f);
-    cubeShader.SetFloat("pointLights[0].linear", 0.045f);
-    cubeShader.SetFloat("pointLights[0].quadratic", 0.0075f);
-
-    cubeShader.SetFloatVec3("pointLights[1].ambient", ambientColor);
-    cubeShader.SetFloatVec3("pointLights[1].diffuse", diffuseColor);
-    cubeShader.SetFloatVec3("pointLights[1].specular", specularColor);
-    cubeShader.SetFloatVec3("pointLights[1].position", pointLightPositions[1]);
-    cubeShader.SetFloat("pointLights[1].constant", 1.0f);
-    cubeShader.SetFloat("pointLights[1].linear", 0.045f);
-    cubeShader.SetFloat("pointLights[1].quadratic", 0.0075f);
-
-    cubeShader.SetFloatVec3("pointLights[2].ambient", ambientColor);
-    cubeShader.SetFloatVec3("pointLights[2].diffuse", diffuseColor);
-    cubeShader.SetFloatVec3("pointLights[2].specular", specularColor);
-    cubeShader.SetFloatVec3("pointLights[2].position", pointLightPositions[2]);
-    cubeShader.SetFloat("pointLights[2].constant", 1.0f);
-    cubeShader.SetFloat("pointLights[2].linear", 0.045f);
-    cubeShader.SetFloat("pointLights[2].quadratic", 0.0075f);
-
-    cubeShader.SetFloatVec3("pointLights[3].ambient", ambientColor);
-    cubeShader.SetFloatVec3("pointLights[3].diffuse", diffuseColor);
-    cubeShader.SetFloatVec3("pointLights[3].specular", specularColor);
-    cubeShader.SetFloatVec3("pointLights[3].position", pointLightPositions[3]);
-    cubeShader.SetFloat("pointLights[3].constant", 1.0f);
-    cubeShader.SetFloat("pointLights[3].linear", 0.045f);
-    cubeShader.SetFloat("pointLights[3].quadratic", 0.0075f);
-    // spotlight properties
-    lightColor = glm::vec3 { 1.0 };
-    diffuseColor = lightColor * glm::vec3 { 1.0f };
-    ambientColor = diffuseColor * glm::vec3 { 0.0f };
-    cubeShader.SetFloatVec3("spotlight.ambient", ambientColor);
-    cubeShader.SetFloatVec3("spotlight.diffuse", diffuseColor);
-    cubeShader.SetFloatVec3("spotlight.specular", specularColor);
-    cubeShader.SetFloat("spotlight.constant", 1.0f);
-    cubeShader.SetFloat("spotlight.linear", 0.09f);
-    cubeShader.SetFloat("spotlight.quadratic", 0.032f);
-    cubeShader.SetFloat("spotlight.innerCutOff", glm::cos(glm::radians(12.5f)));
-    cubeShader.SetFloat("spotlight.outerCutOff", glm::cos(glm::radians(17.5f)));
+    // the rotating cubes are the dynamic shadow casters, everything else is cached in the shadow atlas
+    float const spotOuterCutOff = glm::cos(glm::radians(17.5f));
+    float const spotRange = lightRange(1.0f, 0.09f, 0.032f, 256.0f);
+    int const SHADOW_ATLAS_UNIT = 2;
+    auto shadowAtlas = std::make_unique<ShadowAtlas>();
+    ShadowAtlas::Stats lastShadowStats { ~0u };
+
+    // the rotating cubes pick up the static scene's bounced light from a grid of probes baked in the background,
+    // which fill in over the first frames; a new snapshot of the scene rebakes them whenever the static lights change
+    glm::vec3 const staticAlbedo = AverageTextureColor("./textures/container2.png");
+    auto staticScene = std::make_shared<LightmapBaker>();
+    BuildStaticScene(*staticScene, staticAlbedo, pointLights);
+    ProbeGrid probeGrid { PROBE_GRID_MIN, PROBE_GRID_MAX, PROBE_GRID_RESOLUTION };
+    probeGrid.Rebake(staticScene);
+    bool lastPointLights = pointLights;
+    std::string probeUniforms[ShIrradiance::COEFFICIENT_COUNT];
+    for ( unsigned int i = 0; i < ShIrradiance::COEFFICIENT_COUNT; i++ ) {
+        probeUniforms[i] = "probeIrradiance[" + std::to_string(i) + "]";
+    }
+    unsigned int lastProbesBaked = ~0u;
+
+    // the scene goes to an offscreen target sized to keep the GPU within its frame budget, then to the window
+    int framebufferWidth = WIDTH, framebufferHeight = HEIGHT;
+    if (window != nullptr) {
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    }
+    auto resolution = std::make_unique<DynamicResolution>(framebufferWidth, framebufferHeight);
+    resolution->SetLog(&cout);
+    float lastScale = -1.0f;
+    AntiAliasing lastTitleAntiAliasing = antiAliasing;
+    // the jittered low resolution frames are accumulated into a window sized history
+    auto upsampler = std::make_unique<TemporalUpsampler>(framebufferWidth, framebufferHeight);
+    // passes over the finished frame at the window's size
+    auto renderTargets = std::make_unique<RenderTargetPool>();
+    auto postProcess = std::make_unique<PostProcessChain>(*renderTargets);
+    unsigned int fxaaPass = postProcess->AddPass("FXAA", "./shaders/fxaa.fs");
+    std::unique_ptr<Hud> hud;
+    if (!scripted) {
+        hud = std::make_unique<Hud>();
+    }
+    // GPU time of the scene and of the post-processing averaged over a while under each anti-aliasing mode, once
+    // the timings of the previous one drained
+    AntiAliasing lastAntiAliasing = antiAliasing;
+    unsigned int antiAliasingFrames = 0;
+    double antiAliasingSceneMilliseconds = 0.0;
+    double antiAliasingPostMilliseconds = 0.0;
+    bool lastTemporalUpsampling = false;
+    // where the rotating cubes were last frame, for their velocity
+    glm::mat4 previousCubeModels[CUBE_COUNT];
+    std::copy(std::begin(cubeModels), std::end(cubeModels), std::begin(previousCubeModels));
 
     glEnable(GL_DEPTH_TEST);
     glClearColor(0.07f, 0.13f, 0.17f, 1.0f);
 
-    while (!glfwWindowShouldClose(window)) {
-        float current = static_cast<float>(glfwGetTime());
+    std::unique_ptr<FrameBenchmark> benchmark;
+    if (benchmarkRequested) {
+        // timings must not depend on how far the background bake got
+        while (probeGrid.GetStats().Baked < probeGrid.GetStats().Probes) {
+            std::this_thread::sleep_for(std::chrono::milliseconds { 1 });
+        }
+        dynamicResolution = false;
+        benchmark = std::make_unique<FrameBenchmark>(benchmarkSettings);
+    }
+
+    bool running = true;
+    while (running && (window == nullptr || !glfwWindowShouldClose(window))) {
+        // the scripted modes run on their own clock so every run sees the same frames
+        auto frameStart = std::chrono::steady_clock::now();
+        float current = upsamplingTest ? upsamplingTest->GetTime() : benchmark ? benchmark->GetTime() : static_cast<float>(glfwGetTime());
         deltaTime = current - lastFrame;
         lastFrame = current;
         
-        processInput(window);
+        if (!scripted) {
+            processInput(window);
+        }
+        if (benchmark) {
+            benchmark->BeginFrame();
+            benchmark->PlaceCamera(camera);
+        }
+        if (upsamplingTest) {
+            upsamplingTest->PlaceCamera(camera);
+            dynamicResolution = false;
+            temporalUpsampling = upsamplingTest->UsesTemporalUpsampling();
+            // the reference gets the coverage of its edges, which the temporal history converges to as well
+            antiAliasing = upsamplingTest->GetPass() == UpsamplingTest::Pass::Native ? AntiAliasing::Msaa : AntiAliasing::Off;
+        }
+        if (pointLights != lastPointLights) {
+            setPointLightColors(cubeShader, POINT_LIGHT_COUNT, pointLights);
+            if (cubeIndirectShader) {
+                setPointLightColors(*cubeIndirectShader, POINT_LIGHT_COUNT, pointLights);
+            }
+            staticScene = std::make_shared<LightmapBaker>();
+            BuildStaticScene(*staticScene, staticAlbedo, pointLights);
+            probeGrid.Rebake(staticScene);
+            lastPointLights = pointLights;
+        }
 
+        if (window != nullptr) {
+            glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        }
+        resolution->Resize(framebufferWidth, framebufferHeight);
+        upsampler->Resize(framebufferWidth, framebufferHeight);
+        if (resolution->IsEnabled() != dynamicResolution) {
+            resolution->SetEnabled(dynamicResolution);
+            if (!dynamicResolution) {
+                resolution->SetScale(1.0f);
+            }
+        }
+        if (upsamplingTest && upsamplingTest->IsPassStart()) {
+            resolution->SetScale(upsamplingTest->GetScale());
+            upsampler->Reset();
+        }
+        if (temporalUpsampling && !lastTemporalUpsampling) {
+            upsampler->Reset();
+        }
+        lastTemporalUpsampling = temporalUpsampling;
+        resolution->SetSamples(antiAliasing == AntiAliasing::Msaa ? 4 : 1);
+        postProcess->SetEnabled(fxaaPass, antiAliasing == AntiAliasing::Fxaa);
+        upsampler->BeginFrame();
+        resolution->Begin();
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         glBindVertexArray(VAO);
+        // the history gathers the texture detail of the full resolution over a few frames, so pick mips for that
+        float lodBias = temporalUpsampling ? std::log2(resolution->GetScale()) : 0.0f;
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, diffuseMap.GetTextureId());
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_LOD_BIAS, lodBias);
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, specularMap.GetTextureId());
-
-        cubeShader.Use();
-        cubeShader.SetFloatVec3("spotlight.position", camera.GetPosition());
-        cubeShader.SetFloatVec3("spotlight.direction", camera.GetDirection());
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_LOD_BIAS, lodBias);
 
         glm::mat4 view = camera.GetViewMatrix();
+        glm::mat4 projection = glm::perspective(camera.GetZoom(), (float) WIDTH / (float) HEIGHT, 0.1f, 100.0f);
+        Frustum frustum = camera.GetFrustum(projection);
+        // only what is drawn to the target is jittered; culling and shadows keep the steady projection
+        glm::mat4 drawProjection = temporalUpsampling ? upsampler->JitterProjection(projection, resolution->GetRenderSize()) : projection;
+
+        // the rotating cubes stay in place, so refitting the tree is enough to keep it valid
+        std::copy(std::begin(cubeModels), std::end(cubeModels), std::begin(previousCubeModels));
+        for ( unsigned int i = 0; i < CUBE_COUNT; i++ ) {
+            if (!IsDynamicCube(i)) {
+                continue;
+            }
+            float angle = 20.0f * (i + 1);
+            glm::mat4 model = glm::translate(glm::mat4 { 1.0f }, CUBE_POSITIONS[i]);
+            model = glm::rotate(model, current * glm::radians(angle), glm::vec3 { 0.5f, 1.0f, 0.0f });
+            cubeModels[i] = model;
+            sceneBvh.SetLeafBounds(cubeProxies[i], TransformAABB(cubeBounds, model));
+        }
+        sceneBvh.Refit();
+        objectBatch.Clear();
+        for ( unsigned int i = 0; i < CUBE_COUNT; i++ ) {
+            objectBatch.Add(TransformAABB(cubeBounds, cubeModels[i]), TransformSphere(cubeSphere, cubeModels[i]));
+        }
+        for ( unsigned int i = 0; i < POINT_LIGHT_COUNT; i++ ) {
+            objectBatch.Add(TransformAABB(cubeBounds, lightModels[i]), TransformSphere(cubeSphere, lightModels[i]));
+        }
+
+        // the light cubes mark the lights and cast nothing
+        shadowAtlas->SetDirectionalLight(DIRECTIONAL_LIGHT_DIRECTION);
+        shadowAtlas->SetSpotlight(camera.GetPosition(), camera.GetDirection(), spotOuterCutOff, spotRange);
+        shadowAtlas->SetPointLights(POINT_LIGHT_POSITIONS, POINT_LIGHT_COUNT, pointLightRange);
+        std::vector<AABB> dynamicCasters;
+        for ( unsigned int i = 0; i < CUBE_COUNT; i++ ) {
+            if (IsDynamicCube(i)) {
+                dynamicCasters.push_back(TransformAABB(cubeBounds, cubeModels[i]));
+            }
+        }
+        shadowAtlas->SetDynamicCasters(std::move(dynamicCasters));
+        ShadowAtlas::Stats shadowStats = shadowAtlas->Update(view, projection, camera.GetZoom(), (float) WIDTH / (float) HEIGHT, 0.1f,
+            [&](Shader const &depthShader, Frustum const &tileFrustum, bool dynamic) {
+                glBindVertexArray(VAO);
+                objectBatch.Cull(tileFrustum);
+                for ( unsigned int object = 0; object < CUBE_COUNT; object++ ) {
+                    if (objectBatch.IsVisible(object) && IsDynamicCube(object) == dynamic) {
+                        depthShader.SetFloatMatrix("model", cubeModels[object]);
+                        glDrawArrays(GL_TRIANGLES, 0, 36);
+                    }
+                }
+            });
+
+        cubeShader.Use();
         cubeShader.SetFloatMatrix("view", view);
+        cubeShader.SetFloatMatrix("projection", drawProjection);
+        setViewSpaceLights(cubeShader, view, DIRECTIONAL_LIGHT_DIRECTION, POINT_LIGHT_POSITIONS, POINT_LIGHT_COUNT, camera.GetPosition(), camera.GetDirection());
+        shadowAtlas->Bind(cubeShader, SHADOW_ATLAS_UNIT);
 
-        glm::mat4 projection = glm::perspective(camera.GetZoom(), (float) WIDTH / (float) HEIGHT, 0.1f, 100.0f);
-        cubeShader.SetFloatMatrix("projection", projection);
-
-        for ( unsigned int i = 0; i < 10; i++ ) {
-            glm::mat4 model { 1.0 };
-            model = glm::translate(model, cubePositions[i]);
-            if (i % 3 == 0) {
-                float angle = 20.0f * (i + 1);
-                model = glm::rotate(model, (float) glfwGetTime() * glm::radians(angle), glm::vec3 { 0.5f, 1.0f, 0.0f });
+        // light assignment: a cube only evaluates the point lights whose range reaches it
+        for ( unsigned int i = 0; i < CUBE_COUNT; i++ ) {
+            pointLightMasks[i] = 0;
+        }
+        for ( unsigned int i = 0; i < POINT_LIGHT_COUNT; i++ ) {
+            sceneBvh.QuerySphere(BoundingSphere { POINT_LIGHT_POSITIONS[i], pointLightRange }, [&](unsigned int object) {
+                if (object < CUBE_COUNT) {
+                    pointLightMasks[object] |= 1u << i;
+                }
+            });
+        }
+
+        visibleObjects.clear();
+        objectBatch.Cull(frustum);
+        for ( unsigned int object = 0; object < objectBatch.Size(); object++ ) {
+            if (objectBatch.IsVisible(object)) {
+                visibleObjects.push_back(object);
+            }
+        }
+
+        // rasterize the visible cubes into the CPU depth buffer and drop whatever they hide
+        occlusionBuffer.Begin(projection * view);
+        for (unsigned int object : visibleObjects) {
+            if (object < CUBE_COUNT) {
+                occlusionBuffer.AddOccluder(cubeTriangles, 36, cubeModels[object]);
+            }
+        }
+        occlusionBuffer.Rasterize();
+        occlusionStats.Tested = static_cast<unsigned int>(visibleObjects.size());
+        occlusionStats.RasterizeMilliseconds = occlusionBuffer.GetRasterizeMilliseconds();
+        visibleObjects.erase(std::remove_if(visibleObjects.begin(), visibleObjects.end(), [&](unsigned int object) {
+            glm::mat4 const &model = object < CUBE_COUNT ? cubeModels[object] : lightModels[object - CUBE_COUNT];
+            return !occlusionBuffer.IsVisible(TransformAABB(cubeBounds, model));
+        }), visibleObjects.end());
+        occlusionStats.Rejected = occlusionStats.Tested - static_cast<unsigned int>(visibleObjects.size());
+
+        CullStats stats;
+        stats.Visible = static_cast<unsigned int>(visibleObjects.size());
+        stats.Culled = sceneBvh.GetLeafCount() - stats.Visible;
+
+        if (gpuCulling) {
+            // every cube goes to the GPU, which culls against the frustum and last frame's depth on its own
+            for ( unsigned int i = 0; i < CUBE_COUNT; i++ ) {
+                AABB bounds = TransformAABB(cubeBounds, cubeModels[i]);
+                gpuObjects[i].Model = cubeModels[i];
+                gpuObjects[i].BoundsMin = glm::vec4 { bounds.Min, 1.0f };
+                gpuObjects[i].BoundsMax = glm::vec4 { bounds.Max, 1.0f };
+                gpuObjects[i].Extra = glm::uvec4 { pointLightMasks[i], 0u, 0u, 0u };
+            }
+            gpuCuller->SetObjects(gpuObjects, CUBE_COUNT);
+            gpuCuller->Cull(frustum);
+
+            cubeIndirectShader->Use();
+            cubeIndirectShader->SetFloatMatrix("view", view);
+            cubeIndirectShader->SetFloatMatrix("projection", drawProjection);
+            setViewSpaceLights(*cubeIndirectShader, view, DIRECTIONAL_LIGHT_DIRECTION, POINT_LIGHT_POSITIONS, POINT_LIGHT_COUNT, camera.GetPosition(),
+                               camera.GetDirection());
+            shadowAtlas->Bind(*cubeIndirectShader, SHADOW_ATLAS_UNIT);
+            // culling sampled the depth pyramid on unit 0
+            glBindVertexArray(VAO);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, diffuseMap.GetTextureId());
+            gpuCuller->Draw();
+        } else {
+            for (unsigned int object : visibleObjects) {
+                if (object >= CUBE_COUNT || (bakedLighting && !IsDynamicCube(object))) {
+                    continue;
+                }
+                cubeShader.SetFloatMatrix("model", cubeModels[object]);
+                cubeShader.SetInt("pointLightMask", static_cast<int>(pointLightMasks[object]));
+                // the cubes rotate in place, so the probes around their center are all they need
+                ShIrradiance irradiance;
+                bool probes = probeLighting && IsDynamicCube(object) && probeGrid.Sample(CUBE_POSITIONS[object], irradiance);
+                cubeShader.SetBool("probeLighting", probes);
+                for ( unsigned int i = 0; probes && i < ShIrradiance::COEFFICIENT_COUNT; i++ ) {
+                    cubeShader.SetFloatVec3(probeUniforms[i], irradiance.Coefficients[i]);
+                }
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+            }
+            // the static cubes only evaluate the spotlight on top of their lightmap
+            if (bakedLighting) {
+                bakedShader.Use();
+                bakedShader.SetFloatMatrix("view", view);
+                bakedShader.SetFloatMatrix("projection", drawProjection);
+                setViewSpaceLights(bakedShader, view, DIRECTIONAL_LIGHT_DIRECTION, POINT_LIGHT_POSITIONS, 0, camera.GetPosition(), camera.GetDirection());
+                shadowAtlas->Bind(bakedShader, SHADOW_ATLAS_UNIT);
+                glActiveTexture(GL_TEXTURE0 + LIGHTMAP_UNIT);
+                glBindTexture(GL_TEXTURE_2D, lightmapTexture);
+                glActiveTexture(GL_TEXTURE0);
+                for (unsigned int object : visibleObjects) {
+                    if (object >= CUBE_COUNT || IsDynamicCube(object)) {
+                        continue;
+                    }
+                    bakedShader.SetFloatMatrix("model", cubeModels[object]);
+                    bakedShader.SetFloatVec4("lightmapScaleOffset", lightmapScaleOffsets[lightmapInstances[object]]);
+                    glDrawArrays(GL_TRIANGLES, 0, 36);
+                }
             }
-            cubeShader.SetFloatMatrix("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
         }
 
         lightShader.Use();
         lightShader.SetFloatMatrix("view", view);
-        lightShader.SetFloatMatrix("projection", projection);
-        for ( unsigned int i = 0; i < 4; i++) {
-            glm::mat4 model { 1.0f };
-            model = glm::translate(model, pointLightPositions[i]);
-            model = glm::rotate(model, glm::radians(45.0f), glm::vec3 { 0.0f, 1.0f, 1.0f });
-            model = glm::scale(model, glm::vec3 { 0.2f } );
-            lightShader.SetFloatMatrix("model", model);
+        lightShader.SetFloatMatrix("projection", drawProjection);
+        for (unsigned int object : visibleObjects) {
+            if (object < CUBE_COUNT) {
+                continue;
+            }
+            lightShader.SetFloatMatrix("model", lightModels[object - CUBE_COUNT]);
             glDrawArrays(GL_TRIANGLES, 0, 36);
         }
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        // the velocity pass tests against the resolved depth
+        resolution->ResolveSamples();
+        if (temporalUpsampling) {
+            upsampler->DrawVelocity(*resolution, view, projection, drawProjection, [&](Shader const &velocityShader) {
+                glBindVertexArray(VAO);
+                for (unsigned int object : visibleObjects) {
+                    if (object < CUBE_COUNT) {
+                        velocityShader.SetFloatMatrix("model", cubeModels[object]);
+                        velocityShader.SetFloatMatrix("previousModel", previousCubeModels[object]);
+                    } else {
+                        velocityShader.SetFloatMatrix("model", lightModels[object - CUBE_COUNT]);
+                        velocityShader.SetFloatMatrix("previousModel", lightModels[object - CUBE_COUNT]);
+                    }
+                    glDrawArrays(GL_TRIANGLES, 0, 36);
+                }
+            });
+        }
+
+        resolution->End();
+        GLuint output = postProcess->Begin(framebufferWidth, framebufferHeight);
+        if (temporalUpsampling) {
+            upsampler->Resolve(*resolution, projection * view, output);
+        } else {
+            resolution->Present(output);
+        }
+        postProcess->End();
+        renderTargets->EndFrame();
+        if (upsamplingTest) {
+            upsamplingTest->EndFrame(framebufferWidth, framebufferHeight);
+            if (upsamplingTest->IsFinished()) {
+                exitCode = upsamplingTest->Report();
+                running = false;
+            }
+        }
+
+        if (gpuCulling) {
+            glm::ivec2 renderSize = resolution->GetRenderSize();
+            gpuCuller->UpdateDepthPyramid(resolution->GetFramebuffer(), renderSize.x, renderSize.y, projection * view);
+        }
+
+        if (antiAliasing != lastAntiAliasing) {
+            lastAntiAliasing = antiAliasing;
+            antiAliasingFrames = 0;
+            antiAliasingSceneMilliseconds = 0.0;
+            antiAliasingPostMilliseconds = 0.0;
+        } else if (++antiAliasingFrames > 2 * DynamicResolution::QUERY_FRAMES) {
+            antiAliasingSceneMilliseconds += resolution->GetGpuMilliseconds();
+            antiAliasingPostMilliseconds += postProcess->GetGpuMilliseconds();
+            unsigned int const timedFrames = 60;
+            if (antiAliasingFrames == 2 * DynamicResolution::QUERY_FRAMES + timedFrames) {
+                glm::ivec2 renderSize = resolution->GetRenderSize();
+                cout << "anti-aliasing " << antiAliasingName(antiAliasing) << " at " << renderSize.x << "x" << renderSize.y << ": scene "
+                     << std::fixed << std::setprecision(2) << antiAliasingSceneMilliseconds / timedFrames << " ms, post-processing "
+                     << antiAliasingPostMilliseconds / timedFrames << " ms (gpu, " << timedFrames << " frames)" << std::defaultfloat << endl;
+            }
+        }
+
+        // only touch the window title when the counts change
+        unsigned int gpuVisible = gpuCulling ? gpuCuller->GetVisibleCount() : ~0u;
+        ProbeGrid::Stats probeStats = probeGrid.GetStats();
+        if (stats.Visible != lastStats.Visible || stats.Culled != lastStats.Culled || occlusionStats.Rejected != lastOccluded ||
+            gpuVisible != lastGpuVisible || shadowStats.StaticTiles != lastShadowStats.StaticTiles ||
+            shadowStats.DeferredTiles != lastShadowStats.DeferredTiles || shadowStats.DynamicTiles != lastShadowStats.DynamicTiles ||
+            probeStats.Baked != lastProbesBaked || resolution->GetScale() != lastScale || antiAliasing != lastTitleAntiAliasing) {
+            std::string title = "Light Casters - visible: " + std::to_string(stats.Visible) + " culled: " + std::to_string(stats.Culled) +
+                                " (occluded: " + std::to_string(occlusionStats.Rejected) + ")";
+            if (gpuCulling) {
+                title += " gpu cubes: " + std::to_string(gpuVisible) + "/" + std::to_string(CUBE_COUNT);
+            }
+            title += " shadow tiles redrawn: " + std::to_string(shadowStats.StaticTiles) + " deferred: " + std::to_string(shadowStats.DeferredTiles) +
+                     " dynamic: " + std::to_string(shadowStats.DynamicTiles);
+            glm::ivec2 renderSize = resolution->GetRenderSize();
+            title += " resolution: " + std::to_string(renderSize.x) + "x" + std::to_string(renderSize.y);
+            title += std::string { " aa: " } + antiAliasingName(antiAliasing);
+            if (probeStats.Baked < probeStats.Probes) {
+                title += " probes baked: " + std::to_string(probeStats.Baked) + "/" + std::to_string(probeStats.Probes);
+            }
+            if (window != nullptr) {
+                glfwSetWindowTitle(window, title.c_str());
+            }
+            lastStats = stats;
+            lastOccluded = occlusionStats.Rejected;
+            lastGpuVisible = gpuVisible;
+            lastShadowStats = shadowStats;
+            lastProbesBaked = probeStats.Baked;
+            lastScale = resolution->GetScale();
+            lastTitleAntiAliasing = antiAliasing;
+        }
+
+        if (hud) {
+            double cpuMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+            double gpuMilliseconds = resolution->GetGpuMilliseconds() + postProcess->GetGpuMilliseconds();
+            hud->AddFrame(cpuMilliseconds, gpuMilliseconds);
+            if (hudVisible) {
+                RenderStats::Frame const &counts = RenderStats::GetLastFrame();
+                glm::ivec2 renderSize = resolution->GetRenderSize();
+                std::vector<std::string> lines;
+                char line[128];
+                std::snprintf(line, sizeof(line), "cpu %.2f ms  gpu %.2f ms  hud %.3f ms", cpuMilliseconds, gpuMilliseconds, hud->GetDrawMilliseconds());
+                lines.push_back(line);
+                std::snprintf(line, sizeof(line), "draws %u  triangles %llu  uniforms %u", counts.DrawCalls, static_cast<unsigned long long>(counts.Triangles),
+                              counts.UniformUploads);
+                lines.push_back(line);
+                std::snprintf(line, sizeof(line), "switches: program %u  texture %u  vao %u", counts.ProgramSwitches, counts.TextureSwitches,
+                              counts.VertexArraySwitches);
+                lines.push_back(line);
+                std::snprintf(line, sizeof(line), "memory: textures %.1f mb  buffers %.2f mb", RenderStats::GetTextureBytes() / (1024.0 * 1024.0),
+                              RenderStats::GetBufferBytes() / (1024.0 * 1024.0));
+                lines.push_back(line);
+                if (gpuCulling) {
+                    std::snprintf(line, sizeof(line), "gpu culling: %u/%u cubes visible", gpuVisible, CUBE_COUNT);
+                } else {
+                    std::snprintf(line, sizeof(line), "visible %u  culled %u  occluded %u", stats.Visible, stats.Culled, occlusionStats.Rejected);
+                }
+                lines.push_back(line);
+                std::snprintf(line, sizeof(line), "shadow tiles %u/%u/%u  resolution %dx%d", shadowStats.StaticTiles, shadowStats.DeferredTiles,
+                              shadowStats.DynamicTiles, renderSize.x, renderSize.y);
+                lines.push_back(line);
+                hud->Draw(framebufferWidth, framebufferHeight, lines);
+            }
+            RenderStats::EndFrame();
+        }
+
+        if (benchmark) {
+            benchmark->EndFrame();
+            if (benchmark->IsFinished()) {
+                exitCode = benchmark->Report(cout, framebufferWidth, framebufferHeight);
+                running = false;
+            }
+        }
+        GlIntercept::EndFrame();
+        NullGl::EndFrame();
+        GlCapture::EndFrame();
+        if (GlCapture::IsInstalled() && GlCapture::GetFrameCount() == captureFrames) {
+            std::uint64_t bytes = GlCapture::GetBytesWritten();
+            if (GlCapture::Finish()) {
+                cout << "captured " << captureFrames << " frames, " << std::fixed << std::setprecision(1) << bytes / (1024.0 * 1024.0)
+                     << " MB in " << capturePath << std::defaultfloat << endl;
+            } else {
+                cout << "Can't write " << capturePath << endl;
+                exitCode = -1;
+            }
+            running = false;
+        }
+        if (window != nullptr) {
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
     }
 
+    NullGl::Report(cout);
+    benchmark.reset();
+    hud.reset();
+    gpuCuller.reset();
+    shadowAtlas.reset();
+    postProcess.reset();
+    renderTargets.reset();
+    upsampler.reset();
+    resolution.reset();
+    cubeIndirectShader.reset();
     glDeleteVertexArrays(1, &VAO);
     glDeleteVertexArrays(1, &lightVAO);
     glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &lightmapVBO);
+    glDeleteTextures(1, &lightmapTexture);
     GLuint diffuseMapId = diffuseMap.GetTextureId();
     glDeleteTextures(1, &diffuseMapId);
     GLuint specularMapId = specularMap.GetTextureId();
     glDeleteTextures(1, &specularMapId);
 
-    glfwDestroyWindow(window);
-    glfwTerminate();
-    window = nullptr;
+    if (window != nullptr) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        window = nullptr;
+    }
+    headlessContext.reset();
 
-    return 0;
+    return exitCode;
 }
\ No newline at end of file
@@ -0,0 +1,296 @@
+#include "nullgl.hpp"
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "glentrypoints.hpp"
+
+using std::endl;
+using std::string;
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    bool loaded = false;
+    std::uint64_t calls = 0, draws = 0;
+    GLuint nextName = 1;
+    // per program, the locations handed out by name
+    std::unordered_map<GLuint, std::unordered_map<string, GLint>> locations;
+    GLint viewport[4] = { 0, 0, 0, 0 };
+    GLint drawFramebuffer = 0, readFramebuffer = 0;
+    // what glMapBuffer* points into, as large as the largest buffer
+    std::vector<char> mapping;
+
+    // the frames since the first, which includes the startup
+    Clock::time_point frameStart;
+    unsigned int frames = 0;
+    double totalMilliseconds = 0.0;
+    std::uint64_t totalCalls = 0, totalDraws = 0;
+
+    bool isDraw(char const *name) {
+        bool draw = std::strncmp(name, "glDraw", 6) == 0 || std::strncmp(name, "glMultiDraw", 11) == 0;
+        return draw && std::strncmp(name, "glDrawBuffer", 12) != 0 && std::strcmp(name, "glDrawPixels") != 0;
+    }
+
+    template <auto *Slot, typename Proc = std::remove_pointer_t<decltype(Slot)>>
+    struct Stub;
+
+    template <auto *Slot, typename R, typename... Args>
+    struct Stub<Slot, R (APIENTRYP)(Args...)> {
+        inline static bool draw = false;
+
+        static R APIENTRY Call(Args...) {
+            calls++;
+            if (draw) {
+                draws++;
+            }
+            if constexpr (!std::is_void_v<R>) {
+                return R {};
+            }
+        }
+
+        static void Load(char const *name) {
+            draw = isDraw(name);
+            *Slot = &Call;
+        }
+    };
+
+    void APIENTRY genNames(GLsizei n, GLuint *names) {
+        calls++;
+        for (GLsizei i = 0; i < n; i++) {
+            names[i] = nextName++;
+        }
+    }
+
+    GLuint APIENTRY createShader(GLenum) {
+        calls++;
+        return nextName++;
+    }
+
+    GLuint APIENTRY createProgram() {
+        calls++;
+        return nextName++;
+    }
+
+    GLint location(GLuint program, GLchar const *name) {
+        calls++;
+        auto &programLocations = locations[program];
+        auto found = programLocations.find(name);
+        if (found != programLocations.end()) {
+            return found->second;
+        }
+        GLint index = static_cast<GLint>(programLocations.size());
+        programLocations.emplace(name, index);
+        return index;
+    }
+
+    GLint APIENTRY getLocation(GLuint program, GLchar const *name) {
+        return location(program, name);
+    }
+
+    GLuint APIENTRY getUniformBlockIndex(GLuint program, GLchar const *name) {
+        return static_cast<GLuint>(location(program, name));
+    }
+
+    void APIENTRY getObjectiv(GLuint, GLenum name, GLint *value) {
+        calls++;
+        *value = name == GL_COMPILE_STATUS || name == GL_LINK_STATUS || name == GL_VALIDATE_STATUS ? GL_TRUE : 0;
+    }
+
+    void APIENTRY getIntegerv(GLenum name, GLint *value) {
+        calls++;
+        switch (name) {
+            case GL_VIEWPORT:
+                std::memcpy(value, viewport, sizeof(viewport));
+                break;
+            case GL_DRAW_FRAMEBUFFER_BINDING:
+                *value = drawFramebuffer;
+                break;
+            case GL_READ_FRAMEBUFFER_BINDING:
+                *value = readFramebuffer;
+                break;
+            case GL_MAJOR_VERSION:
+            case GL_MINOR_VERSION:
+                *value = 3;
+                break;
+            case GL_MAX_SAMPLES:
+                *value = 4;
+                break;
+            case GL_MAX_TEXTURE_SIZE:
+                *value = 16384;
+                break;
+            default:
+                *value = 0;
+        }
+    }
+
+    GLubyte const *APIENTRY getString(GLenum name) {
+        calls++;
+        char const *value = "";
+        switch (name) {
+            case GL_VENDOR: value = "none"; break;
+            case GL_RENDERER: value = "null GL"; break;
+            case GL_VERSION: value = "3.3 null GL"; break;
+            case GL_SHADING_LANGUAGE_VERSION: value = "3.30"; break;
+        }
+        return reinterpret_cast<GLubyte const *>(value);
+    }
+
+    GLubyte const *APIENTRY getStringi(GLenum, GLuint) {
+        calls++;
+        return reinterpret_cast<GLubyte const *>("");
+    }
+
+    void APIENTRY viewportStub(GLint x, GLint y, GLsizei width, GLsizei height) {
+        calls++;
+        viewport[0] = x;
+        viewport[1] = y;
+        viewport[2] = width;
+        viewport[3] = height;
+    }
+
+    void APIENTRY bindFramebuffer(GLenum target, GLuint framebuffer) {
+        calls++;
+        if (target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER) {
+            drawFramebuffer = static_cast<GLint>(framebuffer);
+        }
+        if (target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER) {
+            readFramebuffer = static_cast<GLint>(framebuffer);
+        }
+    }
+
+    GLenum APIENTRY checkFramebufferStatus(GLenum) {
+        calls++;
+        return GL_FRAMEBUFFER_COMPLETE;
+    }
+
+    // every query is done, with a result of zero
+    void APIENTRY getQueryObjectiv(GLuint, GLenum name, GLint *value) {
+        calls++;
+        *value = name == GL_QUERY_RESULT_AVAILABLE ? GL_TRUE : 0;
+    }
+
+    void APIENTRY getQueryObjectuiv(GLuint, GLenum name, GLuint *value) {
+        calls++;
+        *value = name == GL_QUERY_RESULT_AVAILABLE ? GL_TRUE : 0;
+    }
+
+    GLsync APIENTRY fenceSync(GLenum, GLbitfield) {
+        calls++;
+        return reinterpret_cast<GLsync>(static_cast<std::uintptr_t>(nextName++));
+    }
+
+    GLenum APIENTRY clientWaitSync(GLsync, GLbitfield, GLuint64) {
+        calls++;
+        return GL_ALREADY_SIGNALED;
+    }
+
+    void APIENTRY bufferData(GLenum, GLsizeiptr size, void const *, GLenum) {
+        calls++;
+        if (static_cast<size_t>(size) > mapping.size()) {
+            mapping.resize(static_cast<size_t>(size));
+        }
+    }
+
+    void *APIENTRY mapBuffer(GLenum, GLenum) {
+        calls++;
+        return mapping.data();
+    }
+
+    void *APIENTRY mapBufferRange(GLenum, GLintptr, GLsizeiptr length, GLbitfield) {
+        calls++;
+        if (static_cast<size_t>(length) > mapping.size()) {
+            mapping.resize(static_cast<size_t>(length));
+        }
+        return mapping.data();
+    }
+
+    GLboolean APIENTRY unmapBuffer(GLenum) {
+        calls++;
+        return GL_TRUE;
+    }
+}
+
+void NullGl::Load(int width, int height) {
+#define LOAD_STUB(name) Stub<&glad_##name>::Load(#name);
+    GL_ENTRY_POINTS(LOAD_STUB)
+#undef LOAD_STUB
+    glad_glGenBuffers = genNames;
+    glad_glGenTextures = genNames;
+    glad_glGenVertexArrays = genNames;
+    glad_glGenFramebuffers = genNames;
+    glad_glGenRenderbuffers = genNames;
+    glad_glGenQueries = genNames;
+    glad_glGenSamplers = genNames;
+    glad_glCreateShader = createShader;
+    glad_glCreateProgram = createProgram;
+    glad_glGetUniformLocation = getLocation;
+    glad_glGetAttribLocation = getLocation;
+    glad_glGetUniformBlockIndex = getUniformBlockIndex;
+    glad_glGetShaderiv = getObjectiv;
+    glad_glGetProgramiv = getObjectiv;
+    glad_glGetIntegerv = getIntegerv;
+    glad_glGetString = getString;
+    glad_glGetStringi = getStringi;
+    glad_glViewport = viewportStub;
+    glad_glBindFramebuffer = bindFramebuffer;
+    glad_glCheckFramebufferStatus = checkFramebufferStatus;
+    glad_glGetQueryObjectiv = getQueryObjectiv;
+    glad_glGetQueryObjectuiv = getQueryObjectuiv;
+    glad_glFenceSync = fenceSync;
+    glad_glClientWaitSync = clientWaitSync;
+    glad_glBufferData = bufferData;
+    glad_glMapBuffer = mapBuffer;
+    glad_glMapBufferRange = mapBufferRange;
+    glad_glUnmapBuffer = unmapBuffer;
+
+    GLVersion.major = 3;
+    GLVersion.minor = 3;
+    GLAD_GL_VERSION_1_0 = GLAD_GL_VERSION_1_1 = GLAD_GL_VERSION_1_2 = GLAD_GL_VERSION_1_3 = GLAD_GL_VERSION_1_4 = GLAD_GL_VERSION_1_5 = 1;
+    GLAD_GL_VERSION_2_0 = GLAD_GL_VERSION_2_1 = 1;
+    GLAD_GL_VERSION_3_0 = GLAD_GL_VERSION_3_1 = GLAD_GL_VERSION_3_2 = GLAD_GL_VERSION_3_3 = 1;
+    viewport[2] = width;
+    viewport[3] = height;
+    loaded = true;
+    frameStart = Clock::now();
+}
+
+bool NullGl::IsLoaded() {
+    return loaded;
+}
+
+void NullGl::EndFrame() {
+    if (!loaded) {
+        return;
+    }
+    Clock::time_point now = Clock::now();
+    if (frames++ > 0) {
+        totalMilliseconds += std::chrono::duration<double, std::milli>(now - frameStart).count();
+        totalCalls += calls;
+        totalDraws += draws;
+    }
+    calls = 0;
+    draws = 0;
+    frameStart = now;
+}
+
+void NullGl::Report(std::ostream &log) {
+    if (frames < 2) {
+        return;
+    }
+    double measured = frames - 1;
+    double drawsPerFrame = totalDraws / measured;
+    log << "null GL: " << frames - 1 << " frames after the first, cpu " << std::fixed << std::setprecision(3) << totalMilliseconds / measured
+        << " ms, " << std::setprecision(1) << totalCalls / measured << " calls and " << drawsPerFrame << " draws per frame";
+    if (drawsPerFrame > 0.0) {
+        log << ", " << std::setprecision(2) << 1000.0 * totalMilliseconds / totalDraws << " us per draw";
+    }
+    log << std::defaultfloat << endl;
+}
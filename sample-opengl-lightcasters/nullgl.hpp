@@ -0,0 +1,22 @@
+#pragma once
+
+#include <ostream>
+
+// A GL backend without a driver, for measuring what the sample itself costs on the CPU per frame and per draw call,
+// run with `./main --null-gl --benchmark`; no GPU or display is needed. Load fills glad's function table with stubs
+// that return right away, except for the few answers the sample depends on: glGen* and glCreate* hand out fresh
+// names, uniform and attribute locations are stable indices per program and name, shaders compile, framebuffers
+// are complete, queries and fences are done, and glGetIntegerv returns the viewport and framebuffer bindings set
+// through it. Nothing is drawn and what the GL would write back, pixels or buffer contents, stays untouched.
+//
+// The stubs count the calls and draws per frame; --gl-calls still works on top of them for the calls per entry point.
+class NullGl {
+    public:
+        // Fills glad's function table, in place of gladLoadGLLoader; width and height are the default framebuffer's
+        static void Load(int width, int height);
+        static bool IsLoaded();
+        // Ends the frame's counts and timing; call once per frame, where the swap would be
+        static void EndFrame();
+        // The mean CPU time, calls and draws per frame and the CPU time per draw
+        static void Report(std::ostream &log);
+};
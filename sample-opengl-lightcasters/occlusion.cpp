@@ -0,0 +1,298 @@
+#include "occlusion.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+OcclusionBuffer::OcclusionBuffer(unsigned int width, unsigned int height, unsigned int threadCount) :
+    width(width), height(height), threadCount(threadCount), viewProjection(1.0f),
+    depth(width * height, 1.0f), tilesX(width / TILE_SIZE), tilesY((height + TILE_SIZE - 1) / TILE_SIZE),
+    rasterizeMilliseconds(0.0) {
+    // the rasterizer's groups of four pixels start on a multiple of four and may run up to the next one
+    assert(width % TILE_SIZE == 0);
+    if (this->threadCount == 0) {
+        this->threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    tileMaxDepth.assign(tilesX * tilesY, 1.0f);
+    bands = std::max(1u, std::min(this->threadCount, tilesY));
+    for (unsigned int band = 1; band < bands; band++) {
+        workers.emplace_back(&OcclusionBuffer::work, this, band);
+    }
+}
+
+OcclusionBuffer::~OcclusionBuffer() {
+    {
+        std::lock_guard<std::mutex> lock { mutex };
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+void OcclusionBuffer::Begin(glm::mat4 const &viewProjection) {
+    this->viewProjection = viewProjection;
+    triangles.clear();
+    std::fill(depth.begin(), depth.end(), 1.0f);
+    std::fill(tileMaxDepth.begin(), tileMaxDepth.end(), 1.0f);
+}
+
+glm::vec3 OcclusionBuffer::toScreen(glm::vec4 const &clip) const {
+    glm::vec3 ndc = glm::vec3 { clip } / clip.w;
+    return glm::vec3 { (ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, ndc.z * 0.5f + 0.5f };
+}
+
+void OcclusionBuffer::addClipTriangle(glm::vec4 const &a, glm::vec4 const &b, glm::vec4 const &c) {
+    // clip against the near plane (z >= -w); anything else is handled by the screen bounds of the rasterizer
+    glm::vec4 const input[3] = { a, b, c };
+    glm::vec4 polygon[4];
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < 3; i++) {
+        glm::vec4 const &current = input[i];
+        glm::vec4 const &next = input[(i + 1) % 3];
+        float currentDistance = current.z + current.w;
+        float nextDistance = next.z + next.w;
+        if (currentDistance >= 0.0f) {
+            polygon[count++] = current;
+        }
+        if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f)) {
+            float t = currentDistance / (currentDistance - nextDistance);
+            polygon[count++] = current + (next - current) * t;
+        }
+    }
+    if (count < 3) {
+        return;
+    }
+
+    glm::vec3 screen[4];
+    for (unsigned int i = 0; i < count; i++) {
+        screen[i] = toScreen(polygon[i]);
+    }
+    // a clipped triangle is at most a quad, fan it back into triangles
+    for (unsigned int i = 1; i + 1 < count; i++) {
+        Triangle triangle { { screen[0], screen[i], screen[i + 1] }, 0.0f, 0.0f };
+        triangle.MinY = std::min({ screen[0].y, screen[i].y, screen[i + 1].y });
+        triangle.MaxY = std::max({ screen[0].y, screen[i].y, screen[i + 1].y });
+        if (triangle.MaxY < 0.0f || triangle.MinY > height) {
+            continue;
+        }
+        triangles.push_back(triangle);
+    }
+}
+
+void OcclusionBuffer::AddOccluder(glm::vec3 const *positions, unsigned int const *indices, size_t indexCount, glm::mat4 const &model) {
+    glm::mat4 transform = viewProjection * model;
+    for (size_t i = 0; i + 2 < indexCount; i += 3) {
+        addClipTriangle(transform * glm::vec4 { positions[indices[i + 0]], 1.0f },
+                        transform * glm::vec4 { positions[indices[i + 1]], 1.0f },
+                        transform * glm::vec4 { positions[indices[i + 2]], 1.0f });
+    }
+}
+
+void OcclusionBuffer::AddOccluder(glm::vec3 const *positions, size_t vertexCount, glm::mat4 const &model) {
+    glm::mat4 transform = viewProjection * model;
+    for (size_t i = 0; i + 2 < vertexCount; i += 3) {
+        addClipTriangle(transform * glm::vec4 { positions[i + 0], 1.0f },
+                        transform * glm::vec4 { positions[i + 1], 1.0f },
+                        transform * glm::vec4 { positions[i + 2], 1.0f });
+    }
+}
+
+void OcclusionBuffer::rasterizeRows(unsigned int firstRow, unsigned int lastRow) {
+    for (Triangle const &triangle : triangles) {
+        if (triangle.MaxY < firstRow || triangle.MinY > lastRow + 1) {
+            continue;
+        }
+        glm::vec3 v0 = triangle.Vertices[0];
+        glm::vec3 v1 = triangle.Vertices[1];
+        glm::vec3 v2 = triangle.Vertices[2];
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+        if (std::abs(area) < 1e-8f) {
+            continue;
+        }
+        if (area < 0.0f) {
+            // occluders are double sided, so just fix the winding
+            std::swap(v1, v2);
+            area = -area;
+        }
+
+        // edge functions E(p) = A * x + B * y + C, positive inside
+        auto edge = [](glm::vec3 const &from, glm::vec3 const &to) {
+            float a = from.y - to.y;
+            float b = to.x - from.x;
+            return glm::vec3 { a, b, -(a * from.x + b * from.y) };
+        };
+        glm::vec3 e0 = edge(v1, v2); // weight of v0
+        glm::vec3 e1 = edge(v2, v0); // weight of v1
+        glm::vec3 e2 = edge(v0, v1); // weight of v2
+        // depth is the barycentric blend of the vertex depths, so also a plane in screen space
+        glm::vec3 z = (e0 * v0.z + e1 * v1.z + e2 * v2.z) / area;
+        // A pixel only counts as hidden if the triangle covers all of it, at the farthest depth it has there;
+        // evaluated at the center, each edge is moved in by its value at the pixel's worst corner and the depth
+        // out by its slope to the farthest corner
+        auto inset = [](glm::vec3 const &plane, float sign) {
+            return glm::vec3 { plane.x, plane.y, plane.z + sign * 0.5f * (std::abs(plane.x) + std::abs(plane.y)) };
+        };
+        e0 = inset(e0, -1.0f);
+        e1 = inset(e1, -1.0f);
+        e2 = inset(e2, -1.0f);
+        z = inset(z, 1.0f);
+
+        int minX = std::max(0, static_cast<int>(std::floor(std::min({ v0.x, v1.x, v2.x }))));
+        int maxX = std::min(static_cast<int>(width) - 1, static_cast<int>(std::ceil(std::max({ v0.x, v1.x, v2.x }))));
+        int minY = std::max(static_cast<int>(firstRow), static_cast<int>(std::floor(triangle.MinY)));
+        int maxY = std::min(static_cast<int>(lastRow), static_cast<int>(std::ceil(triangle.MaxY)));
+        minX &= ~3; // start on a group of four pixels
+
+        for (int y = minY; y <= maxY; y++) {
+            float py = y + 0.5f;
+            float *row = &depth[y * width];
+            int x = minX;
+#if defined(__SSE2__)
+            __m128 px = _mm_add_ps(_mm_set1_ps(x + 0.5f), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+            __m128 step = _mm_set1_ps(4.0f);
+            __m128 zero = _mm_setzero_ps();
+            __m128 a0 = _mm_set1_ps(e0.x), a1 = _mm_set1_ps(e1.x), a2 = _mm_set1_ps(e2.x), az = _mm_set1_ps(z.x);
+            __m128 r0 = _mm_set1_ps(e0.y * py + e0.z);
+            __m128 r1 = _mm_set1_ps(e1.y * py + e1.z);
+            __m128 r2 = _mm_set1_ps(e2.y * py + e2.z);
+            __m128 rz = _mm_set1_ps(z.y * py + z.z);
+            for (; x <= maxX; x += 4) {
+                __m128 w0 = _mm_add_ps(_mm_mul_ps(a0, px), r0);
+                __m128 w1 = _mm_add_ps(_mm_mul_ps(a1, px), r1);
+                __m128 w2 = _mm_add_ps(_mm_mul_ps(a2, px), r2);
+                __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)), _mm_cmpge_ps(w2, zero));
+                if (_mm_movemask_ps(inside)) {
+                    __m128 pixelDepth = _mm_add_ps(_mm_mul_ps(az, px), rz);
+                    __m128 old = _mm_loadu_ps(row + x);
+                    __m128 nearest = _mm_min_ps(old, pixelDepth);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+                }
+                px = _mm_add_ps(px, step);
+            }
+#else
+            for (; x <= maxX; x++) {
+                float px = x + 0.5f;
+                float w0 = e0.x * px + e0.y * py + e0.z;
+                float w1 = e1.x * px + e1.y * py + e1.z;
+                float w2 = e2.x * px + e2.y * py + e2.z;
+                if (w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f) {
+                    row[x] = std::min(row[x], z.x * px + z.y * py + z.z);
+                }
+            }
+#endif
+        }
+    }
+}
+
+void OcclusionBuffer::updateTiles(unsigned int firstTileRow, unsigned int lastTileRow) {
+    for (unsigned int tileY = firstTileRow; tileY <= lastTileRow; tileY++) {
+        for (unsigned int tileX = 0; tileX < tilesX; tileX++) {
+            float farthest = 0.0f;
+            for (unsigned int y = tileY * TILE_SIZE; y < std::min(height, (tileY + 1) * TILE_SIZE); y++) {
+                for (unsigned int x = tileX * TILE_SIZE; x < (tileX + 1) * TILE_SIZE; x++) {
+                    farthest = std::max(farthest, depth[y * width + x]);
+                }
+            }
+            tileMaxDepth[tileY * tilesX + tileX] = farthest;
+        }
+    }
+}
+
+// every band is whole tile rows, so no two threads ever write the same pixel or tile
+void OcclusionBuffer::rasterizeBand(unsigned int band) {
+    unsigned int firstTileRow = band * tilesY / bands;
+    unsigned int lastTileRow = (band + 1) * tilesY / bands - 1;
+    unsigned int lastRow = std::min(height - 1, (lastTileRow + 1) * TILE_SIZE - 1);
+    rasterizeRows(firstTileRow * TILE_SIZE, lastRow);
+    updateTiles(firstTileRow, lastTileRow);
+}
+
+void OcclusionBuffer::work(unsigned int band) {
+    unsigned int done = 0;
+    std::unique_lock<std::mutex> lock { mutex };
+    while (true) {
+        wake.wait(lock, [&] { return stopping || frame != done; });
+        if (stopping) {
+            return;
+        }
+        done = frame;
+        lock.unlock();
+        rasterizeBand(band);
+        lock.lock();
+        if (--bandsLeft == 0) {
+            finished.notify_one();
+        }
+    }
+}
+
+void OcclusionBuffer::Rasterize() {
+    auto start = std::chrono::steady_clock::now();
+
+    {
+        std::lock_guard<std::mutex> lock { mutex };
+        frame++;
+        bandsLeft = bands - 1;
+    }
+    wake.notify_all();
+    rasterizeBand(0);
+    {
+        std::unique_lock<std::mutex> lock { mutex };
+        finished.wait(lock, [&] { return bandsLeft == 0; });
+    }
+
+    rasterizeMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool OcclusionBuffer::IsVisible(AABB const &worldBox) const {
+    glm::vec2 minScreen { 1e30f };
+    glm::vec2 maxScreen { -1e30f };
+    float nearestDepth = 1.0f;
+    for (unsigned int i = 0; i < 8; i++) {
+        glm::vec3 corner { i & 1 ? worldBox.Max.x : worldBox.Min.x,
+                           i & 2 ? worldBox.Max.y : worldBox.Min.y,
+                           i & 4 ? worldBox.Max.z : worldBox.Min.z };
+        glm::vec4 clip = viewProjection * glm::vec4 { corner, 1.0f };
+        if (clip.w <= 1e-5f || clip.z < -clip.w) {
+            return true; // crosses the near plane, too close to judge
+        }
+        glm::vec3 screen = toScreen(clip);
+        minScreen = glm::min(minScreen, glm::vec2 { screen });
+        maxScreen = glm::max(maxScreen, glm::vec2 { screen });
+        nearestDepth = std::min(nearestDepth, screen.z);
+    }
+    if (maxScreen.x < 0.0f || maxScreen.y < 0.0f || minScreen.x >= width || minScreen.y >= height) {
+        return false;
+    }
+
+    // every pixel the screen rectangle touches has to have an occluder in front of the nearest corner
+    int minX = std::max(0, static_cast<int>(std::floor(minScreen.x)));
+    int minY = std::max(0, static_cast<int>(std::floor(minScreen.y)));
+    int maxX = std::min(static_cast<int>(width) - 1, static_cast<int>(std::floor(maxScreen.x)));
+    int maxY = std::min(static_cast<int>(height) - 1, static_cast<int>(std::floor(maxScreen.y)));
+    for (int tileY = minY / static_cast<int>(TILE_SIZE); tileY <= maxY / static_cast<int>(TILE_SIZE); tileY++) {
+        for (int tileX = minX / static_cast<int>(TILE_SIZE); tileX <= maxX / static_cast<int>(TILE_SIZE); tileX++) {
+            if (tileMaxDepth[tileY * tilesX + tileX] < nearestDepth) {
+                continue; // the whole tile is covered by something nearer
+            }
+            int x0 = std::max(minX, tileX * static_cast<int>(TILE_SIZE));
+            int x1 = std::min(maxX, (tileX + 1) * static_cast<int>(TILE_SIZE) - 1);
+            int y0 = std::max(minY, tileY * static_cast<int>(TILE_SIZE));
+            int y1 = std::min(maxY, (tileY + 1) * static_cast<int>(TILE_SIZE) - 1);
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) {
+                    if (depth[y * width + x] >= nearestDepth) {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
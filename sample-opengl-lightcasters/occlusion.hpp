@@ -0,0 +1,78 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "culling.hpp"
+
+// Low-resolution software depth buffer used to reject objects hidden behind large occluders before they reach GL.
+// Occluder triangles are clipped against the near plane, rasterized four pixels at a time with SSE by several
+// threads (each owning a band of rows, started with the buffer and waiting between frames) and the nearest depth is
+// kept per pixel. Only pixels an occluder covers entirely take its depth, the farthest it has in them, so an object
+// seen through a gap or past a silhouette narrower than a pixel is never rejected. A coarse buffer with the farthest
+// depth of every 8x8 tile lets most tests finish without touching individual pixels.
+// Depth is post-projection z/w mapped to [0, 1], which is linear in screen space.
+class OcclusionBuffer {
+    public:
+        static unsigned int const TILE_SIZE = 8;
+    private:
+        struct Triangle {
+            glm::vec3 Vertices[3]; // x, y in pixels and depth
+            float MinY, MaxY;
+        };
+        unsigned int width;
+        unsigned int height;
+        unsigned int threadCount;
+        glm::mat4 viewProjection;
+        std::vector<Triangle> triangles;
+        std::vector<float> depth;
+        std::vector<float> tileMaxDepth; // farthest depth in each tile, anything behind it is hidden
+        unsigned int tilesX, tilesY;
+        double rasterizeMilliseconds;
+
+        // band 0 is rasterized by the caller, the others by one worker each
+        unsigned int bands;
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable finished;
+        unsigned int frame = 0; // counts the Rasterize calls, a new one sets the workers off
+        unsigned int bandsLeft = 0; // workers not done with this frame
+        bool stopping = false;
+
+        void addClipTriangle(glm::vec4 const &a, glm::vec4 const &b, glm::vec4 const &c);
+        glm::vec3 toScreen(glm::vec4 const &clip) const;
+        void rasterizeRows(unsigned int firstRow, unsigned int lastRow);
+        void updateTiles(unsigned int firstTileRow, unsigned int lastTileRow);
+        void rasterizeBand(unsigned int band);
+        void work(unsigned int band);
+    public:
+        // width must be a multiple of the tile size
+        OcclusionBuffer(unsigned int width, unsigned int height, unsigned int threadCount = 0);
+        ~OcclusionBuffer();
+        // Starts a new frame: clears the depth and drops all queued occluders
+        void Begin(glm::mat4 const &viewProjection);
+        // Queues the triangles of an occluder mesh placed with the given model matrix
+        void AddOccluder(glm::vec3 const *positions, unsigned int const *indices, size_t indexCount, glm::mat4 const &model);
+        void AddOccluder(glm::vec3 const *positions, size_t vertexCount, glm::mat4 const &model);
+        // Rasterizes every queued occluder into the depth buffer
+        void Rasterize();
+        // False when the box is behind the occluders everywhere it covers; boxes crossing the near plane are always visible
+        bool IsVisible(AABB const &worldBox) const;
+
+        double GetRasterizeMilliseconds() const { return rasterizeMilliseconds; }
+        size_t GetTriangleCount() const { return triangles.size(); }
+        unsigned int GetWidth() const { return width; }
+        unsigned int GetHeight() const { return height; }
+        float const *GetDepth() const { return depth.data(); }
+};
+
+struct OcclusionStats {
+    unsigned int Tested = 0;
+    unsigned int Rejected = 0;
+    double RasterizeMilliseconds = 0.0;
+};
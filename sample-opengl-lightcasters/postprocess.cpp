@@ -0,0 +1,103 @@
+#include "postprocess.hpp"
+
+#include <algorithm>
+
+PostProcessChain::PostProcessChain(RenderTargetPool &pool)
+    : pool { pool }, queryIndex { 0 }, lastMilliseconds { 0.0 }, input { 0, 0, 0, 0, GL_RGBA8 }, running { false } {
+    // the fullscreen triangle is made up from gl_VertexID, but core profiles still want a vertex array bound
+    glGenVertexArrays(1, &emptyVertexArray);
+    glGenQueries(QUERY_FRAMES, queries);
+    std::fill(queryPending, queryPending + QUERY_FRAMES, false);
+}
+
+PostProcessChain::~PostProcessChain() {
+    glDeleteQueries(QUERY_FRAMES, queries);
+    glDeleteVertexArrays(1, &emptyVertexArray);
+}
+
+unsigned int PostProcessChain::AddPass(std::string const &name, std::string const &fragmentShaderPath, SetUniforms uniforms) {
+    passes.push_back(Pass { name, std::make_unique<Shader>("./shaders/fullscreen.vs", fragmentShaderPath), std::move(uniforms), false });
+    return static_cast<unsigned int>(passes.size() - 1);
+}
+
+bool PostProcessChain::HasEnabledPasses() const {
+    return std::any_of(passes.begin(), passes.end(), [](Pass const &pass) { return pass.Enabled; });
+}
+
+void PostProcessChain::collectQueries() {
+    for (unsigned int i = 0; i < QUERY_FRAMES; i++) {
+        unsigned int index = (queryIndex + i) % QUERY_FRAMES;
+        if (!queryPending[index]) {
+            continue;
+        }
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            break;
+        }
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(queries[index], GL_QUERY_RESULT, &nanoseconds);
+        queryPending[index] = false;
+        lastMilliseconds = nanoseconds / 1e6;
+    }
+}
+
+GLuint PostProcessChain::Begin(int width, int height) {
+    collectQueries();
+    running = HasEnabledPasses();
+    if (!running) {
+        lastMilliseconds = 0.0;
+        return 0;
+    }
+    input = pool.Acquire(width, height, GL_RGBA8);
+    return input.Framebuffer;
+}
+
+void PostProcessChain::End() {
+    if (!running) {
+        return;
+    }
+    running = false;
+    bool timed = !queryPending[queryIndex];
+    if (timed) {
+        glBeginQuery(GL_TIME_ELAPSED, queries[queryIndex]);
+    }
+
+    glDisable(GL_DEPTH_TEST);
+    glBindVertexArray(emptyVertexArray);
+    glActiveTexture(GL_TEXTURE0);
+    RenderTarget source = input;
+    size_t last = passes.size();
+    while (last > 0 && !passes[last - 1].Enabled) {
+        last--;
+    }
+    for (size_t i = 0; i < last; i++) {
+        Pass const &pass = passes[i];
+        if (!pass.Enabled) {
+            continue;
+        }
+        bool lastPass = i + 1 == last;
+        RenderTarget destination = lastPass ? RenderTarget { 0, 0, source.Width, source.Height, source.Format }
+                                            : pool.Acquire(source.Width, source.Height, source.Format);
+        glBindFramebuffer(GL_FRAMEBUFFER, destination.Framebuffer);
+        glViewport(0, 0, destination.Width, destination.Height);
+        pass.Program->Use();
+        pass.Program->SetInt("source", 0);
+        pass.Program->SetFloatVec2("texelSize", 1.0f / glm::vec2 { source.Width, source.Height });
+        if (pass.Uniforms) {
+            pass.Uniforms(*pass.Program);
+        }
+        glBindTexture(GL_TEXTURE_2D, source.Texture);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        pool.Release(source);
+        source = destination;
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glEnable(GL_DEPTH_TEST);
+
+    if (timed) {
+        glEndQuery(GL_TIME_ELAPSED);
+        queryPending[queryIndex] = true;
+        queryIndex = (queryIndex + 1) % QUERY_FRAMES;
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rendertargetpool.hpp"
+#include "shader.h"
+
+// Fullscreen passes run one after the other over the finished, single sampled frame at the window's size. The frame
+// is drawn into a pooled target returned by Begin, each enabled pass reads the previous one's output from texture
+// unit 0 as "source" and writes a new pooled target, and the last one writes the default framebuffer. With no pass
+// enabled Begin hands out the default framebuffer and the chain costs nothing.
+//
+// The passes are timed together with GL_TIME_ELAPSED queries in a small ring, read a few frames late.
+class PostProcessChain {
+    public:
+        static constexpr unsigned int QUERY_FRAMES = 4;
+        // Sets a pass's own uniforms; the chain sets "source" and "texelSize", the size of a source pixel in texture
+        // coordinates
+        using SetUniforms = std::function<void(Shader const &)>;
+    private:
+        struct Pass {
+            std::string Name;
+            std::unique_ptr<Shader> Program;
+            SetUniforms Uniforms;
+            bool Enabled;
+        };
+        RenderTargetPool &pool;
+        std::vector<Pass> passes;
+        GLuint emptyVertexArray;
+        GLuint queries[QUERY_FRAMES];
+        bool queryPending[QUERY_FRAMES];
+        unsigned int queryIndex;
+        double lastMilliseconds;
+        RenderTarget input;
+        bool running; // between Begin and End with a pass enabled
+
+        void collectQueries();
+    public:
+        explicit PostProcessChain(RenderTargetPool &pool);
+        ~PostProcessChain();
+        PostProcessChain(PostProcessChain const &) = delete;
+        PostProcessChain &operator=(PostProcessChain const &) = delete;
+
+        // Appends a pass drawing the fragment shader over the whole frame, disabled; returns its index
+        unsigned int AddPass(std::string const &name, std::string const &fragmentShaderPath, SetUniforms uniforms = {});
+        void SetEnabled(unsigned int pass, bool enabled) { passes[pass].Enabled = enabled; }
+        bool IsEnabled(unsigned int pass) const { return passes[pass].Enabled; }
+        std::string const &GetName(unsigned int pass) const { return passes[pass].Name; }
+        bool HasEnabledPasses() const;
+
+        // The framebuffer to draw the frame into
+        GLuint Begin(int width, int height);
+        // Runs the enabled passes, leaving the default framebuffer bound
+        void End();
+
+        // GPU time of the passes of a recent frame, 0 while none are enabled
+        double GetGpuMilliseconds() const { return lastMilliseconds; }
+};
@@ -0,0 +1,236 @@
+#include "probegrid.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "lightmap.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using std::vector;
+
+namespace {
+    float const PI = 3.14159265358979f;
+    // probes that see the back of a surface in more than this share of directions sit inside a mesh
+    float const INSIDE_FRACTION = 0.25f;
+
+    // the real L2 basis in the usual order: l = 0, then y, z, x, then xy, yz, 3z^2 - 1, xz, x^2 - y^2
+    void evaluateBasis(glm::vec3 const &n, float *basis) {
+        basis[0] = 0.282095f;
+        basis[1] = 0.488603f * n.y;
+        basis[2] = 0.488603f * n.z;
+        basis[3] = 0.488603f * n.x;
+        basis[4] = 1.092548f * n.x * n.y;
+        basis[5] = 1.092548f * n.y * n.z;
+        basis[6] = 0.315392f * (3.0f * n.z * n.z - 1.0f);
+        basis[7] = 1.092548f * n.x * n.z;
+        basis[8] = 0.546274f * (n.x * n.x - n.y * n.y);
+    }
+
+    // Sum of basis * value over count samples, for the three channels at once. count is a multiple of 4.
+    glm::vec3 project(float const *basis, float const *red, float const *green, float const *blue, unsigned int count) {
+#if defined(__SSE2__)
+        __m128 sumRed = _mm_setzero_ps();
+        __m128 sumGreen = _mm_setzero_ps();
+        __m128 sumBlue = _mm_setzero_ps();
+        for (unsigned int i = 0; i < count; i += 4) {
+            __m128 weight = _mm_loadu_ps(basis + i);
+            sumRed = _mm_add_ps(sumRed, _mm_mul_ps(weight, _mm_loadu_ps(red + i)));
+            sumGreen = _mm_add_ps(sumGreen, _mm_mul_ps(weight, _mm_loadu_ps(green + i)));
+            sumBlue = _mm_add_ps(sumBlue, _mm_mul_ps(weight, _mm_loadu_ps(blue + i)));
+        }
+        alignas(16) float lanes[3][4];
+        _mm_store_ps(lanes[0], sumRed);
+        _mm_store_ps(lanes[1], sumGreen);
+        _mm_store_ps(lanes[2], sumBlue);
+        return glm::vec3 { lanes[0][0] + lanes[0][1] + lanes[0][2] + lanes[0][3], lanes[1][0] + lanes[1][1] + lanes[1][2] + lanes[1][3],
+                           lanes[2][0] + lanes[2][1] + lanes[2][2] + lanes[2][3] };
+#else
+        glm::vec3 sum { 0.0f };
+        for (unsigned int i = 0; i < count; i++) {
+            sum += basis[i] * glm::vec3 { red[i], green[i], blue[i] };
+        }
+        return sum;
+#endif
+    }
+}
+
+glm::vec3 ShIrradiance::Evaluate(glm::vec3 const &normal) const {
+    float basis[COEFFICIENT_COUNT];
+    evaluateBasis(normal, basis);
+    glm::vec3 irradiance { 0.0f };
+    for (unsigned int i = 0; i < COEFFICIENT_COUNT; i++) {
+        irradiance += Coefficients[i] * basis[i];
+    }
+    return glm::max(irradiance, glm::vec3 { 0.0f });
+}
+
+ProbeGrid::ProbeGrid(glm::vec3 const &gridMin, glm::vec3 const &gridMax, glm::uvec3 const &resolution, unsigned int directionCount)
+    : gridMin { gridMin }, gridMax { gridMax }, resolution { glm::max(resolution, glm::uvec3 { 2 }) } {
+    // a Fibonacci spiral spreads the directions evenly over the sphere, so each covers the same solid angle
+    unsigned int count = (std::max(directionCount, 4u) + 3) / 4 * 4;
+    directions.resize(count);
+    basis.resize(ShIrradiance::COEFFICIENT_COUNT * count);
+    float const goldenAngle = PI * (3.0f - std::sqrt(5.0f));
+    for (unsigned int i = 0; i < count; i++) {
+        float z = 1.0f - (2.0f * i + 1.0f) / count;
+        float radius = std::sqrt(std::max(0.0f, 1.0f - z * z));
+        float angle = goldenAngle * i;
+        directions[i] = glm::vec3 { radius * std::cos(angle), radius * std::sin(angle), z };
+        float values[ShIrradiance::COEFFICIENT_COUNT];
+        evaluateBasis(directions[i], values);
+        for (unsigned int k = 0; k < ShIrradiance::COEFFICIENT_COUNT; k++) {
+            basis[k * count + i] = values[k];
+        }
+    }
+
+    unsigned int probeCount = this->resolution.x * this->resolution.y * this->resolution.z;
+    probes.resize(probeCount);
+    states.assign(probeCount, ProbeState::Empty);
+    probeVersions.assign(probeCount, 0);
+    stats.Probes = probeCount;
+    worker = std::thread { &ProbeGrid::run, this };
+}
+
+ProbeGrid::~ProbeGrid() {
+    {
+        std::lock_guard<std::mutex> lock { mutex };
+        stopping = true;
+    }
+    wake.notify_all();
+    worker.join();
+}
+
+glm::vec3 ProbeGrid::probePosition(unsigned int probe) const {
+    glm::uvec3 cell { probe % resolution.x, probe / resolution.x % resolution.y, probe / (resolution.x * resolution.y) };
+    return gridMin + (gridMax - gridMin) * glm::vec3 { cell } / glm::vec3 { resolution - 1u };
+}
+
+ProbeGrid::ProbeState ProbeGrid::bakeProbe(LightmapBaker const &scene, TriangleBvh const &bvh, glm::vec3 const &position,
+                                           ShIrradiance &irradiance, unsigned long long &rays) const {
+    unsigned int count = static_cast<unsigned int>(directions.size());
+    vector<float> radiance(3 * count);
+    unsigned int backfaces = 0;
+    for (unsigned int i = 0; i < count; i++) {
+        glm::vec3 light;
+        if (!scene.TraceRadiance(bvh, Ray { position, directions[i] }, light, rays)) {
+            backfaces++;
+        }
+        radiance[i] = light.r;
+        radiance[count + i] = light.g;
+        radiance[2 * count + i] = light.b;
+    }
+    if (backfaces > INSIDE_FRACTION * count) {
+        return ProbeState::Inside;
+    }
+
+    // every direction stands for 4 pi / count of the sphere. Convolving with the clamped cosine scales each band by
+    // pi, 2 pi / 3 and pi / 4, and the shaders' lights are in irradiance over pi, like the lightmap's texels.
+    float const bandScales[3] = { 1.0f, 2.0f / 3.0f, 0.25f };
+    float const weight = 4.0f * PI / count;
+    for (unsigned int k = 0; k < ShIrradiance::COEFFICIENT_COUNT; k++) {
+        float band = bandScales[k == 0 ? 0 : (k < 4 ? 1 : 2)];
+        irradiance.Coefficients[k] = project(&basis[k * count], &radiance[0], &radiance[count], &radiance[2 * count], count) * weight * band;
+    }
+    // the ambient terms are the same from every direction, so they only go into the constant band
+    irradiance.Coefficients[0] += scene.AmbientLight(position) / 0.282095f;
+    return ProbeState::Baked;
+}
+
+void ProbeGrid::run() {
+    std::unique_lock<std::mutex> lock { mutex };
+    while (true) {
+        wake.wait(lock, [&] { return stopping || pendingScene != nullptr; });
+        if (stopping) {
+            return;
+        }
+        std::shared_ptr<LightmapBaker const> scene = std::move(pendingScene);
+        pendingScene.reset();
+        unsigned int version = ++sceneVersion;
+        unsigned int probe = nextProbe;
+        stats.Baked = 0;
+        stats.Rays = 0;
+        lock.unlock();
+
+        auto start = std::chrono::steady_clock::now();
+        TriangleBvh bvh = scene->BuildBvh();
+        unsigned int count = static_cast<unsigned int>(probes.size());
+        bool interrupted = false;
+        // around the grid from where the last bake stopped, until the walk comes back to a probe it already did
+        while (!interrupted && probeVersions[probe] != version) {
+            ShIrradiance irradiance;
+            unsigned long long rays = 0;
+            ProbeState state = bakeProbe(*scene, bvh, probePosition(probe), irradiance, rays);
+            lock.lock();
+            if (state == ProbeState::Baked) {
+                probes[probe] = irradiance;
+            }
+            states[probe] = state;
+            probeVersions[probe] = version;
+            probe = (probe + 1) % count;
+            nextProbe = probe;
+            stats.Baked++;
+            stats.Rays += rays;
+            interrupted = stopping || pendingScene != nullptr;
+            lock.unlock();
+            // leave the core to the render thread between probes
+            std::this_thread::yield();
+        }
+
+        lock.lock();
+        if (!interrupted) {
+            stats.Inside = static_cast<unsigned int>(std::count(states.begin(), states.end(), ProbeState::Inside));
+            stats.Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+}
+
+void ProbeGrid::Rebake(std::shared_ptr<LightmapBaker const> scene) {
+    {
+        std::lock_guard<std::mutex> lock { mutex };
+        pendingScene = std::move(scene);
+    }
+    wake.notify_all();
+}
+
+bool ProbeGrid::Sample(glm::vec3 const &position, ShIrradiance &irradiance) const {
+    glm::vec3 cell = glm::clamp((position - gridMin) / (gridMax - gridMin), glm::vec3 { 0.0f }, glm::vec3 { 1.0f }) * glm::vec3 { resolution - 1u };
+    glm::uvec3 base = glm::min(glm::uvec3 { cell }, resolution - 2u);
+    glm::vec3 fraction = cell - glm::vec3 { base };
+
+    for (auto &coefficient : irradiance.Coefficients) {
+        coefficient = glm::vec3 { 0.0f };
+    }
+    float total = 0.0f;
+    std::lock_guard<std::mutex> lock { mutex };
+    for (unsigned int corner = 0; corner < 8; corner++) {
+        glm::uvec3 offset { corner & 1u, (corner >> 1) & 1u, (corner >> 2) & 1u };
+        unsigned int probe = (base.z + offset.z) * resolution.x * resolution.y + (base.y + offset.y) * resolution.x + base.x + offset.x;
+        // buried probes only see the inside of a mesh, so the others share their weight; none drops to zero, so
+        // they still do when the position sits right on a buried probe
+        if (states[probe] != ProbeState::Baked) {
+            continue;
+        }
+        glm::vec3 weights = glm::mix(glm::vec3 { 1.0f } - fraction, fraction, glm::vec3 { offset });
+        float weight = std::max(weights.x * weights.y * weights.z, 1e-4f);
+        for (unsigned int k = 0; k < ShIrradiance::COEFFICIENT_COUNT; k++) {
+            irradiance.Coefficients[k] += probes[probe].Coefficients[k] * weight;
+        }
+        total += weight;
+    }
+    if (total == 0.0f) {
+        return false;
+    }
+    for (auto &coefficient : irradiance.Coefficients) {
+        coefficient /= total;
+    }
+    return true;
+}
+
+ProbeGrid::Stats ProbeGrid::GetStats() const {
+    std::lock_guard<std::mutex> lock { mutex };
+    return stats;
+}
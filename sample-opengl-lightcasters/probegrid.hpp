@@ -0,0 +1,81 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "trianglebvh.hpp"
+
+class LightmapBaker;
+
+// Irradiance as nine L2 spherical harmonics coefficients per color channel, already convolved with the clamped
+// cosine, so evaluating it for a normal gives what the samples' shaders multiply the diffuse texture with
+struct ShIrradiance {
+    static constexpr unsigned int COEFFICIENT_COUNT = 9;
+    glm::vec3 Coefficients[COEFFICIENT_COUNT];
+
+    glm::vec3 Evaluate(glm::vec3 const &normal) const;
+};
+
+// Regular grid of irradiance probes for lighting moving objects with the static scene's bounced light. Each probe
+// traces a fixed set of directions through the static scene, projects what comes back onto spherical harmonics
+// with SSE, and adds the lights' ambient terms, so an object between probes gets what a lightmap texel there
+// would. Objects blend the eight probes around them trilinearly.
+//
+// Baking runs on a background thread one probe at a time, and every probe is published as soon as it is done.
+// Rebaking after the static lights change moves that thread on to a snapshot of the new scene, while the probes
+// keep their old irradiance until their new one is in, so the cost is spread over as many frames as it takes. The
+// new bake picks up at the probe the interrupted one stopped at and wraps around, so lights changing faster than a
+// bake takes still reach every probe in turn rather than only the first ones.
+class ProbeGrid {
+    public:
+        struct Stats {
+            unsigned int Probes = 0;
+            unsigned int Baked = 0; // for the latest scene
+            unsigned int Inside = 0; // buried in geometry, left out of blending
+            double Milliseconds = 0.0; // for the last complete bake
+            unsigned long long Rays = 0;
+        };
+    private:
+        enum class ProbeState : unsigned char { Empty, Baked, Inside };
+
+        glm::vec3 gridMin, gridMax;
+        glm::uvec3 resolution;
+        // the sampled directions, and each basis function over them in separate rows for the SIMD projection
+        std::vector<glm::vec3> directions;
+        std::vector<float> basis;
+
+        mutable std::mutex mutex;
+        std::condition_variable wake;
+        std::vector<ShIrradiance> probes;
+        std::vector<ProbeState> states;
+        // the scene each probe was last baked against, counting from 1 as the worker picks scenes up; 0 is never
+        std::vector<unsigned int> probeVersions;
+        unsigned int sceneVersion = 0;
+        unsigned int nextProbe = 0; // where the next bake starts
+        std::shared_ptr<LightmapBaker const> pendingScene; // waiting for the worker to pick it up
+        bool stopping = false;
+        Stats stats;
+        std::thread worker;
+
+        glm::vec3 probePosition(unsigned int probe) const;
+        ProbeState bakeProbe(LightmapBaker const &scene, TriangleBvh const &bvh, glm::vec3 const &position, ShIrradiance &irradiance,
+                             unsigned long long &rays) const;
+        void run();
+    public:
+        // resolution probes per axis, at least two, from gridMin to gridMax; directionCount is rounded up to a multiple of 4
+        ProbeGrid(glm::vec3 const &gridMin, glm::vec3 const &gridMax, glm::uvec3 const &resolution, unsigned int directionCount = 256);
+        ~ProbeGrid();
+
+        // Bakes every probe again against the scene in the background; a bake still running for an older scene stops
+        // after its current probe and the new one carries on from there
+        void Rebake(std::shared_ptr<LightmapBaker const> scene);
+        // Irradiance at a position blended from the probes around it, or false while none of them is baked
+        bool Sample(glm::vec3 const &position, ShIrradiance &irradiance) const;
+
+        Stats GetStats() const;
+};
@@ -0,0 +1,408 @@
+#include "renderstats.hpp"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
+
+#include "glentrypoints.hpp"
+
+namespace {
+    int const MAX_LEVELS = 16;
+    // the levels of the six cube faces, or of the only image, then the levels glGenerateMipmap made
+    using TextureLevels = std::array<std::uint64_t, 6 * MAX_LEVELS + 1>;
+
+    bool installed = false;
+    RenderStats::Frame current, last;
+
+    GLuint program = 0;
+    GLuint vertexArray = 0;
+    GLenum activeTexture = GL_TEXTURE0;
+    std::unordered_map<std::uint64_t, GLuint> textures; // bound, by unit and target
+    std::unordered_map<GLenum, GLuint> buffers; // bound, by target but the element array buffer
+    std::unordered_map<GLuint, GLuint> elementBuffers; // bound, by vertex array
+    GLuint renderbuffer = 0;
+
+    std::unordered_map<GLuint, TextureLevels> textureBytes;
+    std::unordered_map<GLuint, std::uint64_t> renderbufferBytes;
+    std::unordered_map<GLuint, std::uint64_t> bufferBytes;
+    std::uint64_t textureTotal = 0, bufferTotal = 0;
+
+    // the driver's function behind the glad pointer at Slot
+    template <auto *Slot>
+    std::remove_pointer_t<decltype(Slot)> real = nullptr;
+
+    template <auto *Slot>
+    void wrap(std::remove_pointer_t<decltype(Slot)> wrapper) {
+        // functions the context doesn't have stay null
+        if (*Slot != nullptr) {
+            real<Slot> = *Slot;
+            *Slot = wrapper;
+        }
+    }
+
+    template <auto *Slot, typename Proc = std::remove_pointer_t<decltype(Slot)>>
+    struct Uniform;
+
+    template <auto *Slot, typename R, typename... Args>
+    struct Uniform<Slot, R (APIENTRYP)(Args...)> {
+        static R APIENTRY Call(Args... args) {
+            current.UniformUploads++;
+            return real<Slot>(args...);
+        }
+    };
+
+    bool isUniform(char const *name) {
+        return std::strncmp(name, "glUniform", 9) == 0 && std::strcmp(name, "glUniformBlockBinding") != 0;
+    }
+
+    std::uint64_t triangles(GLenum mode, GLsizei count) {
+        switch (mode) {
+            case GL_TRIANGLES: return count / 3;
+            case GL_TRIANGLE_STRIP: case GL_TRIANGLE_FAN: return count > 2 ? count - 2 : 0;
+            case GL_TRIANGLES_ADJACENCY: return count / 6;
+            case GL_TRIANGLE_STRIP_ADJACENCY: return count > 5 ? count / 2 - 2 : 0;
+            default: return 0;
+        }
+    }
+
+    void draw(GLenum mode, GLsizei count, GLsizei instances) {
+        current.DrawCalls++;
+        current.Triangles += triangles(mode, count) * static_cast<std::uint64_t>(instances);
+    }
+
+    void APIENTRY drawArrays(GLenum mode, GLint first, GLsizei count) {
+        draw(mode, count, 1);
+        real<&glad_glDrawArrays>(mode, first, count);
+    }
+
+    void APIENTRY drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances) {
+        draw(mode, count, instances);
+        real<&glad_glDrawArraysInstanced>(mode, first, count, instances);
+    }
+
+    void APIENTRY drawElements(GLenum mode, GLsizei count, GLenum type, void const *indices) {
+        draw(mode, count, 1);
+        real<&glad_glDrawElements>(mode, count, type, indices);
+    }
+
+    void APIENTRY drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, void const *indices, GLsizei instances) {
+        draw(mode, count, instances);
+        real<&glad_glDrawElementsInstanced>(mode, count, type, indices, instances);
+    }
+
+    void APIENTRY drawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, void const *indices, GLint baseVertex) {
+        draw(mode, count, 1);
+        real<&glad_glDrawElementsBaseVertex>(mode, count, type, indices, baseVertex);
+    }
+
+    void APIENTRY drawElementsInstancedBaseVertex(GLenum mode, GLsizei count, GLenum type, void const *indices, GLsizei instances, GLint baseVertex) {
+        draw(mode, count, instances);
+        real<&glad_glDrawElementsInstancedBaseVertex>(mode, count, type, indices, instances, baseVertex);
+    }
+
+    void APIENTRY drawRangeElements(GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type, void const *indices) {
+        draw(mode, count, 1);
+        real<&glad_glDrawRangeElements>(mode, start, end, count, type, indices);
+    }
+
+    void APIENTRY useProgram(GLuint name) {
+        current.ProgramSwitches += name != program;
+        program = name;
+        real<&glad_glUseProgram>(name);
+    }
+
+    void APIENTRY bindVertexArray(GLuint array) {
+        current.VertexArraySwitches += array != vertexArray;
+        vertexArray = array;
+        real<&glad_glBindVertexArray>(array);
+    }
+
+    void APIENTRY activeTextureUnit(GLenum unit) {
+        activeTexture = unit;
+        real<&glad_glActiveTexture>(unit);
+    }
+
+    // the cube map faces are images of the cube map bound
+    GLenum bindingTarget(GLenum target) {
+        bool face = target >= GL_TEXTURE_CUBE_MAP_POSITIVE_X && target <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z;
+        return face ? GL_TEXTURE_CUBE_MAP : target;
+    }
+
+    GLuint &boundTexture(GLenum target) {
+        // an unknown binding is 0, which it is on a new context
+        return textures[static_cast<std::uint64_t>(activeTexture) << 32 | bindingTarget(target)];
+    }
+
+    void APIENTRY bindTexture(GLenum target, GLuint texture) {
+        GLuint &bound = boundTexture(target);
+        current.TextureSwitches += texture != bound;
+        bound = texture;
+        real<&glad_glBindTexture>(target, texture);
+    }
+
+    std::uint64_t bytesPerPixel(GLint internalFormat) {
+        switch (internalFormat) {
+            case GL_R8: case GL_RED: case GL_R8I: case GL_R8UI: case GL_STENCIL_INDEX8:
+                return 1;
+            case GL_RG8: case GL_RG: case GL_R16F: case GL_R16: case GL_R16I: case GL_R16UI: case GL_DEPTH_COMPONENT16:
+                return 2;
+            case GL_RGB8: case GL_RGB: case GL_SRGB8:
+                return 3;
+            case GL_RGB16F: case GL_RGB16:
+                return 6;
+            case GL_RGBA16F: case GL_RGBA16: case GL_RG32F: case GL_RG32I: case GL_RG32UI: case GL_DEPTH32F_STENCIL8:
+                return 8;
+            case GL_RGB32F: case GL_RGB32I: case GL_RGB32UI:
+                return 12;
+            case GL_RGBA32F: case GL_RGBA32I: case GL_RGBA32UI:
+                return 16;
+            default: // RGBA8, RG16F, R32F, R11F_G11F_B10F, RGB10_A2, the 24 and 32-bit depth formats
+                return 4;
+        }
+    }
+
+    void setTextureBytes(GLuint texture, int slot, std::uint64_t bytes) {
+        if (texture == 0) {
+            return;
+        }
+        std::uint64_t &level = textureBytes[texture][slot];
+        textureTotal = textureTotal - level + bytes;
+        level = bytes;
+    }
+
+    void setLevelBytes(GLenum target, GLint level, std::uint64_t bytes) {
+        if (level < 0 || level >= MAX_LEVELS) {
+            return;
+        }
+        int face = bindingTarget(target) == GL_TEXTURE_CUBE_MAP ? static_cast<int>(target - GL_TEXTURE_CUBE_MAP_POSITIVE_X) : 0;
+        setTextureBytes(boundTexture(target), face * MAX_LEVELS + level, bytes);
+    }
+
+    std::uint64_t imageBytes(GLint internalFormat, GLsizei width, GLsizei height, GLsizei depth) {
+        return static_cast<std::uint64_t>(width) * height * depth * bytesPerPixel(internalFormat);
+    }
+
+    void APIENTRY texImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type,
+                             void const *pixels) {
+        if (target != GL_PROXY_TEXTURE_2D && target != GL_PROXY_TEXTURE_CUBE_MAP) {
+            setLevelBytes(target, level, imageBytes(internalFormat, width, height, 1));
+        }
+        real<&glad_glTexImage2D>(target, level, internalFormat, width, height, border, format, type, pixels);
+    }
+
+    void APIENTRY texImage3D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format,
+                             GLenum type, void const *pixels) {
+        if (target != GL_PROXY_TEXTURE_3D && target != GL_PROXY_TEXTURE_2D_ARRAY) {
+            setLevelBytes(target, level, imageBytes(internalFormat, width, height, depth));
+        }
+        real<&glad_glTexImage3D>(target, level, internalFormat, width, height, depth, border, format, type, pixels);
+    }
+
+    void APIENTRY texImage2DMultisample(GLenum target, GLsizei samples, GLenum internalFormat, GLsizei width, GLsizei height, GLboolean fixed) {
+        setLevelBytes(target, 0, samples * imageBytes(static_cast<GLint>(internalFormat), width, height, 1));
+        real<&glad_glTexImage2DMultisample>(target, samples, internalFormat, width, height, fixed);
+    }
+
+    void APIENTRY compressedTexImage2D(GLenum target, GLint level, GLenum internalFormat, GLsizei width, GLsizei height, GLint border, GLsizei size,
+                                       void const *data) {
+        setLevelBytes(target, level, static_cast<std::uint64_t>(size));
+        real<&glad_glCompressedTexImage2D>(target, level, internalFormat, width, height, border, size, data);
+    }
+
+    void APIENTRY generateMipmap(GLenum target) {
+        GLuint texture = boundTexture(target);
+        auto found = textureBytes.find(texture);
+        if (found != textureBytes.end()) {
+            std::uint64_t base = 0;
+            for (int face = 0; face < 6; face++) {
+                base += found->second[face * MAX_LEVELS];
+            }
+            setTextureBytes(texture, 6 * MAX_LEVELS, base / 3);
+        }
+        real<&glad_glGenerateMipmap>(target);
+    }
+
+    void APIENTRY deleteTextures(GLsizei n, GLuint const *names) {
+        for (GLsizei i = 0; i < n; i++) {
+            auto found = textureBytes.find(names[i]);
+            if (found != textureBytes.end()) {
+                for (std::uint64_t bytes : found->second) {
+                    textureTotal -= bytes;
+                }
+                textureBytes.erase(found);
+            }
+        }
+        // deleting a bound object unbinds it, and a new object may get its name
+        for (auto &[key, bound] : textures) {
+            if (std::find(names, names + n, bound) != names + n) {
+                bound = 0;
+            }
+        }
+        real<&glad_glDeleteTextures>(n, names);
+    }
+
+    void APIENTRY bindRenderbuffer(GLenum target, GLuint name) {
+        renderbuffer = name;
+        real<&glad_glBindRenderbuffer>(target, name);
+    }
+
+    void setRenderbufferBytes(std::uint64_t bytes) {
+        if (renderbuffer != 0) {
+            std::uint64_t &stored = renderbufferBytes[renderbuffer];
+            textureTotal = textureTotal - stored + bytes;
+            stored = bytes;
+        }
+    }
+
+    void APIENTRY renderbufferStorage(GLenum target, GLenum internalFormat, GLsizei width, GLsizei height) {
+        setRenderbufferBytes(imageBytes(static_cast<GLint>(internalFormat), width, height, 1));
+        real<&glad_glRenderbufferStorage>(target, internalFormat, width, height);
+    }
+
+    void APIENTRY renderbufferStorageMultisample(GLenum target, GLsizei samples, GLenum internalFormat, GLsizei width, GLsizei height) {
+        setRenderbufferBytes(std::max(samples, 1) * imageBytes(static_cast<GLint>(internalFormat), width, height, 1));
+        real<&glad_glRenderbufferStorageMultisample>(target, samples, internalFormat, width, height);
+    }
+
+    void APIENTRY deleteRenderbuffers(GLsizei n, GLuint const *names) {
+        for (GLsizei i = 0; i < n; i++) {
+            auto found = renderbufferBytes.find(names[i]);
+            if (found != renderbufferBytes.end()) {
+                textureTotal -= found->second;
+                renderbufferBytes.erase(found);
+            }
+            if (names[i] == renderbuffer) {
+                renderbuffer = 0;
+            }
+        }
+        real<&glad_glDeleteRenderbuffers>(n, names);
+    }
+
+    // the element array buffer binding belongs to the vertex array
+    GLuint &boundBuffer(GLenum target) {
+        return target == GL_ELEMENT_ARRAY_BUFFER ? elementBuffers[vertexArray] : buffers[target];
+    }
+
+    void APIENTRY bindBuffer(GLenum target, GLuint buffer) {
+        boundBuffer(target) = buffer;
+        real<&glad_glBindBuffer>(target, buffer);
+    }
+
+    void APIENTRY bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+        buffers[target] = buffer;
+        real<&glad_glBindBufferBase>(target, index, buffer);
+    }
+
+    void APIENTRY bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+        buffers[target] = buffer;
+        real<&glad_glBindBufferRange>(target, index, buffer, offset, size);
+    }
+
+    void APIENTRY bufferData(GLenum target, GLsizeiptr size, void const *data, GLenum usage) {
+        GLuint buffer = boundBuffer(target);
+        if (buffer != 0) {
+            std::uint64_t &stored = bufferBytes[buffer];
+            bufferTotal = bufferTotal - stored + static_cast<std::uint64_t>(size);
+            stored = static_cast<std::uint64_t>(size);
+        }
+        real<&glad_glBufferData>(target, size, data, usage);
+    }
+
+    void APIENTRY deleteBuffers(GLsizei n, GLuint const *names) {
+        for (GLsizei i = 0; i < n; i++) {
+            auto found = bufferBytes.find(names[i]);
+            if (found != bufferBytes.end()) {
+                bufferTotal -= found->second;
+                bufferBytes.erase(found);
+            }
+        }
+        for (auto *bindings : { &buffers, &elementBuffers }) {
+            for (auto &[key, bound] : *bindings) {
+                if (std::find(names, names + n, bound) != names + n) {
+                    bound = 0;
+                }
+            }
+        }
+        real<&glad_glDeleteBuffers>(n, names);
+    }
+
+    void APIENTRY deleteVertexArrays(GLsizei n, GLuint const *arrays) {
+        for (GLsizei i = 0; i < n; i++) {
+            elementBuffers.erase(arrays[i]);
+        }
+        if (std::find(arrays, arrays + n, vertexArray) != arrays + n) {
+            vertexArray = 0;
+        }
+        real<&glad_glDeleteVertexArrays>(n, arrays);
+    }
+
+    void APIENTRY deleteProgram(GLuint name) {
+        if (name == program) {
+            program = 0;
+        }
+        real<&glad_glDeleteProgram>(name);
+    }
+}
+
+void RenderStats::Install() {
+    if (installed) {
+        return;
+    }
+#define WRAP_UNIFORM(name) if (isUniform(#name)) { wrap<&glad_##name>(&Uniform<&glad_##name>::Call); }
+    GL_ENTRY_POINTS(WRAP_UNIFORM)
+#undef WRAP_UNIFORM
+    wrap<&glad_glDrawArrays>(drawArrays);
+    wrap<&glad_glDrawArraysInstanced>(drawArraysInstanced);
+    wrap<&glad_glDrawElements>(drawElements);
+    wrap<&glad_glDrawElementsInstanced>(drawElementsInstanced);
+    wrap<&glad_glDrawElementsBaseVertex>(drawElementsBaseVertex);
+    wrap<&glad_glDrawElementsInstancedBaseVertex>(drawElementsInstancedBaseVertex);
+    wrap<&glad_glDrawRangeElements>(drawRangeElements);
+    wrap<&glad_glUseProgram>(useProgram);
+    wrap<&glad_glDeleteProgram>(deleteProgram);
+    wrap<&glad_glBindVertexArray>(bindVertexArray);
+    wrap<&glad_glDeleteVertexArrays>(deleteVertexArrays);
+    wrap<&glad_glActiveTexture>(activeTextureUnit);
+    wrap<&glad_glBindTexture>(bindTexture);
+    wrap<&glad_glTexImage2D>(texImage2D);
+    wrap<&glad_glTexImage3D>(texImage3D);
+    wrap<&glad_glTexImage2DMultisample>(texImage2DMultisample);
+    wrap<&glad_glCompressedTexImage2D>(compressedTexImage2D);
+    wrap<&glad_glGenerateMipmap>(generateMipmap);
+    wrap<&glad_glDeleteTextures>(deleteTextures);
+    wrap<&glad_glBindRenderbuffer>(bindRenderbuffer);
+    wrap<&glad_glRenderbufferStorage>(renderbufferStorage);
+    wrap<&glad_glRenderbufferStorageMultisample>(renderbufferStorageMultisample);
+    wrap<&glad_glDeleteRenderbuffers>(deleteRenderbuffers);
+    wrap<&glad_glBindBuffer>(bindBuffer);
+    wrap<&glad_glBindBufferBase>(bindBufferBase);
+    wrap<&glad_glBindBufferRange>(bindBufferRange);
+    wrap<&glad_glBufferData>(bufferData);
+    wrap<&glad_glDeleteBuffers>(deleteBuffers);
+    installed = true;
+}
+
+bool RenderStats::IsInstalled() {
+    return installed;
+}
+
+void RenderStats::EndFrame() {
+    last = current;
+    current = Frame {};
+}
+
+RenderStats::Frame const &RenderStats::GetLastFrame() {
+    return last;
+}
+
+std::uint64_t RenderStats::GetTextureBytes() {
+    return textureTotal;
+}
+
+std::uint64_t RenderStats::GetBufferBytes() {
+    return bufferTotal;
+}
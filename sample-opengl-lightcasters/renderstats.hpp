@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+// Per-frame render counters and the GPU memory in use, for the HUD. Like GlIntercept it swaps some of glad's
+// function pointers for wrappers, but only the few it needs: draws, binds, uniform uploads and the calls that
+// allocate texture, renderbuffer and buffer storage. Everything is counted in memory, a wrapper costs an add or two.
+//
+// The memory is what the sample asked for: the sizes passed to glBufferData and the images' sizes in their internal
+// formats, with a third on top of the base level for glGenerateMipmap. Drivers pad and compress behind that. The
+// indirect draws GpuCuller issues through its own function pointers aren't seen.
+class RenderStats {
+    public:
+        struct Frame {
+            unsigned int DrawCalls = 0;
+            std::uint64_t Triangles = 0;
+            // binds of another program, texture or vertex array than the one already bound
+            unsigned int ProgramSwitches = 0;
+            unsigned int TextureSwitches = 0;
+            unsigned int VertexArraySwitches = 0;
+            unsigned int UniformUploads = 0;
+        };
+
+        // Wraps glad's function pointers; call once after gladLoadGLLoader, before any GL object is made
+        static void Install();
+        static bool IsInstalled();
+        // Keeps the frame's counts for GetLastFrame and starts the next one
+        static void EndFrame();
+        static Frame const &GetLastFrame();
+        // textures and renderbuffers
+        static std::uint64_t GetTextureBytes();
+        static std::uint64_t GetBufferBytes();
+};
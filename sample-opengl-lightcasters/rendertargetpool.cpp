@@ -0,0 +1,61 @@
+#include "rendertargetpool.hpp"
+
+#include <algorithm>
+
+RenderTargetPool::RenderTargetPool() : frame { 0 } {}
+
+RenderTargetPool::~RenderTargetPool() {
+    for (Entry &entry : entries) {
+        glDeleteFramebuffers(1, &entry.Target.Framebuffer);
+        glDeleteTextures(1, &entry.Target.Texture);
+    }
+}
+
+RenderTarget RenderTargetPool::Acquire(int width, int height, GLenum format) {
+    for (Entry &entry : entries) {
+        if (!entry.InUse && entry.Target.Width == width && entry.Target.Height == height && entry.Target.Format == format) {
+            entry.InUse = true;
+            entry.LastUsed = frame;
+            return entry.Target;
+        }
+    }
+
+    RenderTarget target { 0, 0, width, height, format };
+    glGenTextures(1, &target.Texture);
+    glBindTexture(GL_TEXTURE_2D, target.Texture);
+    // no data is uploaded, so the pixel format only has to be valid for the internal one
+    glTexImage2D(GL_TEXTURE_2D, 0, static_cast<GLint>(format), width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glGenFramebuffers(1, &target.Framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.Framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.Texture, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    entries.push_back(Entry { target, true, frame });
+    return target;
+}
+
+void RenderTargetPool::Release(RenderTarget const &target) {
+    for (Entry &entry : entries) {
+        if (entry.Target.Framebuffer == target.Framebuffer) {
+            entry.InUse = false;
+            entry.LastUsed = frame;
+            return;
+        }
+    }
+}
+
+void RenderTargetPool::EndFrame() {
+    frame++;
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [&](Entry &entry) {
+        if (entry.InUse || frame - entry.LastUsed < IDLE_FRAMES) {
+            return false;
+        }
+        glDeleteFramebuffers(1, &entry.Target.Framebuffer);
+        glDeleteTextures(1, &entry.Target.Texture);
+        return true;
+    }), entries.end());
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+// A color texture with a framebuffer around it
+struct RenderTarget {
+    GLuint Framebuffer;
+    GLuint Texture;
+    int Width, Height;
+    GLenum Format;
+};
+
+// Hands out temporary render targets for passes that only need them within a frame. Released targets are kept and
+// handed out again to the next request of the same size and format, so a chain of passes allocates nothing once
+// it has run a frame; targets nobody asked for in a while, e.g. after a resize, are deleted.
+class RenderTargetPool {
+    public:
+        // free targets unused for this many frames are deleted
+        static constexpr unsigned int IDLE_FRAMES = 60;
+    private:
+        struct Entry {
+            RenderTarget Target;
+            bool InUse;
+            unsigned long long LastUsed;
+        };
+        std::vector<Entry> entries;
+        unsigned long long frame;
+    public:
+        RenderTargetPool();
+        ~RenderTargetPool();
+        RenderTargetPool(RenderTargetPool const &) = delete;
+        RenderTargetPool &operator=(RenderTargetPool const &) = delete;
+
+        // A target of the given size and internal format, linearly filtered and clamped to its edges
+        RenderTarget Acquire(int width, int height, GLenum format);
+        void Release(RenderTarget const &target);
+        // Deletes the targets left idle too long; call once per frame
+        void EndFrame();
+
+        // targets allocated, in use or not
+        std::size_t GetTargetCount() const { return entries.size(); }
+};
@@ -0,0 +1,443 @@
+// Replays a GL trace written by `./main --capture FILE` on a headless context; neither the sample nor its assets are
+// needed. Build with `make replay` and run ./replay FILE. It issues the recorded calls in order, timing each one on
+// the CPU and, with --gpu, on the GPU with a timestamp between every two calls, then reports the frames, the most
+// expensive calls and the time per entry point. `--top N` sets how many calls the report lists, `--csv FILE` writes
+// every call with its frame and index, for bisecting a regression between two drivers or two builds.
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "glentrypoints.hpp"
+#include "gltrace.hpp"
+#include "headless.hpp"
+
+using Clock = std::chrono::steady_clock;
+using std::string;
+using std::vector;
+
+static int const MAX_ARGUMENTS = 16;
+
+struct Entry {
+    string Name;
+    void (*Play)(Entry const &entry);
+    GlObject Names[MAX_ARGUMENTS];
+    GlObject Result;
+    bool UsesProgram; // glUseProgram, which the uniform locations depend on
+};
+
+struct CallTiming {
+    unsigned int Frame, Index;
+    std::uint16_t Id;
+    double CpuMs, GpuMs;
+};
+
+static vector<char> trace;
+static size_t cursor = 0;
+static bool truncated = false;
+
+// the replay's names of the capture's, per namespace; uniform locations and blocks are keyed by program too
+static std::unordered_map<std::uint64_t, std::uint64_t> names[static_cast<int>(GlObject::UniformBlock) + 1];
+static std::uint64_t recorded[MAX_ARGUMENTS]; // the call's arguments as captured
+static std::uint64_t currentProgram = 0;
+
+// the copies of the call's data, aligned for whatever the driver reads from them, and room for what it writes
+static vector<vector<std::uint64_t>> scratch;
+static size_t scratchUsed = 0;
+static GLuint *generatedNames = nullptr;
+static std::uint32_t generatedCount = 0;
+static GlObject generatedObject = GlObject::None;
+static double callCpuMs = 0.0;
+
+template <typename T>
+static T read() {
+    T value {};
+    if (cursor + sizeof(T) > trace.size()) {
+        truncated = true;
+        cursor = trace.size();
+        return value;
+    }
+    std::memcpy(&value, trace.data() + cursor, sizeof(T));
+    cursor += sizeof(T);
+    return value;
+}
+
+static void readBytes(void *destination, size_t size) {
+    if (cursor + size > trace.size()) {
+        truncated = true;
+        cursor = trace.size();
+        return;
+    }
+    std::memcpy(destination, trace.data() + cursor, size);
+    cursor += size;
+}
+
+static void *allocate(size_t size) {
+    if (scratchUsed == scratch.size()) {
+        scratch.emplace_back();
+    }
+    vector<std::uint64_t> &buffer = scratch[scratchUsed++];
+    buffer.resize(std::max(buffer.size(), size / sizeof(std::uint64_t) + 1));
+    return buffer.data();
+}
+
+static bool perProgram(GlObject object) {
+    return object == GlObject::UniformLocation || object == GlObject::UniformBlock;
+}
+
+static std::uint64_t key(GlObject object, std::uint64_t name, std::uint64_t program) {
+    return perProgram(object) ? program << 32 | (name & 0xffffffff) : name;
+}
+
+static std::uint64_t translate(GlObject object, std::uint64_t name, std::uint64_t program) {
+    auto const &map = names[static_cast<int>(object)];
+    auto found = map.find(key(object, name, program));
+    return found == map.end() ? name : found->second;
+}
+
+static void remember(GlObject object, std::uint64_t name, std::uint64_t replayed, std::uint64_t program) {
+    names[static_cast<int>(object)][key(object, name, program)] = replayed;
+}
+
+// glUniform* sets a location of the program in use, the others name their program first
+static std::uint64_t programOf(Entry const &entry) {
+    return entry.Names[0] == GlObject::Program ? recorded[0] : currentProgram;
+}
+
+static void *decodePointer(Entry const &entry, int index) {
+    switch (read<GlPayload>()) {
+        case GlPayload::Null:
+            return nullptr;
+        case GlPayload::Offset:
+            return reinterpret_cast<void *>(static_cast<std::uintptr_t>(read<std::uint64_t>()));
+        case GlPayload::Data: {
+            std::uint32_t size = read<std::uint32_t>();
+            void *data = allocate(size);
+            readBytes(data, size);
+            return data;
+        }
+        case GlPayload::Strings: {
+            std::uint32_t count = read<std::uint32_t>();
+            char **strings = static_cast<char **>(allocate(count * sizeof(char *)));
+            for (std::uint32_t i = 0; i < count && !truncated; i++) {
+                std::uint32_t length = read<std::uint32_t>();
+                strings[i] = static_cast<char *>(allocate(length + 1));
+                readBytes(strings[i], length);
+                strings[i][length] = '\0';
+            }
+            return strings;
+        }
+        case GlPayload::Names: {
+            std::uint32_t count = read<std::uint32_t>();
+            GLuint *values = static_cast<GLuint *>(allocate(count * sizeof(GLuint)));
+            for (std::uint32_t i = 0; i < count; i++) {
+                values[i] = static_cast<GLuint>(translate(entry.Names[index], read<GLuint>(), 0));
+            }
+            return values;
+        }
+        case GlPayload::Output:
+            // at least enough for any of the glGet*v functions
+            return allocate(std::max<size_t>(read<std::uint32_t>(), 4096));
+        case GlPayload::Generated:
+            generatedCount = read<std::uint32_t>();
+            generatedNames = static_cast<GLuint *>(allocate(generatedCount * sizeof(GLuint)));
+            generatedObject = entry.Names[index];
+            return generatedNames;
+    }
+    truncated = true;
+    return nullptr;
+}
+
+template <typename T>
+static T decode(Entry const &entry, int index) {
+    if constexpr (std::is_same_v<T, GLsync>) {
+        std::uint64_t sync = read<std::uint64_t>();
+        return reinterpret_cast<GLsync>(static_cast<std::uintptr_t>(translate(GlObject::Sync, sync, 0)));
+    } else if constexpr (std::is_pointer_v<T>) {
+        return static_cast<T>(decodePointer(entry, index));
+    } else {
+        T value = read<T>();
+        if constexpr (std::is_integral_v<T>) {
+            recorded[index] = static_cast<std::uint64_t>(value);
+            if (entry.Names[index] != GlObject::None) {
+                value = static_cast<T>(translate(entry.Names[index], recorded[index], programOf(entry)));
+            }
+        }
+        return value;
+    }
+}
+
+template <auto *Slot, typename Proc = std::remove_pointer_t<decltype(Slot)>>
+struct Player;
+
+template <auto *Slot, typename R, typename... Args>
+struct Player<Slot, R (APIENTRYP)(Args...)> {
+    static_assert(sizeof...(Args) <= MAX_ARGUMENTS);
+
+    static void Play(Entry const &entry) {
+        play(entry, std::index_sequence_for<Args...> {});
+    }
+
+    template <size_t... Indices>
+    static void play(Entry const &entry, std::index_sequence<Indices...>) {
+        scratchUsed = 0;
+        // braces evaluate the arguments in order, as they were written
+        std::tuple<Args...> arguments { decode<Args>(entry, static_cast<int>(Indices))... };
+        if (entry.UsesProgram) {
+            currentProgram = recorded[0];
+        }
+        auto start = Clock::now();
+        if constexpr (std::is_void_v<R>) {
+            std::apply(*Slot, arguments);
+            callCpuMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            readGenerated();
+        } else {
+            R result = std::apply(*Slot, arguments);
+            callCpuMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            readGenerated();
+            if constexpr (std::is_same_v<R, GLsync>) {
+                remember(GlObject::Sync, read<std::uint64_t>(), reinterpret_cast<std::uintptr_t>(result), 0);
+            } else if constexpr (!std::is_pointer_v<R>) {
+                R captured = read<R>();
+                if (entry.Result != GlObject::None) {
+                    remember(entry.Result, static_cast<std::uint64_t>(captured), static_cast<std::uint64_t>(result), programOf(entry));
+                }
+            }
+        }
+    }
+
+    static void readGenerated() {
+        if (generatedNames != nullptr) {
+            for (std::uint32_t i = 0; i < generatedCount; i++) {
+                remember(generatedObject, read<GLuint>(), generatedNames[i], 0);
+            }
+            generatedNames = nullptr;
+        }
+    }
+};
+
+static bool loadTrace(char const *path) {
+    std::ifstream file { path, std::ios::binary };
+    if (!file) {
+        return false;
+    }
+    trace.assign(std::istreambuf_iterator<char> { file }, std::istreambuf_iterator<char> {});
+    return true;
+}
+
+int main(int argc, char **argv) {
+    char const *path = nullptr;
+    char const *csvPath = nullptr;
+    bool gpuTiming = false;
+    unsigned int top = 10;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--gpu") == 0) {
+            gpuTiming = true;
+        } else if (std::strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+            csvPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--top") == 0 && i + 1 < argc) {
+            top = static_cast<unsigned int>(std::atoi(argv[++i]));
+        } else if (argv[i][0] != '-' && path == nullptr) {
+            path = argv[i];
+        } else {
+            std::printf("usage: %s [--gpu] [--top N] [--csv FILE] TRACE\n", argv[0]);
+            return 1;
+        }
+    }
+    if (path == nullptr) {
+        std::printf("usage: %s [--gpu] [--top N] [--csv FILE] TRACE\n", argv[0]);
+        return 1;
+    }
+    if (!loadTrace(path)) {
+        std::printf("can't read %s\n", path);
+        return 1;
+    }
+    std::uint32_t magic = read<std::uint32_t>();
+    std::uint32_t version = read<std::uint32_t>();
+    int width = static_cast<int>(read<std::uint32_t>());
+    int height = static_cast<int>(read<std::uint32_t>());
+    if (truncated || magic != GL_TRACE_MAGIC || version != GL_TRACE_VERSION) {
+        std::printf("%s isn't a version %u GL trace\n", path, GL_TRACE_VERSION);
+        return 1;
+    }
+
+    auto context = HeadlessContext::Create(width, height);
+    if (context == nullptr) {
+        std::printf("no headless OpenGL 3.3 context available\n");
+        return 1;
+    }
+    if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(HeadlessContext::GetProcAddress))) {
+        std::printf("failed to initialize GLAD\n");
+        return 1;
+    }
+    std::printf("renderer: %s, %s\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+
+    std::unordered_map<string, void (*)(Entry const &)> players;
+#define ADD_PLAYER(name) if (glad_##name != nullptr) { players[#name] = &Player<&glad_##name>::Play; }
+    GL_ENTRY_POINTS(ADD_PLAYER)
+#undef ADD_PLAYER
+
+    vector<Entry> entries;
+    vector<CallTiming> calls;
+    vector<GLuint> timestamps;
+    vector<unsigned int> frameErrors;
+    unsigned int frame = 0, index = 0;
+    size_t frameStart = 0;
+    // reads the frame's timestamps back once it's done, the difference of two is the call between them
+    auto endFrame = [&]() {
+        size_t count = calls.size() - frameStart;
+        if (gpuTiming && count > 0) {
+            glQueryCounter(timestamps[count], GL_TIMESTAMP);
+            GLuint64 previous = 0;
+            glGetQueryObjectui64v(timestamps[0], GL_QUERY_RESULT, &previous);
+            for (size_t i = 0; i < count; i++) {
+                GLuint64 next = 0;
+                glGetQueryObjectui64v(timestamps[i + 1], GL_QUERY_RESULT, &next);
+                calls[frameStart + i].GpuMs = static_cast<double>(next - previous) / 1e6;
+                previous = next;
+            }
+        }
+        unsigned int errors = 0;
+        while (glGetError() != GL_NO_ERROR) {
+            errors++;
+        }
+        frameErrors.push_back(errors);
+        frameStart = calls.size();
+        frame++;
+        index = 0;
+    };
+
+    bool ended = false;
+    while (!ended && !truncated) {
+        std::uint16_t tag = read<std::uint16_t>();
+        if (tag == GL_TRACE_DECLARE) {
+            std::uint16_t id = read<std::uint16_t>();
+            string name(read<std::uint16_t>(), '\0');
+            readBytes(name.data(), name.size());
+            auto player = players.find(name);
+            if (player == players.end()) {
+                std::printf("the trace calls %s, which this context doesn't have\n", name.c_str());
+                return 1;
+            }
+            if (id >= entries.size()) {
+                entries.resize(id + 1);
+            }
+            Entry &entry = entries[id];
+            entry.Name = name;
+            entry.Play = player->second;
+            for (int i = 0; i < MAX_ARGUMENTS; i++) {
+                entry.Names[i] = GetNameArgument(name.c_str(), i);
+            }
+            entry.Result = GetNameArgument(name.c_str(), -1);
+            entry.UsesProgram = name == "glUseProgram";
+        } else if (tag == GL_TRACE_FRAME) {
+            endFrame();
+        } else if (tag == GL_TRACE_END) {
+            ended = true;
+        } else {
+            if (tag >= entries.size() || entries[tag].Play == nullptr) {
+                std::printf("the trace calls entry point %u before declaring it\n", tag);
+                return 1;
+            }
+            size_t count = calls.size() - frameStart;
+            if (gpuTiming) {
+                if (count + 1 >= timestamps.size()) {
+                    size_t previous = timestamps.size();
+                    timestamps.resize(std::max<size_t>(2 * previous, 1024));
+                    glGenQueries(static_cast<GLsizei>(timestamps.size() - previous), timestamps.data() + previous);
+                }
+                glQueryCounter(timestamps[count], GL_TIMESTAMP);
+            }
+            entries[tag].Play(entries[tag]);
+            calls.push_back(CallTiming { frame, index++, tag, callCpuMs, 0.0 });
+        }
+    }
+    if (!ended) {
+        std::printf("%s is truncated, replayed %zu calls\n", path, calls.size());
+        return 1;
+    }
+    if (calls.size() > frameStart) {
+        endFrame();
+    }
+
+    // frames
+    std::printf("%u frames, %zu calls; frame 0 includes the startup\n", frame, calls.size());
+    std::printf("%6s %8s %10s %10s %7s\n", "frame", "calls", "cpu ms", "gpu ms", "errors");
+    size_t first = 0;
+    for (unsigned int f = 0; f < frame; f++) {
+        size_t last = first;
+        double cpu = 0.0, gpu = 0.0;
+        for (; last < calls.size() && calls[last].Frame == f; last++) {
+            cpu += calls[last].CpuMs;
+            gpu += calls[last].GpuMs;
+        }
+        std::printf("%6u %8zu %10.3f %10.3f %7u\n", f, last - first, cpu, gpu, frameErrors[f]);
+        first = last;
+    }
+
+    // the most expensive calls, by GPU time when there is one
+    auto cost = [&](CallTiming const &call) { return gpuTiming ? call.GpuMs : call.CpuMs; };
+    vector<CallTiming> sorted = calls;
+    size_t shown = std::min<size_t>(top, sorted.size());
+    std::partial_sort(sorted.begin(), sorted.begin() + shown, sorted.end(), [&](CallTiming const &a, CallTiming const &b) { return cost(a) > cost(b); });
+    std::printf("\ntop %zu calls by %s time\n", shown, gpuTiming ? "GPU" : "CPU");
+    std::printf("%6s %8s %-36s %10s %10s\n", "frame", "call", "entry point", "cpu ms", "gpu ms");
+    for (size_t i = 0; i < shown; i++) {
+        CallTiming const &call = sorted[i];
+        std::printf("%6u %8u %-36s %10.3f %10.3f\n", call.Frame, call.Index, entries[call.Id].Name.c_str(), call.CpuMs, call.GpuMs);
+    }
+
+    // per entry point
+    struct Total {
+        std::uint16_t Id;
+        size_t Calls;
+        double CpuMs, GpuMs;
+    };
+    vector<Total> totals;
+    for (size_t i = 0; i < entries.size(); i++) {
+        totals.push_back(Total { static_cast<std::uint16_t>(i), 0, 0.0, 0.0 });
+    }
+    for (auto const &call : calls) {
+        totals[call.Id].Calls++;
+        totals[call.Id].CpuMs += call.CpuMs;
+        totals[call.Id].GpuMs += call.GpuMs;
+    }
+    std::sort(totals.begin(), totals.end(), [&](Total const &a, Total const &b) {
+        return gpuTiming ? a.GpuMs > b.GpuMs : a.CpuMs > b.CpuMs;
+    });
+    std::printf("\nper entry point\n");
+    std::printf("%-36s %8s %10s %10s\n", "entry point", "calls", "cpu ms", "gpu ms");
+    for (auto const &total : totals) {
+        if (total.Calls > 0) {
+            std::printf("%-36s %8zu %10.3f %10.3f\n", entries[total.Id].Name.c_str(), total.Calls, total.CpuMs, total.GpuMs);
+        }
+    }
+
+    if (csvPath != nullptr) {
+        std::ofstream csv { csvPath };
+        csv << "frame,call,entry point,cpu ms,gpu ms\n";
+        for (auto const &call : calls) {
+            csv << call.Frame << ',' << call.Index << ',' << entries[call.Id].Name << ',' << call.CpuMs << ',' << call.GpuMs << '\n';
+        }
+        if (!csv) {
+            std::printf("can't write %s\n", csvPath);
+            return 1;
+        }
+    }
+    if (!timestamps.empty()) {
+        glDeleteQueries(static_cast<GLsizei>(timestamps.size()), timestamps.data());
+    }
+    return 0;
+}
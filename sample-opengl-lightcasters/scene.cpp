@@ -0,0 +1,59 @@
+#include "scene.hpp"
+
+#include <cstdio>
+#include <vector>
+
+#include "lightmap.hpp"
+#include "stb_image.h"
+
+using std::vector;
+
+glm::vec3 AverageTextureColor(char const *path) {
+    int width, height, channels;
+    unsigned char *data = stbi_load(path, &width, &height, &channels, 3);
+    if (data == nullptr) {
+        std::printf("Unable to load %s, bouncing off grey\n", path);
+        return glm::vec3 { 0.5f };
+    }
+    glm::dvec3 sum { 0.0 };
+    for (int i = 0; i < width * height; i++) {
+        sum += glm::dvec3 { data[i * 3], data[i * 3 + 1], data[i * 3 + 2] };
+    }
+    stbi_image_free(data);
+    return glm::vec3 { sum / (255.0 * width * height) };
+}
+
+void BuildStaticScene(LightmapBaker &baker, glm::vec3 const &albedo, bool pointLights) {
+    // the cube is unwrapped once in model space and every static cube gets its own square of the lightmap
+    vector<glm::vec3> positions, normals;
+    for (unsigned int i = 0; i < CUBE_VERTEX_COUNT; i++) {
+        float const *vertex = &CUBE_VERTICES[i * CUBE_VERTEX_STRIDE];
+        positions.push_back(glm::vec3 { vertex[0], vertex[1], vertex[2] });
+        normals.push_back(glm::vec3 { vertex[3], vertex[4], vertex[5] });
+    }
+    vector<glm::vec2> coords = UnwrapLightmap(positions, normals, LIGHTMAP_INSTANCE_RESOLUTION);
+    vector<unsigned int> staticCubes;
+    for (unsigned int i = 0; i < CUBE_COUNT; i++) {
+        if (!IsDynamicCube(i)) {
+            staticCubes.push_back(i);
+        }
+    }
+    vector<glm::vec4> scaleOffsets;
+    PackLightmapInstances(static_cast<unsigned int>(staticCubes.size()), LIGHTMAP_INSTANCE_RESOLUTION, scaleOffsets);
+
+    // the rotating cubes move, so they neither receive nor cast baked light
+    for (size_t instance = 0; instance < staticCubes.size(); instance++) {
+        vector<glm::vec3> world(positions.size());
+        vector<glm::vec2> lightmapCoords(coords.size());
+        for (size_t i = 0; i < positions.size(); i++) {
+            world[i] = positions[i] + CUBE_POSITIONS[staticCubes[instance]];
+            lightmapCoords[i] = coords[i] * glm::vec2 { scaleOffsets[instance] } + glm::vec2 { scaleOffsets[instance].z, scaleOffsets[instance].w };
+        }
+        baker.AddMesh(world, normals, lightmapCoords, albedo);
+    }
+    baker.AddDirectionalLight(LightmapBaker::DirectionalLight { DIRECTIONAL_LIGHT_DIRECTION, DIRECTIONAL_LIGHT_DIFFUSE, DIRECTIONAL_LIGHT_AMBIENT });
+    for (unsigned int i = 0; pointLights && i < POINT_LIGHT_COUNT; i++) {
+        baker.AddPointLight(LightmapBaker::PointLight { POINT_LIGHT_POSITIONS[i], POINT_LIGHT_DIFFUSE, POINT_LIGHT_AMBIENT, POINT_LIGHT_CONSTANT,
+                                                        POINT_LIGHT_LINEAR, POINT_LIGHT_QUADRATIC });
+    }
+}
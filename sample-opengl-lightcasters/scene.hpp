@@ -0,0 +1,105 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// The light casters scene, shared by the viewer and the lightmap baker so a bake matches what the viewer draws
+
+// unit cube as a triangle list
+inline float const CUBE_VERTICES[] = {
+    // positions          // normals           // texture coords
+    -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
+     0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
+     0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
+     0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
+    -0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
+    -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
+
+    -0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   0.0f, 0.0f,
+     0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   1.0f, 0.0f,
+     0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   1.0f, 1.0f,
+     0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   1.0f, 1.0f,
+    -0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   0.0f, 1.0f,
+    -0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   0.0f, 0.0f,
+
+    -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+    -0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
+    -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+    -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+    -0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
+    -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+
+     0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+     0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
+     0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+     0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+     0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
+     0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+
+    -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
+     0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 1.0f,
+     0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
+     0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
+    -0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 0.0f,
+    -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
+
+    -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f,
+     0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 1.0f,
+     0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
+     0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
+    -0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 0.0f,
+    -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f
+};
+inline unsigned int const CUBE_VERTEX_COUNT = 36;
+inline unsigned int const CUBE_VERTEX_STRIDE = 8;
+
+inline glm::vec3 const CUBE_POSITIONS[] = {
+    glm::vec3 { 0.0f,  0.0f,  0.0f },
+    glm::vec3 { 2.0f,  5.0f, -15.0f },
+    glm::vec3 { -1.5f, -2.2f, -2.5f },
+    glm::vec3 { -3.8f, -2.0f, -12.3f },
+    glm::vec3 { 2.4f, -0.4f, -3.5f },
+    glm::vec3 { -1.7f,  3.0f, -7.5f },
+    glm::vec3 { 1.3f, -2.0f, -2.5f },
+    glm::vec3 { 1.5f,  2.0f, -2.5f },
+    glm::vec3 { 1.5f,  0.2f, -1.5f },
+    glm::vec3 { -1.3f,  1.0f, -1.5f }
+};
+inline unsigned int const CUBE_COUNT = 10;
+// every third cube rotates, the others never move and can be baked
+inline bool IsDynamicCube(unsigned int cube) { return cube % 3 == 0; }
+
+inline glm::vec3 const DIRECTIONAL_LIGHT_DIRECTION { -0.2f, -1.0f, -0.3f };
+inline glm::vec3 const DIRECTIONAL_LIGHT_DIFFUSE { 0.8f };
+inline glm::vec3 const DIRECTIONAL_LIGHT_AMBIENT = DIRECTIONAL_LIGHT_DIFFUSE * 0.05f;
+inline glm::vec3 const DIRECTIONAL_LIGHT_SPECULAR { 0.5f };
+
+inline glm::vec3 const POINT_LIGHT_POSITIONS[] = {
+    glm::vec3 { 0.7f,  0.2f,  2.0f },
+    glm::vec3 { 2.3f, -3.3f, -4.0f },
+    glm::vec3 { -4.0f,  2.0f, -12.0f },
+    glm::vec3 { 0.0f,  0.0f, -3.0f }
+};
+inline unsigned int const POINT_LIGHT_COUNT = 4;
+inline glm::vec3 const POINT_LIGHT_DIFFUSE { 0.3f, 0.0f, 0.0f };
+inline glm::vec3 const POINT_LIGHT_AMBIENT = POINT_LIGHT_DIFFUSE * 0.05f;
+inline glm::vec3 const POINT_LIGHT_SPECULAR { 1.0f, 0.0f, 0.0f };
+inline float const POINT_LIGHT_CONSTANT = 1.0f;
+inline float const POINT_LIGHT_LINEAR = 0.045f;
+inline float const POINT_LIGHT_QUADRATIC = 0.0075f;
+
+// texels per side of each static cube's square in the baked lightmap
+inline unsigned int const LIGHTMAP_INSTANCE_RESOLUTION = 128;
+inline char const *const LIGHTMAP_PATH = "./lightmap.hdr";
+
+// the irradiance probes cover the cubes with a margin, a probe about every 1.5 units
+inline glm::vec3 const PROBE_GRID_MIN { -5.5f, -4.0f, -16.5f };
+inline glm::vec3 const PROBE_GRID_MAX { 4.0f, 6.5f, 2.0f };
+inline glm::uvec3 const PROBE_GRID_RESOLUTION { 7, 8, 13 };
+
+class LightmapBaker;
+
+// Average color of a texture, which is what bounced light picks up from a surface using it. Grey if it won't load.
+glm::vec3 AverageTextureColor(char const *path);
+// The static cubes with their lightmap coordinates, laid out the way the viewer draws them, and the lights; the
+// point lights only while they are switched on
+void BuildStaticScene(LightmapBaker &baker, glm::vec3 const &albedo, bool pointLights = true);
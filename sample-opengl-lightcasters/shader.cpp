@@ -6,6 +6,10 @@ using std::stringstream;
 using std::cout;
 using std::endl;
 
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+
 Shader::Shader(string vertexShaderPath, string fragmentShaderPath) {
     string vertexCode;
     string fragmentCode;
@@ -86,6 +90,43 @@ Shader::Shader(string vertexShaderPath, string fragmentShaderPath) {
     glDeleteShader(fragmentShader);
 }
 
+Shader::Shader(string computeShaderPath) {
+    string computeCode;
+    ifstream computeShaderFile;
+    computeShaderFile.exceptions(ifstream::failbit | ifstream::badbit);
+    try {
+        computeShaderFile.open(computeShaderPath);
+        stringstream computeShaderStream;
+        computeShaderStream << computeShaderFile.rdbuf();
+        computeShaderFile.close();
+        computeCode = computeShaderStream.str();
+    } catch (ifstream::failure e) {
+        cout << "Unable to read shader file" << endl;
+    }
+    char const *cShaderCode = computeCode.c_str();
+
+    GLint success;
+    GLchar infoLog[512];
+    // Compute shaders run outside of the graphics pipeline, so the program holds this single stage
+    GLuint computeShader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(computeShader, 1, &cShaderCode, nullptr);
+    glCompileShader(computeShader);
+    glGetShaderiv(computeShader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(computeShader, 512, nullptr, infoLog);
+        cout << "Compute shader compilation error" << infoLog << endl;
+    }
+    program_id = glCreateProgram();
+    glAttachShader(program_id, computeShader);
+    glLinkProgram(program_id);
+    glGetProgramiv(program_id, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(program_id, 512, nullptr, infoLog);
+        cout << "Shader program link error" << infoLog << endl;
+    }
+    glDeleteShader(computeShader);
+}
+
 Shader::~Shader() {
     glDeleteProgram(program_id);
 }
@@ -116,4 +157,12 @@ void Shader::SetFloatVec3(std::string const &uniform, float x, float y, float z)
 
 void Shader::SetFloatVec3(std::string const &uniform, glm::vec3 vector) const {
     glUniform3fv(glGetUniformLocation(program_id, uniform.c_str()), 1, &vector[0]);
+}
+
+void Shader::SetFloatVec2(std::string const &uniform, glm::vec2 vector) const {
+    glUniform2fv(glGetUniformLocation(program_id, uniform.c_str()), 1, &vector[0]);
+}
+
+void Shader::SetFloatVec4(std::string const &uniform, glm::vec4 vector) const {
+    glUniform4fv(glGetUniformLocation(program_id, uniform.c_str()), 1, &vector[0]);
 }
\ No newline at end of file
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <string>
@@ -10,6 +12,8 @@ class Shader {
         int program_id;
     public:
         Shader(std::string vertexShaderPath, std::string fragmentShaderPath);
+        // Compute-only program; needs a GL 4.3 context
+        explicit Shader(std::string computeShaderPath);
         ~Shader();
         int GetProgramId() const { return program_id; }
         void Use() const;
@@ -19,4 +23,6 @@ class Shader {
         void SetFloatMatrix(std::string const &uniform, glm::mat4 matrix) const;
         void SetFloatVec3(std::string const &uniform, float x, float y, float z) const;
         void SetFloatVec3(std::string const &uniform, glm::vec3 vector) const;
+        void SetFloatVec2(std::string const &uniform, glm::vec2 vector) const;
+        void SetFloatVec4(std::string const &uniform, glm::vec4 vector) const;
 };
\ No newline at end of file
@@ -0,0 +1,99 @@
+#version 330 core
+
+struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+    float shininess;
+};
+
+struct Spotlight {
+    vec3 position;
+    vec3 direction;
+    float innerCutOff;
+    float outerCutOff;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+out vec4 FragColor;
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+in vec2 LightmapCoords;
+in vec3 ShadowPos;
+
+uniform Material material;
+// the camera's spotlight moves, so it is the only light evaluated here
+uniform Spotlight spotlight;
+// ambient, direct and bounced diffuse light of the static lights, written by the baker
+uniform sampler2D lightmap;
+
+uniform sampler2DShadow shadowAtlas;
+uniform float shadowTexelSize;
+uniform mat4 spotShadowMatrix;
+uniform vec4 spotShadowRect;
+
+vec3 CalcSpotlight(Spotlight light, vec3 normal, vec3 viewDir, float shadow);
+float SampleShadow(mat4 atlasMatrix, vec4 rect);
+
+void main() {
+    vec3 normal = normalize(Normal);
+    vec3 viewDir = normalize(-FragPos);
+
+    // the static lights' specular highlights depend on the view and are not baked
+    vec3 result = texture(lightmap, LightmapCoords).rgb * vec3(texture(material.diffuse, TexCoords));
+    result += CalcSpotlight(spotlight, normal, viewDir, SampleShadow(spotShadowMatrix, spotShadowRect));
+
+    FragColor = vec4(result, 1.0);
+}
+
+vec3 CalcSpotlight(Spotlight light, vec3 normal, vec3 viewDir, float shadow) {
+    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
+
+    vec3 lightDir = normalize(-FragPos);
+    float diffuseImpact = max(dot(normal, lightDir), 0.0);
+    vec3 diffuse = light.diffuse * diffuseImpact * vec3(texture(material.diffuse, TexCoords));
+
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float specularImpact = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    vec3 specular = light.specular * specularImpact * vec3(texture(material.specular, TexCoords));
+
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.innerCutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    diffuse *= intensity;
+    specular *= intensity;
+
+    float dist = length(light.position - FragPos);
+    float attenuation = 1 / (light.constant + light.linear * dist + light.quadratic * (dist * dist));
+    ambient *= attenuation;
+    diffuse *= attenuation;
+    specular *= attenuation;
+
+    return ambient + shadow * (diffuse + specular);
+}
+
+// 1 where lit: nine filtered comparisons, kept inside the tile so none reads a neighbouring one
+float SampleShadow(mat4 atlasMatrix, vec4 rect) {
+    if (rect.z <= rect.x) {
+        return 1.0;
+    }
+    vec4 position = atlasMatrix * vec4(ShadowPos, 1.0);
+    vec3 coords = position.xyz / position.w;
+    if (coords.z >= 1.0) {
+        return 1.0;
+    }
+    float lit = 0.0;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            vec2 uv = clamp(coords.xy + vec2(x, y) * shadowTexelSize, rect.xy, rect.zw);
+            lit += texture(shadowAtlas, vec3(uv, coords.z));
+        }
+    }
+    return lit / 9.0;
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNorm;
+layout (location = 2) in vec2 aTexCoords;
+// the cube's own lightmap coordinates, shared by every instance
+layout (location = 4) in vec2 aLightmapCoords;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+out vec2 LightmapCoords;
+// world position pushed out along the normal, where the shadow atlas is sampled
+out vec3 ShadowPos;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform mat4 model;
+// maps this instance into its square of the lightmap
+uniform vec4 lightmapScaleOffset;
+
+// world units to push the shadow lookup out of the surface, against self-shadowing
+const float SHADOW_NORMAL_OFFSET = 0.02;
+
+void main() {
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    FragPos = vec3(view * model * vec4(aPos, 1.0));
+    Normal = mat3(transpose(inverse(view * model))) * aNorm;
+    TexCoords = aTexCoords;
+    vec3 worldNormal = normalize(mat3(transpose(inverse(model))) * aNorm);
+    ShadowPos = vec3(model * vec4(aPos, 1.0)) + worldNormal * SHADOW_NORMAL_OFFSET;
+    LightmapCoords = aLightmapCoords * lightmapScaleOffset.xy + lightmapScaleOffset.zw;
+}
\ No newline at end of file
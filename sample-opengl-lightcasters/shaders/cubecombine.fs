@@ -41,6 +41,10 @@ out vec4 FragColor;
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
+in vec3 ShadowPos;
+in vec3 WorldNormal;
+// bit i is set when pointLights[i] reaches this object
+flat in int PointLightMask;
 
 uniform Material material;
 uniform DirectionalLight directionalLight;
@@ -48,30 +52,59 @@ uniform DirectionalLight directionalLight;
 uniform PointLight pointLights[NR_POINT_LIGHTS];
 uniform Spotlight spotlight;
 
-vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir);
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 viewDir);
-vec3 CalcSpotlight(Spotlight light, vec3 normal, vec3 viewDir);
+// every shadow map in tiles of one depth atlas, see ShadowAtlas; a tile whose rect is empty casts no shadows
+uniform sampler2DShadow shadowAtlas;
+uniform float shadowTexelSize;
+#define CASCADE_COUNT 3
+uniform mat4 cascadeMatrices[CASCADE_COUNT];
+uniform vec4 cascadeRects[CASCADE_COUNT];
+uniform float cascadeEnds[CASCADE_COUNT];
+uniform mat4 spotShadowMatrix;
+uniform vec4 spotShadowRect;
+// six cube faces per point light: +X, -X, +Y, -Y, +Z, -Z
+uniform mat4 pointShadowMatrices[NR_POINT_LIGHTS * 6];
+uniform vec4 pointShadowRects[NR_POINT_LIGHTS * 6];
+uniform vec3 pointShadowPositions[NR_POINT_LIGHTS];
+
+// irradiance blended from the probe grid at the object, see ProbeGrid; when set it stands in for the lights'
+// flat ambient terms with the bounced light of the static scene
+uniform bool probeLighting;
+uniform vec3 probeIrradiance[9];
+
+vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir, float shadow);
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 viewDir, float shadow);
+vec3 CalcSpotlight(Spotlight light, vec3 normal, vec3 viewDir, float shadow);
+float SampleShadow(mat4 atlasMatrix, vec4 rect);
+float DirectionalShadow();
+float PointShadow(int light);
+vec3 ProbeIrradiance(vec3 normal);
 
 void main() {
     vec3 normal = normalize(Normal);
     vec3 viewDir = normalize(-FragPos);
 
     // set the directional light of the scene
-    vec3 result = CalcDirectionalLight(directionalLight, normal, viewDir);
+    vec3 result = CalcDirectionalLight(directionalLight, normal, viewDir, DirectionalShadow());
 
     // set the point light of the scene
     for (int i = 0; i < NR_POINT_LIGHTS; i++) {
-        result += CalcPointLight(pointLights[i], normal, viewDir);
+        if ((PointLightMask & (1 << i)) != 0) {
+            result += CalcPointLight(pointLights[i], normal, viewDir, PointShadow(i));
+        }
     }
 
     // set the spotlight of the scene
-    result += CalcSpotlight(spotlight, normal, viewDir);
+    result += CalcSpotlight(spotlight, normal, viewDir, SampleShadow(spotShadowMatrix, spotShadowRect));
+
+    if (probeLighting) {
+        result += ProbeIrradiance(normalize(WorldNormal)) * vec3(texture(material.diffuse, TexCoords));
+    }
 
     FragColor = vec4(result, 1.0);
 }
 
-vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir) {
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
+vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir, float shadow) {
+    vec3 ambient = probeLighting ? vec3(0.0) : light.ambient * vec3(texture(material.diffuse, TexCoords));
 
     vec3 lightDir = normalize(-light.direction);
     float diffuseImpact = max(dot(normal, lightDir), 0.0);
@@ -81,11 +114,11 @@ vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir) {
     float specularImpact = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
     vec3 specular = light.specular * specularImpact * vec3(texture(material.specular, TexCoords));
 
-    return ambient + diffuse + specular;
+    return ambient + shadow * (diffuse + specular);
 }
 
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 viewDir) {
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 viewDir, float shadow) {
+    vec3 ambient = probeLighting ? vec3(0.0) : light.ambient * vec3(texture(material.diffuse, TexCoords));
 
     vec3 lightDir = normalize(light.position - FragPos);
     float diffuseImpact = max(dot(normal, lightDir), 0.0);
@@ -102,10 +135,10 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 viewDir) {
     diffuse *= attenuation;
     specular *= attenuation;
 
-    return ambient + diffuse + specular;
+    return ambient + shadow * (diffuse + specular);
 }
 
-vec3 CalcSpotlight(Spotlight light, vec3 normal, vec3 viewDir) {
+vec3 CalcSpotlight(Spotlight light, vec3 normal, vec3 viewDir, float shadow) {
     vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
 
     vec3 lightDir = normalize(-FragPos);
@@ -128,5 +161,63 @@ vec3 CalcSpotlight(Spotlight light, vec3 normal, vec3 viewDir) {
     diffuse *= attenuation;
     specular *= attenuation;
 
-    return ambient + diffuse + specular;
+    return ambient + shadow * (diffuse + specular);
+}
+
+// 1 where lit: nine filtered comparisons, kept inside the tile so none reads a neighbouring one
+float SampleShadow(mat4 atlasMatrix, vec4 rect) {
+    if (rect.z <= rect.x) {
+        return 1.0;
+    }
+    vec4 position = atlasMatrix * vec4(ShadowPos, 1.0);
+    vec3 coords = position.xyz / position.w;
+    if (coords.z >= 1.0) {
+        return 1.0;
+    }
+    float lit = 0.0;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            vec2 uv = clamp(coords.xy + vec2(x, y) * shadowTexelSize, rect.xy, rect.zw);
+            lit += texture(shadowAtlas, vec3(uv, coords.z));
+        }
+    }
+    return lit / 9.0;
+}
+
+float DirectionalShadow() {
+    float depth = -FragPos.z;
+    for (int i = 0; i < CASCADE_COUNT; i++) {
+        if (depth < cascadeEnds[i]) {
+            return SampleShadow(cascadeMatrices[i], cascadeRects[i]);
+        }
+    }
+    return 1.0;
+}
+
+float PointShadow(int light) {
+    vec3 offset = ShadowPos - pointShadowPositions[light];
+    vec3 distance = abs(offset);
+    int face;
+    if (distance.x >= distance.y && distance.x >= distance.z) {
+        face = offset.x > 0.0 ? 0 : 1;
+    } else if (distance.y >= distance.z) {
+        face = offset.y > 0.0 ? 2 : 3;
+    } else {
+        face = offset.z > 0.0 ? 4 : 5;
+    }
+    return SampleShadow(pointShadowMatrices[light * 6 + face], pointShadowRects[light * 6 + face]);
+}
+
+// the nine L2 spherical harmonics, already convolved with the cosine on the CPU
+vec3 ProbeIrradiance(vec3 normal) {
+    vec3 irradiance = probeIrradiance[0] * 0.282095
+                    + probeIrradiance[1] * 0.488603 * normal.y
+                    + probeIrradiance[2] * 0.488603 * normal.z
+                    + probeIrradiance[3] * 0.488603 * normal.x
+                    + probeIrradiance[4] * 1.092548 * normal.x * normal.y
+                    + probeIrradiance[5] * 1.092548 * normal.y * normal.z
+                    + probeIrradiance[6] * 0.315392 * (3.0 * normal.z * normal.z - 1.0)
+                    + probeIrradiance[7] * 1.092548 * normal.x * normal.z
+                    + probeIrradiance[8] * 0.546274 * (normal.x * normal.x - normal.y * normal.y);
+    return max(irradiance, vec3(0.0));
 }
\ No newline at end of file
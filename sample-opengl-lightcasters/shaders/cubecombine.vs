@@ -7,14 +7,28 @@ layout (location = 2) in vec2 aTexCoords;
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
+// world position pushed out along the normal, where the shadow atlas is sampled
+out vec3 ShadowPos;
+// for the irradiance probes, which are in world space
+out vec3 WorldNormal;
+// bit i is set when pointLights[i] reaches this object
+flat out int PointLightMask;
 
 uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
+uniform int pointLightMask;
+
+// world units to push the shadow lookup out of the surface, against self-shadowing
+const float SHADOW_NORMAL_OFFSET = 0.02;
 
 void main() {
     gl_Position = projection * view * model * vec4(aPos, 1.0);
     FragPos = vec3(view * model * vec4(aPos, 1.0));
     Normal = mat3(transpose(inverse(view * model))) * aNorm;
     TexCoords = aTexCoords;
+    vec3 worldNormal = normalize(mat3(transpose(inverse(model))) * aNorm);
+    WorldNormal = worldNormal;
+    ShadowPos = vec3(model * vec4(aPos, 1.0)) + worldNormal * SHADOW_NORMAL_OFFSET;
+    PointLightMask = pointLightMask;
 }
\ No newline at end of file
@@ -0,0 +1,47 @@
+#version 430 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNorm;
+layout (location = 2) in vec2 aTexCoords;
+// advances once per instance, so the draw command's base instance picks the object
+layout (location = 3) in uint aObjectId;
+
+struct Object {
+    mat4 model;
+    vec4 boundsMin;
+    vec4 boundsMax;
+    uvec4 extra;
+};
+
+layout (std430, binding = 0) readonly buffer Objects {
+    Object objects[];
+};
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+// world position pushed out along the normal, where the shadow atlas is sampled
+out vec3 ShadowPos;
+// for the irradiance probes, which are in world space
+out vec3 WorldNormal;
+// bit i is set when pointLights[i] reaches this object
+flat out int PointLightMask;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+// world units to push the shadow lookup out of the surface, against self-shadowing
+const float SHADOW_NORMAL_OFFSET = 0.02;
+
+void main() {
+    Object object = objects[aObjectId];
+    mat4 viewModel = view * object.model;
+    gl_Position = projection * viewModel * vec4(aPos, 1.0);
+    FragPos = vec3(viewModel * vec4(aPos, 1.0));
+    Normal = mat3(transpose(inverse(viewModel))) * aNorm;
+    TexCoords = aTexCoords;
+    vec3 worldNormal = normalize(mat3(transpose(inverse(object.model))) * aNorm);
+    WorldNormal = worldNormal;
+    ShadowPos = vec3(object.model * vec4(aPos, 1.0)) + worldNormal * SHADOW_NORMAL_OFFSET;
+    PointLightMask = int(object.extra.x);
+}
\ No newline at end of file
@@ -0,0 +1,131 @@
+#version 330 core
+
+// FXAA after the quality variant of Timothy Lottes' FXAA 3.11: finds the pixels on a luma edge, walks along the edge
+// both ways to its ends, and blends each pixel with its neighbour across the edge by how close it is to the end
+// the edge steps at, which smooths the staircase a pixel wide edge is drawn as.
+in vec2 TexCoords;
+
+out vec4 FragColor;
+
+uniform sampler2D source;
+uniform vec2 texelSize;
+
+// local contrast below max(EDGE_THRESHOLD_MIN, EDGE_THRESHOLD * brightest neighbour) is left alone
+const float EDGE_THRESHOLD = 0.125;
+const float EDGE_THRESHOLD_MIN = 0.0312;
+// how much of the sub-pixel aliasing, single pixel features, to take out
+const float SUBPIXEL_QUALITY = 0.75;
+// steps of the search along the edge, growing so long edges are still found cheaply
+const int SEARCH_STEPS = 12;
+const float SEARCH_STEP[12] = float[](1.0, 1.0, 1.0, 1.0, 1.0, 1.5, 2.0, 2.0, 2.0, 2.0, 4.0, 8.0);
+
+float luma(vec3 color) {
+    // perceived brightness, roughly gamma corrected
+    return sqrt(dot(color, vec3(0.299, 0.587, 0.114)));
+}
+
+float lumaAt(vec2 coords) {
+    return luma(textureLod(source, coords, 0.0).rgb);
+}
+
+void main() {
+    vec3 center = textureLod(source, TexCoords, 0.0).rgb;
+    float lumaCenter = luma(center);
+    float lumaDown = lumaAt(TexCoords + vec2(0.0, -texelSize.y));
+    float lumaUp = lumaAt(TexCoords + vec2(0.0, texelSize.y));
+    float lumaLeft = lumaAt(TexCoords + vec2(-texelSize.x, 0.0));
+    float lumaRight = lumaAt(TexCoords + vec2(texelSize.x, 0.0));
+
+    float lumaMin = min(lumaCenter, min(min(lumaDown, lumaUp), min(lumaLeft, lumaRight)));
+    float lumaMax = max(lumaCenter, max(max(lumaDown, lumaUp), max(lumaLeft, lumaRight)));
+    float range = lumaMax - lumaMin;
+    if (range < max(EDGE_THRESHOLD_MIN, lumaMax * EDGE_THRESHOLD)) {
+        FragColor = vec4(center, 1.0);
+        return;
+    }
+
+    float lumaDownLeft = lumaAt(TexCoords - texelSize);
+    float lumaUpRight = lumaAt(TexCoords + texelSize);
+    float lumaUpLeft = lumaAt(TexCoords + vec2(-texelSize.x, texelSize.y));
+    float lumaDownRight = lumaAt(TexCoords + vec2(texelSize.x, -texelSize.y));
+
+    // which way the edge runs, from the second derivatives across rows and columns
+    float lumaDownUp = lumaDown + lumaUp;
+    float lumaLeftRight = lumaLeft + lumaRight;
+    float lumaLeftCorners = lumaDownLeft + lumaUpLeft;
+    float lumaDownCorners = lumaDownLeft + lumaDownRight;
+    float lumaRightCorners = lumaDownRight + lumaUpRight;
+    float lumaUpCorners = lumaUpRight + lumaUpLeft;
+    float edgeHorizontal = abs(-2.0 * lumaLeft + lumaLeftCorners) + abs(-2.0 * lumaCenter + lumaDownUp) * 2.0 + abs(-2.0 * lumaRight + lumaRightCorners);
+    float edgeVertical = abs(-2.0 * lumaUp + lumaUpCorners) + abs(-2.0 * lumaCenter + lumaLeftRight) * 2.0 + abs(-2.0 * lumaDown + lumaDownCorners);
+    bool horizontal = edgeHorizontal >= edgeVertical;
+
+    // which side of this pixel the edge lies on: towards the steeper neighbour
+    float luma1 = horizontal ? lumaDown : lumaLeft;
+    float luma2 = horizontal ? lumaUp : lumaRight;
+    float gradient1 = luma1 - lumaCenter;
+    float gradient2 = luma2 - lumaCenter;
+    bool steepest1 = abs(gradient1) >= abs(gradient2);
+    float gradientScaled = 0.25 * max(abs(gradient1), abs(gradient2));
+    float stepLength = horizontal ? texelSize.y : texelSize.x;
+    float lumaLocalAverage;
+    if (steepest1) {
+        stepLength = -stepLength;
+        lumaLocalAverage = 0.5 * (luma1 + lumaCenter);
+    } else {
+        lumaLocalAverage = 0.5 * (luma2 + lumaCenter);
+    }
+
+    // walk along the edge, half a pixel off the center onto it, until the luma no longer matches the edge's
+    vec2 edgeCoords = TexCoords;
+    if (horizontal) {
+        edgeCoords.y += stepLength * 0.5;
+    } else {
+        edgeCoords.x += stepLength * 0.5;
+    }
+    vec2 offset = horizontal ? vec2(texelSize.x, 0.0) : vec2(0.0, texelSize.y);
+    vec2 coords1 = edgeCoords - offset;
+    vec2 coords2 = edgeCoords + offset;
+    float lumaEnd1 = lumaAt(coords1) - lumaLocalAverage;
+    float lumaEnd2 = lumaAt(coords2) - lumaLocalAverage;
+    bool reached1 = abs(lumaEnd1) >= gradientScaled;
+    bool reached2 = abs(lumaEnd2) >= gradientScaled;
+    for (int i = 1; i < SEARCH_STEPS && !(reached1 && reached2); i++) {
+        if (!reached1) {
+            coords1 -= offset * SEARCH_STEP[i];
+            lumaEnd1 = lumaAt(coords1) - lumaLocalAverage;
+            reached1 = abs(lumaEnd1) >= gradientScaled;
+        }
+        if (!reached2) {
+            coords2 += offset * SEARCH_STEP[i];
+            lumaEnd2 = lumaAt(coords2) - lumaLocalAverage;
+            reached2 = abs(lumaEnd2) >= gradientScaled;
+        }
+    }
+
+    // only the end nearer to this pixel counts, and only if the luma there changes the way it does here, i.e. the
+    // pixel is on the side of the step that gets blended
+    float distance1 = horizontal ? TexCoords.x - coords1.x : TexCoords.y - coords1.y;
+    float distance2 = horizontal ? coords2.x - TexCoords.x : coords2.y - TexCoords.y;
+    bool nearer1 = distance1 < distance2;
+    float distanceFinal = min(distance1, distance2);
+    float edgeLength = distance1 + distance2;
+    bool centerSmaller = lumaCenter - lumaLocalAverage < 0.0;
+    bool correctVariation = ((nearer1 ? lumaEnd1 : lumaEnd2) < 0.0) != centerSmaller;
+    float pixelOffset = correctVariation ? 0.5 - distanceFinal / edgeLength : 0.0;
+
+    // sub-pixel aliasing: how much this pixel stands out against the average of its 3x3 neighbourhood
+    float lumaAverage = (1.0 / 12.0) * (2.0 * (lumaDownUp + lumaLeftRight) + lumaLeftCorners + lumaRightCorners);
+    float subPixelOffset1 = clamp(abs(lumaAverage - lumaCenter) / range, 0.0, 1.0);
+    float subPixelOffset2 = (-2.0 * subPixelOffset1 + 3.0) * subPixelOffset1 * subPixelOffset1;
+    float subPixelOffset = subPixelOffset2 * subPixelOffset2 * SUBPIXEL_QUALITY;
+    pixelOffset = max(pixelOffset, subPixelOffset);
+
+    vec2 finalCoords = TexCoords;
+    if (horizontal) {
+        finalCoords.y += pixelOffset * stepLength;
+    } else {
+        finalCoords.x += pixelOffset * stepLength;
+    }
+    FragColor = vec4(textureLod(source, finalCoords, 0.0).rgb, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+#version 330 core
+
+in vec2 TexCoords;
+in vec4 Color;
+
+out vec4 FragColor;
+
+uniform sampler2D font;
+
+void main() {
+    // solid quads have negative texture coordinates
+    float coverage = TexCoords.x < 0.0 ? 1.0 : texture(font, TexCoords).r;
+    FragColor = vec4(Color.rgb, Color.a * coverage);
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+#version 330 core
+
+in vec2 TexCoords;
+
+out vec4 FragColor;
+
+// this frame at its render size, in the lower-left corner of the dynamic resolution target
+uniform sampler2D current;
+uniform sampler2D velocity;
+uniform sampler2D depth;
+// the accumulated frames at the output size
+uniform sampler2D history;
+uniform vec2 renderSize;
+// sub-pixel offset the frame was rendered with, in render pixels
+uniform vec2 jitter;
+uniform bool hasHistory;
+uniform mat4 currentToPrevious;
+
+// share of the current frame in the blend when its sample is right on the output pixel and when it is far off; a
+// slower blend keeps more of the history, which has been resampled once for every frame it lived through
+const float BLEND_NEAR = 0.4;
+const float BLEND_FAR = 0.1;
+// the history is clipped to this many standard deviations around the neighbourhood's mean
+const float GAMMA = 1.25;
+
+// Catmull-Rom read of the history out of nine bilinear taps; a plain bilinear read would blur it a little more
+// every frame it is reprojected
+vec3 sampleHistory(vec2 coords) {
+    vec2 size = vec2(textureSize(history, 0));
+    vec2 position = coords * size;
+    vec2 center = floor(position - 0.5) + 0.5;
+    vec2 f = position - center;
+    vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+    vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+    vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+    vec2 w3 = f * f * (-0.5 + 0.5 * f);
+    vec2 w12 = w1 + w2;
+    vec2 tc0 = (center - 1.0) / size;
+    vec2 tc12 = (center + w2 / w12) / size;
+    vec2 tc3 = (center + 2.0) / size;
+    vec3 result = texture(history, vec2(tc12.x, tc0.y)).rgb * w12.x * w0.y
+                + texture(history, vec2(tc0.x, tc12.y)).rgb * w0.x * w12.y
+                + texture(history, vec2(tc12.x, tc12.y)).rgb * w12.x * w12.y
+                + texture(history, vec2(tc3.x, tc12.y)).rgb * w3.x * w12.y
+                + texture(history, vec2(tc12.x, tc3.y)).rgb * w12.x * w3.y
+                + texture(history, vec2(tc0.x, tc0.y)).rgb * w0.x * w0.y
+                + texture(history, vec2(tc3.x, tc0.y)).rgb * w3.x * w0.y
+                + texture(history, vec2(tc0.x, tc3.y)).rgb * w0.x * w3.y
+                + texture(history, vec2(tc3.x, tc3.y)).rgb * w3.x * w3.y;
+    return max(result, vec3(0.0));
+}
+
+void main() {
+    // the rendered sample nearest to this output pixel; the jitter moved the image by its offset
+    vec2 position = TexCoords * renderSize;
+    ivec2 last = ivec2(renderSize) - 1;
+    ivec2 texel = clamp(ivec2(floor(position + jitter)), ivec2(0), last);
+    vec3 color = texelFetch(current, texel, 0).rgb;
+
+    // range and spread of the neighbourhood for clamping the history, and the closest surface in it, whose motion
+    // is used so edges of moving objects drag their history along
+    vec3 low = color;
+    vec3 high = color;
+    vec3 sum = vec3(0.0);
+    vec3 sumSquares = vec3(0.0);
+    float closest = 1.0;
+    ivec2 closestTexel = texel;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            ivec2 neighbour = clamp(texel + ivec2(x, y), ivec2(0), last);
+            vec3 sampled = texelFetch(current, neighbour, 0).rgb;
+            low = min(low, sampled);
+            high = max(high, sampled);
+            sum += sampled;
+            sumSquares += sampled * sampled;
+            float sampledDepth = texelFetch(depth, neighbour, 0).r;
+            if (sampledDepth < closest) {
+                closest = sampledDepth;
+                closestTexel = neighbour;
+            }
+        }
+    }
+
+    vec2 motion;
+    if (closest < 1.0) {
+        motion = texelFetch(velocity, closestTexel, 0).xy;
+    } else {
+        // nothing drawn here, so only the camera moved it
+        vec4 previous = currentToPrevious * vec4(TexCoords * 2.0 - 1.0, 1.0, 1.0);
+        motion = TexCoords - (previous.xy / previous.w * 0.5 + 0.5);
+    }
+    vec2 previousCoords = TexCoords - motion;
+
+    if (!hasHistory || any(lessThan(previousCoords, vec2(0.0))) || any(greaterThan(previousCoords, vec2(1.0)))) {
+        // nothing to accumulate with yet, a filtered read of the current frame is the best guess
+        vec2 coords = (position + jitter) / vec2(textureSize(current, 0));
+        FragColor = vec4(texture(current, coords).rgb, 1.0);
+        return;
+    }
+
+    // the min-max box alone lets through whatever lies between the two sides of an edge
+    vec3 mean = sum / 9.0;
+    vec3 deviation = sqrt(max(sumSquares / 9.0 - mean * mean, vec3(0.0)));
+    vec3 accumulated = clamp(sampleHistory(previousCoords), max(low, mean - GAMMA * deviation), min(high, mean + GAMMA * deviation));
+    vec2 offset = vec2(texel) + 0.5 - jitter - position;
+    float blend = mix(BLEND_FAR, BLEND_NEAR, exp(-2.29 * dot(offset, offset)));
+    FragColor = vec4(mix(accumulated, color, blend), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,11 @@
+#version 330 core
+
+in vec4 CurrentPosition;
+in vec4 PreviousPosition;
+
+// how far the surface moved on screen since the previous frame, in texture coordinates
+out vec2 Velocity;
+
+void main() {
+    Velocity = (CurrentPosition.xy / CurrentPosition.w - PreviousPosition.xy / PreviousPosition.w) * 0.5;
+}
\ No newline at end of file
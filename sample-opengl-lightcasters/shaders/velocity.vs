@@ -0,0 +1,21 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+
+out vec4 CurrentPosition;
+out vec4 PreviousPosition;
+
+// the same expression as the lighting shaders, so the depth matches what they wrote
+uniform mat4 projection;
+uniform mat4 view;
+uniform mat4 model;
+// without the jitter, which must not show up as motion
+uniform mat4 viewProjection;
+uniform mat4 previousViewProjection;
+uniform mat4 previousModel;
+
+void main() {
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    CurrentPosition = viewProjection * model * vec4(aPos, 1.0);
+    PreviousPosition = previousViewProjection * previousModel * vec4(aPos, 1.0);
+}
\ No newline at end of file
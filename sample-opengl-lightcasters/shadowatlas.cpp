@@ -0,0 +1,438 @@
+#include "shadowatlas.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+using std::string;
+using std::to_string;
+using std::vector;
+
+namespace {
+    // how far behind a cascade's sphere, towards the light, casters are still caught
+    float const CASCADE_CASTER_MARGIN = 50.0f;
+    float const POINT_NEAR = 0.05f;
+    // a tile shrinks only once its light needs less than this fraction of its size, so it does not flicker
+    float const SHRINK_THRESHOLD = 0.4f;
+
+    // +X, -X, +Y, -Y, +Z, -Z, as cubecombine.fs picks the face by the major axis
+    glm::vec3 const FACE_DIRECTIONS[6] = { { 1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f },
+                                           { 0.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f } };
+    glm::vec3 const FACE_UPS[6] = { { 0.0f, -1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f },
+                                    { 0.0f, 0.0f, -1.0f }, { 0.0f, -1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f } };
+
+    bool intersects(Frustum const &frustum, AABB const &box) {
+        glm::vec3 center = (box.Min + box.Max) * 0.5f;
+        glm::vec3 extent = (box.Max - box.Min) * 0.5f;
+        for (auto const &plane : frustum.Planes) {
+            if (glm::dot(glm::vec3 { plane }, center) + plane.w + glm::dot(glm::abs(glm::vec3 { plane }), extent) < 0.0f) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    glm::vec3 upFor(glm::vec3 const &direction) {
+        return std::abs(direction.y) > 0.99f ? glm::vec3 { 1.0f, 0.0f, 0.0f } : glm::vec3 { 0.0f, 1.0f, 0.0f };
+    }
+
+    // even bits to x, odd bits to y
+    glm::uvec2 mortonDecode(unsigned int code) {
+        glm::uvec2 position { 0 };
+        for (unsigned int bit = 0; bit < 16; bit++) {
+            position.x |= ((code >> (2 * bit)) & 1u) << bit;
+            position.y |= ((code >> (2 * bit + 1)) & 1u) << bit;
+        }
+        return position;
+    }
+}
+
+ShadowAtlas::ShadowAtlas() : ShadowAtlas(Settings {}) {}
+
+ShadowAtlas::ShadowAtlas(Settings const &settings) :
+    settings(settings), directionalDirection(0.0f, -1.0f, 0.0f), spotPosition(0.0f), spotDirection(0.0f, 0.0f, -1.0f), spotOuterCutOff(0.0f),
+    spotRange(0.0f), hasSpot(false), cascadeEnds {} {
+    staticTexture = createDepthTexture(false);
+    texture = createDepthTexture(true);
+    for (auto [target, attachment] : { std::pair { &staticFramebuffer, staticTexture }, std::pair { &framebuffer, texture } }) {
+        glGenFramebuffers(1, target);
+        glBindFramebuffer(GL_FRAMEBUFFER, *target);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, attachment, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cout << "Shadow atlas framebuffer is incomplete" << std::endl;
+        }
+        // nothing is cached yet, and unwritten texels should not shadow anything
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    depthShader = std::make_unique<Shader>("./shaders/shadowdepth.vs", "./shaders/shadowdepth.fs");
+
+    for (unsigned int i = 0; i < CASCADE_COUNT; i++) {
+        tiles.push_back(Tile { CASCADE, i });
+    }
+    tiles.push_back(Tile { SPOT, 0 });
+    for (unsigned int light = 0; light < MAX_POINT_LIGHTS; light++) {
+        for (unsigned int face = 0; face < 6; face++) {
+            tiles.push_back(Tile { POINT_FACE, light });
+        }
+    }
+}
+
+ShadowAtlas::~ShadowAtlas() {
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteFramebuffers(1, &staticFramebuffer);
+    glDeleteTextures(1, &texture);
+    glDeleteTextures(1, &staticTexture);
+}
+
+GLuint ShadowAtlas::createDepthTexture(bool compare) const {
+    GLuint id;
+    glGenTextures(1, &id);
+    glBindTexture(GL_TEXTURE_2D, id);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, settings.AtlasSize, settings.AtlasSize, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    if (compare) {
+        // sampler2DShadow: every lookup returns the 2x2 bilinear-filtered comparison result
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    } else {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return id;
+}
+
+void ShadowAtlas::SetSpotlight(glm::vec3 const &position, glm::vec3 const &direction, float outerCutOff, float range) {
+    spotPosition = position;
+    spotDirection = glm::normalize(direction);
+    spotOuterCutOff = outerCutOff;
+    spotRange = range;
+    hasSpot = true;
+}
+
+void ShadowAtlas::SetPointLights(glm::vec3 const *positions, unsigned int count, float range) {
+    pointLights.clear();
+    for (unsigned int i = 0; i < std::min(count, MAX_POINT_LIGHTS); i++) {
+        pointLights.push_back(PointLight { positions[i], range });
+    }
+}
+
+void ShadowAtlas::InvalidateStatic(AABB const &bounds) {
+    for (auto &tile : tiles) {
+        if (tile.HasStatic && intersects(Frustum::FromMatrix(tile.RenderedViewProjection), bounds)) {
+            tile.StaticDirty = true;
+        }
+    }
+}
+
+void ShadowAtlas::updateImportance(glm::mat4 const &view, glm::mat4 const &projection, float fov) {
+    Frustum frustum = Frustum::FromMatrix(projection * view);
+    // fraction of the screen height a sphere covers, 0 when it is off screen
+    auto screenSize = [&](glm::vec3 const &center, float radius) {
+        for (auto const &plane : frustum.Planes) {
+            if (glm::dot(glm::vec3 { plane }, center) + plane.w < -radius) {
+                return 0.0f;
+            }
+        }
+        float distance = glm::length(glm::vec3 { view * glm::vec4 { center, 1.0f } });
+        if (distance <= radius) {
+            return 1.0f;
+        }
+        return std::min(1.0f, radius / (distance * std::tan(fov * 0.5f)));
+    };
+
+    for (auto &tile : tiles) {
+        if (tile.Kind == SPOT) {
+            // a sphere around the whole cone
+            float radius = spotRange * std::max(0.5f, std::sqrt(std::max(0.0f, 1.25f - spotOuterCutOff)));
+            tile.Importance = hasSpot ? screenSize(spotPosition + spotDirection * spotRange * 0.5f, radius) : 0.0f;
+            tile.Active = tile.Importance > 0.0f;
+            float coneAngle = 2.0f * std::acos(glm::clamp(spotOuterCutOff, 0.0f, 1.0f));
+            glm::mat4 projection = glm::perspective(std::min(coneAngle * 1.1f, glm::radians(170.0f)), 1.0f, POINT_NEAR, std::max(spotRange, 1.0f));
+            tile.ViewProjection = projection * glm::lookAt(spotPosition, spotPosition + spotDirection, upFor(spotDirection));
+        } else if (tile.Kind == POINT_FACE) {
+            if (tile.Light >= pointLights.size()) {
+                tile.Active = false;
+                tile.Importance = 0.0f;
+                continue;
+            }
+            PointLight const &light = pointLights[tile.Light];
+            tile.Importance = screenSize(light.Position, light.Range);
+            tile.Active = tile.Importance > 0.0f;
+            unsigned int face = static_cast<unsigned int>(&tile - &tiles[CASCADE_COUNT + 1]) % 6;
+            glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, POINT_NEAR, light.Range);
+            tile.ViewProjection = projection * glm::lookAt(light.Position, light.Position + FACE_DIRECTIONS[face], FACE_UPS[face]);
+        } else {
+            // nearer cascades cover less ground at the same resolution, so they win ties
+            tile.Active = true;
+            tile.Importance = 1.0f - 0.01f * tile.Light;
+        }
+    }
+}
+
+bool ShadowAtlas::updateSizes() {
+    vector<unsigned int> sizes;
+    for (auto const &tile : tiles) {
+        unsigned int maxSize = tile.Kind == CASCADE ? settings.CascadeSize : tile.Kind == SPOT ? settings.MaxSpotSize : settings.MaxPointFaceSize;
+        maxSize = std::max(maxSize, settings.MinTileSize);
+        float wanted = tile.Importance * maxSize;
+        unsigned int size = tile.Size ? tile.Size : settings.MinTileSize;
+        if (tile.Kind == CASCADE) {
+            size = maxSize;
+        } else if (tile.Active) {
+            while (size < maxSize && wanted >= size * 2.0f) {
+                size *= 2;
+            }
+            while (size > settings.MinTileSize && wanted < size * SHRINK_THRESHOLD) {
+                size /= 2;
+            }
+        }
+        // an inactive tile keeps its size, so it keeps its cached depth for when its light comes back into view
+        sizes.push_back(size);
+    }
+
+    // halve the least important tiles until everything fits
+    auto area = [](vector<unsigned int> const &sizes) {
+        unsigned long long total = 0;
+        for (unsigned int size : sizes) {
+            total += static_cast<unsigned long long>(size) * size;
+        }
+        return total;
+    };
+    unsigned long long atlasArea = static_cast<unsigned long long>(settings.AtlasSize) * settings.AtlasSize;
+    while (area(sizes) > atlasArea) {
+        int smallest = -1;
+        for (unsigned int i = 0; i < tiles.size(); i++) {
+            if (sizes[i] > settings.MinTileSize && (smallest < 0 || tiles[i].Importance < tiles[smallest].Importance ||
+                                                   (tiles[i].Importance == tiles[smallest].Importance && sizes[i] > sizes[smallest]))) {
+                smallest = static_cast<int>(i);
+            }
+        }
+        if (smallest < 0) {
+            break;
+        }
+        sizes[smallest] /= 2;
+    }
+
+    bool changed = false;
+    for (unsigned int i = 0; i < tiles.size(); i++) {
+        changed = changed || sizes[i] != tiles[i].Size;
+    }
+    if (!changed) {
+        return false;
+    }
+
+    // largest first, each tile starts on a multiple of its own area in Morton order, so it is an aligned square
+    vector<unsigned int> order(tiles.size());
+    for (unsigned int i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return sizes[a] > sizes[b]; });
+    unsigned int cell = 0;
+    for (unsigned int i : order) {
+        unsigned int side = sizes[i] / settings.MinTileSize;
+        glm::uvec2 origin = mortonDecode(cell) * settings.MinTileSize;
+        cell += side * side;
+        if (origin.x + sizes[i] > settings.AtlasSize || origin.y + sizes[i] > settings.AtlasSize) {
+            // only when even the minimum sizes do not fit; the tile goes unshadowed
+            sizes[i] = 0;
+        }
+        if (origin != tiles[i].Origin || sizes[i] != tiles[i].Size) {
+            tiles[i].HasStatic = false;
+            tiles[i].StaticDirty = true;
+            tiles[i].HadDynamic = false;
+        }
+        tiles[i].Origin = origin;
+        tiles[i].Size = sizes[i];
+    }
+    return true;
+}
+
+void ShadowAtlas::updateCascades(glm::mat4 const &view, float fov, float aspect, float near) {
+    glm::mat4 inverseView = glm::inverse(view);
+    glm::mat4 lightRotation = glm::lookAt(glm::vec3 { 0.0f }, directionalDirection, upFor(directionalDirection));
+    float far = settings.ShadowDistance;
+    float tanY = std::tan(fov * 0.5f);
+    float tanX = tanY * aspect;
+    float start = near;
+    for (unsigned int i = 0; i < CASCADE_COUNT; i++) {
+        float fraction = static_cast<float>(i + 1) / CASCADE_COUNT;
+        float end = glm::mix(near + (far - near) * fraction, near * std::pow(far / near, fraction), settings.CascadeSplitBlend);
+        cascadeEnds[i] = end;
+
+        // a sphere around the slice, centered on the view axis, keeps its size however the camera turns
+        float centerDepth = (start + end) * 0.5f;
+        float radius = std::max(glm::length(glm::vec3 { tanX * start, tanY * start, start - centerDepth }),
+                                glm::length(glm::vec3 { tanX * end, tanY * end, end - centerDepth }));
+        glm::vec3 center { inverseView * glm::vec4 { 0.0f, 0.0f, -centerDepth, 1.0f } };
+
+        // move the projection in whole texels only, so a camera that moves less than a texel keeps the cache
+        Tile &tile = tiles[i];
+        float texel = 2.0f * radius / std::max(tile.Size, 1u);
+        glm::vec3 lightCenter = glm::floor(glm::vec3 { lightRotation * glm::vec4 { center, 1.0f } } / texel) * texel;
+        glm::mat4 projection = glm::ortho(lightCenter.x - radius, lightCenter.x + radius, lightCenter.y - radius, lightCenter.y + radius,
+                                          -lightCenter.z - radius - CASCADE_CASTER_MARGIN, -lightCenter.z + radius);
+        tile.ViewProjection = projection * lightRotation;
+        start = end;
+    }
+}
+
+void ShadowAtlas::renderTile(Tile const &tile, bool dynamicCasters, DrawCasters const &draw) {
+    glm::mat4 const &viewProjection = dynamicCasters ? tile.RenderedViewProjection : tile.ViewProjection;
+    glViewport(tile.Origin.x, tile.Origin.y, tile.Size, tile.Size);
+    glScissor(tile.Origin.x, tile.Origin.y, tile.Size, tile.Size);
+    glEnable(GL_SCISSOR_TEST);
+    if (!dynamicCasters) {
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+    depthShader->SetFloatMatrix("lightViewProjection", viewProjection);
+    draw(*depthShader, Frustum::FromMatrix(viewProjection), dynamicCasters);
+    glDisable(GL_SCISSOR_TEST);
+}
+
+ShadowAtlas::Stats ShadowAtlas::Update(glm::mat4 const &view, glm::mat4 const &projection, float fov, float aspect, float near,
+                                       DrawCasters const &draw) {
+    Stats stats;
+    updateImportance(view, projection, fov);
+    stats.Repacks = updateSizes() ? 1 : 0;
+    updateCascades(view, fov, aspect, near);
+
+    // tiles without any cached depth first, then the most important stale ones
+    vector<unsigned int> pending;
+    for (unsigned int i = 0; i < tiles.size(); i++) {
+        Tile &tile = tiles[i];
+        if (tile.Size > 0 && tile.Active && (tile.StaticDirty || !tile.HasStatic || tile.ViewProjection != tile.RenderedViewProjection)) {
+            pending.push_back(i);
+        }
+    }
+    std::stable_sort(pending.begin(), pending.end(), [&](unsigned int a, unsigned int b) {
+        if (tiles[a].HasStatic != tiles[b].HasStatic) {
+            return !tiles[a].HasStatic;
+        }
+        return tiles[a].Importance > tiles[b].Importance;
+    });
+
+    GLint viewport[4];
+    GLint previousFramebuffer;
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glEnable(GL_DEPTH_TEST);
+    // slope-scaled bias against acne; cubecombine.fs adds a small offset along the normal for the rest
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
+    depthShader->Use();
+
+    vector<bool> refreshed(tiles.size(), false);
+    glBindFramebuffer(GL_FRAMEBUFFER, staticFramebuffer);
+    for (unsigned int i : pending) {
+        Tile &tile = tiles[i];
+        unsigned int texels = tile.Size * tile.Size;
+        // the first tile always goes, so a budget smaller than a tile cannot stall everything
+        if (stats.StaticTiles > 0 && stats.StaticTexels + texels > settings.StaticTexelBudget) {
+            stats.DeferredTiles++;
+            continue;
+        }
+        renderTile(tile, false, draw);
+        tile.RenderedViewProjection = tile.ViewProjection;
+        tile.HasStatic = true;
+        tile.StaticDirty = false;
+        refreshed[i] = true;
+        stats.StaticTiles++;
+        stats.StaticTexels += texels;
+    }
+
+    // copy the cached depth of every tile that changed or has dynamic casters, new or gone, and draw those on top
+    for (unsigned int i = 0; i < tiles.size(); i++) {
+        Tile &tile = tiles[i];
+        if (!tile.HasStatic) {
+            continue;
+        }
+        bool overlapped = false;
+        if (tile.Active) {
+            Frustum frustum = Frustum::FromMatrix(tile.RenderedViewProjection);
+            for (auto const &caster : dynamicCasters) {
+                if (intersects(frustum, caster)) {
+                    overlapped = true;
+                    break;
+                }
+            }
+        }
+        if (!refreshed[i] && !overlapped && !tile.HadDynamic) {
+            continue;
+        }
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, staticFramebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+        GLint x0 = tile.Origin.x, y0 = tile.Origin.y, x1 = x0 + tile.Size, y1 = y0 + tile.Size;
+        glBlitFramebuffer(x0, y0, x1, y1, x0, y0, x1, y1, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        if (overlapped) {
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            renderTile(tile, true, draw);
+            stats.DynamicTiles++;
+        }
+        tile.HadDynamic = overlapped;
+    }
+
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    return stats;
+}
+
+glm::vec4 ShadowAtlas::tileRect(Tile const &tile) const {
+    // an empty rectangle tells the shader to leave the light unshadowed
+    if (!tile.HasStatic || !tile.Active) {
+        return glm::vec4 { 0.0f };
+    }
+    // half a texel in, so filtered lookups never read a neighbouring tile
+    glm::vec2 min = (glm::vec2 { tile.Origin } + 0.5f) / static_cast<float>(settings.AtlasSize);
+    glm::vec2 max = (glm::vec2 { tile.Origin } + static_cast<float>(tile.Size) - 0.5f) / static_cast<float>(settings.AtlasSize);
+    return glm::vec4 { min, max };
+}
+
+glm::mat4 ShadowAtlas::atlasMatrix(Tile const &tile) const {
+    // clip space to the tile's texture coordinates, and depth from [-1, 1] to [0, 1]
+    float scale = static_cast<float>(tile.Size) / settings.AtlasSize;
+    glm::vec2 offset = glm::vec2 { tile.Origin } / static_cast<float>(settings.AtlasSize);
+    glm::mat4 bias { 1.0f };
+    bias[0][0] = 0.5f * scale;
+    bias[1][1] = 0.5f * scale;
+    bias[2][2] = 0.5f;
+    bias[3] = glm::vec4 { offset + 0.5f * scale, 0.5f, 1.0f };
+    return bias * tile.RenderedViewProjection;
+}
+
+void ShadowAtlas::Bind(Shader const &shader, unsigned int textureUnit) const {
+    glActiveTexture(GL_TEXTURE0 + textureUnit);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glActiveTexture(GL_TEXTURE0);
+    shader.SetInt("shadowAtlas", static_cast<int>(textureUnit));
+    shader.SetFloat("shadowTexelSize", 1.0f / settings.AtlasSize);
+    for (unsigned int i = 0; i < tiles.size(); i++) {
+        Tile const &tile = tiles[i];
+        if (tile.Kind == CASCADE) {
+            string index = "[" + to_string(tile.Light) + "]";
+            shader.SetFloatMatrix("cascadeMatrices" + index, atlasMatrix(tile));
+            shader.SetFloatVec4("cascadeRects" + index, tileRect(tile));
+            shader.SetFloat("cascadeEnds" + index, cascadeEnds[tile.Light]);
+        } else if (tile.Kind == SPOT) {
+            shader.SetFloatMatrix("spotShadowMatrix", atlasMatrix(tile));
+            shader.SetFloatVec4("spotShadowRect", tileRect(tile));
+        } else {
+            string index = "[" + to_string(i - CASCADE_COUNT - 1) + "]";
+            shader.SetFloatMatrix("pointShadowMatrices" + index, atlasMatrix(tile));
+            shader.SetFloatVec4("pointShadowRects" + index, tileRect(tile));
+        }
+    }
+    for (unsigned int i = 0; i < pointLights.size(); i++) {
+        shader.SetFloatVec3("pointShadowPositions[" + to_string(i) + "]", pointLights[i].Position);
+    }
+}
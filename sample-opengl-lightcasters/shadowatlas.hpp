@@ -0,0 +1,111 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "culling.hpp"
+#include "shader.h"
+
+// Every shadow map of the scene packed into tiles of one depth texture: CASCADE_COUNT cascades for the directional
+// light, one tile for the spotlight and six cube-face tiles per point light.
+//
+// Static casters are rendered into a second, cached atlas and only redrawn when their tile's light transform
+// changes (the light moved, or a cascade followed the camera by a texel), a static caster inside the tile was
+// invalidated or the tile was resized or moved. Each frame the tiles that a dynamic caster overlaps, now or last
+// frame, copy their cached depth into the sampled atlas and draw the dynamic casters on top.
+//
+// Tile resolutions follow the screen-space size of the light's volume, in powers of two between the minimum
+// tile size and the light's maximum, and are packed in Morton order, largest first, which never leaves gaps.
+// Static redraws are capped by a texel budget per frame, most important first; a tile over the budget keeps its
+// stale shadows, or reads as unshadowed if it has none yet.
+class ShadowAtlas {
+    public:
+        static constexpr unsigned int CASCADE_COUNT = 3;
+        static constexpr unsigned int MAX_POINT_LIGHTS = 4;
+        // draws the static or the dynamic casters with the depth shader, skipping those outside the tile's frustum
+        using DrawCasters = std::function<void(Shader const &depthShader, Frustum const &frustum, bool dynamicCasters)>;
+
+        struct Settings {
+            unsigned int AtlasSize = 2048;
+            unsigned int MinTileSize = 64;
+            unsigned int CascadeSize = 512;
+            unsigned int MaxSpotSize = 1024;
+            unsigned int MaxPointFaceSize = 256;
+            float ShadowDistance = 30.0f; // the last cascade ends here
+            float CascadeSplitBlend = 0.75f; // 0: uniform splits, 1: logarithmic
+            unsigned int StaticTexelBudget = 1024 * 1024; // static texels redrawn per frame
+        };
+        struct Stats {
+            unsigned int StaticTiles = 0; // tiles whose cached static depth was redrawn
+            unsigned int StaticTexels = 0;
+            unsigned int DeferredTiles = 0; // needed a static redraw but did not fit in the budget
+            unsigned int DynamicTiles = 0; // tiles the dynamic casters were drawn into
+            unsigned int Repacks = 0;
+        };
+    private:
+        enum TileKind { CASCADE, SPOT, POINT_FACE };
+        struct Tile {
+            TileKind Kind;
+            unsigned int Light; // point light index for POINT_FACE
+            bool Active = false; // the light exists and something it lights is on screen
+            float Importance = 0.0f; // screen-space size of the light's volume, 0 to 1
+            unsigned int Size = 0; // 0 until packed
+            glm::uvec2 Origin { 0 };
+            glm::mat4 ViewProjection { 0.0f }; // of the light, for the current frame
+            glm::mat4 RenderedViewProjection { 0.0f }; // that the cached static depth was rendered with
+            bool HasStatic = false; // the cached depth belongs to this tile's current placement
+            bool StaticDirty = true;
+            bool HadDynamic = false; // dynamic casters were drawn into the sampled atlas last frame
+        };
+        struct PointLight {
+            glm::vec3 Position;
+            float Range;
+        };
+
+        Settings settings;
+        GLuint staticTexture, staticFramebuffer;
+        GLuint texture, framebuffer; // sampled, with hardware depth comparison
+        std::unique_ptr<Shader> depthShader;
+        std::vector<Tile> tiles;
+        glm::vec3 directionalDirection;
+        glm::vec3 spotPosition, spotDirection;
+        float spotOuterCutOff, spotRange;
+        bool hasSpot;
+        std::vector<PointLight> pointLights;
+        std::vector<AABB> dynamicCasters;
+        float cascadeEnds[CASCADE_COUNT];
+
+        GLuint createDepthTexture(bool compare) const;
+        void updateCascades(glm::mat4 const &view, float fov, float aspect, float near);
+        void updateImportance(glm::mat4 const &view, glm::mat4 const &projection, float fov);
+        // picks tile sizes from the importance and repacks the atlas when any of them changed
+        bool updateSizes();
+        void renderTile(Tile const &tile, bool dynamicCasters, DrawCasters const &draw);
+        glm::vec4 tileRect(Tile const &tile) const;
+        glm::mat4 atlasMatrix(Tile const &tile) const;
+    public:
+        ShadowAtlas();
+        explicit ShadowAtlas(Settings const &settings);
+        ~ShadowAtlas();
+        ShadowAtlas(ShadowAtlas const &) = delete;
+        ShadowAtlas &operator=(ShadowAtlas const &) = delete;
+
+        // Lights in world space; call every frame before Update, a light whose transform changes is redrawn
+        void SetDirectionalLight(glm::vec3 const &direction) { directionalDirection = glm::normalize(direction); }
+        void SetSpotlight(glm::vec3 const &position, glm::vec3 const &direction, float outerCutOff, float range);
+        void SetPointLights(glm::vec3 const *positions, unsigned int count, float range);
+        // A static caster moved or changed: tiles that saw its bounds, old or new, redraw their cached depth
+        void InvalidateStatic(AABB const &bounds);
+        // Bounds of the dynamic casters this frame
+        void SetDynamicCasters(std::vector<AABB> casters) { dynamicCasters = std::move(casters); }
+        // Brings the atlas up to date for the camera; restores the viewport and framebuffer when done
+        Stats Update(glm::mat4 const &view, glm::mat4 const &projection, float fov, float aspect, float near, DrawCasters const &draw);
+        // Binds the atlas to a texture unit and sets the uniforms cubecombine.fs samples it with
+        void Bind(Shader const &shader, unsigned int textureUnit) const;
+
+        unsigned int GetAtlasSize() const { return settings.AtlasSize; }
+};
@@ -0,0 +1,149 @@
+#include "temporalupsampler.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+    // radical inverse of index in the given base, in [0, 1)
+    float halton(unsigned int index, unsigned int base) {
+        float result = 0.0f;
+        float fraction = 1.0f / base;
+        while (index > 0) {
+            result += (index % base) * fraction;
+            index /= base;
+            fraction /= base;
+        }
+        return result;
+    }
+
+    // texture units of the resolve pass
+    int const CURRENT_UNIT = 0;
+    int const VELOCITY_UNIT = 1;
+    int const DEPTH_UNIT = 2;
+    int const HISTORY_UNIT = 3;
+}
+
+TemporalUpsampler::TemporalUpsampler(int windowWidth, int windowHeight)
+    : velocityShader { "./shaders/velocity.vs", "./shaders/velocity.fs" }, resolveShader { "./shaders/fullscreen.vs", "./shaders/temporalresolve.fs" },
+      width { windowWidth }, height { windowHeight }, current { 0 }, hasHistory { false }, frame { 0 }, jitter { 0.0f }, previousViewProjection { 1.0f } {
+    // the fullscreen triangle is made up from gl_VertexID, but core profiles still want a vertex array bound
+    glGenVertexArrays(1, &emptyVertexArray);
+    resolveShader.Use();
+    resolveShader.SetInt("current", CURRENT_UNIT);
+    resolveShader.SetInt("velocity", VELOCITY_UNIT);
+    resolveShader.SetInt("depth", DEPTH_UNIT);
+    resolveShader.SetInt("history", HISTORY_UNIT);
+    allocate();
+}
+
+TemporalUpsampler::~TemporalUpsampler() {
+    release();
+    glDeleteVertexArrays(1, &emptyVertexArray);
+}
+
+void TemporalUpsampler::allocate() {
+    glGenTextures(2, historyTextures);
+    glGenFramebuffers(2, historyFramebuffers);
+    for (int i = 0; i < 2; i++) {
+        glBindTexture(GL_TEXTURE_2D, historyTextures[i]);
+        // half floats keep the slow blend from banding
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindFramebuffer(GL_FRAMEBUFFER, historyFramebuffers[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, historyTextures[i], 0);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    hasHistory = false;
+}
+
+void TemporalUpsampler::release() {
+    glDeleteFramebuffers(2, historyFramebuffers);
+    glDeleteTextures(2, historyTextures);
+}
+
+void TemporalUpsampler::Resize(int windowWidth, int windowHeight) {
+    if (windowWidth <= 0 || windowHeight <= 0 || (windowWidth == width && windowHeight == height)) {
+        return;
+    }
+    width = windowWidth;
+    height = windowHeight;
+    release();
+    allocate();
+}
+
+void TemporalUpsampler::BeginFrame() {
+    // index 0 of both sequences is the pixel's corner, so start at 1
+    unsigned int index = frame % JITTER_PHASES + 1;
+    jitter = glm::vec2 { halton(index, 2), halton(index, 3) } - 0.5f;
+    frame++;
+}
+
+glm::mat4 TemporalUpsampler::JitterProjection(glm::mat4 const &projection, glm::ivec2 const &renderSize) const {
+    // a translation after the projection moves the whole image by the offset, whatever the depth
+    glm::vec2 offset = 2.0f * jitter / glm::vec2 { renderSize };
+    return glm::translate(glm::mat4 { 1.0f }, glm::vec3 { offset, 0.0f }) * projection;
+}
+
+void TemporalUpsampler::DrawVelocity(DynamicResolution const &target, glm::mat4 const &view, glm::mat4 const &projection,
+                                     glm::mat4 const &jitteredProjection, DrawObjects const &draw) const {
+    glBindFramebuffer(GL_FRAMEBUFFER, target.GetFramebuffer());
+    glDrawBuffer(GL_COLOR_ATTACHMENT1);
+    GLfloat const still[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    glClearBufferfv(GL_COLOR, 0, still);
+
+    // the objects are drawn again exactly where they already are in the depth buffer; pulling them a little
+    // closer keeps the depth test from losing pixels to rounding
+    glDepthFunc(GL_LEQUAL);
+    glDepthMask(GL_FALSE);
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(-1.0f, -1.0f);
+    velocityShader.Use();
+    velocityShader.SetFloatMatrix("view", view);
+    velocityShader.SetFloatMatrix("projection", jitteredProjection);
+    velocityShader.SetFloatMatrix("viewProjection", projection * view);
+    velocityShader.SetFloatMatrix("previousViewProjection", hasHistory ? previousViewProjection : projection * view);
+    draw(velocityShader);
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+}
+
+void TemporalUpsampler::Resolve(DynamicResolution const &target, glm::mat4 const &viewProjection, GLuint destination) {
+    glm::ivec2 renderSize = target.GetRenderSize();
+    unsigned int next = 1 - current;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, historyFramebuffers[next]);
+    glViewport(0, 0, width, height);
+    glDisable(GL_DEPTH_TEST);
+    resolveShader.Use();
+    resolveShader.SetFloatVec2("renderSize", glm::vec2 { renderSize });
+    resolveShader.SetFloatVec2("jitter", jitter);
+    resolveShader.SetBool("hasHistory", hasHistory);
+    // from this frame's clip space to the previous one's, for the pixels no object covers
+    resolveShader.SetFloatMatrix("currentToPrevious", (hasHistory ? previousViewProjection : viewProjection) * glm::inverse(viewProjection));
+    glActiveTexture(GL_TEXTURE0 + CURRENT_UNIT);
+    glBindTexture(GL_TEXTURE_2D, target.GetColorTexture());
+    glActiveTexture(GL_TEXTURE0 + VELOCITY_UNIT);
+    glBindTexture(GL_TEXTURE_2D, target.GetVelocityTexture());
+    glActiveTexture(GL_TEXTURE0 + DEPTH_UNIT);
+    glBindTexture(GL_TEXTURE_2D, target.GetDepthTexture());
+    glActiveTexture(GL_TEXTURE0 + HISTORY_UNIT);
+    glBindTexture(GL_TEXTURE_2D, historyTextures[current]);
+    glBindVertexArray(emptyVertexArray);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glActiveTexture(GL_TEXTURE0);
+    glEnable(GL_DEPTH_TEST);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, historyFramebuffers[next]);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, destination);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, destination);
+
+    current = next;
+    hasHistory = true;
+    previousViewProjection = viewProjection;
+}
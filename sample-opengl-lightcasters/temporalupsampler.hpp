@@ -0,0 +1,67 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <functional>
+
+#include "dynamicresolution.hpp"
+#include "shader.h"
+
+// Temporal upsampling of the DynamicResolution target to the window's resolution. Every frame the projection is
+// shifted by a sub-pixel offset from a Halton sequence, so successive low resolution frames sample different points
+// inside each pixel, and a resolve pass accumulates them into a full resolution history:
+//
+// - a velocity pass draws the frame's objects once more into the target's velocity attachment, giving for each
+//   pixel how far it moved on screen since the previous frame from the current and previous model matrices. Pixels
+//   no object covers are reprojected from the camera's motion alone.
+// - the resolve reprojects the history along that velocity, clips it to the mean and spread of the current frame's
+//   3x3 neighbourhood so disoccluded or changed surfaces don't ghost, and blends in the current frame's nearest sample,
+//   weighted by how close that sample falls to the output pixel's center.
+//
+// The history is two window sized textures used in turn; the one just written is copied to the window.
+class TemporalUpsampler {
+    public:
+        static unsigned int const JITTER_PHASES = 16;
+        // Draws every object of the frame with the given shader, setting "model" and "previousModel" for each
+        using DrawObjects = std::function<void(Shader const &)>;
+    private:
+        Shader velocityShader;
+        Shader resolveShader;
+        GLuint emptyVertexArray;
+        GLuint historyTextures[2];
+        GLuint historyFramebuffers[2];
+        int width, height;
+        unsigned int current; // history written last
+        bool hasHistory;
+        unsigned int frame;
+        glm::vec2 jitter; // in render pixels
+        glm::mat4 previousViewProjection;
+
+        void allocate();
+        void release();
+    public:
+        TemporalUpsampler(int windowWidth, int windowHeight);
+        ~TemporalUpsampler();
+        TemporalUpsampler(TemporalUpsampler const &) = delete;
+        TemporalUpsampler &operator=(TemporalUpsampler const &) = delete;
+
+        // Reallocates the history when the window's framebuffer size changed
+        void Resize(int windowWidth, int windowHeight);
+        // Drops the history, for camera cuts and after the upsampler was off
+        void Reset() { hasHistory = false; }
+
+        // Picks this frame's sub-pixel offset
+        void BeginFrame();
+        // The projection shifted by this frame's offset; draw the frame with it, but cull with the original
+        glm::mat4 JitterProjection(glm::mat4 const &projection, glm::ivec2 const &renderSize) const;
+        glm::vec2 GetJitter() const { return jitter; }
+
+        // Fills the target's velocity attachment where the frame's objects are visible. Call after the frame is drawn
+        // into the bound target, with the view and both projections the frame was drawn with.
+        void DrawVelocity(DynamicResolution const &target, glm::mat4 const &view, glm::mat4 const &projection, glm::mat4 const &jitteredProjection,
+                          DrawObjects const &draw) const;
+        // Accumulates the target into the history and copies the result to the given framebuffer, the default one
+        // unless a post-process chain follows
+        void Resolve(DynamicResolution const &target, glm::mat4 const &viewProjection, GLuint destination = 0);
+};
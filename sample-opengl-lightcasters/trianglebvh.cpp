@@ -0,0 +1,213 @@
+#include "trianglebvh.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+using std::vector;
+
+namespace {
+    float area(AABB const &box) {
+        glm::vec3 size = glm::max(box.Max - box.Min, glm::vec3 { 0.0f });
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    AABB combine(AABB const &a, AABB const &b) {
+        return AABB { glm::min(a.Min, b.Min), glm::max(a.Max, b.Max) };
+    }
+
+    AABB const EMPTY_BOX { glm::vec3 { FLT_MAX }, glm::vec3 { -FLT_MAX } };
+
+    // distance along the ray at which it enters the box, or FLT_MAX if it misses it before maxDistance
+    float enterBox(AABB const &box, glm::vec3 const &origin, glm::vec3 const &inverseDirection, float maxDistance) {
+        glm::vec3 t0 = (box.Min - origin) * inverseDirection;
+        glm::vec3 t1 = (box.Max - origin) * inverseDirection;
+        glm::vec3 near = glm::min(t0, t1);
+        glm::vec3 far = glm::max(t0, t1);
+        float enter = std::max({ near.x, near.y, near.z, 0.0f });
+        float exit = std::min({ far.x, far.y, far.z, maxDistance });
+        return enter <= exit ? enter : FLT_MAX;
+    }
+}
+
+TriangleBvh::TriangleBvh(vector<glm::vec3> const &corners) {
+    unsigned int count = static_cast<unsigned int>(corners.size() / 3);
+    vector<AABB> bounds(count);
+    vector<glm::vec3> centroids(count);
+    triangleIds.resize(count);
+    for (unsigned int i = 0; i < count; i++) {
+        bounds[i] = ComputeAABB(&corners[i * 3], 3);
+        centroids[i] = (corners[i * 3] + corners[i * 3 + 1] + corners[i * 3 + 2]) / 3.0f;
+        triangleIds[i] = i;
+    }
+    nodes.reserve(count * 2);
+    nodes.push_back(Node {});
+    if (count > 0) {
+        build(0, 0, count, 0, bounds, centroids);
+    }
+    triangles.resize(count);
+    for (unsigned int i = 0; i < count; i++) {
+        glm::vec3 const *corner = &corners[triangleIds[i] * 3];
+        triangles[i] = Triangle { corner[0], corner[1] - corner[0], corner[2] - corner[0] };
+    }
+}
+
+void TriangleBvh::build(unsigned int node, unsigned int begin, unsigned int end, unsigned int depth, vector<AABB> const &bounds, vector<glm::vec3> const &centroids) {
+    AABB box = EMPTY_BOX;
+    AABB centroidBox = EMPTY_BOX;
+    for (unsigned int i = begin; i < end; i++) {
+        box = combine(box, bounds[triangleIds[i]]);
+        centroidBox = combine(centroidBox, AABB { centroids[triangleIds[i]], centroids[triangleIds[i]] });
+    }
+    nodes[node].Box = box;
+    unsigned int count = end - begin;
+
+    // cheapest split over every axis; a leaf costs one intersection per triangle. The last level the traversal
+    // stack can take only has leaves, however many triangles they get.
+    float bestCost = static_cast<float>(count);
+    int bestAxis = -1;
+    unsigned int bestBin = 0;
+    glm::vec3 extent = centroidBox.Max - centroidBox.Min;
+    for (int axis = 0; axis < 3 && count > MAX_LEAF_SIZE && depth + 1 < MAX_STACK; axis++) {
+        if (extent[axis] <= 0.0f) {
+            continue;
+        }
+        AABB binBoxes[BIN_COUNT];
+        unsigned int binCounts[BIN_COUNT] = {};
+        std::fill(binBoxes, binBoxes + BIN_COUNT, EMPTY_BOX);
+        float scale = BIN_COUNT / extent[axis];
+        for (unsigned int i = begin; i < end; i++) {
+            unsigned int id = triangleIds[i];
+            unsigned int bin = std::min(BIN_COUNT - 1, static_cast<unsigned int>((centroids[id][axis] - centroidBox.Min[axis]) * scale));
+            binBoxes[bin] = combine(binBoxes[bin], bounds[id]);
+            binCounts[bin]++;
+        }
+        // sweep from the right to get every suffix, then from the left to price every split
+        AABB rightBoxes[BIN_COUNT];
+        unsigned int rightCounts[BIN_COUNT];
+        AABB running = EMPTY_BOX;
+        unsigned int runningCount = 0;
+        for (unsigned int bin = BIN_COUNT - 1; bin > 0; bin--) {
+            running = combine(running, binBoxes[bin]);
+            runningCount += binCounts[bin];
+            rightBoxes[bin] = running;
+            rightCounts[bin] = runningCount;
+        }
+        running = EMPTY_BOX;
+        runningCount = 0;
+        float parentArea = area(box);
+        for (unsigned int bin = 0; bin < BIN_COUNT - 1; bin++) {
+            running = combine(running, binBoxes[bin]);
+            runningCount += binCounts[bin];
+            if (runningCount == 0 || rightCounts[bin + 1] == 0) {
+                continue;
+            }
+            // one traversal step plus the triangles of each side, weighted by the chance of entering it
+            float cost = 1.0f + (area(running) * runningCount + area(rightBoxes[bin + 1]) * rightCounts[bin + 1]) / parentArea;
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = bin;
+            }
+        }
+    }
+
+    if (bestAxis < 0) {
+        nodes[node].Offset = begin;
+        nodes[node].Count = count;
+        return;
+    }
+    float scale = BIN_COUNT / extent[bestAxis];
+    auto middle = std::partition(triangleIds.begin() + begin, triangleIds.begin() + end, [&](unsigned int id) {
+        return std::min(BIN_COUNT - 1, static_cast<unsigned int>((centroids[id][bestAxis] - centroidBox.Min[bestAxis]) * scale)) <= bestBin;
+    });
+    unsigned int split = static_cast<unsigned int>(middle - triangleIds.begin());
+
+    unsigned int first = static_cast<unsigned int>(nodes.size());
+    nodes.push_back(Node {});
+    build(first, begin, split, depth + 1, bounds, centroids);
+    unsigned int second = static_cast<unsigned int>(nodes.size());
+    nodes.push_back(Node {});
+    build(second, split, end, depth + 1, bounds, centroids);
+    nodes[node].Offset = second;
+    nodes[node].Count = 0;
+}
+
+template <bool AnyHit>
+bool TriangleBvh::traverse(Ray const &ray, float maxDistance, RayHit &hit) const {
+    if (triangles.empty()) {
+        return false;
+    }
+    glm::vec3 inverseDirection = 1.0f / ray.Direction;
+    bool found = false;
+    hit.Distance = maxDistance;
+    unsigned int stack[MAX_STACK];
+    unsigned int top = 0;
+    if (enterBox(nodes[0].Box, ray.Origin, inverseDirection, maxDistance) == FLT_MAX) {
+        return false;
+    }
+    stack[top++] = 0;
+    while (top > 0) {
+        Node const &node = nodes[stack[--top]];
+        if (node.Count > 0) {
+            for (unsigned int i = node.Offset; i < node.Offset + node.Count; i++) {
+                // Moller-Trumbore
+                Triangle const &triangle = triangles[i];
+                glm::vec3 p = glm::cross(ray.Direction, triangle.Edge2);
+                float determinant = glm::dot(triangle.Edge1, p);
+                if (std::abs(determinant) < 1e-12f) {
+                    continue;
+                }
+                float inverseDeterminant = 1.0f / determinant;
+                glm::vec3 s = ray.Origin - triangle.Corner;
+                float u = glm::dot(s, p) * inverseDeterminant;
+                if (u < 0.0f || u > 1.0f) {
+                    continue;
+                }
+                glm::vec3 q = glm::cross(s, triangle.Edge1);
+                float v = glm::dot(ray.Direction, q) * inverseDeterminant;
+                if (v < 0.0f || u + v > 1.0f) {
+                    continue;
+                }
+                float distance = glm::dot(triangle.Edge2, q) * inverseDeterminant;
+                if (distance <= 0.0f || distance >= hit.Distance) {
+                    continue;
+                }
+                hit = RayHit { distance, triangleIds[i], u, v };
+                found = true;
+                if (AnyHit) {
+                    return true;
+                }
+            }
+            continue;
+        }
+        // visit the nearer child first so the farther one is more likely to be skipped
+        unsigned int first = static_cast<unsigned int>(&node - nodes.data()) + 1;
+        unsigned int second = node.Offset;
+        float firstDistance = enterBox(nodes[first].Box, ray.Origin, inverseDirection, hit.Distance);
+        float secondDistance = enterBox(nodes[second].Box, ray.Origin, inverseDirection, hit.Distance);
+        if (firstDistance > secondDistance) {
+            std::swap(first, second);
+            std::swap(firstDistance, secondDistance);
+        }
+        if (secondDistance != FLT_MAX) {
+            assert(top < MAX_STACK);
+            stack[top++] = second;
+        }
+        if (firstDistance != FLT_MAX) {
+            assert(top < MAX_STACK);
+            stack[top++] = first;
+        }
+    }
+    return found;
+}
+
+bool TriangleBvh::Intersect(Ray const &ray, float maxDistance, RayHit &hit) const {
+    return traverse<false>(ray, maxDistance, hit);
+}
+
+bool TriangleBvh::Occluded(Ray const &ray, float maxDistance) const {
+    RayHit hit;
+    return traverse<true>(ray, maxDistance, hit);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "culling.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+struct Ray {
+    glm::vec3 Origin;
+    glm::vec3 Direction;
+};
+
+struct RayHit {
+    float Distance;
+    unsigned int Triangle; // index in the order the triangles were given
+    float U, V; // barycentric weights of the second and third corner
+};
+
+// Static bounding volume hierarchy over triangles, for ray queries. Built once, top-down, splitting each node at
+// the cheapest of a few binned candidates per axis by the surface area heuristic. Nodes are stored depth-first,
+// so the first child always follows its parent and only the second child's index is kept.
+class TriangleBvh {
+    private:
+        struct Node {
+            AABB Box;
+            unsigned int Offset; // first triangle for leaves, second child for inner nodes
+            unsigned int Count; // 0 for inner nodes
+        };
+        // corner and the two edges leaving it, which is what the intersection test needs
+        struct Triangle {
+            glm::vec3 Corner;
+            glm::vec3 Edge1;
+            glm::vec3 Edge2;
+        };
+        // leaves sit at most MAX_STACK - 1 levels down, which keeps the traversal within its stack
+        static unsigned int const MAX_STACK = 64;
+        static unsigned int const BIN_COUNT = 12;
+        static unsigned int const MAX_LEAF_SIZE = 4;
+
+        std::vector<Node> nodes;
+        std::vector<Triangle> triangles; // in leaf order
+        std::vector<unsigned int> triangleIds;
+
+        void build(unsigned int node, unsigned int begin, unsigned int end, unsigned int depth, std::vector<AABB> const &bounds, std::vector<glm::vec3> const &centroids);
+        template <bool AnyHit>
+        bool traverse(Ray const &ray, float maxDistance, RayHit &hit) const;
+    public:
+        // three corners per triangle
+        explicit TriangleBvh(std::vector<glm::vec3> const &corners);
+
+        // Closest hit closer than maxDistance, from either side of the triangle
+        bool Intersect(Ray const &ray, float maxDistance, RayHit &hit) const;
+        // Any hit closer than maxDistance, for shadow rays
+        bool Occluded(Ray const &ray, float maxDistance) const;
+
+        size_t GetNodeCount() const { return nodes.size(); }
+        size_t GetTriangleCount() const { return triangles.size(); }
+};
@@ -0,0 +1,88 @@
+#include "upsamplingtest.hpp"
+
+#include <glad/glad.h>
+#include "camera.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+using std::cout;
+using std::endl;
+using std::vector;
+
+namespace {
+    double psnr(vector<unsigned char> const &a, vector<unsigned char> const &b) {
+        double sum = 0.0;
+        for (size_t i = 0; i < a.size(); i++) {
+            double difference = static_cast<double>(a[i]) - b[i];
+            sum += difference * difference;
+        }
+        double mean = sum / std::max<size_t>(a.size(), 1);
+        return mean == 0.0 ? 99.0 : 10.0 * std::log10(255.0 * 255.0 / mean);
+    }
+
+    // the difference amplified four times, rows from the top as PPM wants them
+    void writeDifference(char const *path, vector<unsigned char> const &a, vector<unsigned char> const &b, int width, int height) {
+        std::ofstream file { path, std::ios::binary };
+        file << "P6\n" << width << " " << height << "\n255\n";
+        for (int y = height - 1; y >= 0; y--) {
+            for (int x = 0; x < width * 3; x++) {
+                size_t i = static_cast<size_t>(y) * width * 3 + x;
+                file.put(static_cast<char>(std::min(255, 4 * std::abs(a[i] - b[i]))));
+            }
+        }
+    }
+}
+
+UpsamplingTest::UpsamplingTest() : pass { Pass::Native }, frame { 0 }, width { 0 }, height { 0 } {}
+
+void UpsamplingTest::PlaceCamera(Camera &camera) const {
+    // drifts sideways and forward through the cubes while panning, so both the camera and the cubes move
+    float time = GetTime();
+    glm::vec3 position { 0.5f + 1.2f * std::sin(0.8f * time), 1.0f + 0.3f * time, 5.0f - 1.5f * time };
+    camera.SetView(position, -90.0f + 12.0f * std::sin(0.6f * time), -6.0f);
+}
+
+void UpsamplingTest::EndFrame(int width, int height) {
+    if (pass == Pass::Done) {
+        return;
+    }
+    if (std::find(std::begin(CAPTURES), std::end(CAPTURES), frame) != std::end(CAPTURES)) {
+        this->width = width;
+        this->height = height;
+        vector<unsigned char> pixels(static_cast<size_t>(width) * height * 3);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+        if (pass == Pass::Native) {
+            native.push_back(std::move(pixels));
+        } else {
+            captured[pass == Pass::Stretched ? 0 : 1].push_back(std::move(pixels));
+        }
+    }
+    if (++frame == FRAMES) {
+        frame = 0;
+        pass = static_cast<Pass>(static_cast<int>(pass) + 1);
+    }
+}
+
+int UpsamplingTest::Report() const {
+    cout << "Upsampling test, " << width << "x" << height << " at " << SCALE * 100.0f << "% scale, PSNR against native resolution:" << endl;
+    bool passed = !native.empty();
+    for (size_t i = 0; i < native.size(); i++) {
+        double stretched = psnr(native[i], captured[0][i]);
+        double temporal = psnr(native[i], captured[1][i]);
+        cout << "  frame " << CAPTURES[i] << std::fixed << std::setprecision(2) << ": stretched " << stretched << " dB, temporal " << temporal
+             << " dB" << endl;
+        passed = passed && temporal >= MIN_PSNR && temporal >= stretched + MIN_GAIN;
+    }
+    if (!native.empty()) {
+        writeDifference("./upsampling-diff.ppm", native.back(), captured[1].back(), width, height);
+        cout << "  difference of the last temporal frame written to upsampling-diff.ppm" << endl;
+    }
+    cout << (passed ? "PASS" : "FAIL") << " (temporal at least " << MIN_PSNR << " dB and " << MIN_GAIN << " dB over stretched)" << endl;
+    return passed ? 0 : 1;
+}
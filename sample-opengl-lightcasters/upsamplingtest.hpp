@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+
+class Camera;
+
+// Image difference test of the temporal upsampler, run with `./main --upsampling-test`. It flies the camera along a
+// fixed path with a fixed time step three times: at native resolution with MSAA, at a reduced scale stretched over the
+// window, and at the same scale through the temporal upsampler. Frames captured at the same points of the last two
+// passes are compared with the native ones by PSNR, and the difference of the last temporal capture is written to
+// upsampling-diff.ppm. The test passes when temporal upsampling stays close enough to native and beats the stretched
+// frames by a margin on every capture.
+class UpsamplingTest {
+    public:
+        enum class Pass { Native, Stretched, Temporal, Done };
+        static constexpr float SCALE = 0.75f; // 56% of the pixels
+        static constexpr unsigned int FRAMES = 120;
+        static constexpr float FRAME_TIME = 1.0f / 60.0f;
+        // the history needs a few dozen frames to fill in
+        static constexpr unsigned int CAPTURES[] = { 60, 90, 119 };
+        static constexpr double MIN_PSNR = 36.0;
+        static constexpr double MIN_GAIN = 0.5; // over the stretched frame, in dB
+    private:
+        Pass pass;
+        unsigned int frame;
+        int width, height;
+        std::vector<std::vector<unsigned char>> native;
+        std::vector<std::vector<unsigned char>> captured[2]; // stretched and temporal
+    public:
+        UpsamplingTest();
+
+        Pass GetPass() const { return pass; }
+        bool IsFinished() const { return pass == Pass::Done; }
+        // the first frame of a pass, where the scale changes and the history must go
+        bool IsPassStart() const { return frame == 0; }
+        float GetScale() const { return pass == Pass::Native ? 1.0f : SCALE; }
+        bool UsesTemporalUpsampling() const { return pass == Pass::Temporal; }
+        // the scene's clock, which only depends on the frame
+        float GetTime() const { return frame * FRAME_TIME; }
+        void PlaceCamera(Camera &camera) const;
+
+        // Call once the frame is in the default framebuffer
+        void EndFrame(int width, int height);
+        // Prints the results and returns the process exit code
+        int Report() const;
+};
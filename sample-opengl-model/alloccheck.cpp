@@ -0,0 +1,182 @@
+// Headless check that a warm frame of the viewer doesn't touch the heap: the culled draw of a grid of meshes with
+// its transforms and draw list in a FrameArena, and the uniforms set through the shader's C string setters, as
+// main's loop does them. The GL entry points are stubs that do nothing, so no context or display is needed and
+// only the sample's own allocations are counted. Build with `make alloccheck` and run ./alloccheck from this
+// directory so the shaders are found; `make check` runs it. It fails when AllocTracker counts any allocation after
+// the warm-up.
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <type_traits>
+#include <vector>
+
+#include "alloctracker.hpp"
+#include "culling.hpp"
+#include "framearena.hpp"
+#include "mesh.hpp"
+#include "shader.h"
+
+unsigned int const GRID = 16; // GRID x GRID meshes
+unsigned int const MATERIALS = 6;
+unsigned int const FRAMES_PER_TURN = 60;
+// one full turn around the grid, so the draw list has been as long as it gets and the arena has grown to fit
+unsigned int const WARMUP_FRAMES = FRAMES_PER_TURN;
+unsigned int const FRAMES = 4 * FRAMES_PER_TURN;
+// smaller than a frame needs, so the warm-up has the arena overflow and consolidate
+size_t const ARENA_CAPACITY = 4 * 1024;
+
+namespace {
+    template <typename Proc>
+    struct Stub;
+
+    template <typename R, typename... Args>
+    struct Stub<R (APIENTRYP)(Args...)> {
+        static R APIENTRY Call(Args...) {
+            if constexpr (!std::is_void_v<R>) {
+                return R {};
+            }
+        }
+    };
+
+    template <typename Proc>
+    void stub(Proc &slot) {
+        slot = &Stub<Proc>::Call;
+    }
+
+    // shaders compile and programs link, so the constructor has nothing to report
+    void APIENTRY getObjectiv(GLuint, GLenum, GLint *value) {
+        *value = GL_TRUE;
+    }
+
+    // the entry points the shader, the setters and Mesh::Draw call
+    void loadStubs() {
+        stub(glad_glCreateShader);
+        stub(glad_glShaderSource);
+        stub(glad_glCompileShader);
+        stub(glad_glGetShaderInfoLog);
+        stub(glad_glCreateProgram);
+        stub(glad_glAttachShader);
+        stub(glad_glLinkProgram);
+        stub(glad_glGetProgramInfoLog);
+        stub(glad_glDeleteShader);
+        stub(glad_glDeleteProgram);
+        stub(glad_glUseProgram);
+        stub(glad_glGetUniformLocation);
+        stub(glad_glUniform1i);
+        stub(glad_glUniform1f);
+        stub(glad_glUniform3f);
+        stub(glad_glUniform3fv);
+        stub(glad_glUniformMatrix4fv);
+        stub(glad_glActiveTexture);
+        stub(glad_glBindTexture);
+        stub(glad_glBindVertexArray);
+        stub(glad_glDrawElements);
+        glad_glGetShaderiv = &getObjectiv;
+        glad_glGetProgramiv = &getObjectiv;
+    }
+
+    // a unit quad at the cell, with a diffuse and specular texture and a normal map on every other material
+    Mesh makeTile(unsigned int x, unsigned int z, unsigned int material) {
+        std::vector<Vertex> vertices(4);
+        for (unsigned int i = 0; i < 4; i++) {
+            float u = static_cast<float>(i & 1);
+            float v = static_cast<float>(i >> 1);
+            vertices[i] = Vertex {};
+            vertices[i].Position = glm::vec3 { x + u, 0.0f, z + v };
+            vertices[i].Normal = glm::vec3 { 0.0f, 1.0f, 0.0f };
+            vertices[i].TexCoords = glm::vec2 { u, v };
+        }
+        std::vector<unsigned int> indices { 0, 2, 1, 1, 2, 3 };
+        unsigned int id = 1 + 3 * material;
+        std::vector<Texture> textures {
+            Texture { id, "texture_diffuse", "" },
+            Texture { id + 1, "texture_specular", "" },
+        };
+        if (material % 2 == 1) {
+            textures.push_back(Texture { id + 2, "texture_normal", "" });
+        }
+        return Mesh { vertices, indices, textures };
+    }
+}
+
+int main() {
+    loadStubs();
+    Shader shader { "./shader/model.vs", "./shader/model.fs" };
+    std::vector<Mesh> meshes;
+    for (unsigned int z = 0; z < GRID; z++) {
+        for (unsigned int x = 0; x < GRID; x++) {
+            meshes.push_back(makeTile(x, z, (x * 7 + z * 3) % MATERIALS));
+        }
+    }
+    FrameArena arena { ARENA_CAPACITY };
+    CullingBatch cullingBatch;
+    glm::mat4 model = glm::translate(glm::mat4 { 1.0f }, glm::vec3 { GRID * -0.5f, 0.0f, GRID * -0.5f });
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+
+    AllocTracker::Frame counted;
+    unsigned int allocatingFrames = 0;
+    unsigned int minVisible = ~0u, maxVisible = 0;
+    AllocTracker::EndFrame();
+    for (unsigned int frame = 0; frame < WARMUP_FRAMES + FRAMES; frame++) {
+        // circling the grid from close by, so how many meshes are visible changes from frame to frame
+        float angle = glm::radians(360.0f * frame / FRAMES_PER_TURN);
+        glm::vec3 eye { 6.0f * std::cos(angle), 3.0f, 6.0f * std::sin(angle) };
+        glm::mat4 view = glm::lookAt(eye, glm::vec3 { 0.0f }, glm::vec3 { 0.0f, 1.0f, 0.0f });
+
+        shader.Use();
+        shader.SetFloatMatrix("projection", projection);
+        shader.SetFloatMatrix("view", view);
+        // set once in the viewer, here every frame so each setter is covered
+        shader.SetFloatVec3("pointLight.position", eye);
+        shader.SetFloatVec3("directionalLight.direction", -0.2f, -1.0f, -0.3f);
+        shader.SetFloat("pointLight.linear", 0.045f);
+
+        // Model::Draw(shader, frustum, model, arena) but for the node transforms and texture residency
+        cullingBatch.Clear();
+        cullingBatch.Reserve(meshes.size());
+        glm::mat4 *transforms = arena.Allocate<glm::mat4>(meshes.size());
+        for (unsigned int i = 0; i < meshes.size(); i++) {
+            transforms[i] = model;
+            cullingBatch.Add(TransformAABB(meshes[i].GetAABB(), transforms[i]), TransformSphere(meshes[i].GetBoundingSphere(), transforms[i]));
+        }
+        CullStats stats = cullingBatch.Cull(Frustum::FromMatrix(projection * view));
+        std::uint64_t *drawList = BuildDrawList(meshes, cullingBatch, stats, arena);
+        Mesh const *previous = nullptr;
+        for (unsigned int i = 0; i < stats.Visible; i++) {
+            unsigned int index = static_cast<unsigned int>(drawList[i]);
+            shader.SetFloatMatrix("model", transforms[index]);
+            meshes[index].Draw(shader, previous == nullptr || !meshes[index].SharesMaterial(*previous));
+            previous = &meshes[index];
+        }
+
+        arena.Reset();
+        AllocTracker::EndFrame();
+        if (frame < WARMUP_FRAMES) {
+            continue;
+        }
+        AllocTracker::Frame const &last = AllocTracker::GetLastFrame();
+        counted.News += last.News;
+        counted.NewBytes += last.NewBytes;
+        counted.Mallocs += last.Mallocs;
+        counted.MallocBytes += last.MallocBytes;
+        allocatingFrames += last.Mallocs != 0;
+        minVisible = std::min(minVisible, stats.Visible);
+        maxVisible = std::max(maxVisible, stats.Visible);
+    }
+
+    bool ok = counted.Mallocs == 0;
+    std::printf("%u frames after %u of warm-up, %u to %u of %zu meshes drawn, arena %zu bytes\n", FRAMES, WARMUP_FRAMES,
+                minVisible, maxVisible, meshes.size(), arena.GetCapacity());
+    std::printf("allocating frames %u, news %llu (%llu bytes), mallocs %llu (%llu bytes): %s\n", allocatingFrames,
+                static_cast<unsigned long long>(counted.News), static_cast<unsigned long long>(counted.NewBytes),
+                static_cast<unsigned long long>(counted.Mallocs), static_cast<unsigned long long>(counted.MallocBytes),
+                ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,259 @@
+#include "alloctracker.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <cxxabi.h>
+#include <execinfo.h>
+#include <mutex>
+#include <new>
+
+using std::endl;
+
+// glibc's own allocator, which the interposed functions forward to
+extern "C" {
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *pointer, size_t size);
+    void __libc_free(void *pointer);
+    void *__libc_memalign(size_t alignment, size_t size);
+}
+
+namespace {
+    struct CallSite {
+        static constexpr int DEPTH = 10;
+        void *Frames[DEPTH];
+        int Depth;
+        std::uint64_t Count;
+        std::uint64_t Bytes;
+    };
+
+    std::atomic<std::uint64_t> news { 0 }, newBytes { 0 }, mallocs { 0 }, mallocBytes { 0 };
+    AllocTracker::Frame lastFrame;
+
+    std::atomic<unsigned int> sampleInterval { 0 };
+    std::atomic<std::uint64_t> sampleCounter { 0 };
+    std::mutex callSitesMutex;
+    // open addressing on the hash of the stack; a full table drops the new stacks
+    CallSite callSites[512];
+    std::uint64_t droppedSamples = 0;
+    // backtrace can allocate the first time it unwinds, which must not sample again
+    thread_local bool sampling = false;
+
+    void countMalloc(size_t size) {
+        mallocs.fetch_add(1, std::memory_order_relaxed);
+        mallocBytes.fetch_add(size, std::memory_order_relaxed);
+    }
+
+    void sample(size_t size) {
+        void *frames[CallSite::DEPTH + 2];
+        sampling = true;
+        int depth = backtrace(frames, CallSite::DEPTH + 2);
+        sampling = false;
+        // the first two frames are sample and operator new
+        int skip = std::min(depth, 2);
+        depth -= skip;
+        std::uint64_t hash = 14695981039346656037ull;
+        for (int i = 0; i < depth; i++) {
+            hash = (hash ^ reinterpret_cast<std::uintptr_t>(frames[skip + i])) * 1099511628211ull;
+        }
+
+        std::lock_guard<std::mutex> lock { callSitesMutex };
+        size_t const capacity = sizeof(callSites) / sizeof(callSites[0]);
+        for (size_t probe = 0; probe < capacity; probe++) {
+            CallSite &site = callSites[(hash + probe) % capacity];
+            if (site.Count == 0) {
+                std::memcpy(site.Frames, frames + skip, depth * sizeof(void *));
+                site.Depth = depth;
+            } else if (site.Depth != depth || std::memcmp(site.Frames, frames + skip, depth * sizeof(void *)) != 0) {
+                continue;
+            }
+            site.Count++;
+            site.Bytes += size;
+            return;
+        }
+        droppedSamples++;
+    }
+
+    void *allocate(size_t size) {
+        news.fetch_add(1, std::memory_order_relaxed);
+        newBytes.fetch_add(size, std::memory_order_relaxed);
+        unsigned int interval = sampleInterval.load(std::memory_order_relaxed);
+        if (interval != 0 && !sampling && sampleCounter.fetch_add(1, std::memory_order_relaxed) % interval == 0) {
+            sample(size);
+        }
+        return std::malloc(size == 0 ? 1 : size);
+    }
+
+    void *allocateAligned(size_t size, size_t alignment) {
+        news.fetch_add(1, std::memory_order_relaxed);
+        newBytes.fetch_add(size, std::memory_order_relaxed);
+        countMalloc(size);
+        return __libc_memalign(alignment, size == 0 ? 1 : size);
+    }
+
+    // "./main(_ZN4Mesh4DrawER6Shaderb+0x2c) [0x...]" with the mangled name demangled
+    void writeSymbol(std::ostream &log, char const *symbol) {
+        char const *open = std::strchr(symbol, '(');
+        char const *plus = open != nullptr ? std::strchr(open, '+') : nullptr;
+        if (open == nullptr || plus == nullptr || plus == open + 1) {
+            log << symbol;
+            return;
+        }
+        char mangled[256];
+        size_t length = std::min(static_cast<size_t>(plus - open - 1), sizeof(mangled) - 1);
+        std::memcpy(mangled, open + 1, length);
+        mangled[length] = '\0';
+        int status = 0;
+        char *demangled = abi::__cxa_demangle(mangled, nullptr, nullptr, &status);
+        if (status != 0) {
+            log << symbol;
+            return;
+        }
+        log << demangled << ' ' << plus;
+        std::free(demangled);
+    }
+}
+
+extern "C" {
+    void *malloc(size_t size) {
+        countMalloc(size);
+        return __libc_malloc(size);
+    }
+
+    void *calloc(size_t count, size_t size) {
+        countMalloc(count * size);
+        return __libc_calloc(count, size);
+    }
+
+    void *realloc(void *pointer, size_t size) {
+        countMalloc(size);
+        return __libc_realloc(pointer, size);
+    }
+
+    void free(void *pointer) {
+        __libc_free(pointer);
+    }
+}
+
+void *operator new(size_t size) {
+    void *pointer = allocate(size);
+    if (pointer == nullptr) {
+        throw std::bad_alloc {};
+    }
+    return pointer;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void *operator new(size_t size, std::nothrow_t const &) noexcept {
+    return allocate(size);
+}
+
+void *operator new[](size_t size, std::nothrow_t const &) noexcept {
+    return allocate(size);
+}
+
+void *operator new(size_t size, std::align_val_t alignment) {
+    void *pointer = allocateAligned(size, static_cast<size_t>(alignment));
+    if (pointer == nullptr) {
+        throw std::bad_alloc {};
+    }
+    return pointer;
+}
+
+void *operator new[](size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void operator delete(void *pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, size_t, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, size_t, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void AllocTracker::EndFrame() {
+    lastFrame.News = news.exchange(0, std::memory_order_relaxed);
+    lastFrame.NewBytes = newBytes.exchange(0, std::memory_order_relaxed);
+    lastFrame.Mallocs = mallocs.exchange(0, std::memory_order_relaxed);
+    lastFrame.MallocBytes = mallocBytes.exchange(0, std::memory_order_relaxed);
+}
+
+AllocTracker::Frame const &AllocTracker::GetLastFrame() {
+    return lastFrame;
+}
+
+void AllocTracker::SampleCallSites(unsigned int interval) {
+    if (interval != 0) {
+        // the first backtrace loads the unwinder, which allocates
+        void *frames[1];
+        sampling = true;
+        backtrace(frames, 1);
+        sampling = false;
+    }
+    sampleInterval.store(interval, std::memory_order_relaxed);
+}
+
+void AllocTracker::ReportCallSites(std::ostream &log, unsigned int count) {
+    unsigned int interval = sampleInterval.exchange(0, std::memory_order_relaxed);
+    CallSite const *sorted[sizeof(callSites) / sizeof(callSites[0])];
+    size_t sites = 0;
+    {
+        std::lock_guard<std::mutex> lock { callSitesMutex };
+        for (auto const &site : callSites) {
+            if (site.Count != 0) {
+                sorted[sites++] = &site;
+            }
+        }
+    }
+    std::sort(sorted, sorted + sites, [](CallSite const *a, CallSite const *b) { return a->Count > b->Count; });
+
+    log << sites << " call sites of operator new sampled";
+    if (droppedSamples > 0) {
+        log << ", " << droppedSamples << " samples dropped with the table full";
+    }
+    log << endl;
+    for (size_t i = 0; i < std::min(sites, static_cast<size_t>(count)); i++) {
+        CallSite const &site = *sorted[i];
+        log << site.Count << " samples, " << site.Bytes << " bytes" << endl;
+        sampling = true;
+        char **symbols = backtrace_symbols(site.Frames, site.Depth);
+        sampling = false;
+        for (int j = 0; symbols != nullptr && j < site.Depth; j++) {
+            log << "    ";
+            writeSymbol(log, symbols[j]);
+            log << endl;
+        }
+        std::free(symbols);
+    }
+    sampleInterval.store(interval, std::memory_order_relaxed);
+}
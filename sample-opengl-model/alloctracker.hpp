@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+// Counts the heap traffic of the whole program. Linking alloctracker.o replaces the global operator new and delete,
+// and interposes malloc, calloc, realloc and free over glibc's, so the counts take in the libraries and the GL
+// driver as well. operator new allocates through malloc, so every new is also counted as a malloc. A count is a
+// relaxed atomic add; the counts are split into frames by EndFrame.
+//
+// With sampling on, the call stack of every Nth operator new is kept in a fixed table, which allocates nothing
+// itself. Link with -rdynamic for the stacks to name the program's own functions.
+class AllocTracker {
+    public:
+        struct Frame {
+            std::uint64_t News = 0;
+            std::uint64_t NewBytes = 0;
+            std::uint64_t Mallocs = 0; // news included
+            std::uint64_t MallocBytes = 0;
+        };
+
+        // Keeps the counts since the last call for GetLastFrame
+        static void EndFrame();
+        static Frame const &GetLastFrame();
+        // Records the call stack of every interval'th operator new from now on, 0 stops
+        static void SampleCallSites(unsigned int interval);
+        // Prints the most frequent of the sampled call stacks
+        static void ReportCallSites(std::ostream &log, unsigned int count);
+};
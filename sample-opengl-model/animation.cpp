@@ -0,0 +1,565 @@
+#include "animation.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using std::string;
+using std::vector;
+
+namespace {
+    // the three smallest components of a unit quaternion lie within +-1/sqrt(2)
+    float const ROTATION_RANGE = 0.70710678f;
+    float const ROTATION_STEPS = 32767.0f;
+    float const VECTOR_STEPS = 65535.0f;
+    unsigned int const MAX_FRAMES = 65536;
+
+    void encodeRotation(glm::quat q, std::uint16_t *out) {
+        q = glm::normalize(q);
+        float components[4] = { q.x, q.y, q.z, q.w };
+        int largest = 0;
+        for (int i = 1; i < 4; i++) {
+            if (std::abs(components[i]) > std::abs(components[largest])) {
+                largest = i;
+            }
+        }
+        // q and -q are the same rotation, so the dropped component can always be made positive
+        float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+        std::uint16_t packed[3];
+        int k = 0;
+        for (int i = 0; i < 4; i++) {
+            if (i != largest) {
+                float value = glm::clamp(components[i] * sign / ROTATION_RANGE, -1.0f, 1.0f);
+                packed[k++] = static_cast<std::uint16_t>(std::lround((value * 0.5f + 0.5f) * ROTATION_STEPS));
+            }
+        }
+        // the index of the dropped component rides in the top bits of the first two values
+        out[0] = static_cast<std::uint16_t>(packed[0] | ((largest >> 1) << 15));
+        out[1] = static_cast<std::uint16_t>(packed[1] | ((largest & 1) << 15));
+        out[2] = packed[2];
+    }
+
+    glm::quat nlerp(glm::quat const &a, glm::quat const &b, float t) {
+        float sign = glm::dot(a, b) < 0.0f ? -1.0f : 1.0f;
+        return glm::normalize(a * (1.0f - t) + b * (t * sign));
+    }
+
+    // Linear for vectors, normalized-linear for rotations: the same interpolation the sampler uses
+    template <typename T>
+    T interpolate(T const &a, T const &b, float t) {
+        return glm::mix(a, b, t);
+    }
+
+    template <>
+    glm::quat interpolate(glm::quat const &a, glm::quat const &b, float t) {
+        return nlerp(a, b, t);
+    }
+
+    template <typename T>
+    T sampleTrack(vector<float> const &times, vector<T> const &values, float time) {
+        auto next = std::upper_bound(times.begin(), times.end(), time);
+        if (next == times.begin()) {
+            return values.front();
+        }
+        if (next == times.end()) {
+            return values.back();
+        }
+        size_t index = next - times.begin();
+        float t = (time - times[index - 1]) / (times[index] - times[index - 1]);
+        return interpolate(values[index - 1], values[index], t);
+    }
+
+    // Frames to keep so that interpolating between kept frames stays within the tolerance everywhere
+    template <typename T, typename Error>
+    vector<unsigned int> reduceKeys(vector<T> const &samples, float tolerance, Error error) {
+        bool constant = true;
+        for (size_t i = 1; i < samples.size() && constant; i++) {
+            constant = error(samples[0], samples[i]) <= tolerance;
+        }
+        if (constant) {
+            return vector<unsigned int> { 0 };
+        }
+        // greedily grow each segment until some skipped frame no longer fits
+        vector<unsigned int> keys { 0 };
+        unsigned int anchor = 0;
+        for (unsigned int end = anchor + 2; end < samples.size(); end++) {
+            bool fits = true;
+            for (unsigned int i = anchor + 1; i < end && fits; i++) {
+                float t = static_cast<float>(i - anchor) / (end - anchor);
+                fits = error(interpolate(samples[anchor], samples[end], t), samples[i]) <= tolerance;
+            }
+            if (!fits) {
+                anchor = end - 1;
+                keys.push_back(anchor);
+            }
+        }
+        keys.push_back(static_cast<unsigned int>(samples.size() - 1));
+        return keys;
+    }
+
+    // Key pair around a frame and the blend factor between them
+    inline void findKeys(std::uint16_t const *frames, unsigned int count, float frame, unsigned int &first, unsigned int &second, float &t) {
+        if (count == 1) {
+            first = second = 0;
+            t = 0.0f;
+            return;
+        }
+        second = static_cast<unsigned int>(std::upper_bound(frames + 1, frames + count - 1, frame) - frames);
+        first = second - 1;
+        t = glm::clamp((frame - frames[first]) / static_cast<float>(frames[second] - frames[first]), 0.0f, 1.0f);
+    }
+
+    // translation, rotation and scale of an affine transform without shear
+    void decompose(glm::mat4 const &transform, glm::vec3 &translation, glm::quat &rotation, glm::vec3 &scale) {
+        translation = glm::vec3 { transform[3] };
+        scale = glm::vec3 { glm::length(glm::vec3 { transform[0] }), glm::length(glm::vec3 { transform[1] }), glm::length(glm::vec3 { transform[2] }) };
+        glm::mat3 basis { glm::vec3 { transform[0] } / scale.x, glm::vec3 { transform[1] } / scale.y, glm::vec3 { transform[2] } / scale.z };
+        if (glm::determinant(basis) < 0.0f) {
+            scale.x = -scale.x;
+            basis[0] = -basis[0];
+        }
+        rotation = glm::normalize(glm::quat_cast(basis));
+    }
+}
+
+float AngleBetween(glm::quat const &a, glm::quat const &b) {
+    glm::vec4 from { a.x, a.y, a.z, a.w };
+    glm::vec4 to { b.x, b.y, b.z, b.w };
+    float chord = glm::length(glm::dot(from, to) < 0.0f ? from + to : from - to);
+    return 4.0f * std::asin(std::min(1.0f, chord * 0.5f));
+}
+
+void Pose::Resize(unsigned int count) {
+    this->count = count;
+    paddedCount = (count + WIDTH - 1) / WIDTH * WIDTH;
+    data.assign(COMPONENT_COUNT * paddedCount, 0.0f);
+    std::fill(Get(RW), Get(RW) + paddedCount, 1.0f);
+    std::fill(Get(SX), Get(SX) + 3 * paddedCount, 1.0f);
+}
+
+glm::vec3 Pose::GetTranslation(unsigned int node) const {
+    return glm::vec3 { Get(TX)[node], Get(TY)[node], Get(TZ)[node] };
+}
+
+glm::quat Pose::GetRotation(unsigned int node) const {
+    return glm::quat { Get(RW)[node], Get(RX)[node], Get(RY)[node], Get(RZ)[node] };
+}
+
+glm::vec3 Pose::GetScale(unsigned int node) const {
+    return glm::vec3 { Get(SX)[node], Get(SY)[node], Get(SZ)[node] };
+}
+
+void Pose::Blend(Pose const &a, Pose const &b, float weight, Pose &out) {
+    unsigned int padded = a.paddedCount;
+    if (out.paddedCount != padded) {
+        out.Resize(a.count);
+    }
+#if defined(__SSE2__)
+    __m128 w = _mm_set1_ps(weight);
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 signBit = _mm_set1_ps(-0.0f);
+    for (unsigned int i = 0; i < padded; i += WIDTH) {
+        for (int c : { TX, TY, TZ, SX, SY, SZ }) {
+            __m128 va = _mm_loadu_ps(a.Get(static_cast<Component>(c)) + i);
+            __m128 vb = _mm_loadu_ps(b.Get(static_cast<Component>(c)) + i);
+            _mm_storeu_ps(out.Get(static_cast<Component>(c)) + i, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), w)));
+        }
+        __m128 ax = _mm_loadu_ps(a.Get(RX) + i), ay = _mm_loadu_ps(a.Get(RY) + i), az = _mm_loadu_ps(a.Get(RZ) + i), aw = _mm_loadu_ps(a.Get(RW) + i);
+        __m128 bx = _mm_loadu_ps(b.Get(RX) + i), by = _mm_loadu_ps(b.Get(RY) + i), bz = _mm_loadu_ps(b.Get(RZ) + i), bw = _mm_loadu_ps(b.Get(RW) + i);
+        // take the shorter arc: flip b's weight wherever the dot product is negative
+        __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+        __m128 wb = _mm_xor_ps(w, _mm_and_ps(dot, signBit));
+        __m128 wa = _mm_sub_ps(one, w);
+        __m128 x = _mm_add_ps(_mm_mul_ps(ax, wa), _mm_mul_ps(bx, wb));
+        __m128 y = _mm_add_ps(_mm_mul_ps(ay, wa), _mm_mul_ps(by, wb));
+        __m128 z = _mm_add_ps(_mm_mul_ps(az, wa), _mm_mul_ps(bz, wb));
+        __m128 qw = _mm_add_ps(_mm_mul_ps(aw, wa), _mm_mul_ps(bw, wb));
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(qw, qw))));
+        __m128 inverse = _mm_div_ps(one, length);
+        _mm_storeu_ps(out.Get(RX) + i, _mm_mul_ps(x, inverse));
+        _mm_storeu_ps(out.Get(RY) + i, _mm_mul_ps(y, inverse));
+        _mm_storeu_ps(out.Get(RZ) + i, _mm_mul_ps(z, inverse));
+        _mm_storeu_ps(out.Get(RW) + i, _mm_mul_ps(qw, inverse));
+    }
+#else
+    for (unsigned int i = 0; i < padded; i++) {
+        for (int c : { TX, TY, TZ, SX, SY, SZ }) {
+            float va = a.Get(static_cast<Component>(c))[i];
+            out.Get(static_cast<Component>(c))[i] = va + (b.Get(static_cast<Component>(c))[i] - va) * weight;
+        }
+        glm::quat q = nlerp(a.GetRotation(i), b.GetRotation(i), weight);
+        out.Get(RX)[i] = q.x;
+        out.Get(RY)[i] = q.y;
+        out.Get(RZ)[i] = q.z;
+        out.Get(RW)[i] = q.w;
+    }
+#endif
+}
+
+Skeleton::Skeleton(SceneGraph const &nodes, std::unordered_map<string, BoneInfo> const &bones) {
+    for (unsigned int i = 0; i < nodes.Size(); i++) {
+        parents.push_back(nodes.GetParent(i));
+        names.push_back(nodes.GetName(i));
+        bindTransforms.push_back(nodes.GetLocalTransform(i));
+    }
+    boneNodes.assign(bones.size(), SceneGraph::NO_PARENT);
+    boneOffsets.assign(bones.size(), glm::mat4 { 1.0f });
+    for (auto const &[name, bone] : bones) {
+        boneNodes[bone.Id] = FindNode(name);
+        boneOffsets[bone.Id] = bone.Offset;
+    }
+}
+
+int Skeleton::FindNode(string const &name) const {
+    auto found = std::find(names.begin(), names.end(), name);
+    return found == names.end() ? SceneGraph::NO_PARENT : static_cast<int>(found - names.begin());
+}
+
+void Skeleton::ComputeBoneMatrices(Pose const &pose, glm::mat4 *modelTransforms, glm::mat4 *bones) const {
+    for (unsigned int i = 0; i < parents.size(); i++) {
+        glm::mat4 local = glm::mat4_cast(pose.GetRotation(i));
+        glm::vec3 scale = pose.GetScale(i);
+        local[0] *= scale.x;
+        local[1] *= scale.y;
+        local[2] *= scale.z;
+        local[3] = glm::vec4 { pose.GetTranslation(i), 1.0f };
+        modelTransforms[i] = parents[i] == SceneGraph::NO_PARENT ? local : modelTransforms[parents[i]] * local;
+    }
+    for (unsigned int i = 0; i < boneNodes.size(); i++) {
+        bones[i] = boneNodes[i] == SceneGraph::NO_PARENT ? glm::mat4 { 1.0f } : modelTransforms[boneNodes[i]] * boneOffsets[i];
+    }
+}
+
+void AnimationClip::ChannelSet::Reserve(size_t channels) {
+    Channels.reserve(channels);
+}
+
+AnimationClip::AnimationClip(string name, float duration, vector<AnimationTrack> const &tracks, Skeleton const &skeleton,
+                             CompressionSettings const &settings) :
+    name(std::move(name)), duration(duration), sampleRate(settings.SampleRate), trackCount(skeleton.GetNodeCount()) {
+    vector<AnimationTrack const *> nodeTracks(trackCount, nullptr);
+    for (auto const &track : tracks) {
+        int node = skeleton.FindNode(track.Node);
+        if (node != SceneGraph::NO_PARENT) {
+            nodeTracks[node] = &track;
+        }
+    }
+    unsigned int frameCount = std::min(MAX_FRAMES, static_cast<unsigned int>(std::lround(duration * sampleRate)) + 1);
+    unsigned int paddedCount = (trackCount + Pose::WIDTH - 1) / Pose::WIDTH * Pose::WIDTH;
+    positions.Reserve(paddedCount);
+    rotations.Reserve(paddedCount);
+    scales.Reserve(paddedCount);
+
+    // quantize the kept keys of a position or scale channel to 16 bits within its range
+    auto addVectors = [](ChannelSet &set, vector<glm::vec3> const &samples, float tolerance) {
+        vector<unsigned int> keys = reduceKeys(samples, tolerance, [](glm::vec3 const &a, glm::vec3 const &b) { return glm::length(a - b); });
+        Channel channel { static_cast<unsigned int>(set.Frames.size()), static_cast<unsigned int>(keys.size()), samples[keys[0]], glm::vec3 { 0.0f } };
+        glm::vec3 rangeMax = channel.RangeMin;
+        for (unsigned int key : keys) {
+            channel.RangeMin = glm::min(channel.RangeMin, samples[key]);
+            rangeMax = glm::max(rangeMax, samples[key]);
+        }
+        channel.RangeExtent = rangeMax - channel.RangeMin;
+        for (unsigned int key : keys) {
+            set.Frames.push_back(static_cast<std::uint16_t>(key));
+            for (int c = 0; c < 3; c++) {
+                float normalized = channel.RangeExtent[c] > 0.0f ? (samples[key][c] - channel.RangeMin[c]) / channel.RangeExtent[c] : 0.0f;
+                set.Values.push_back(static_cast<std::uint16_t>(std::lround(normalized * VECTOR_STEPS)));
+            }
+        }
+        set.Channels.push_back(channel);
+    };
+    auto addRotations = [this](vector<glm::quat> const &samples, float tolerance) {
+        vector<unsigned int> keys = reduceKeys(samples, tolerance, AngleBetween);
+        rotations.Channels.push_back(Channel { static_cast<unsigned int>(rotations.Frames.size()), static_cast<unsigned int>(keys.size()),
+                                               glm::vec3 { 0.0f }, glm::vec3 { 0.0f } });
+        for (unsigned int key : keys) {
+            rotations.Frames.push_back(static_cast<std::uint16_t>(key));
+            std::uint16_t packed[3];
+            encodeRotation(samples[key], packed);
+            rotations.Values.insert(rotations.Values.end(), packed, packed + 3);
+        }
+    };
+
+    for (unsigned int node = 0; node < trackCount; node++) {
+        glm::vec3 bindPosition, bindScale;
+        glm::quat bindRotation;
+        decompose(skeleton.GetBindTransform(node), bindPosition, bindRotation, bindScale);
+        AnimationTrack const *track = nodeTracks[node];
+
+        // resample onto the frame grid; channels the source leaves out keep the bind pose
+        vector<glm::vec3> positionSamples, scaleSamples;
+        vector<glm::quat> rotationSamples;
+        for (unsigned int frame = 0; frame < frameCount; frame++) {
+            float time = std::min(frame / sampleRate, duration);
+            positionSamples.push_back(track && !track->Positions.empty() ? sampleTrack(track->PositionTimes, track->Positions, time) : bindPosition);
+            scaleSamples.push_back(track && !track->Scales.empty() ? sampleTrack(track->ScaleTimes, track->Scales, time) : bindScale);
+            glm::quat rotation = track && !track->Rotations.empty() ? sampleTrack(track->RotationTimes, track->Rotations, time) : bindRotation;
+            // keep neighbouring samples in the same hemisphere so interpolating them takes the short way
+            if (!rotationSamples.empty() && glm::dot(rotationSamples.back(), rotation) < 0.0f) {
+                rotation = -rotation;
+            }
+            rotationSamples.push_back(glm::normalize(rotation));
+        }
+        addVectors(positions, positionSamples, settings.PositionTolerance);
+        addVectors(scales, scaleSamples, settings.ScaleTolerance);
+        addRotations(rotationSamples, settings.RotationTolerance);
+    }
+
+    // pad with copies of the last channel so the sampler always reads full groups
+    for (ChannelSet *set : { &positions, &rotations, &scales }) {
+        while (!set->Channels.empty() && set->Channels.size() < paddedCount) {
+            set->Channels.push_back(set->Channels.back());
+        }
+        set->Channels.shrink_to_fit();
+        set->Frames.shrink_to_fit();
+        set->Values.shrink_to_fit();
+    }
+}
+
+size_t AnimationClip::GetMemoryUsage() const {
+    size_t bytes = sizeof(*this) + name.capacity();
+    for (ChannelSet const *set : { &positions, &rotations, &scales }) {
+        bytes += set->Channels.capacity() * sizeof(Channel) + set->Frames.capacity() * sizeof(std::uint16_t) +
+                 set->Values.capacity() * sizeof(std::uint16_t);
+    }
+    return bytes;
+}
+
+void AnimationClip::sampleVectors(ChannelSet const &set, float frame, unsigned int first, float *x, float *y, float *z) const {
+    alignas(16) float from[3][Pose::WIDTH], to[3][Pose::WIDTH], rangeMin[3][Pose::WIDTH], step[3][Pose::WIDTH], t[Pose::WIDTH];
+    for (unsigned int lane = 0; lane < Pose::WIDTH; lane++) {
+        Channel const &channel = set.Channels[first + lane];
+        unsigned int key0, key1;
+        findKeys(&set.Frames[channel.FirstKey], channel.KeyCount, frame, key0, key1, t[lane]);
+        std::uint16_t const *value0 = &set.Values[(channel.FirstKey + key0) * 3];
+        std::uint16_t const *value1 = &set.Values[(channel.FirstKey + key1) * 3];
+        for (int c = 0; c < 3; c++) {
+            from[c][lane] = value0[c];
+            to[c][lane] = value1[c];
+            rangeMin[c][lane] = channel.RangeMin[c];
+            step[c][lane] = channel.RangeExtent[c] / VECTOR_STEPS;
+        }
+    }
+    float *outputs[3] = { x + first, y + first, z + first };
+    // interpolating the quantized values is the same as interpolating the decoded ones
+#if defined(__SSE2__)
+    __m128 vt = _mm_load_ps(t);
+    for (int c = 0; c < 3; c++) {
+        __m128 a = _mm_load_ps(from[c]);
+        __m128 value = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(to[c]), a), vt));
+        _mm_storeu_ps(outputs[c], _mm_add_ps(_mm_load_ps(rangeMin[c]), _mm_mul_ps(value, _mm_load_ps(step[c]))));
+    }
+#else
+    for (int c = 0; c < 3; c++) {
+        for (unsigned int lane = 0; lane < Pose::WIDTH; lane++) {
+            float value = from[c][lane] + (to[c][lane] - from[c][lane]) * t[lane];
+            outputs[c][lane] = rangeMin[c][lane] + value * step[c][lane];
+        }
+    }
+#endif
+}
+
+#if defined(__SSE2__)
+namespace {
+    // decodes four smallest-three rotations held as 15-bit values and the index of the dropped component
+    void decodeRotations(__m128i const packed[3], __m128i largest, __m128 &x, __m128 &y, __m128 &z, __m128 &w) {
+        __m128 scale = _mm_set1_ps(2.0f * ROTATION_RANGE / ROTATION_STEPS);
+        __m128 offset = _mm_set1_ps(ROTATION_RANGE);
+        __m128 a = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(packed[0]), scale), offset);
+        __m128 b = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(packed[1]), scale), offset);
+        __m128 c = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(packed[2]), scale), offset);
+        __m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, a), _mm_mul_ps(b, b)), _mm_mul_ps(c, c));
+        __m128 dropped = _mm_sqrt_ps(_mm_max_ps(_mm_setzero_ps(), _mm_sub_ps(_mm_set1_ps(1.0f), sum)));
+        __m128 is0 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_set1_epi32(0)));
+        __m128 is1 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_set1_epi32(1)));
+        __m128 is2 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_set1_epi32(2)));
+        __m128 is3 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_set1_epi32(3)));
+        auto select = [](__m128 mask, __m128 yes, __m128 no) { return _mm_or_ps(_mm_and_ps(mask, yes), _mm_andnot_ps(mask, no)); };
+        // the kept components fill the other slots in order: 0 -> (d,a,b,c), 1 -> (a,d,b,c), 2 -> (a,b,d,c), 3 -> (a,b,c,d)
+        x = select(is0, dropped, a);
+        y = select(is0, a, select(is1, dropped, b));
+        z = select(is3, c, select(is2, dropped, b));
+        w = select(is3, dropped, c);
+    }
+}
+#else
+namespace {
+    glm::quat decodeRotation(std::uint16_t const *in) {
+        int largest = ((in[0] >> 15) << 1) | (in[1] >> 15);
+        float values[3];
+        for (int i = 0; i < 3; i++) {
+            values[i] = ((in[i] & 0x7FFF) / ROTATION_STEPS * 2.0f - 1.0f) * ROTATION_RANGE;
+        }
+        float dropped = std::sqrt(std::max(0.0f, 1.0f - values[0] * values[0] - values[1] * values[1] - values[2] * values[2]));
+        float components[4];
+        for (int i = 0, k = 0; i < 4; i++) {
+            components[i] = i == largest ? dropped : values[k++];
+        }
+        return glm::quat { components[3], components[0], components[1], components[2] };
+    }
+}
+#endif
+
+void AnimationClip::sampleRotations(float frame, unsigned int first, float *x, float *y, float *z, float *w) const {
+    std::uint16_t const *keys0[Pose::WIDTH], *keys1[Pose::WIDTH];
+    alignas(16) float t[Pose::WIDTH];
+    for (unsigned int lane = 0; lane < Pose::WIDTH; lane++) {
+        Channel const &channel = rotations.Channels[first + lane];
+        unsigned int key0, key1;
+        findKeys(&rotations.Frames[channel.FirstKey], channel.KeyCount, frame, key0, key1, t[lane]);
+        keys0[lane] = &rotations.Values[(channel.FirstKey + key0) * 3];
+        keys1[lane] = &rotations.Values[(channel.FirstKey + key1) * 3];
+    }
+#if defined(__SSE2__)
+    // gather each lane's keys into component registers, the dropped index split off the top bits
+    auto load = [](std::uint16_t const *const *keys, __m128i *packed, __m128i &largest) {
+        for (int c = 0; c < 3; c++) {
+            packed[c] = _mm_setr_epi32(keys[0][c] & 0x7FFF, keys[1][c] & 0x7FFF, keys[2][c] & 0x7FFF, keys[3][c] & 0x7FFF);
+        }
+        auto index = [](std::uint16_t const *key) { return ((key[0] >> 15) << 1) | (key[1] >> 15); };
+        largest = _mm_setr_epi32(index(keys[0]), index(keys[1]), index(keys[2]), index(keys[3]));
+    };
+    __m128i packed[3], largest;
+    __m128 ax, ay, az, aw, bx, by, bz, bw;
+    load(keys0, packed, largest);
+    decodeRotations(packed, largest, ax, ay, az, aw);
+    load(keys1, packed, largest);
+    decodeRotations(packed, largest, bx, by, bz, bw);
+    __m128 vt = _mm_load_ps(t);
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+    __m128 wb = _mm_xor_ps(vt, _mm_and_ps(dot, _mm_set1_ps(-0.0f)));
+    __m128 wa = _mm_sub_ps(one, vt);
+    __m128 qx = _mm_add_ps(_mm_mul_ps(ax, wa), _mm_mul_ps(bx, wb));
+    __m128 qy = _mm_add_ps(_mm_mul_ps(ay, wa), _mm_mul_ps(by, wb));
+    __m128 qz = _mm_add_ps(_mm_mul_ps(az, wa), _mm_mul_ps(bz, wb));
+    __m128 qw = _mm_add_ps(_mm_mul_ps(aw, wa), _mm_mul_ps(bw, wb));
+    __m128 inverse = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(qx, qx), _mm_mul_ps(qy, qy)),
+                                                           _mm_add_ps(_mm_mul_ps(qz, qz), _mm_mul_ps(qw, qw)))));
+    _mm_storeu_ps(x + first, _mm_mul_ps(qx, inverse));
+    _mm_storeu_ps(y + first, _mm_mul_ps(qy, inverse));
+    _mm_storeu_ps(z + first, _mm_mul_ps(qz, inverse));
+    _mm_storeu_ps(w + first, _mm_mul_ps(qw, inverse));
+#else
+    for (unsigned int lane = 0; lane < Pose::WIDTH; lane++) {
+        glm::quat q = nlerp(decodeRotation(keys0[lane]), decodeRotation(keys1[lane]), t[lane]);
+        x[first + lane] = q.x;
+        y[first + lane] = q.y;
+        z[first + lane] = q.z;
+        w[first + lane] = q.w;
+    }
+#endif
+}
+
+void AnimationClip::Sample(float time, Pose &pose) const {
+    if (pose.Size() != trackCount) {
+        pose.Resize(trackCount);
+    }
+    float wrapped = duration > 0.0f ? std::fmod(time, duration) : 0.0f;
+    if (wrapped < 0.0f) {
+        wrapped += duration;
+    }
+    float frame = wrapped * sampleRate;
+    for (unsigned int first = 0; first < pose.GetPaddedSize(); first += Pose::WIDTH) {
+        sampleVectors(positions, frame, first, pose.Get(Pose::TX), pose.Get(Pose::TY), pose.Get(Pose::TZ));
+        sampleRotations(frame, first, pose.Get(Pose::RX), pose.Get(Pose::RY), pose.Get(Pose::RZ), pose.Get(Pose::RW));
+        sampleVectors(scales, frame, first, pose.Get(Pose::SX), pose.Get(Pose::SY), pose.Get(Pose::SZ));
+    }
+}
+
+CrowdAnimator::CrowdAnimator(Skeleton const &skeleton, unsigned int threadCount) : skeleton(skeleton), threadCount(0), frame(0) {
+    SetThreadCount(threadCount);
+}
+
+void CrowdAnimator::SetThreadCount(unsigned int count) {
+    threadCount = count == 0 ? std::max(1u, std::thread::hardware_concurrency()) : count;
+    scratch.resize(threadCount);
+}
+
+unsigned int CrowdAnimator::Add(Character const &character) {
+    characters.push_back(character);
+    bones.resize(bones.size() + skeleton.GetBoneCount(), glm::mat4 { 1.0f });
+    return static_cast<unsigned int>(characters.size() - 1);
+}
+
+unsigned int CrowdAnimator::GetUpdateInterval(unsigned int character, glm::vec3 const &viewer) const {
+    float distance = glm::length(characters[character].Position - viewer);
+    unsigned int interval = 1;
+    for (float lodDistance : lodDistances) {
+        if (distance > lodDistance) {
+            interval *= 2;
+        }
+    }
+    return interval;
+}
+
+void CrowdAnimator::animate(unsigned int index, Scratch &work) {
+    Character const &character = characters[index];
+    if (!character.Clip) {
+        return;
+    }
+    character.Clip->Sample(character.Time, work.Primary);
+    if (character.BlendClip && character.BlendWeight > 0.0f) {
+        character.BlendClip->Sample(character.Time, work.Secondary);
+        Pose::Blend(work.Primary, work.Secondary, character.BlendWeight, work.Primary);
+    }
+    work.ModelTransforms.resize(skeleton.GetNodeCount());
+    skeleton.ComputeBoneMatrices(work.Primary, work.ModelTransforms.data(), &bones[index * skeleton.GetBoneCount()]);
+}
+
+CrowdAnimator::UpdateStats CrowdAnimator::Update(float deltaTime, glm::vec3 const &viewer) {
+    PROFILE_ZONE("CrowdAnimator::Update");
+    auto start = std::chrono::steady_clock::now();
+    UpdateStats stats;
+    vector<unsigned int> due;
+    due.reserve(characters.size());
+    for (unsigned int i = 0; i < characters.size(); i++) {
+        characters[i].Time += deltaTime * characters[i].Speed;
+        // the character index staggers the far ones across frames
+        if ((frame + i) % GetUpdateInterval(i, viewer) == 0) {
+            due.push_back(i);
+        }
+    }
+    frame++;
+    stats.Sampled = static_cast<unsigned int>(due.size());
+    stats.Skipped = static_cast<unsigned int>(characters.size() - due.size());
+
+    std::atomic<unsigned int> nextChunk { 0 };
+    unsigned int chunkCount = static_cast<unsigned int>((due.size() + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    auto work = [&](Scratch &local) {
+        PROFILE_ZONE("animate");
+        for (unsigned int chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++) {
+            size_t end = std::min(due.size(), static_cast<size_t>(chunk + 1) * CHUNK_SIZE);
+            for (size_t i = chunk * CHUNK_SIZE; i < end; i++) {
+                animate(due[i], local);
+            }
+        }
+    };
+    unsigned int workers = std::min(threadCount, chunkCount);
+    if (workers <= 1) {
+        work(scratch[0]);
+    } else {
+        // the calling thread takes chunks too
+        vector<std::thread> threads;
+        for (unsigned int i = 1; i < workers; i++) {
+            threads.emplace_back([&work, &local = scratch[i]] {
+                Profiler::SetThreadName("crowd worker");
+                work(local);
+            });
+        }
+        work(scratch[0]);
+        for (auto &thread : threads) {
+            thread.join();
+        }
+    }
+    stats.Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
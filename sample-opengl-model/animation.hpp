@@ -0,0 +1,173 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "scenegraph.hpp"
+#include "skinning.hpp"
+
+// Keyframes of one node as imported, with times in seconds
+struct AnimationTrack {
+    std::string Node;
+    std::vector<float> PositionTimes;
+    std::vector<glm::vec3> Positions;
+    std::vector<float> RotationTimes;
+    std::vector<glm::quat> Rotations;
+    std::vector<float> ScaleTimes;
+    std::vector<glm::vec3> Scales;
+};
+
+struct CompressionSettings {
+    float SampleRate = 30.0f; // keys are snapped to frames of this rate
+    // a key is dropped when interpolating its neighbours reproduces it this closely
+    float PositionTolerance = 0.0005f;
+    float RotationTolerance = 0.0005f; // radians
+    float ScaleTolerance = 0.0005f;
+};
+
+// Angle of the rotation taking one orientation to the other. Uses the chord between the quaternions, which stays
+// precise for the tiny angles compression tolerances are about, where acos of their dot product does not
+float AngleBetween(glm::quat const &a, glm::quat const &b);
+
+// Local transforms of every node in structure-of-arrays form, padded to a multiple of Pose::WIDTH so the
+// sampling and blending kernels always work on full groups of nodes
+class Pose {
+    public:
+        static unsigned int const WIDTH = 4;
+        enum Component { TX, TY, TZ, RX, RY, RZ, RW, SX, SY, SZ, COMPONENT_COUNT };
+    private:
+        unsigned int count;
+        unsigned int paddedCount;
+        std::vector<float> data;
+    public:
+        Pose() : count(0), paddedCount(0) {}
+        void Resize(unsigned int count);
+        float *Get(Component component) { return &data[component * paddedCount]; }
+        float const *Get(Component component) const { return &data[component * paddedCount]; }
+        glm::vec3 GetTranslation(unsigned int node) const;
+        glm::quat GetRotation(unsigned int node) const;
+        glm::vec3 GetScale(unsigned int node) const;
+        unsigned int Size() const { return count; }
+        unsigned int GetPaddedSize() const { return paddedCount; }
+        // out = a * (1 - weight) + b * weight, rotations normalized-lerped along the shorter arc
+        static void Blend(Pose const &a, Pose const &b, float weight, Pose &out);
+};
+
+// Node hierarchy and bind pose the clips animate, plus the bones that skin with it
+class Skeleton {
+    private:
+        std::vector<int> parents; // depth-first, parents first
+        std::vector<std::string> names;
+        std::vector<glm::mat4> bindTransforms; // local transforms of the nodes no clip animates
+        std::vector<int> boneNodes; // by bone id
+        std::vector<glm::mat4> boneOffsets;
+    public:
+        Skeleton() = default;
+        Skeleton(SceneGraph const &nodes, std::unordered_map<std::string, BoneInfo> const &bones);
+        int FindNode(std::string const &name) const;
+        // Model-space transforms of every node and the skinning matrix of every bone for a pose
+        void ComputeBoneMatrices(Pose const &pose, glm::mat4 *modelTransforms, glm::mat4 *bones) const;
+
+        unsigned int GetNodeCount() const { return static_cast<unsigned int>(parents.size()); }
+        unsigned int GetBoneCount() const { return static_cast<unsigned int>(boneNodes.size()); }
+        glm::mat4 const &GetBindTransform(unsigned int node) const { return bindTransforms[node]; }
+};
+
+// A compressed animation. Every node of the skeleton gets a track, in node order, so sampling writes a pose with
+// no indirection; nodes the source does not animate hold a single bind-pose key. Keys sit on frames of the sample
+// rate and carry only what linear interpolation cannot reconstruct within the tolerances. Rotations are stored as
+// the three smallest components of the quaternion in 15 bits each (6 bytes), positions and scales as 16 bits per
+// component within the range of their channel.
+class AnimationClip {
+    private:
+        struct Channel {
+            unsigned int FirstKey;
+            unsigned int KeyCount;
+            glm::vec3 RangeMin; // positions and scales only
+            glm::vec3 RangeExtent;
+        };
+        // one channel kind: per-track channels and their keys
+        struct ChannelSet {
+            std::vector<Channel> Channels;
+            std::vector<std::uint16_t> Frames;
+            std::vector<std::uint16_t> Values; // three per key
+            void Reserve(size_t channels);
+        };
+        std::string name;
+        float duration;
+        float sampleRate;
+        unsigned int trackCount;
+        ChannelSet positions, rotations, scales;
+
+        void sampleVectors(ChannelSet const &set, float frame, unsigned int first, float *x, float *y, float *z) const;
+        void sampleRotations(float frame, unsigned int first, float *x, float *y, float *z, float *w) const;
+    public:
+        AnimationClip() : duration(0.0f), sampleRate(30.0f), trackCount(0) {}
+        // Tracks are matched to skeleton nodes by name, unmatched tracks are ignored
+        AnimationClip(std::string name, float duration, std::vector<AnimationTrack> const &tracks, Skeleton const &skeleton,
+                      CompressionSettings const &settings = CompressionSettings {});
+        // Samples every track at a time that wraps around the duration, four tracks at a time
+        void Sample(float time, Pose &pose) const;
+
+        std::string const &GetName() const { return name; }
+        float GetDuration() const { return duration; }
+        unsigned int GetTrackCount() const { return trackCount; }
+        size_t GetKeyCount() const { return positions.Frames.size() + rotations.Frames.size() + scales.Frames.size(); }
+        size_t GetMemoryUsage() const;
+};
+
+// Animates a crowd of characters sharing a skeleton. Each update samples (and optionally blends two clips for)
+// the characters due this frame on several threads, which take chunks of characters from a shared counter.
+// Characters far from the viewer are re-sampled less often: beyond LodDistances[i] only every 2^(i+1) frames,
+// staggered so the work spreads evenly, while their time keeps advancing every frame.
+class CrowdAnimator {
+    public:
+        struct Character {
+            AnimationClip const *Clip = nullptr;
+            AnimationClip const *BlendClip = nullptr; // optional second clip mixed in by BlendWeight
+            float BlendWeight = 0.0f;
+            float Time = 0.0f;
+            float Speed = 1.0f;
+            glm::vec3 Position { 0.0f };
+        };
+        struct UpdateStats {
+            unsigned int Sampled = 0;
+            unsigned int Skipped = 0;
+            double Milliseconds = 0.0;
+        };
+    private:
+        // per-thread scratch so workers never allocate or share
+        struct Scratch {
+            Pose Primary;
+            Pose Secondary;
+            std::vector<glm::mat4> ModelTransforms;
+        };
+        Skeleton const &skeleton;
+        std::vector<Character> characters;
+        std::vector<glm::mat4> bones; // GetBoneCount() per character
+        std::vector<Scratch> scratch;
+        unsigned int threadCount;
+        unsigned int frame;
+        std::vector<float> lodDistances;
+
+        void animate(unsigned int character, Scratch &work);
+    public:
+        static unsigned int const CHUNK_SIZE = 16;
+
+        CrowdAnimator(Skeleton const &skeleton, unsigned int threadCount = 0);
+        unsigned int Add(Character const &character);
+        Character &GetCharacter(unsigned int index) { return characters[index]; }
+        // ascending distances; empty turns the level of detail off
+        void SetLodDistances(std::vector<float> distances) { lodDistances = std::move(distances); }
+        unsigned int GetUpdateInterval(unsigned int character, glm::vec3 const &viewer) const;
+        UpdateStats Update(float deltaTime, glm::vec3 const &viewer);
+        // Bone matrices from the character's latest sample
+        glm::mat4 const *GetBones(unsigned int character) const { return &bones[character * skeleton.GetBoneCount()]; }
+        size_t Size() const { return characters.size(); }
+        void SetThreadCount(unsigned int count);
+};
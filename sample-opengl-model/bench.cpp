@@ -0,0 +1,357 @@
+// CPU benchmarks for the model-side data structures, animation and tangent frames; no GL context is needed.
+// Build with `make bench` and run ./bench. `./bench --tangents` runs only the QTangent shading check, which is
+// what `make check` runs; it fails when the check does.
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "animation.hpp"
+#include "mesh.hpp"
+#include "scenegraph.hpp"
+#include "tangents.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static glm::mat4 spin(float angle) {
+    glm::mat4 transform = glm::translate(glm::mat4 { 1.0f }, glm::vec3 { 0.0f, 1.0f, 0.0f });
+    return glm::rotate(transform, angle, glm::vec3 { 0.0f, 1.0f, 0.0f });
+}
+
+// chains of `depth` nodes under a single root, like long skeletons or deeply nested exports
+static void buildDeep(SceneGraph &graph, unsigned int chains, unsigned int depth) {
+    unsigned int root = graph.AddNode(SceneGraph::NO_PARENT, glm::mat4 { 1.0f }, "root");
+    for (unsigned int chain = 0; chain < chains; chain++) {
+        int parent = static_cast<int>(root);
+        for (unsigned int i = 0; i < depth; i++) {
+            parent = static_cast<int>(graph.AddNode(parent, spin(0.01f * i)));
+        }
+    }
+}
+
+// every node hangs directly from the root, like a flat level export
+static void buildWide(SceneGraph &graph, unsigned int count) {
+    unsigned int root = graph.AddNode(SceneGraph::NO_PARENT, glm::mat4 { 1.0f }, "root");
+    for (unsigned int i = 0; i < count; i++) {
+        graph.AddNode(static_cast<int>(root), spin(0.01f * i));
+    }
+}
+
+// full: the root moves, so everything is recomputed; sparse: a few random nodes move every frame
+static void benchUpdates(char const *name, SceneGraph &graph, unsigned int sparseCount) {
+    graph.UpdateWorldTransforms();
+    unsigned int const frames = 200;
+    std::mt19937 rng { 1234 };
+    std::uniform_int_distribution<unsigned int> pick { 1, static_cast<unsigned int>(graph.Size() - 1) };
+
+    unsigned long long touched = 0;
+    auto start = Clock::now();
+    for (unsigned int frame = 0; frame < frames; frame++) {
+        graph.SetLocalTransform(0, spin(0.001f * frame));
+        touched += graph.UpdateWorldTransforms();
+    }
+    double fullMs = millisecondsSince(start);
+    double fullRate = touched / (fullMs / 1000.0);
+
+    touched = 0;
+    std::vector<unsigned int> picks(frames * sparseCount);
+    for (auto &node : picks) {
+        node = pick(rng);
+    }
+    start = Clock::now();
+    for (unsigned int frame = 0; frame < frames; frame++) {
+        for (unsigned int i = 0; i < sparseCount; i++) {
+            unsigned int node = picks[frame * sparseCount + i];
+            graph.SetLocalTransform(node, graph.GetLocalTransform(node) * spin(0.001f));
+        }
+        touched += graph.UpdateWorldTransforms();
+    }
+    double sparseMs = millisecondsSince(start);
+
+    std::printf("%-26s %8zu nodes | full %7.3f ms/frame %6.1f M transforms/s | %u moved %7.3f ms/frame, %9.0f nodes/frame\n",
+                name, graph.Size(), fullMs / frames, fullRate / 1e6, sparseCount, sparseMs / frames,
+                static_cast<double>(touched) / frames);
+}
+
+unsigned int const LIMBS = 3;
+unsigned int const LIMB_LENGTH = 21;
+float const CLIP_DURATION = 2.0f;
+float const SOURCE_RATE = 60.0f; // keys per second of the uncompressed tracks, as exporters bake them
+
+// a root with a few long limbs, every node but the root a bone
+static void buildSkeleton(SceneGraph &graph, std::unordered_map<std::string, BoneInfo> &bones) {
+    graph.AddNode(SceneGraph::NO_PARENT, glm::mat4 { 1.0f }, "root");
+    for (unsigned int limb = 0; limb < LIMBS; limb++) {
+        int parent = 0;
+        for (unsigned int i = 0; i < LIMB_LENGTH; i++) {
+            std::string name = "bone" + std::to_string(limb) + "_" + std::to_string(i);
+            parent = static_cast<int>(graph.AddNode(parent, glm::translate(glm::mat4 { 1.0f }, glm::vec3 { 0.0f, 0.1f, 0.0f }), name));
+            bones.emplace(name, BoneInfo { static_cast<int>(bones.size()), glm::mat4 { 1.0f } });
+        }
+    }
+}
+
+// every limb sways, the first bone of each also bobs; the tips are left to the bind pose
+static std::vector<AnimationTrack> buildTracks(SceneGraph const &graph, float phase) {
+    std::vector<AnimationTrack> tracks;
+    unsigned int keys = static_cast<unsigned int>(CLIP_DURATION * SOURCE_RATE) + 1;
+    for (unsigned int node = 1; node < graph.Size(); node++) {
+        unsigned int along = (node - 1) % LIMB_LENGTH;
+        if (along >= LIMB_LENGTH - 3) {
+            continue;
+        }
+        AnimationTrack track;
+        track.Node = graph.GetName(node);
+        for (unsigned int k = 0; k < keys; k++) {
+            float time = k / SOURCE_RATE;
+            float angle = 0.3f * std::sin(glm::two_pi<float>() * time / CLIP_DURATION + phase + 0.2f * node);
+            track.RotationTimes.push_back(time);
+            track.Rotations.push_back(glm::angleAxis(angle, glm::normalize(glm::vec3 { 1.0f, 0.0f, 0.3f * (node % 3) })));
+            track.PositionTimes.push_back(time);
+            float bob = along == 0 ? 0.05f * std::sin(glm::two_pi<float>() * 2.0f * time / CLIP_DURATION) : 0.0f;
+            track.Positions.push_back(glm::vec3 { 0.0f, 0.1f + bob, 0.0f });
+            track.ScaleTimes.push_back(time);
+            track.Scales.push_back(glm::vec3 { 1.0f });
+        }
+        tracks.push_back(std::move(track));
+    }
+    return tracks;
+}
+
+// the straightforward sampler the clip replaces: search each key array, then lerp and slerp
+template <typename T>
+static T sampleRaw(std::vector<float> const &times, std::vector<T> const &values, float time) {
+    size_t next = std::upper_bound(times.begin(), times.end(), time) - times.begin();
+    if (next == 0 || next == times.size()) {
+        return values[next == 0 ? 0 : next - 1];
+    }
+    float t = (time - times[next - 1]) / (times[next] - times[next - 1]);
+    if constexpr (std::is_same_v<T, glm::quat>) {
+        return glm::slerp(values[next - 1], values[next], t);
+    } else {
+        return glm::mix(values[next - 1], values[next], t);
+    }
+}
+
+static size_t rawMemory(std::vector<AnimationTrack> const &tracks) {
+    size_t bytes = 0;
+    for (auto const &track : tracks) {
+        bytes += track.PositionTimes.size() * (sizeof(float) + sizeof(glm::vec3)) + track.RotationTimes.size() * (sizeof(float) + sizeof(glm::quat)) +
+                 track.ScaleTimes.size() * (sizeof(float) + sizeof(glm::vec3));
+    }
+    return bytes;
+}
+
+static void benchAnimation() {
+    SceneGraph graph;
+    std::unordered_map<std::string, BoneInfo> boneInfo;
+    buildSkeleton(graph, boneInfo);
+    Skeleton skeleton { graph, boneInfo };
+    std::vector<AnimationTrack> tracks = buildTracks(graph, 0.0f);
+    AnimationClip clip { "sway", CLIP_DURATION, tracks, skeleton };
+    AnimationClip other { "sway2", CLIP_DURATION, buildTracks(graph, 1.5f), skeleton };
+
+    std::printf("\nanimation: %u nodes, %zu animated tracks, %.1f s at %.0f keys/s\n", skeleton.GetNodeCount(), tracks.size(), CLIP_DURATION, SOURCE_RATE);
+    std::printf("clip memory: raw %zu bytes, compressed %zu bytes (%zu keys kept), %.1fx smaller\n", rawMemory(tracks), clip.GetMemoryUsage(),
+                clip.GetKeyCount(), static_cast<double>(rawMemory(tracks)) / clip.GetMemoryUsage());
+
+    // error against the raw tracks over many in-between times
+    Pose pose;
+    float maxAngle = 0.0f, maxDistance = 0.0f;
+    for (unsigned int step = 0; step < 1000; step++) {
+        float time = CLIP_DURATION * step / 1000.0f;
+        clip.Sample(time, pose);
+        for (auto const &track : tracks) {
+            int node = skeleton.FindNode(track.Node);
+            glm::quat expected = sampleRaw(track.RotationTimes, track.Rotations, time);
+            maxAngle = std::max(maxAngle, AngleBetween(expected, pose.GetRotation(node)));
+            maxDistance = std::max(maxDistance, glm::length(sampleRaw(track.PositionTimes, track.Positions, time) - pose.GetTranslation(node)));
+        }
+    }
+    std::printf("max error: rotation %.5f rad, position %.6f\n", maxAngle, maxDistance);
+
+    // single-thread sampling throughput
+    unsigned int const samples = 20000;
+    std::vector<glm::vec3> positions(skeleton.GetNodeCount()), scales(skeleton.GetNodeCount());
+    std::vector<glm::quat> rotations(skeleton.GetNodeCount());
+    volatile float sink = 0.0f; // keeps the samples from being optimized away
+    auto start = Clock::now();
+    for (unsigned int i = 0; i < samples; i++) {
+        float time = std::fmod(i * 0.0137f, CLIP_DURATION);
+        for (unsigned int t = 0; t < tracks.size(); t++) {
+            positions[t] = sampleRaw(tracks[t].PositionTimes, tracks[t].Positions, time);
+            rotations[t] = sampleRaw(tracks[t].RotationTimes, tracks[t].Rotations, time);
+            scales[t] = sampleRaw(tracks[t].ScaleTimes, tracks[t].Scales, time);
+        }
+        sink = sink + rotations[i % tracks.size()].w;
+    }
+    double rawMs = millisecondsSince(start);
+    start = Clock::now();
+    for (unsigned int i = 0; i < samples; i++) {
+        clip.Sample(std::fmod(i * 0.0137f, CLIP_DURATION), pose);
+        sink = sink + pose.Get(Pose::RW)[i % pose.Size()];
+    }
+    double compressedMs = millisecondsSince(start);
+    std::printf("sampling, one core: raw lerp/slerp %6.1f M tracks/s | compressed SIMD %6.1f M tracks/s\n",
+                tracks.size() * samples / (rawMs * 1e3), skeleton.GetNodeCount() * static_cast<double>(samples) / (compressedMs * 1e3));
+
+    // a crowd blending two clips, spread over a field the viewer stands at the corner of
+    unsigned int const characters = 1000;
+    unsigned int const frames = 100;
+    unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned int> threadCounts { 1 };
+    for (unsigned int threads = 2; threads < cores; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    if (cores > 1) {
+        threadCounts.push_back(cores);
+    }
+    for (int lod = 0; lod < 2; lod++) {
+        for (unsigned int threads : threadCounts) {
+            CrowdAnimator crowd { skeleton, threads };
+            for (unsigned int i = 0; i < characters; i++) {
+                CrowdAnimator::Character character;
+                character.Clip = &clip;
+                character.BlendClip = &other;
+                character.BlendWeight = 0.3f;
+                character.Time = 0.01f * i;
+                character.Position = glm::vec3 { 2.0f * (i % 32), 0.0f, 2.0f * (i / 32) };
+                crowd.Add(character);
+            }
+            if (lod) {
+                crowd.SetLodDistances({ 20.0f, 40.0f });
+            }
+            double milliseconds = 0.0;
+            unsigned long long sampled = 0;
+            for (unsigned int frame = 0; frame < frames; frame++) {
+                auto stats = crowd.Update(1.0f / 60.0f, glm::vec3 { 0.0f });
+                milliseconds += stats.Milliseconds;
+                sampled += stats.Sampled;
+            }
+            std::printf("crowd %u characters %-6s %2u threads: %6.3f ms/frame, %4.0f sampled/frame, %5.2f M bones/s per core\n", characters,
+                        lod ? "lod" : "no lod", threads, milliseconds / frames, static_cast<double>(sampled) / frames,
+                        sampled * skeleton.GetBoneCount() / (milliseconds * 1e3) / std::min(threads, cores));
+        }
+    }
+}
+
+// a torus with the texture wrapped once around each circle; the second half of the tube mirrors u, as a
+// symmetric model sharing half a texture would
+static void buildTorus(unsigned int rings, unsigned int sides, std::vector<glm::vec3> &positions, std::vector<glm::vec3> &normals,
+                       std::vector<glm::vec2> &texCoords, std::vector<unsigned int> &indices) {
+    for (unsigned int ring = 0; ring <= rings; ring++) {
+        float u = glm::two_pi<float>() * ring / rings;
+        glm::vec3 center { std::cos(u), 0.0f, std::sin(u) };
+        for (unsigned int side = 0; side <= sides; side++) {
+            float v = glm::two_pi<float>() * side / sides;
+            glm::vec3 normal = center * std::cos(v) + glm::vec3 { 0.0f, std::sin(v), 0.0f };
+            positions.push_back(center + 0.3f * normal);
+            normals.push_back(normal);
+            float mirrored = ring <= rings / 2 ? static_cast<float>(ring) / rings : 1.0f - static_cast<float>(ring) / rings;
+            texCoords.push_back(glm::vec2 { 4.0f * mirrored, static_cast<float>(side) / sides });
+        }
+    }
+    for (unsigned int ring = 0; ring < rings; ring++) {
+        for (unsigned int side = 0; side < sides; side++) {
+            unsigned int a = ring * (sides + 1) + side;
+            unsigned int b = a + sides + 1;
+            indices.insert(indices.end(), { a, a + 1, b, b, a + 1, b + 1 });
+        }
+    }
+}
+
+// Shades the torus through a bumpy procedural normal map with float tangent frames and with decoded QTangents,
+// and fails if any diffuse or specular term differs by more than an 8-bit color step
+static bool benchTangents() {
+    std::vector<glm::vec3> positions, normals;
+    std::vector<glm::vec2> texCoords;
+    std::vector<unsigned int> indices;
+    buildTorus(1024, 512, positions, normals, texCoords, indices);
+
+    std::printf("\ntangent frames: %zu vertices\n", positions.size());
+    unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<glm::vec4> tangents;
+    for (unsigned int threads : { 1u, cores }) {
+        auto start = Clock::now();
+        tangents = GenerateTangents(positions, normals, texCoords, indices, threads);
+        std::printf("generation on %2u threads: %7.2f ms\n", threads, millisecondsSince(start));
+        if (cores == 1) {
+            break;
+        }
+    }
+
+    std::vector<glm::vec3> lights = { glm::normalize(glm::vec3 { 1.0f, 1.0f, 0.5f }), glm::normalize(glm::vec3 { -0.3f, 0.2f, 1.0f }),
+                                      glm::vec3 { 0.0f, -1.0f, 0.0f } };
+    glm::vec3 const view { 0.0f, 0.0f, 1.0f };
+    float const shininess = 32.0f;
+    float maxAngle = 0.0f, maxDiffuse = 0.0f, maxSpecular = 0.0f;
+    for (size_t i = 0; i < positions.size(); i++) {
+        glm::vec3 tangent { tangents[i] };
+        glm::mat3 reference { tangent, tangents[i].w * glm::cross(normals[i], tangent), normals[i] };
+        std::int16_t packed[4];
+        EncodeQTangent(normals[i], tangents[i], packed);
+        glm::mat3 decoded = DecodeQTangent(packed);
+
+        glm::vec2 uv = texCoords[i] * glm::two_pi<float>() * 3.0f;
+        glm::vec3 mapped = glm::normalize(glm::vec3 { 0.5f * std::sin(uv.x), 0.5f * std::cos(uv.y), 1.0f });
+        glm::vec3 expected = glm::normalize(reference * mapped);
+        glm::vec3 actual = glm::normalize(decoded * mapped);
+        maxAngle = std::max(maxAngle, std::acos(glm::clamp(glm::dot(expected, actual), -1.0f, 1.0f)));
+        for (auto const &light : lights) {
+            maxDiffuse = std::max(maxDiffuse, std::abs(std::max(glm::dot(expected, light), 0.0f) - std::max(glm::dot(actual, light), 0.0f)));
+            glm::vec3 halfway = glm::normalize(light + view);
+            float specularExpected = std::pow(std::max(glm::dot(expected, halfway), 0.0f), shininess);
+            float specularActual = std::pow(std::max(glm::dot(actual, halfway), 0.0f), shininess);
+            maxSpecular = std::max(maxSpecular, std::abs(specularExpected - specularActual));
+        }
+    }
+    float const tolerance = 1.0f / 255.0f;
+    bool passed = maxDiffuse <= tolerance && maxSpecular <= tolerance;
+    std::printf("QTangent vs float frame: max normal error %.4f deg, diffuse %.6f, specular %.6f (tolerance %.6f) %s\n",
+                glm::degrees(maxAngle), maxDiffuse, maxSpecular, tolerance, passed ? "ok" : "FAILED");
+
+    // what a float tangent and bitangent per vertex would have added
+    size_t const floatFrameBytes = 2 * sizeof(glm::vec3);
+    size_t const packedBytes = sizeof(Vertex::QTangent);
+    std::printf("vertex %zu bytes with QTangent, %zu with float tangent and bitangent: %.1f MB saved on %zu vertices\n", sizeof(Vertex),
+                sizeof(Vertex) - packedBytes + floatFrameBytes, (floatFrameBytes - packedBytes) * positions.size() / 1e6, positions.size());
+    return passed;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 && std::string { argv[1] } == "--tangents") {
+        return benchTangents() ? 0 : 1;
+    }
+    std::printf("scene graph world transform updates\n");
+    struct { char const *name; unsigned int chains, depth; } deepCases[] = {
+        { "deep 10 x 100", 10, 100 },
+        { "deep 100 x 1000", 100, 1000 },
+        { "deep 1 x 100000", 1, 100000 },
+    };
+    for (auto const &deep : deepCases) {
+        SceneGraph graph;
+        buildDeep(graph, deep.chains, deep.depth);
+        benchUpdates(deep.name, graph, 16);
+    }
+    for (unsigned int count : { 1000u, 100000u }) {
+        SceneGraph graph;
+        buildWide(graph, count);
+        std::string name = "wide " + std::to_string(count);
+        benchUpdates(name.c_str(), graph, 16);
+    }
+    benchAnimation();
+    return benchTangents() ? 0 : 1;
+}
@@ -2,7 +2,8 @@
 
 Camera::Camera(glm::vec3 position, glm::vec3 up, float yaw, float pitch) : 
                 front(glm::vec3 { 0.0f, 0.0f, -1.0f }),
-                moveSpeed(SPEED), mouseSensitivity(SENSITIVITY), mouseZoom(ZOOM)
+                moveSpeed(SPEED), mouseSensitivity(SENSITIVITY), mouseZoom(ZOOM),
+                collider(nullptr), collisionRadius(0.2f)
 {
     Camera::position = position;
     Camera::worldUp = up;
@@ -13,7 +14,8 @@ Camera::Camera(glm::vec3 position, glm::vec3 up, float yaw, float pitch) :
 
 Camera::Camera(float posX, float posY, float posZ, float upX, float upY, float upZ, float yaw, float pitch) : 
                 front(glm::vec3 { 0.0f, 0.0f, -1.0f }),
-                moveSpeed(SPEED), mouseSensitivity(SENSITIVITY), mouseZoom(ZOOM)
+                moveSpeed(SPEED), mouseSensitivity(SENSITIVITY), mouseZoom(ZOOM),
+                collider(nullptr), collisionRadius(0.2f)
 {
     Camera::position = glm::vec3 { posX, posY, posZ };
     Camera::worldUp = glm::vec3 { upX, upY, upZ };
@@ -24,18 +26,20 @@ Camera::Camera(float posX, float posY, float posZ, float upX, float upY, float u
 
 void Camera::ProcessKeyboard(Movement direction, float deltaTime) {
     float velocity = deltaTime * moveSpeed;
+    glm::vec3 target = position;
     if (direction == FORWARD) {
-        position += front * velocity;
+        target += front * velocity;
     }
     if (direction == BACKWARD) {
-        position -= front * velocity;
+        target -= front * velocity;
     }
     if (direction == RIGHT) {
-        position += right * velocity;
+        target += right * velocity;
     }
     if (direction == LEFT) {
-        position -= right * velocity;
+        target -= right * velocity;
     }
+    position = collider ? collider->ResolveMove(position, target, collisionRadius) : target;
 }
 
 void Camera::ProcessMouseMovement(float xoffset, float yoffset, bool constrainPitch) {
@@ -1,7 +1,11 @@
+#pragma once
+
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "culling.hpp"
+
 float const YAW = -90.0f;
 float const PITCH = 0.0f;
 float const SPEED = 2.5f;
@@ -15,6 +19,14 @@ enum Movement {
     RIGHT
 };
 
+// Anything the camera can bump into. Returns where a sphere of the given radius ends up when it tries to move
+// from `from` to `to`, e.g. stopped at or sliding along a wall.
+class CameraCollider {
+    public:
+        virtual ~CameraCollider() = default;
+        virtual glm::vec3 ResolveMove(glm::vec3 const &from, glm::vec3 const &to, float radius) const = 0;
+};
+
 class Camera {
     private:
         glm::vec3 position; // camera position
@@ -27,6 +39,8 @@ class Camera {
         float moveSpeed; // movement speed 
         float mouseSensitivity; // mouse sensitivity
         float mouseZoom; // mouse zoom
+        CameraCollider const *collider; // optional, movement goes straight through geometry when null
+        float collisionRadius; // radius of the sphere used to collide the camera
     public:
         Camera(glm::vec3 position = glm::vec3 { 0.0f, 0.0f, 0.0f },
                 glm::vec3 up = glm::vec3 { 0.0f, 1.0f, 0.0f },
@@ -67,9 +81,14 @@ class Camera {
         void ProcessKeyboard(Movement direction, float deltaTime);
         void ProcessMouseMovement(float xoffset, float yoffset, bool constrainPitch = true);
         void ProcessMouseScroll(float yoffset);
+        void SetCollider(CameraCollider const *collider, float radius = 0.2f) { this->collider = collider; collisionRadius = radius; }
+        bool HasCollider() const { return collider != nullptr; }
         float GetZoom() const { return glm::radians(mouseZoom); }
         glm::vec3 GetPosition() const { return position; }
         glm::vec3 GetDirection() const { return front; }
+        // Frustum planes in world space, used to reject bounds that cannot appear on screen
+        static Frustum ExtractFrustum(glm::mat4 const &projection, glm::mat4 const &view) { return Frustum::FromMatrix(projection * view); }
+        Frustum GetFrustum(glm::mat4 const &projection) const { return ExtractFrustum(projection, GetViewMatrix()); }
     protected:
         void updateCameraVectors();
 };
\ No newline at end of file
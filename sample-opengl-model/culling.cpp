@@ -0,0 +1,145 @@
+#include "culling.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+Frustum Frustum::FromMatrix(glm::mat4 const &viewProjection) {
+    // glm is column-major, so row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+    glm::mat4 const &m = viewProjection;
+    glm::vec4 row0 { m[0][0], m[1][0], m[2][0], m[3][0] };
+    glm::vec4 row1 { m[0][1], m[1][1], m[2][1], m[3][1] };
+    glm::vec4 row2 { m[0][2], m[1][2], m[2][2], m[3][2] };
+    glm::vec4 row3 { m[0][3], m[1][3], m[2][3], m[3][3] };
+
+    Frustum frustum;
+    frustum.Planes[0] = row3 + row0; // left
+    frustum.Planes[1] = row3 - row0; // right
+    frustum.Planes[2] = row3 + row1; // bottom
+    frustum.Planes[3] = row3 - row1; // top
+    frustum.Planes[4] = row3 + row2; // near
+    frustum.Planes[5] = row3 - row2; // far
+    // normalize so that plane distances are in world units and can be compared against radii
+    for (auto &plane : frustum.Planes) {
+        plane /= glm::length(glm::vec3 { plane });
+    }
+    return frustum;
+}
+
+AABB ComputeAABB(glm::vec3 const *points, size_t count) {
+    AABB box { glm::vec3 { FLT_MAX }, glm::vec3 { -FLT_MAX } };
+    for (size_t i = 0; i < count; i++) {
+        box.Min = glm::min(box.Min, points[i]);
+        box.Max = glm::max(box.Max, points[i]);
+    }
+    if (count == 0) {
+        box.Min = box.Max = glm::vec3 { 0.0f };
+    }
+    return box;
+}
+
+AABB TransformAABB(AABB const &box, glm::mat4 const &transform) {
+    // Arvo's method: transform the center, and project the extents on the absolute value of the rotation/scale part
+    glm::vec3 center = (box.Min + box.Max) * 0.5f;
+    glm::vec3 extent = (box.Max - box.Min) * 0.5f;
+    glm::vec3 newCenter = glm::vec3 { transform * glm::vec4 { center, 1.0f } };
+    glm::vec3 newExtent {
+        std::abs(transform[0][0]) * extent.x + std::abs(transform[1][0]) * extent.y + std::abs(transform[2][0]) * extent.z,
+        std::abs(transform[0][1]) * extent.x + std::abs(transform[1][1]) * extent.y + std::abs(transform[2][1]) * extent.z,
+        std::abs(transform[0][2]) * extent.x + std::abs(transform[1][2]) * extent.y + std::abs(transform[2][2]) * extent.z
+    };
+    return AABB { newCenter - newExtent, newCenter + newExtent };
+}
+
+BoundingSphere TransformSphere(BoundingSphere const &sphere, glm::mat4 const &transform) {
+    // non-uniform scale stretches the sphere, so use the largest axis scale to stay conservative
+    float scale = std::max({
+        glm::length(glm::vec3 { transform[0] }),
+        glm::length(glm::vec3 { transform[1] }),
+        glm::length(glm::vec3 { transform[2] })
+    });
+    return BoundingSphere { glm::vec3 { transform * glm::vec4 { sphere.Center, 1.0f } }, sphere.Radius * scale };
+}
+
+void CullingBatch::Clear() {
+    centerX.clear(); centerY.clear(); centerZ.clear();
+    extentX.clear(); extentY.clear(); extentZ.clear();
+    radius.clear();
+}
+
+void CullingBatch::Reserve(size_t count) {
+    centerX.reserve(count); centerY.reserve(count); centerZ.reserve(count);
+    extentX.reserve(count); extentY.reserve(count); extentZ.reserve(count);
+    radius.reserve(count);
+}
+
+unsigned int CullingBatch::Add(AABB const &box, BoundingSphere const &sphere) {
+    // the box is stored as center/extents; the sphere shares the box center so only its radius is kept,
+    // clamped so it never lies outside the sphere that was handed in
+    glm::vec3 center = (box.Min + box.Max) * 0.5f;
+    glm::vec3 extent = (box.Max - box.Min) * 0.5f;
+    centerX.push_back(center.x); centerY.push_back(center.y); centerZ.push_back(center.z);
+    extentX.push_back(extent.x); extentY.push_back(extent.y); extentZ.push_back(extent.z);
+    radius.push_back(std::min(glm::length(extent), glm::distance(center, sphere.Center) + sphere.Radius));
+    return static_cast<unsigned int>(radius.size() - 1);
+}
+
+CullStats CullingBatch::Cull(Frustum const &frustum) {
+    size_t const count = radius.size();
+    visibility.resize(count);
+
+    size_t i = 0;
+#if defined(__SSE2__)
+    // four items per iteration; each plane is broadcast once per lane group
+    for (; i + 4 <= count; i += 4) {
+        __m128 cx = _mm_loadu_ps(&centerX[i]);
+        __m128 cy = _mm_loadu_ps(&centerY[i]);
+        __m128 cz = _mm_loadu_ps(&centerZ[i]);
+        __m128 ex = _mm_loadu_ps(&extentX[i]);
+        __m128 ey = _mm_loadu_ps(&extentY[i]);
+        __m128 ez = _mm_loadu_ps(&extentZ[i]);
+        __m128 r = _mm_loadu_ps(&radius[i]);
+        __m128 outside = _mm_setzero_ps();
+        for (auto const &plane : frustum.Planes) {
+            __m128 nx = _mm_set1_ps(plane.x);
+            __m128 ny = _mm_set1_ps(plane.y);
+            __m128 nz = _mm_set1_ps(plane.z);
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)),
+                                     _mm_add_ps(_mm_mul_ps(nz, cz), _mm_set1_ps(plane.w)));
+            __m128 projected = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::abs(plane.x)), ex),
+                                                     _mm_mul_ps(_mm_set1_ps(std::abs(plane.y)), ey)),
+                                          _mm_mul_ps(_mm_set1_ps(std::abs(plane.z)), ez));
+            __m128 reach = _mm_min_ps(projected, r);
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(dist, reach), _mm_setzero_ps()));
+        }
+        int mask = _mm_movemask_ps(outside);
+        visibility[i + 0] = !(mask & 1);
+        visibility[i + 1] = !(mask & 2);
+        visibility[i + 2] = !(mask & 4);
+        visibility[i + 3] = !(mask & 8);
+    }
+#endif
+    for (; i < count; i++) {
+        bool outside = false;
+        for (auto const &plane : frustum.Planes) {
+            float dist = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w;
+            float projected = std::abs(plane.x) * extentX[i] + std::abs(plane.y) * extentY[i] + std::abs(plane.z) * extentZ[i];
+            if (dist + std::min(projected, radius[i]) < 0.0f) {
+                outside = true;
+                break;
+            }
+        }
+        visibility[i] = !outside;
+    }
+
+    CullStats stats;
+    for (size_t j = 0; j < count; j++) {
+        stats.Visible += visibility[j];
+    }
+    stats.Culled = static_cast<unsigned int>(count) - stats.Visible;
+    return stats;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// axis-aligned bounding box in the space of whatever owns it (mesh, object or world)
+struct AABB {
+    glm::vec3 Min;
+    glm::vec3 Max;
+};
+
+struct BoundingSphere {
+    glm::vec3 Center;
+    float Radius;
+};
+
+// six planes (left, right, bottom, top, near, far) stored as (normal, distance) with the normal pointing inwards
+struct Frustum {
+    glm::vec4 Planes[6];
+
+    // Gribb/Hartmann extraction: every plane is a sum or difference of the fourth row and another row of the clip matrix
+    static Frustum FromMatrix(glm::mat4 const &viewProjection);
+};
+
+struct CullStats {
+    unsigned int Visible = 0;
+    unsigned int Culled = 0;
+
+    CullStats &operator+=(CullStats const &other) {
+        Visible += other.Visible;
+        Culled += other.Culled;
+        return *this;
+    }
+};
+
+AABB ComputeAABB(glm::vec3 const *points, size_t count);
+AABB TransformAABB(AABB const &box, glm::mat4 const &transform);
+BoundingSphere TransformSphere(BoundingSphere const &sphere, glm::mat4 const &transform);
+
+// Bounds are kept as structure-of-arrays so the kernel can test four of them per SSE instruction.
+// An item is rejected if either its sphere or its box lies completely behind one of the planes,
+// which is as tight as the better of the two volumes for that plane.
+class CullingBatch {
+    private:
+        std::vector<float> centerX, centerY, centerZ;
+        std::vector<float> extentX, extentY, extentZ;
+        std::vector<float> radius;
+        std::vector<unsigned char> visibility;
+    public:
+        void Clear();
+        void Reserve(size_t count);
+        // returns the index used to query the visibility after Cull
+        unsigned int Add(AABB const &box, BoundingSphere const &sphere);
+        CullStats Cull(Frustum const &frustum);
+        bool IsVisible(unsigned int index) const { return visibility[index] != 0; }
+        size_t Size() const { return radius.size(); }
+};
@@ -0,0 +1,34 @@
+#include "framearena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+FrameArena::FrameArena(size_t capacity)
+    : block { new std::byte[capacity] }, capacity { capacity }, used { 0 }, overflowBytes { 0 }, peak { 0 } {}
+
+void *FrameArena::allocate(size_t size, size_t alignment) {
+    std::uintptr_t base = reinterpret_cast<std::uintptr_t>(block.get());
+    size_t offset = (base + used + alignment - 1) / alignment * alignment - base;
+    if (offset + size <= capacity) {
+        used = offset + size;
+        peak = std::max(peak, used + overflowBytes);
+        return block.get() + offset;
+    }
+    // new[] aligns to the fundamental alignment, padding covers anything stricter
+    size_t padded = size + (alignment > alignof(std::max_align_t) ? alignment : 0);
+    overflow.emplace_back(new std::byte[padded]);
+    overflowBytes += padded;
+    peak = std::max(peak, used + overflowBytes);
+    std::uintptr_t address = reinterpret_cast<std::uintptr_t>(overflow.back().get());
+    return overflow.back().get() + ((address + alignment - 1) / alignment * alignment - address);
+}
+
+void FrameArena::Reset() {
+    if (!overflow.empty()) {
+        capacity = peak;
+        block.reset(new std::byte[capacity]);
+        overflow.clear();
+        overflowBytes = 0;
+    }
+    used = 0;
+}
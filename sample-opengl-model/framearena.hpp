@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// A linear allocator for data that only lives until the end of the frame, like draw lists, sort keys and uniforms
+// staged for upload. Allocate bumps an offset into one block and Reset rewinds it, nothing is freed on its own.
+// Running out takes an extra block from the heap for the rest of the frame; Reset then swaps all of them for one
+// block of their total size, so only the first frames that need more memory allocate.
+class FrameArena {
+    private:
+        std::unique_ptr<std::byte[]> block;
+        size_t capacity;
+        size_t used;
+        std::vector<std::unique_ptr<std::byte[]>> overflow; // blocks taken since the last Reset
+        size_t overflowBytes;
+        size_t peak; // most bytes in use at once, overflow included
+
+        void *allocate(size_t size, size_t alignment);
+    public:
+        explicit FrameArena(size_t capacity);
+        FrameArena(FrameArena const &) = delete;
+        FrameArena &operator=(FrameArena const &) = delete;
+
+        // Uninitialized room for count objects, to be written before they are read; valid until Reset
+        template <typename T>
+        T *Allocate(size_t count) {
+            static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>, "the arena never runs destructors");
+            return static_cast<T *>(allocate(count * sizeof(T), alignof(T)));
+        }
+        // Call once per frame, after the last use of anything allocated in it
+        void Reset();
+        size_t GetCapacity() const { return capacity; }
+        size_t GetPeak() const { return peak; }
+};
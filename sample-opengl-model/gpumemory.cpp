@@ -0,0 +1,201 @@
+#include "gpumemory.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <vector>
+
+using std::endl;
+using std::vector;
+
+namespace {
+    struct Resource {
+        char const *Owner = nullptr; // nullptr for a free slot
+        GpuMemory::Kind Kind = GpuMemory::Kind::Buffer;
+        std::uint64_t Bytes = 0;
+        std::uint64_t LastUsed = 0; // frame of the last Touch
+        bool Resident = true;
+        std::function<void()> Evict;
+    };
+
+    vector<Resource> resources; // by handle - 1
+    vector<GpuMemory::Handle> freeHandles;
+    std::uint64_t budget = 0;
+    std::uint64_t frame = 1;
+    std::uint64_t residentBytes = 0;
+    std::uint64_t evictions = 0, restores = 0;
+
+    Resource *find(GpuMemory::Handle handle) {
+        if (handle == 0 || handle > resources.size() || resources[handle - 1].Owner == nullptr) {
+            return nullptr;
+        }
+        return &resources[handle - 1];
+    }
+
+    void add(GpuMemory::Stats &stats, Resource const &resource) {
+        stats.Resources++;
+        if (!resource.Resident) {
+            stats.Evicted++;
+            stats.EvictedBytes += resource.Bytes;
+        } else if (resource.Kind == GpuMemory::Kind::Buffer) {
+            stats.BufferBytes += resource.Bytes;
+        } else {
+            stats.TextureBytes += resource.Bytes;
+        }
+    }
+
+    double megabytes(std::uint64_t bytes) {
+        return bytes / (1024.0 * 1024.0);
+    }
+}
+
+GpuMemory::Handle GpuMemory::Register(char const *owner, Kind kind, std::uint64_t bytes, std::function<void()> evict) {
+    Handle handle;
+    if (!freeHandles.empty()) {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+    } else {
+        resources.emplace_back();
+        handle = static_cast<Handle>(resources.size());
+    }
+    resources[handle - 1] = Resource { owner, kind, bytes, frame, true, std::move(evict) };
+    residentBytes += bytes;
+    return handle;
+}
+
+void GpuMemory::Unregister(Handle handle) {
+    Resource *resource = find(handle);
+    if (resource == nullptr) {
+        return;
+    }
+    if (resource->Resident) {
+        residentBytes -= resource->Bytes;
+    }
+    *resource = Resource {};
+    freeHandles.push_back(handle);
+}
+
+void GpuMemory::Resize(Handle handle, std::uint64_t bytes) {
+    Resource *resource = find(handle);
+    if (resource == nullptr) {
+        return;
+    }
+    if (resource->Resident) {
+        residentBytes = residentBytes - resource->Bytes + bytes;
+    }
+    resource->Bytes = bytes;
+}
+
+bool GpuMemory::Touch(Handle handle) {
+    Resource *resource = find(handle);
+    if (resource == nullptr) {
+        return true;
+    }
+    resource->LastUsed = frame;
+    return resource->Resident;
+}
+
+void GpuMemory::Restored(Handle handle, std::uint64_t bytes) {
+    Resource *resource = find(handle);
+    if (resource == nullptr || resource->Resident) {
+        return;
+    }
+    resource->Resident = true;
+    resource->Bytes = bytes;
+    resource->LastUsed = frame;
+    residentBytes += bytes;
+    restores++;
+}
+
+void GpuMemory::SetBudget(std::uint64_t bytes) {
+    budget = bytes;
+}
+
+std::uint64_t GpuMemory::GetBudget() {
+    return budget;
+}
+
+void GpuMemory::EndFrame() {
+    // a scan per eviction, evictions are rare and the resources few
+    while (budget != 0 && residentBytes > budget) {
+        Resource *oldest = nullptr;
+        for (auto &resource : resources) {
+            if (resource.Owner != nullptr && resource.Resident && resource.Evict && resource.LastUsed < frame
+                && (oldest == nullptr || resource.LastUsed < oldest->LastUsed)) {
+                oldest = &resource;
+            }
+        }
+        if (oldest == nullptr) {
+            break;
+        }
+        oldest->Evict();
+        oldest->Resident = false;
+        residentBytes -= oldest->Bytes;
+        evictions++;
+    }
+    frame++;
+}
+
+GpuMemory::Stats GpuMemory::GetStats() {
+    Stats stats;
+    for (auto const &resource : resources) {
+        if (resource.Owner != nullptr) {
+            add(stats, resource);
+        }
+    }
+    stats.Evictions = evictions;
+    stats.Restores = restores;
+    return stats;
+}
+
+GpuMemory::Stats GpuMemory::GetOwnerStats(char const *owner) {
+    Stats stats;
+    for (auto const &resource : resources) {
+        if (resource.Owner != nullptr && std::strcmp(resource.Owner, owner) == 0) {
+            add(stats, resource);
+        }
+    }
+    return stats;
+}
+
+void GpuMemory::Report(std::ostream &log) {
+    vector<char const *> owners;
+    for (auto const &resource : resources) {
+        if (resource.Owner != nullptr && std::none_of(owners.begin(), owners.end(), [&](char const *owner) { return std::strcmp(owner, resource.Owner) == 0; })) {
+            owners.push_back(resource.Owner);
+        }
+    }
+    auto writeStats = [&](char const *name, Stats const &stats) {
+        log << name << ": buffers " << megabytes(stats.BufferBytes) << " MB, textures " << megabytes(stats.TextureBytes) << " MB, "
+            << stats.Evicted << " of " << stats.Resources << " resources evicted (" << megabytes(stats.EvictedBytes) << " MB)" << endl;
+    };
+    log << std::fixed << std::setprecision(1);
+    for (char const *owner : owners) {
+        writeStats(owner, GetOwnerStats(owner));
+    }
+    Stats total = GetStats();
+    writeStats("total", total);
+    log << "budget ";
+    if (budget != 0) {
+        log << megabytes(budget) << " MB, ";
+    } else {
+        log << "none, ";
+    }
+    log << total.Evictions << " evictions and " << total.Restores << " restores" << endl;
+    log << std::defaultfloat;
+}
+
+std::uint64_t GpuMemory::TextureBytes(int width, int height, int bytesPerTexel, bool mipmapped) {
+    std::uint64_t bytes = 0;
+    if (width <= 0 || height <= 0) {
+        return 0;
+    }
+    while (true) {
+        bytes += static_cast<std::uint64_t>(width) * height * bytesPerTexel;
+        if (!mipmapped || (width == 1 && height == 1)) {
+            return bytes;
+        }
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+
+// The video memory of the buffers and textures the sample made, grouped by owner, with a budget. Sizes are what
+// was asked for: the bytes given to glBufferData, and for textures the texels of every mip level at the size of
+// their internal format. Drivers pad and compress behind that.
+//
+// Resources with an evict function can be dropped to free their memory and made again from what their owner kept
+// on the CPU or on disk. EndFrame evicts the least recently used of them until the resident bytes fit the budget.
+// Resources used in the frame that ends are never evicted, so a frame that needs more than the budget goes over
+// it for that frame. Owners Touch their resources before drawing with them and restore the ones that were
+// evicted. Only for the thread with the context.
+class GpuMemory {
+    public:
+        enum class Kind { Buffer, Texture };
+        using Handle = unsigned int; // 0 is no resource
+
+        struct Stats {
+            std::uint64_t BufferBytes = 0; // resident
+            std::uint64_t TextureBytes = 0;
+            std::uint64_t EvictedBytes = 0; // evicted and not restored since
+            unsigned int Resources = 0;
+            unsigned int Evicted = 0;
+            std::uint64_t Evictions = 0; // since the start
+            std::uint64_t Restores = 0;
+        };
+
+        // The owner groups the resource in the stats, it must be a literal or interned. Without evict the
+        // resource is never evicted but still counts against the budget.
+        static Handle Register(char const *owner, Kind kind, std::uint64_t bytes, std::function<void()> evict = nullptr);
+        static void Unregister(Handle handle);
+        // For storage that grows, like a buffer given a larger glBufferData
+        static void Resize(Handle handle, std::uint64_t bytes);
+        // Marks the resource used this frame; false if it was evicted and has to be made again, then Restored
+        static bool Touch(Handle handle);
+        // The resource was made again after an eviction, with bytes of storage
+        static void Restored(Handle handle, std::uint64_t bytes);
+
+        // 0, the default, is no budget
+        static void SetBudget(std::uint64_t bytes);
+        static std::uint64_t GetBudget();
+        // Evicts down to the budget and starts the next frame; call once per frame after the last draw
+        static void EndFrame();
+
+        static Stats GetStats();
+        static Stats GetOwnerStats(char const *owner);
+        // One line per owner and the totals
+        static void Report(std::ostream &log);
+
+        // Bytes of a width by height texture with the given texel size, and its mip chain down to 1x1
+        static std::uint64_t TextureBytes(int width, int height, int bytesPerTexel, bool mipmapped);
+};
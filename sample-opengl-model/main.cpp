@@ -8,14 +8,26 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <cmath>
+#include <cstdio>
+#include <future>
 #include <iostream>
+#include <string>
 using std::cout;
 using std::endl;
 
+#include "alloctracker.hpp"
+#include "framearena.hpp"
+#include "gpumemory.hpp"
 #include "model.hpp"
+#include "profiler.hpp"
+#include "startup.hpp"
+#include "texturestream.hpp"
 
 unsigned int const WIDTH = 800;
 unsigned int const HEIGHT = 600;
+// frames after which --allocations expects the loop to stop allocating
+unsigned int const WARM_FRAMES = 120;
 
 Camera camera { glm::vec3 { 0.0f, 0.0f, 3.0f } };
 float deltaTime = 0.0f;
@@ -23,6 +35,26 @@ float lastFrame = 0.0f;
 float lastX = WIDTH / 2.0f;
 float lastY = HEIGHT / 2.0f;
 bool firstMouse = true;
+bool collisionKeyDown = false;
+bool profileKeyDown = false;
+char const *const PROFILE_PATH = "./profile.json";
+ModelCollider *collider = nullptr;
+Model const *pickModel = nullptr;
+glm::mat4 pickTransform { 1.0f };
+
+// Stops the recording and writes it out for chrome://tracing or ui.perfetto.dev
+void writeProfile() {
+    Profiler::Stop();
+    if (Profiler::WriteChromeTrace(PROFILE_PATH)) {
+        cout << "Profile written to " << PROFILE_PATH;
+    } else {
+        cout << "Unable to write " << PROFILE_PATH;
+    }
+    if (Profiler::GetDroppedCount() > 0) {
+        cout << ", " << Profiler::GetDroppedCount() << " zones dropped";
+    }
+    cout << endl;
+}
 
 void processInput(GLFWwindow* window) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
@@ -40,9 +72,67 @@ void processInput(GLFWwindow* window) {
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
         camera.ProcessKeyboard(RIGHT, deltaTime);
     }
+    // toggle camera collision against the model on key press
+    bool collisionKey = glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS;
+    if (collisionKey && !collisionKeyDown) {
+        camera.SetCollider(camera.HasCollider() ? nullptr : collider);
+        cout << "Camera collision " << (camera.HasCollider() ? "on" : "off") << endl;
+    }
+    collisionKeyDown = collisionKey;
+    // start and stop recording a profile on key press
+    bool profileKey = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+    if (profileKey && !profileKeyDown) {
+        if (Profiler::IsRecording()) {
+            writeProfile();
+        } else {
+            Profiler::Start();
+            cout << "Profiling, press P again to stop" << endl;
+        }
+    }
+    profileKeyDown = profileKey;
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+    StartupTrace::Start();
+    // --profile records from once the context exists, the rest of model loading included
+    bool profileStartup = false;
+    // --serial-startup loads the model only once the shaders are compiled, as before, to compare the time to first frame
+    bool serialStartup = false;
+    // --first-frame exits once the first frame is on screen and the startup trace printed, so startup can be timed
+    // run after run, with and without --serial-startup
+    bool firstFrameOnly = false;
+    // --allocations reports every warm frame that calls operator new, with the call stacks, and exits with 1 if any did
+    bool checkAllocations = false;
+    for (int i = 1; i < argc; i++) {
+        std::string argument { argv[i] };
+        if (argument == "--profile") {
+            profileStartup = true;
+        } else if (argument == "--serial-startup") {
+            serialStartup = true;
+        } else if (argument == "--first-frame") {
+            firstFrameOnly = true;
+        } else if (argument == "--allocations") {
+            checkAllocations = true;
+        } else if (argument == "--memory-budget" && i + 1 < argc) {
+            // in megabytes; the least recently drawn meshes and textures are evicted to stay under it
+            GpuMemory::SetBudget(static_cast<std::uint64_t>(std::stod(argv[++i]) * 1024.0 * 1024.0));
+        } else if (argument == "--texture-budget" && i + 1 < argc) {
+            // in megabytes; no finer mip levels stream in once the textures take this much
+            TextureStream::SetBudget(static_cast<std::uint64_t>(std::stod(argv[++i]) * 1024.0 * 1024.0));
+        }
+    }
+
+    // reading the file and decoding the textures need no context, so they run while the window and context are
+    // made and the shaders compile; the GL objects are made once both sides are done
+    std::future<Model> loader;
+    if (!serialStartup) {
+        loader = std::async(std::launch::async, [] {
+            Profiler::SetThreadName("model loader");
+            return Model { "./model/backpack.obj", false };
+        });
+    }
+
+    StartupPhase windowPhase { "create window" };
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -53,6 +143,7 @@ int main() {
         cout << "Failed to create GLFW window" << endl;
         return -1;
     }
+    windowPhase.End();
 
     glfwMakeContextCurrent(window);
     glfwSetFramebufferSizeCallback(window, [](GLFWwindow*, int width, int height) {
@@ -78,63 +169,176 @@ int main() {
         camera.ProcessMouseScroll(static_cast<float>(yoffset));
     });
 
+    StartupPhase gladPhase { "load GL functions" };
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
         cout << "Unable to initialize GLAD" << endl;
         return -1;
     }
+    gladPhase.End();
+    Profiler::SetThreadName("main");
+    if (profileStartup) {
+        Profiler::Start();
+    }
 
-    Shader shader { "./shader/model.vs", "./shader/model.fs" };
-    // Instantiate the model from file
-    Model backpack { "./model/backpack.obj" };
-
-    shader.Use();
-
-    glm::vec3 lightColor { 1.0 };
-    glm::vec3 diffuseColor = lightColor * glm::vec3 { 0.8f };
-    glm::vec3 ambientColor = diffuseColor * glm::vec3 { 0.2f };
-    glm::vec3 specularColor = lightColor * glm::vec3 { 0.5f };
-    // directional light properties
-    shader.SetFloatVec3("directionalLight.ambient", ambientColor);
-    shader.SetFloatVec3("directionalLight.diffuse", diffuseColor);
-    shader.SetFloatVec3("directionalLight.specular", specularColor);
-    shader.SetFloatVec3("directionalLight.direction", glm::vec3 { -0.2f, -1.0f, -0.3f });
-    // point light properties
-    glm::vec3 pointLightPos { -4.0f,  2.0f, 2.0f };
-    shader.SetFloatVec3("pointLight.ambient", ambientColor);
-    shader.SetFloatVec3("pointLight.diffuse", diffuseColor);
-    shader.SetFloatVec3("pointLight.specular", specularColor);
-    shader.SetFloatVec3("pointLight.position", pointLightPos);
-    shader.SetFloat("pointLight.constant", 1.0f);
-    shader.SetFloat("pointLight.linear", 0.045f);
-    shader.SetFloat("pointLight.quadratic", 0.0075f);
-
-    glEnable(GL_DEPTH_TEST);
-    glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
-
-    while (!glfwWindowShouldClose(window)) {
-        processInput(window);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        shader.Use();
-
-        glm::mat4 projection = glm::perspective(glm::radians(camera.GetZoom()), (float)WIDTH/(float)HEIGHT, 0.1f, 100.0f);
-        shader.SetFloatMatrix("projection", projection);
-
-        glm::mat4 view = camera.GetViewMatrix();
-        shader.SetFloatMatrix("view", view);
+    // transient data of one frame, so that a warm frame doesn't touch the heap
+    FrameArena frameArena { 64 * 1024 };
+    unsigned int frameCount = 0;
+    unsigned int allocatingFrames = 0;
+    // the GL objects go out of scope while the context still exists
+    {
+        StartupPhase shaderPhase { "compile shaders" };
+        Shader shader { "./shader/model.vs", "./shader/model.fs" };
+        shaderPhase.End();
+        // Instantiate the model from file
+        StartupPhase modelPhase { serialStartup ? "load model" : "wait for model" };
+        Model backpack = serialStartup ? Model { "./model/backpack.obj", false } : loader.get();
+        modelPhase.End();
+        backpack.Upload();
 
         glm::mat4 model { 1.0f };
         model = glm::rotate(model, glm::radians(25.0f), glm::vec3 { 0.5f, 1.0f, 0.0f });
         model = glm::translate(model, glm::vec3 { 0.0f, 0.0f, 0.0f });
         model = glm::scale(model, glm::vec3 { 0.01f, 0.01f, 0.01f });
-        shader.SetFloatMatrix("model", model);
 
-        backpack.Draw(shader);
+        ModelCollider backpackCollider { backpack, model };
+        collider = &backpackCollider;
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
-    }
+        // pick the model under the cursor on left click
+        pickModel = &backpack;
+        pickTransform = model;
+        glfwSetMouseButtonCallback(window, [](GLFWwindow* window, int button, int action, int) {
+            if (button != GLFW_MOUSE_BUTTON_LEFT || action != GLFW_PRESS) {
+                return;
+            }
+            double xpos, ypos;
+            glfwGetCursorPos(window, &xpos, &ypos);
+            glm::mat4 projection = glm::perspective(glm::radians(camera.GetZoom()), (float)WIDTH/(float)HEIGHT, 0.1f, 100.0f);
+            glm::mat4 inverse = glm::inverse(projection * camera.GetViewMatrix());
+            // cursor to normalized device coordinates, then back to world space on the near and far planes
+            float x = 2.0f * static_cast<float>(xpos) / WIDTH - 1.0f;
+            float y = 1.0f - 2.0f * static_cast<float>(ypos) / HEIGHT;
+            glm::vec4 nearPoint = inverse * glm::vec4 { x, y, -1.0f, 1.0f };
+            glm::vec4 farPoint = inverse * glm::vec4 { x, y, 1.0f, 1.0f };
+            glm::vec3 origin = glm::vec3 { nearPoint } / nearPoint.w;
+            glm::vec3 direction = glm::normalize(glm::vec3 { farPoint } / farPoint.w - origin);
 
+            RayHit hit;
+            unsigned int meshIndex = 0;
+            if (pickModel->Raycast(Ray { origin, direction, 100.0f }, pickTransform, hit, &meshIndex)) {
+                cout << "Picked mesh " << meshIndex << " triangle " << hit.Triangle << " at distance " << hit.Distance << endl;
+            }
+        });
+
+        shader.Use();
+
+        glm::vec3 lightColor { 1.0 };
+        glm::vec3 diffuseColor = lightColor * glm::vec3 { 0.8f };
+        glm::vec3 ambientColor = diffuseColor * glm::vec3 { 0.2f };
+        glm::vec3 specularColor = lightColor * glm::vec3 { 0.5f };
+        // directional light properties
+        shader.SetFloatVec3("directionalLight.ambient", ambientColor);
+        shader.SetFloatVec3("directionalLight.diffuse", diffuseColor);
+        shader.SetFloatVec3("directionalLight.specular", specularColor);
+        shader.SetFloatVec3("directionalLight.direction", glm::vec3 { -0.2f, -1.0f, -0.3f });
+        // point light properties
+        glm::vec3 pointLightPos { -4.0f,  2.0f, 2.0f };
+        shader.SetFloatVec3("pointLight.ambient", ambientColor);
+        shader.SetFloatVec3("pointLight.diffuse", diffuseColor);
+        shader.SetFloatVec3("pointLight.specular", specularColor);
+        shader.SetFloatVec3("pointLight.position", pointLightPos);
+        shader.SetFloat("pointLight.constant", 1.0f);
+        shader.SetFloat("pointLight.linear", 0.045f);
+        shader.SetFloat("pointLight.quadratic", 0.0075f);
+
+        glEnable(GL_DEPTH_TEST);
+        glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
+
+        CullStats lastStats { ~0u, ~0u };
+        std::uint64_t lastMemoryBytes = 0;
+
+        while (!glfwWindowShouldClose(window)) {
+            float currentFrame = static_cast<float>(glfwGetTime());
+            deltaTime = currentFrame - lastFrame;
+            lastFrame = currentFrame;
+
+            processInput(window);
+            // the zones close before the swap, whose wait for vsync would count as the frame's work otherwise
+            {
+                PROFILE_ZONE("frame");
+                PROFILE_GPU_ZONE("frame");
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+                shader.Use();
+
+                glm::mat4 projection = glm::perspective(glm::radians(camera.GetZoom()), (float)WIDTH/(float)HEIGHT, 0.1f, 100.0f);
+                shader.SetFloatMatrix("projection", projection);
+
+                glm::mat4 view = camera.GetViewMatrix();
+                shader.SetFloatMatrix("view", view);
+
+                // the model matrix is applied on top of each mesh's node transform
+                CullStats stats = backpack.Draw(shader, camera.GetFrustum(projection), model, frameArena);
+                // the mip levels the draw sampled, for the streaming to catch up with over the next frames
+                float pixelsPerUnit = HEIGHT / (2.0f * std::tan(glm::radians(camera.GetZoom()) / 2.0f));
+                backpack.RequestTextureLevels(model, camera.GetPosition(), pixelsPerUnit);
+                TextureStream::Update();
+                // only touch the window title when the counts change
+                GpuMemory::Stats memory = backpack.GetMemoryStats();
+                std::uint64_t memoryBytes = memory.BufferBytes + memory.TextureBytes;
+                if (stats.Visible != lastStats.Visible || stats.Culled != lastStats.Culled || memoryBytes != lastMemoryBytes) {
+                    char title[96];
+                    std::snprintf(title, sizeof(title), "3D Model - visible: %u culled: %u gpu: %.1f MB", stats.Visible, stats.Culled,
+                                  memoryBytes / (1024.0 * 1024.0));
+                    glfwSetWindowTitle(window, title);
+                    lastStats = stats;
+                    lastMemoryBytes = memoryBytes;
+                }
+            }
+
+            {
+                PROFILE_ZONE("swap");
+                glfwSwapBuffers(window);
+            }
+            if (!StartupTrace::IsFinished()) {
+                StartupTrace::Finish(cout);
+                if (firstFrameOnly) {
+                    glfwSetWindowShouldClose(window, true);
+                }
+            }
+            glfwPollEvents();
+            Profiler::EndFrame();
+            frameArena.Reset();
+            GpuMemory::EndFrame();
+
+            AllocTracker::EndFrame();
+            if (checkAllocations) {
+                AllocTracker::Frame const &allocations = AllocTracker::GetLastFrame();
+                if (frameCount > WARM_FRAMES && allocations.News > 0) {
+                    cout << "Frame " << frameCount << ": " << allocations.News << " news of " << allocations.NewBytes << " bytes" << endl;
+                    allocatingFrames++;
+                }
+                // startup allocates plenty, the call sites are only of interest once the loop is warm
+                if (frameCount == WARM_FRAMES) {
+                    AllocTracker::SampleCallSites(1);
+                }
+            }
+            frameCount++;
+        }
+
+        if (Profiler::IsRecording()) {
+            writeProfile();
+        }
+        GpuMemory::Report(cout);
+        TextureStream::Stats streaming = TextureStream::GetStats();
+        cout << "Texture streaming: " << streaming.ResidentBytes / (1024.0 * 1024.0) << " MB resident, " << streaming.LevelsStreamedIn
+             << " levels streamed in and " << streaming.LevelsStreamedOut << " out" << endl;
+    }
     glfwTerminate();
+    if (checkAllocations) {
+        cout << allocatingFrames << " of " << (frameCount > WARM_FRAMES ? frameCount - WARM_FRAMES - 1 : 0) << " warm frames allocated, arena peak "
+             << frameArena.GetPeak() << " bytes" << endl;
+        AllocTracker::ReportCallSites(cout, 10);
+        return allocatingFrames > 0 ? 1 : 0;
+    }
     return 0;
 }
\ No newline at end of file
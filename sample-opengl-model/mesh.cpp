@@ -1,6 +1,10 @@
 #include <glad/glad.h>
 
 #include "mesh.hpp"
+#include "framearena.hpp"
+
+#include <algorithm>
+#include <cmath>
 
 using std::string;
 using std::to_string;
@@ -9,7 +13,128 @@ Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std:
     this->vertices = vertices;
     this->indices = indices;
     this->textures = textures;
+    skinned = std::any_of(this->vertices.begin(), this->vertices.end(), [](Vertex const &vertex) { return vertex.m_Weights[0] > 0.0f; });
+    VAO = 0;
+    VBO = 0;
+    EBO = 0;
+    skinnedVAO = 0;
+    skinnedVBO = 0;
+    skinnedCapacity = 0;
+    memory = 0;
+    skinnedMemory = 0;
+    owner = "meshes";
+    computeBounds();
+    computeUvDensity();
+    nameTextureUniforms();
+}
+
+void Mesh::Upload(std::vector<Texture> const &loadedTextures, char const *owner) {
+    for (auto &texture : textures) {
+        for (auto const &loaded : loadedTextures) {
+            if (texture.Id == 0 && texture.Path == loaded.Path) {
+                texture.Id = loaded.Id;
+                break;
+            }
+        }
+    }
+    setupMesh();
+    this->owner = owner;
+    memory = GpuMemory::Register(owner, GpuMemory::Kind::Buffer, getBufferBytes(), [this] { evict(); });
+}
+
+std::uint64_t Mesh::getBufferBytes() const {
+    return vertices.size() * sizeof(Vertex) + indices.size() * sizeof(unsigned int);
+}
+
+void Mesh::evict() {
+    // nothing to delete before Upload, when GL may not even be loaded
+    if (VAO == 0) {
+        return;
+    }
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    VAO = VBO = EBO = 0;
+}
+
+void Mesh::MakeResident() {
+    GpuMemory::Touch(skinnedMemory);
+    if (GpuMemory::Touch(memory)) {
+        return;
+    }
     setupMesh();
+    // the pre-skinned vertex array draws with the indices of the buffer just made
+    if (skinnedVAO) {
+        glBindVertexArray(skinnedVAO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBindVertexArray(0);
+    }
+    GpuMemory::Restored(memory, getBufferBytes());
+}
+
+void Mesh::Release() {
+    evict();
+    if (skinnedVAO != 0) {
+        glDeleteVertexArrays(1, &skinnedVAO);
+        glDeleteBuffers(1, &skinnedVBO);
+        skinnedVAO = skinnedVBO = 0;
+    }
+    skinnedCapacity = 0;
+    GpuMemory::Unregister(memory);
+    GpuMemory::Unregister(skinnedMemory);
+    memory = skinnedMemory = 0;
+}
+
+void Mesh::ReplaceTexture(string const &path, unsigned int id) {
+    for (auto &texture : textures) {
+        if (texture.Path == path) {
+            texture.Id = id;
+        }
+    }
+}
+
+void Mesh::computeBounds() {
+    bounds = AABB { glm::vec3 { 0.0f }, glm::vec3 { 0.0f } };
+    if (!vertices.empty()) {
+        bounds.Min = bounds.Max = vertices[0].Position;
+    }
+    for (auto const &vertex : vertices) {
+        bounds.Min = glm::min(bounds.Min, vertex.Position);
+        bounds.Max = glm::max(bounds.Max, vertex.Position);
+    }
+    // center the sphere on the box and grow it to the farthest vertex, which is tighter than the box diagonal
+    sphere.Center = (bounds.Min + bounds.Max) * 0.5f;
+    float radiusSquared = 0.0f;
+    for (auto const &vertex : vertices) {
+        glm::vec3 offset = vertex.Position - sphere.Center;
+        radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+    }
+    sphere.Radius = glm::sqrt(radiusSquared);
+}
+
+void Mesh::computeUvDensity() {
+    // the ratio of the areas, so stretching in one direction averages out
+    float area = 0.0f;
+    float uvArea = 0.0f;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        Vertex const &a = vertices[indices[i]];
+        Vertex const &b = vertices[indices[i + 1]];
+        Vertex const &c = vertices[indices[i + 2]];
+        area += glm::length(glm::cross(b.Position - a.Position, c.Position - a.Position));
+        glm::vec2 ab = b.TexCoords - a.TexCoords;
+        glm::vec2 ac = c.TexCoords - a.TexCoords;
+        uvArea += std::abs(ab.x * ac.y - ab.y * ac.x);
+    }
+    uvDensity = area > 0.0f ? std::sqrt(uvArea / area) : 0.0f;
+}
+
+std::vector<glm::vec3> Mesh::collectPositions() const {
+    std::vector<glm::vec3> positions;
+    positions.reserve(vertices.size());
+    for (auto const &vertex : vertices) {
+        positions.push_back(vertex.Position);
+    }
+    return positions;
 }
 
 void Mesh::setupMesh() {
@@ -28,6 +153,14 @@ void Mesh::setupMesh() {
     // TexCoords vertex data
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
     glEnableVertexAttribArray(2);
+    // tangent frame, read as a normalized vec4 quaternion
+    glVertexAttribPointer(3, 4, GL_SHORT, GL_TRUE, sizeof(Vertex), (void*)offsetof(Vertex, QTangent));
+    glEnableVertexAttribArray(3);
+    // bone ids and weights for skinned.vs; ids stay integers
+    glVertexAttribIPointer(5, MAX_BONE_INFLUENCE, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
+    glEnableVertexAttribArray(5);
+    glVertexAttribPointer(6, MAX_BONE_INFLUENCE, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
+    glEnableVertexAttribArray(6);
 
     glGenBuffers(1, &EBO);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
@@ -36,27 +169,133 @@ void Mesh::setupMesh() {
     glBindVertexArray(0);
 }
 
-void Mesh::Draw(Shader &shader) const {
+void Mesh::nameTextureUniforms() {
     unsigned int diffuseNr = 1;
     unsigned int specularNr = 1;
+    normalMapped = false;
 
+    textureUniforms.clear();
     for (unsigned int i = 0; i < textures.size(); i++) {
-        glActiveTexture(GL_TEXTURE0 + i);
-
         string texture_nr;
         string texture_type = textures[i].Type;
         if (texture_type == "texture_diffuse") {
             texture_nr = to_string(diffuseNr++);
         } else if (texture_type == "texture_specular") {
             texture_nr = to_string(specularNr);
+        } else if (texture_type == "texture_normal") {
+            texture_nr = "1";
+            normalMapped = true;
         }
+        textureUniforms.push_back("material." + texture_type + texture_nr);
+    }
+}
 
-        shader.SetInt(("material." + texture_type + texture_nr).c_str(), i);
+void Mesh::bindTextures(Shader &shader) const {
+    for (unsigned int i = 0; i < textures.size(); i++) {
+        glActiveTexture(GL_TEXTURE0 + i);
+        shader.SetInt(textureUniforms[i].c_str(), i);
         glBindTexture(GL_TEXTURE_2D, textures[i].Id);
     }
-
     glActiveTexture(GL_TEXTURE0);
+    shader.SetBool("normalMapped", normalMapped);
+}
+
+bool Mesh::SharesMaterial(Mesh const &other) const {
+    if (textures.size() != other.textures.size()) {
+        return false;
+    }
+    for (unsigned int i = 0; i < textures.size(); i++) {
+        if (textures[i].Id != other.textures[i].Id || textureUniforms[i] != other.textureUniforms[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Mesh::Draw(Shader &shader, bool bindMaterial) const {
+    if (bindMaterial) {
+        bindTextures(shader);
+    }
     glBindVertexArray(VAO);
     glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
     glBindVertexArray(0);
-}
\ No newline at end of file
+}
+
+void Mesh::DrawInstanced(Shader &shader, unsigned int instanceCount) const {
+    bindTextures(shader);
+    glBindVertexArray(VAO);
+    glDrawElementsInstanced(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0, instanceCount);
+    glBindVertexArray(0);
+}
+
+void Mesh::PreSkin(Shader const &preSkinShader, unsigned int instanceCount) {
+    // position, normal, texture coordinates and tangent frame, interleaved as preskin.vs declares them
+    GLsizei const stride = 12 * sizeof(GLfloat);
+    if (instanceCount > skinnedCapacity) {
+        if (!skinnedVAO) {
+            glGenVertexArrays(1, &skinnedVAO);
+            glGenBuffers(1, &skinnedVBO);
+        }
+        skinnedCapacity = instanceCount;
+        glBindVertexArray(skinnedVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, skinnedVBO);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(skinnedCapacity) * vertices.size() * stride, nullptr, GL_DYNAMIC_COPY);
+        std::uint64_t skinnedBytes = static_cast<std::uint64_t>(skinnedCapacity) * vertices.size() * stride;
+        if (skinnedMemory) {
+            GpuMemory::Resize(skinnedMemory, skinnedBytes);
+        } else {
+            skinnedMemory = GpuMemory::Register(owner, GpuMemory::Kind::Buffer, skinnedBytes);
+        }
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(GLfloat)));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(GLfloat)));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride, (void*)(8 * sizeof(GLfloat)));
+        glEnableVertexAttribArray(3);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBindVertexArray(0);
+    }
+
+    // every vertex of every instance is captured once, instance after instance, without rasterizing anything
+    preSkinShader.Use();
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, skinnedVBO);
+    glBeginTransformFeedback(GL_POINTS);
+    glBindVertexArray(VAO);
+    glDrawArraysInstanced(GL_POINTS, 0, vertices.size(), instanceCount);
+    glBindVertexArray(0);
+    glEndTransformFeedback();
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glDisable(GL_RASTERIZER_DISCARD);
+}
+
+void Mesh::DrawPreSkinned(Shader &shader, unsigned int instanceCount) const {
+    // instance i starts i * vertexCount vertices into the buffer, every instance reuses the same indices
+    if (drawCounts.size() != instanceCount) {
+        drawCounts.assign(instanceCount, static_cast<GLsizei>(indices.size()));
+        drawOffsets.assign(instanceCount, nullptr);
+        drawBaseVertices.resize(instanceCount);
+        for (unsigned int i = 0; i < instanceCount; i++) {
+            drawBaseVertices[i] = static_cast<GLint>(i * vertices.size());
+        }
+    }
+    bindTextures(shader);
+    glBindVertexArray(skinnedVAO);
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_INT, drawOffsets.data(), static_cast<GLsizei>(instanceCount),
+                                  drawBaseVertices.data());
+    glBindVertexArray(0);
+}
+
+std::uint64_t *BuildDrawList(std::vector<Mesh> const &meshes, CullingBatch const &batch, CullStats const &stats, FrameArena &arena) {
+    std::uint64_t *drawList = arena.Allocate<std::uint64_t>(stats.Visible);
+    unsigned int drawCount = 0;
+    for (unsigned int i = 0; i < meshes.size(); i++) {
+        if (batch.IsVisible(i)) {
+            drawList[drawCount++] = static_cast<std::uint64_t>(meshes[i].GetMaterialKey()) << 32 | i;
+        }
+    }
+    std::sort(drawList, drawList + drawCount);
+    return drawList;
+}
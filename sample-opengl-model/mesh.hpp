@@ -1,18 +1,24 @@
+#pragma once
+
 #include <glm/glm.hpp>
+#include "culling.hpp"
+#include "gpumemory.hpp"
 #include "shader.h"
+#include "trianglebvh.hpp"
+#include <cstdint>
 #include <string>
 #include <vector>
 
 #define MAX_BONE_INFLUENCE 4
 
+class FrameArena;
+
 struct Vertex {
     glm::vec3 Position;
     glm::vec3 Normal;
     glm::vec2 TexCoords;
-    // tangent
-    glm::vec3 Tangent;
-    // bitangent
-    glm::vec3 Bitangent;
+    // tangent frame as a snorm16 quaternion, the sign of w is the bitangent's handedness (see tangents.hpp)
+    std::int16_t QTangent[4];
 	//bone indexes which will influence this vertex
 	int m_BoneIDs[MAX_BONE_INFLUENCE];
 	//weights from each bone
@@ -30,10 +36,71 @@ class Mesh {
         std::vector<Vertex> vertices;
         std::vector<unsigned int> indices;
         std::vector<Texture> textures;
+        std::vector<std::string> textureUniforms; // sampler uniform of each texture, named once rather than per draw
+        bool normalMapped;
         unsigned int VAO, VBO, EBO;
+        bool skinned; // some vertex has a bone weight
+        // world-space vertices of every instance written by PreSkin, drawn instead of VAO by DrawPreSkinned
+        unsigned int skinnedVAO, skinnedVBO;
+        unsigned int skinnedCapacity; // instances skinnedVBO has room for
+        GpuMemory::Handle memory; // VBO and EBO, evictable as the vertices and indices stay on the CPU
+        GpuMemory::Handle skinnedMemory; // skinnedVBO, whose contents only PreSkin can make
+        char const *owner; // of both in GpuMemory
+        mutable std::vector<GLsizei> drawCounts; // per-instance arguments for the pre-skinned multi-draw
+        mutable std::vector<void const *> drawOffsets;
+        mutable std::vector<GLint> drawBaseVertices;
+        AABB bounds; // bounding box in model space
+        BoundingSphere sphere; // bounding sphere in model space
+        float uvDensity; // texture coordinate units per model space unit, averaged over the surface
+        TriangleBvh bvh; // triangle hierarchy for ray and sweep queries in model space
         void setupMesh();
+        void evict();
+        std::uint64_t getBufferBytes() const;
+        void nameTextureUniforms();
+        void bindTextures(Shader &shader) const;
+        void computeBounds();
+        void computeUvDensity();
+        std::vector<glm::vec3> collectPositions() const;
     public:
+        // Only keeps the data, so meshes can be made on worker threads; Upload makes the GL objects
         Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
-        void Draw(Shader &shader) const;
+        // Creates the vertex array and buffers on the thread with the context and registers them with GpuMemory
+        // under owner. Textures without an id yet take the id of the loaded texture with the same path. The mesh
+        // must not move from then on, eviction calls back into it.
+        void Upload(std::vector<Texture> const &loadedTextures = {}, char const *owner = "meshes");
+        // Makes the buffers again if they were evicted, and marks them used this frame; call before drawing
+        void MakeResident();
+        // Deletes the GL objects and unregisters them
+        void Release();
+        std::vector<Texture> const &GetTextures() const { return textures; }
+        // For a texture made again under another name
+        void ReplaceTexture(std::string const &path, unsigned int id);
+        // Without bindMaterial the textures bound by the last draw are used, see SharesMaterial
+        void Draw(Shader &shader, bool bindMaterial = true) const;
+        // Same textures in the same units, so one mesh can be drawn after the other without rebinding
+        bool SharesMaterial(Mesh const &other) const;
+        // Meshes sharing a material have the same key
+        unsigned int GetMaterialKey() const { return textures.empty() ? 0 : textures[0].Id; }
+        // One draw for many instances; skinned.vs picks each instance's block of the bound BonePalette
+        void DrawInstanced(Shader &shader, unsigned int instanceCount) const;
+        // Skins every instance once with transform feedback, for frames that draw the mesh in several passes
+        void PreSkin(Shader const &preSkinShader, unsigned int instanceCount);
+        // Draws the instances written by the last PreSkin in one call; the vertices are already in world space
+        void DrawPreSkinned(Shader &shader, unsigned int instanceCount) const;
+        bool IsSkinned() const { return skinned; }
+        size_t GetVertexCount() const { return vertices.size(); }
+        AABB const &GetAABB() const { return bounds; }
+        BoundingSphere const &GetBoundingSphere() const { return sphere; }
+        // 0 without texture coordinates
+        float GetUvDensity() const { return uvDensity; }
+        // CPU only, so meshes can build their hierarchies on worker threads
+        void BuildBvh() { bvh.Build(collectPositions(), indices); }
+        std::uint64_t GetGeometryHash() const { return TriangleBvh::HashGeometry(collectPositions(), indices); }
+        TriangleBvh &GetBvh() { return bvh; }
+        TriangleBvh const &GetBvh() const { return bvh; }
 };
 
+// The meshes a culled batch found visible, mesh i having been added i'th, as a draw list in the arena: material key
+// in the high 32 bits and mesh index in the low, sorted so the meshes of a material are adjacent and in their order.
+// The list has stats.Visible entries.
+std::uint64_t *BuildDrawList(std::vector<Mesh> const &meshes, CullingBatch const &batch, CullStats const &stats, FrameArena &arena);
@@ -1,6 +1,12 @@
+#include <algorithm>
 #include <functional>
+#include <fstream>
+#include <future>
 #include "model.hpp"
+#include <glm/gtc/type_ptr.hpp>
+#include "startup.hpp"
 #include "stb_image.h"
+#include "tangents.hpp"
 #include <unordered_map>
 
 using Assimp::Importer;
@@ -10,64 +16,374 @@ using std::string;
 using std::vector;
 
 // std::unordered_map<std::string, std::reference_wrapper<Texture>> loaded_textures;
-vector<Texture> textures_loaded;	
 
-Model::Model(char const *path) {
+Model::Model(char const *path, bool upload) : name { Profiler::Intern(path) } {
     stbi_set_flip_vertically_on_load(true);
     loadModel(path);
+    if (upload) {
+        Upload();
+    }
+}
+
+void Model::Upload() {
+    PROFILE_ZONE("Model::Upload");
+    {
+        StartupPhase phase { "wait for textures" };
+        for (auto &decode : decodes) {
+            decode.wait();
+        }
+    }
+    StartupPhase phase { "upload model" };
+    for (unsigned int i = 0; i < decodes.size(); i++) {
+        TextureStream::Prepared prepared = decodes[i].get();
+        if (prepared.Width == 0) {
+            cout << "Failed to load image" << endl;
+        }
+        textureStreams.push_back(TextureStream::Add(prepared, name));
+        loadedTextures[i].Id = TextureStream::GetTexture(textureStreams.back());
+    }
+    decodes.clear();
+    for (auto &mesh : meshes) {
+        mesh.Upload(loadedTextures, name);
+    }
+    uploaded = true;
+}
+
+Model::~Model() {
+    // a model that never reached Upload has no GL objects, e.g. the loader's when the window couldn't be made
+    if (!uploaded) {
+        return;
+    }
+    for (auto &mesh : meshes) {
+        mesh.Release();
+    }
+    for (auto texture : textureStreams) {
+        TextureStream::Remove(texture);
+    }
+}
+
+unsigned int Model::findLoadedTexture(Texture const &texture) const {
+    // by path, as a texture evicted and made again has another name
+    for (unsigned int i = 0; i < loadedTextures.size(); i++) {
+        if (loadedTextures[i].Path == texture.Path) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+void Model::makeResident(unsigned int mesh) {
+    meshes[mesh].MakeResident();
+    for (auto const &texture : meshes[mesh].GetTextures()) {
+        unsigned int loaded = findLoadedTexture(texture);
+        if (TextureStream::MakeResident(textureStreams[loaded])) {
+            loadedTextures[loaded].Id = TextureStream::GetTexture(textureStreams[loaded]);
+            for (auto &other : meshes) {
+                other.ReplaceTexture(loadedTextures[loaded].Path, loadedTextures[loaded].Id);
+            }
+        }
+    }
+}
+
+void Model::RequestTextureLevels(glm::mat4 const &model, glm::vec3 const &eye, float pixelsPerUnit) const {
+    for (unsigned int i = 0; i < meshes.size(); i++) {
+        if (i >= cullingBatch.Size() || !cullingBatch.IsVisible(i) || meshes[i].GetUvDensity() <= 0.0f) {
+            continue;
+        }
+        glm::mat4 transform = model * GetMeshTransform(i);
+        BoundingSphere sphere = TransformSphere(meshes[i].GetBoundingSphere(), transform);
+        // the nearest point of the bounds samples the finest level
+        float distance = std::max(glm::length(sphere.Center - eye) - sphere.Radius, 0.01f);
+        float scale = glm::length(glm::vec3 { transform[0] });
+        // texture coordinate units per pixel at that distance
+        float uvPerPixel = meshes[i].GetUvDensity() * distance / (pixelsPerUnit * scale);
+        for (auto const &texture : meshes[i].GetTextures()) {
+            TextureStream::Handle stream = textureStreams[findLoadedTexture(texture)];
+            TextureStream::Request(stream, std::log2(std::max(TextureStream::GetSize(stream) * uvPerPixel, 1.0f)));
+        }
+    }
 }
 
 void Model::Draw(Shader &shader) {
+    PROFILE_ZONE("Model::Draw");
+    nodes.UpdateWorldTransforms();
     for (unsigned int i = 0; i < meshes.size(); i++) {
+        makeResident(i);
+        PROFILE_GPU_ZONE(drawNames[i]);
+        shader.SetFloatMatrix("model", GetMeshTransform(i));
         meshes[i].Draw(shader);
     }
 }
 
+CullStats Model::Draw(Shader &shader, Frustum const &frustum, glm::mat4 const &model, FrameArena &arena) {
+    PROFILE_ZONE("Model::Draw");
+    nodes.UpdateWorldTransforms();
+    cullingBatch.Clear();
+    cullingBatch.Reserve(meshes.size());
+    glm::mat4 *transforms = arena.Allocate<glm::mat4>(meshes.size());
+    for (unsigned int i = 0; i < meshes.size(); i++) {
+        transforms[i] = model * GetMeshTransform(i);
+        cullingBatch.Add(TransformAABB(meshes[i].GetAABB(), transforms[i]), TransformSphere(meshes[i].GetBoundingSphere(), transforms[i]));
+    }
+
+    CullStats stats = cullingBatch.Cull(frustum);
+    std::uint64_t *drawList = BuildDrawList(meshes, cullingBatch, stats, arena);
+    for (unsigned int i = 0; i < stats.Visible; i++) {
+        makeResident(static_cast<unsigned int>(drawList[i]));
+    }
+
+    Mesh const *previous = nullptr;
+    for (unsigned int i = 0; i < stats.Visible; i++) {
+        unsigned int index = static_cast<unsigned int>(drawList[i]);
+        PROFILE_GPU_ZONE(drawNames[index]);
+        shader.SetFloatMatrix("model", transforms[index]);
+        meshes[index].Draw(shader, previous == nullptr || !meshes[index].SharesMaterial(*previous));
+        previous = &meshes[index];
+    }
+    return stats;
+}
+
 void Model::loadModel(string path) {
     Importer importer;
+    StartupPhase importPhase { "import model" };
     aiScene const *scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+    importPhase.End();
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
         cout << "ERROR::ASSIMP" << importer.GetErrorString() << endl;
         return;
     }
 
+    StartupPhase processPhase { "process meshes" };
     directory = path.substr(0, path.find_last_of('/'));
-    processNode(scene->mRootNode, scene);
+    processNode(scene->mRootNode, scene, SceneGraph::NO_PARENT);
+    nodes.UpdateWorldTransforms();
+    // bones are animated through the nodes of the same name
+    boneNodes.assign(boneInfo.size(), SceneGraph::NO_PARENT);
+    for (auto const &[name, bone] : boneInfo) {
+        boneNodes[bone.Id] = nodes.FindNode(name);
+    }
+    skeleton = Skeleton { nodes, boneInfo };
+    loadAnimations(scene);
+    processPhase.End();
+    StartupPhase collisionPhase { "build collision" };
+    buildCollision(path);
+}
+
+void Model::loadAnimations(aiScene const *scene) {
+    for (unsigned int i = 0; i < scene->mNumAnimations; i++) {
+        aiAnimation const *animation = scene->mAnimations[i];
+        // keys are in ticks; files that leave the rate out are commonly authored at 25
+        float ticksPerSecond = animation->mTicksPerSecond != 0.0 ? static_cast<float>(animation->mTicksPerSecond) : 25.0f;
+        vector<AnimationTrack> tracks;
+        for (unsigned int j = 0; j < animation->mNumChannels; j++) {
+            aiNodeAnim const *channel = animation->mChannels[j];
+            AnimationTrack track;
+            track.Node = channel->mNodeName.C_Str();
+            for (unsigned int k = 0; k < channel->mNumPositionKeys; k++) {
+                aiVectorKey const &key = channel->mPositionKeys[k];
+                track.PositionTimes.push_back(static_cast<float>(key.mTime) / ticksPerSecond);
+                track.Positions.push_back(glm::vec3 { key.mValue.x, key.mValue.y, key.mValue.z });
+            }
+            for (unsigned int k = 0; k < channel->mNumRotationKeys; k++) {
+                aiQuatKey const &key = channel->mRotationKeys[k];
+                track.RotationTimes.push_back(static_cast<float>(key.mTime) / ticksPerSecond);
+                track.Rotations.push_back(glm::quat { key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z });
+            }
+            for (unsigned int k = 0; k < channel->mNumScalingKeys; k++) {
+                aiVectorKey const &key = channel->mScalingKeys[k];
+                track.ScaleTimes.push_back(static_cast<float>(key.mTime) / ticksPerSecond);
+                track.Scales.push_back(glm::vec3 { key.mValue.x, key.mValue.y, key.mValue.z });
+            }
+            tracks.push_back(std::move(track));
+        }
+        animations.emplace_back(animation->mName.C_Str(), static_cast<float>(animation->mDuration) / ticksPerSecond, tracks, skeleton);
+    }
+}
+
+void Model::buildCollision(string const &path) {
+    string cachePath = path + ".bvh";
+    std::ifstream cache { cachePath, std::ios::binary };
+    if (cache) {
+        std::uint32_t meshCount = 0;
+        cache.read(reinterpret_cast<char *>(&meshCount), sizeof(meshCount));
+        bool valid = cache && meshCount == meshes.size();
+        for (unsigned int i = 0; valid && i < meshes.size(); i++) {
+            valid = meshes[i].GetBvh().Load(cache, meshes[i].GetGeometryHash());
+        }
+        if (valid) {
+            return;
+        }
+    }
+
+    // meshes are independent, so each one builds on its own thread
+    vector<std::future<void>> jobs;
+    for (auto &mesh : meshes) {
+        jobs.push_back(std::async(std::launch::async, [&mesh] {
+            Profiler::SetThreadName("bvh build");
+            PROFILE_ZONE("Mesh::BuildBvh");
+            mesh.BuildBvh();
+        }));
+    }
+    for (auto &job : jobs) {
+        job.wait();
+    }
+
+    std::ofstream output { cachePath, std::ios::binary };
+    std::uint32_t meshCount = static_cast<std::uint32_t>(meshes.size());
+    output.write(reinterpret_cast<char const *>(&meshCount), sizeof(meshCount));
+    for (auto const &mesh : meshes) {
+        mesh.GetBvh().Save(output);
+    }
+    if (!output) {
+        cout << "Unable to write collision cache " << cachePath << endl;
+    }
+}
+
+bool Model::Raycast(Ray const &ray, glm::mat4 const &transform, RayHit &hit, unsigned int *meshIndex) const {
+    float maxDistance = ray.MaxDistance;
+    bool found = false;
+    for (unsigned int i = 0; i < meshes.size(); i++) {
+        // move the ray into mesh space without normalizing, so ray distances are the same in both spaces
+        glm::mat4 inverse = glm::inverse(transform * GetMeshTransform(i));
+        Ray local { glm::vec3 { inverse * glm::vec4 { ray.Origin, 1.0f } }, glm::vec3 { inverse * glm::vec4 { ray.Direction, 0.0f } }, maxDistance };
+        RayHit meshHit;
+        if (meshes[i].GetBvh().Raycast(local, meshHit)) {
+            maxDistance = meshHit.Distance;
+            hit = meshHit;
+            hit.Normal = glm::normalize(glm::mat3 { glm::transpose(inverse) } * meshHit.Normal);
+            found = true;
+            if (meshIndex) {
+                *meshIndex = i;
+            }
+        }
+    }
+    return found;
+}
+
+bool Model::SphereSweep(glm::vec3 const &center, float radius, glm::vec3 const &motion, glm::mat4 const &transform, RayHit &hit) const {
+    bool found = false;
+    for (unsigned int i = 0; i < meshes.size(); i++) {
+        glm::mat4 meshTransform = transform * GetMeshTransform(i);
+        glm::mat4 inverse = glm::inverse(meshTransform);
+        glm::vec3 localCenter { inverse * glm::vec4 { center, 1.0f } };
+        glm::vec3 localMotion { inverse * glm::vec4 { motion, 0.0f } };
+        float localRadius = radius / glm::length(glm::vec3 { meshTransform[0] });
+        RayHit meshHit;
+        if (meshes[i].GetBvh().SphereSweep(localCenter, localRadius, localMotion, meshHit) && (!found || meshHit.Distance < hit.Distance)) {
+            hit = meshHit;
+            hit.Normal = glm::normalize(glm::mat3 { glm::transpose(inverse) } * meshHit.Normal);
+            found = true;
+        }
+    }
+    return found;
+}
+
+void Model::ComputeBoneMatrices(glm::mat4 *bones) const {
+    for (auto const &[name, bone] : boneInfo) {
+        int node = boneNodes[bone.Id];
+        bones[bone.Id] = node == SceneGraph::NO_PARENT ? glm::mat4 { 1.0f } : nodes.GetWorldTransform(node) * bone.Offset;
+    }
+}
+
+void Model::DrawInstanced(Shader &shader, BonePalette const &palette) {
+    nodes.UpdateWorldTransforms();
+    // the material textures take the first units
+    palette.Bind(shader, 8);
+    for (unsigned int i = 0; i < meshes.size(); i++) {
+        makeResident(i);
+        PROFILE_GPU_ZONE(drawNames[i]);
+        shader.SetFloatMatrix("nodeTransform", GetMeshTransform(i));
+        meshes[i].DrawInstanced(shader, palette.GetInstanceCount());
+    }
+}
+
+void Model::PreSkin(Shader const &preSkinShader, BonePalette const &palette) {
+    nodes.UpdateWorldTransforms();
+    preSkinShader.Use();
+    palette.Bind(preSkinShader, 8);
+    for (unsigned int i = 0; i < meshes.size(); i++) {
+        makeResident(i);
+        PROFILE_GPU_ZONE(drawNames[i]);
+        preSkinShader.SetFloatMatrix("nodeTransform", GetMeshTransform(i));
+        meshes[i].PreSkin(preSkinShader, palette.GetInstanceCount());
+    }
+}
+
+void Model::DrawPreSkinned(Shader &shader, unsigned int instanceCount) {
+    shader.SetFloatMatrix("model", glm::mat4 { 1.0f });
+    for (unsigned int i = 0; i < meshes.size(); i++) {
+        makeResident(i);
+        PROFILE_GPU_ZONE(drawNames[i]);
+        meshes[i].DrawPreSkinned(shader, instanceCount);
+    }
+}
+
+glm::vec3 ModelCollider::ResolveMove(glm::vec3 const &from, glm::vec3 const &to, float radius) const {
+    float const skin = 0.001f; // stay this far off the surface so the next sweep does not start in contact
+    glm::vec3 position = from;
+    glm::vec3 motion = to - from;
+    // a few iterations of move-until-contact then slide the remainder along the contact plane
+    for (int iteration = 0; iteration < 3; iteration++) {
+        float length = glm::length(motion);
+        if (length < 1e-6f) {
+            break;
+        }
+        RayHit hit;
+        if (!model.SphereSweep(position, radius, motion, transform, hit)) {
+            position += motion;
+            break;
+        }
+        float travel = std::max(hit.Distance - skin / length, 0.0f);
+        position += motion * travel;
+        motion *= 1.0f - travel;
+        motion -= hit.Normal * glm::dot(motion, hit.Normal);
+    }
+    return position;
 }
 
-void Model::processNode(aiNode *node, aiScene const *scene) {
+void Model::processNode(aiNode *node, aiScene const *scene, int parent) {
+    // aiMatrix4x4 is row-major, glm is column-major
+    glm::mat4 localTransform = glm::transpose(glm::make_mat4(&node->mTransformation.a1));
+    unsigned int index = nodes.AddNode(parent, localTransform, node->mName.C_Str());
     // first, process the mesh in the current node
     for (unsigned int i = 0; i < node->mNumMeshes; i++) {
         aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
+        aiString material;
+        scene->mMaterials[mesh->mMaterialIndex]->Get(AI_MATKEY_NAME, material);
+        drawNames.push_back(Profiler::Intern("mesh " + std::to_string(meshes.size()) + " (" + material.C_Str() + ")"));
         meshes.push_back(processMesh(mesh, scene));
+        meshNodes.push_back(index);
     }
-    // next, recursively process the children nodes
+    // next, recursively process the children nodes, which keeps the graph depth-first
     for (unsigned int i = 0; i < node->mNumChildren; i++) {
-        processNode(node->mChildren[i], scene);
+        processNode(node->mChildren[i], scene, static_cast<int>(index));
     }
 }
 
-Mesh Model::processMesh(aiMesh *mesh, aiScene const *scene) const {
+Mesh Model::processMesh(aiMesh *mesh, aiScene const *scene) {
     vector<Vertex> vertices;
     vector<unsigned int> indices;
     vector<Texture> textures;
     
     // convert Assimp data structure to own data structure
     for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-        Vertex vertex;
+        Vertex vertex {};
         vertex.Position = glm::vec3 { mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z };
         if (mesh->HasNormals()) {
             vertex.Normal = glm::vec3 { mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z };
         }
         if (mesh->mTextureCoords[0]) {
             vertex.TexCoords = glm::vec2 { mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y }; 
-            // vertex.Tangent = glm::vec3 { mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z };
-            // vertex.Bitangent = glm::vec3 { mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z };
         } else {
             vertex.TexCoords = glm::vec2 { 0.0f, 0.0f };
         }
+        for (int j = 0; j < MAX_BONE_INFLUENCE; j++) {
+            vertex.m_BoneIDs[j] = -1;
+            vertex.m_Weights[j] = 0.0f;
+        }
         vertices.push_back(vertex);
     }
+    extractBoneWeights(vertices, mesh);
 
     for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
         aiFace face = mesh->mFaces[i];
@@ -75,17 +391,90 @@ Mesh Model::processMesh(aiMesh *mesh, aiScene const *scene) const {
             indices.push_back(face.mIndices[j]);
         }
     }
+    generateTangentFrames(vertices, indices);
 
     aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
     vector<Texture> diffuseMaps = loadMaterialTexture(material, aiTextureType_DIFFUSE, "texture_diffuse");
     textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
     vector<Texture> specularMaps = loadMaterialTexture(material, aiTextureType_SPECULAR, "texture_specular");
     textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+    // obj files list their normal maps as bump maps
+    vector<Texture> normalMaps = loadMaterialTexture(material, aiTextureType_NORMALS, "texture_normal");
+    if (normalMaps.empty()) {
+        normalMaps = loadMaterialTexture(material, aiTextureType_HEIGHT, "texture_normal");
+    }
+    textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
     
     return Mesh { vertices, indices, textures };
 }
 
-vector<Texture> Model::loadMaterialTexture(aiMaterial *material, aiTextureType textureType, std::string type) const {
+// Keeps the strongest MAX_BONE_INFLUENCE weights of a vertex
+static void addBoneWeight(Vertex &vertex, int boneId, float weight) {
+    int weakest = 0;
+    for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+        if (vertex.m_BoneIDs[i] == boneId) {
+            return;
+        }
+        if (vertex.m_Weights[i] < vertex.m_Weights[weakest]) {
+            weakest = i;
+        }
+    }
+    if (weight > vertex.m_Weights[weakest]) {
+        vertex.m_BoneIDs[weakest] = boneId;
+        vertex.m_Weights[weakest] = weight;
+    }
+}
+
+void Model::generateTangentFrames(vector<Vertex> &vertices, vector<unsigned int> const &indices) {
+    vector<glm::vec3> positions, normals;
+    vector<glm::vec2> texCoords;
+    positions.reserve(vertices.size());
+    normals.reserve(vertices.size());
+    texCoords.reserve(vertices.size());
+    for (auto const &vertex : vertices) {
+        positions.push_back(vertex.Position);
+        normals.push_back(vertex.Normal);
+        texCoords.push_back(vertex.TexCoords);
+    }
+    // without texture coordinates every face is degenerate and the tangents fall back to any perpendicular
+    vector<glm::vec4> tangents = GenerateTangents(positions, normals, texCoords, indices);
+    for (size_t i = 0; i < vertices.size(); i++) {
+        EncodeQTangent(vertices[i].Normal, tangents[i], vertices[i].QTangent);
+    }
+}
+
+void Model::extractBoneWeights(vector<Vertex> &vertices, aiMesh *mesh) {
+    for (unsigned int i = 0; i < mesh->mNumBones; i++) {
+        aiBone *bone = mesh->mBones[i];
+        string name = bone->mName.C_Str();
+        // meshes share the bones of a skeleton, so the ids are per model
+        auto found = boneInfo.find(name);
+        if (found == boneInfo.end()) {
+            glm::mat4 offset = glm::transpose(glm::make_mat4(&bone->mOffsetMatrix.a1));
+            found = boneInfo.emplace(name, BoneInfo { static_cast<int>(boneInfo.size()), offset }).first;
+        }
+        for (unsigned int j = 0; j < bone->mNumWeights; j++) {
+            aiVertexWeight const &weight = bone->mWeights[j];
+            if (weight.mVertexId < vertices.size()) {
+                addBoneWeight(vertices[weight.mVertexId], found->second.Id, weight.mWeight);
+            }
+        }
+    }
+    // dropped influences would otherwise shrink the vertex towards the origin
+    for (auto &vertex : vertices) {
+        float total = 0.0f;
+        for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+            total += vertex.m_Weights[i];
+        }
+        if (total > 0.0f) {
+            for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+                vertex.m_Weights[i] /= total;
+            }
+        }
+    }
+}
+
+vector<Texture> Model::loadMaterialTexture(aiMaterial *material, aiTextureType textureType, std::string type) {
     vector<Texture> textures;
     for (unsigned int i = 0; i < material->GetTextureCount(textureType); i++)
     {
@@ -110,11 +499,11 @@ vector<Texture> Model::loadMaterialTexture(aiMaterial *material, aiTextureType t
         material->GetTexture(textureType, i, &str);
         // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
         bool skip = false;
-        for(unsigned int j = 0; j < textures_loaded.size(); j++)
+        for(unsigned int j = 0; j < loadedTextures.size(); j++)
         {
-            if(std::strcmp(textures_loaded[j].Path.data(), str.C_Str()) == 0)
+            if(std::strcmp(loadedTextures[j].Path.data(), str.C_Str()) == 0)
             {
-                textures.push_back(textures_loaded[j]);
+                textures.push_back(loadedTextures[j]);
                 skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
                 break;
             }
@@ -122,46 +511,25 @@ vector<Texture> Model::loadMaterialTexture(aiMaterial *material, aiTextureType t
         if(!skip)
         {   // if texture hasn't been loaded already, load it
             Texture texture;
-            texture.Id = loadTextureFromFile(str.C_Str(), this->directory);
+            texture.Id = 0; // set by Upload
             texture.Type = type;
             texture.Path = str.C_Str();
             textures.push_back(texture);
-            textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+            loadedTextures.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+            // the decodes run alongside the rest of the import and are only waited for by Upload
+            decodes.push_back(std::async(std::launch::async, [path = directory + '/' + texture.Path] {
+                Profiler::SetThreadName("texture decode");
+                return prepareTexture(path);
+            }));
         }
     }
 
     return textures;
 }
 
-unsigned int Model::loadTextureFromFile(char const *path, string const &directory) const {
-    unsigned int textureId = 0;
-    int width, height, numOfColorChannel;
-    string fullPath = directory + '/' + path;
-    unsigned char *imageData = stbi_load(fullPath.c_str(), &width, &height, &numOfColorChannel, 0);
-
-    if (imageData) {
-        glGenTextures(1, &textureId);
-        glBindTexture(GL_TEXTURE_2D, textureId);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        GLenum format = GL_RGBA;
-        if (numOfColorChannel == 1) {
-            format = GL_RED;
-        } else if (numOfColorChannel == 3) {
-            format = GL_RGB;
-        } else if (numOfColorChannel == 4) {
-            format = GL_RGBA;
-        }
-
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, imageData);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    } else {
-        cout << "Failed to load image" << endl;
-    }
-
-    stbi_image_free(imageData);
-    return textureId;
+TextureStream::Prepared Model::prepareTexture(string const &path) {
+    char const *name = Profiler::Intern("decode " + path.substr(path.find_last_of('/') + 1));
+    StartupPhase phase { name };
+    PROFILE_ZONE(name);
+    return TextureStream::Prepare(path);
 }
\ No newline at end of file
@@ -1,23 +1,107 @@
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include <future>
 #include <glm/glm.hpp>
 #include <iostream>
+#include "animation.hpp"
+#include "camera.hpp"
+#include "framearena.hpp"
+#include "gpumemory.hpp"
 #include "mesh.hpp"
+#include "profiler.hpp"
+#include "scenegraph.hpp"
+#include "skinning.hpp"
+#include "texturestream.hpp"
+#include <unordered_map>
 #include <vector>
 
 
 class Model {
     private:
         std::vector<Mesh> meshes;
+        SceneGraph nodes; // the aiNode hierarchy with its transforms
+        std::vector<unsigned int> meshNodes; // node each mesh hangs from
+        std::vector<char const *> drawNames; // "mesh <index> (<material>)", the profiler's name for each mesh's draws
+        std::unordered_map<std::string, BoneInfo> boneInfo; // bones of every mesh by node name
+        std::vector<int> boneNodes; // node driving each bone, by bone id
+        Skeleton skeleton;
+        std::vector<AnimationClip> animations; // compressed on load
         std::string directory;
+        char const *name; // the file, which the model's resources are grouped under in GpuMemory
+        CullingBatch cullingBatch; // reused every frame to avoid reallocating the bound arrays
+        std::vector<Texture> loadedTextures; // one per file, so meshes sharing a texture share its id
+        std::vector<std::future<TextureStream::Prepared>> decodes; // the coarse levels of each loaded texture, until Upload
+        std::vector<TextureStream::Handle> textureStreams; // of each loaded texture
+        bool uploaded = false;
         
         void loadModel(std::string path);
-        void processNode(aiNode *node, aiScene const *scene);
-        Mesh processMesh(aiMesh *mesh, aiScene const *scene) const;
-        std::vector<Texture> loadMaterialTexture(aiMaterial *material, aiTextureType textureType, std::string type) const;
-        unsigned int loadTextureFromFile(char const *path, std::string const &directory) const;
+        // Loads the triangle hierarchies from <path>.bvh, or builds them in parallel and writes that cache
+        void buildCollision(std::string const &path);
+        void processNode(aiNode *node, aiScene const *scene, int parent);
+        Mesh processMesh(aiMesh *mesh, aiScene const *scene);
+        void extractBoneWeights(std::vector<Vertex> &vertices, aiMesh *mesh);
+        // MikkTSpace-style tangents from the texture coordinates, packed into each vertex's QTangent
+        void generateTangentFrames(std::vector<Vertex> &vertices, std::vector<unsigned int> const &indices);
+        void loadAnimations(aiScene const *scene);
+        std::vector<Texture> loadMaterialTexture(aiMaterial *material, aiTextureType textureType, std::string type);
+        static TextureStream::Prepared prepareTexture(std::string const &path);
+        // index in loadedTextures of a mesh's texture
+        unsigned int findLoadedTexture(Texture const &texture) const;
+        // Makes the buffers and textures of the mesh resident before it draws
+        void makeResident(unsigned int mesh);
     public:
-        Model(char const *path);
+        // Without upload only the CPU does any work, the file is read and its textures decoded on worker threads,
+        // so the model can load on any thread while the context is made; Upload must follow on the context's thread
+        explicit Model(char const *path, bool upload = true);
+        // Only before Upload, eviction calls back into the model afterwards
+        Model(Model &&) = default;
+        ~Model();
+        // Waits for the textures to decode, then makes the GL objects of the meshes and textures
+        void Upload();
+        bool IsUploaded() const { return uploaded; }
+        // The feedback pass of texture streaming: requests the mip level each texture of the meshes the last culled
+        // Draw found visible will be sampled at, from their distance to the eye and the texel density of their
+        // texture coordinates. pixelsPerUnit is the height in pixels of something one unit tall one unit away.
+        void RequestTextureLevels(glm::mat4 const &model, glm::vec3 const &eye, float pixelsPerUnit) const;
+        // Video memory of the meshes and textures
+        GpuMemory::Stats GetMemoryStats() const { return GpuMemory::GetOwnerStats(name); }
+        // Both draws update the node transforms first and set the "model" uniform for every mesh
         void Draw(Shader &shader);
+        // Draw only the meshes whose bounds, placed with the model matrix, intersect the frustum. The draw list and
+        // the model matrices live in the arena; the visible meshes are sorted by material so shared textures bind once.
+        CullStats Draw(Shader &shader, Frustum const &frustum, glm::mat4 const &model, FrameArena &arena);
+        // Node transforms can be changed through the graph; queries use the world transforms of the last draw
+        SceneGraph &GetSceneGraph() { return nodes; }
+        SceneGraph const &GetSceneGraph() const { return nodes; }
+        // Model-space transform of a mesh, i.e. the world transform of its node
+        glm::mat4 const &GetMeshTransform(unsigned int mesh) const { return nodes.GetWorldTransform(meshNodes[mesh]); }
+
+        bool IsSkinned() const { return !boneNodes.empty(); }
+        unsigned int GetBoneCount() const { return static_cast<unsigned int>(boneNodes.size()); }
+        std::unordered_map<std::string, BoneInfo> const &GetBoneInfo() const { return boneInfo; }
+        Skeleton const &GetSkeleton() const { return skeleton; }
+        std::vector<AnimationClip> const &GetAnimations() const { return animations; }
+        // Skinning matrices for the current node transforms, indexed by bone id
+        void ComputeBoneMatrices(glm::mat4 *bones) const;
+        // Draws palette.GetInstanceCount() instances, skinned in the vertex shader (skinned.vs)
+        void DrawInstanced(Shader &shader, BonePalette const &palette);
+        // Skins every instance of the palette once (preskin.vs); DrawPreSkinned then draws them any number of times
+        void PreSkin(Shader const &preSkinShader, BonePalette const &palette);
+        void DrawPreSkinned(Shader &shader, unsigned int instanceCount);
+        // Closest hit of a world-space ray against the model placed with the given transform
+        bool Raycast(Ray const &ray, glm::mat4 const &transform, RayHit &hit, unsigned int *meshIndex = nullptr) const;
+        // First contact of a world-space sphere moving by `motion`; assumes the transform scales uniformly
+        bool SphereSweep(glm::vec3 const &center, float radius, glm::vec3 const &motion, glm::mat4 const &transform, RayHit &hit) const;
+};
+
+// Lets the camera stop at, and slide along, the surfaces of a placed model
+class ModelCollider : public CameraCollider {
+    private:
+        Model const &model;
+        glm::mat4 transform;
+    public:
+        ModelCollider(Model const &model, glm::mat4 const &transform) : model(model), transform(transform) {}
+        void SetTransform(glm::mat4 const &transform) { this->transform = transform; }
+        glm::vec3 ResolveMove(glm::vec3 const &from, glm::vec3 const &to, float radius) const override;
 };
\ No newline at end of file
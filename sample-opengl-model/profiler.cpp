@@ -0,0 +1,272 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+namespace {
+    struct CpuEvent {
+        char const *Name;
+        std::int64_t Start, End;
+    };
+
+    // Written by its thread only and drained by EndFrame, which only moves the tail
+    struct ThreadRing {
+        static constexpr std::uint64_t CAPACITY = 1 << 14;
+        std::unique_ptr<CpuEvent[]> Events { new CpuEvent[CAPACITY] };
+        std::atomic<std::uint64_t> Head { 0 };
+        std::atomic<std::uint64_t> Tail { 0 };
+        std::atomic<std::uint64_t> Dropped { 0 };
+        std::atomic<bool> Exited { false };
+        std::atomic<char const *> Name { "thread" };
+        bool Free = false; // exited and drained, so a new thread can take it; guarded by ringsMutex
+        unsigned int Track = 0;
+    };
+
+    struct TraceEvent {
+        char const *Name;
+        char const *Category;
+        std::int64_t Start, End;
+        unsigned int Track; // 0 is the GPU, the threads follow
+    };
+
+    struct PendingGpuZone {
+        char const *Name;
+        GLuint Queries[2];
+    };
+
+    // hands the ring back when its thread exits
+    struct ThreadSlot {
+        ThreadRing *Ring = nullptr;
+        char const *Name = nullptr;
+        ~ThreadSlot() {
+            if (Ring != nullptr) {
+                Ring->Exited.store(true, std::memory_order_release);
+            }
+        }
+    };
+
+    GLsizei const QUERY_BATCH = 64;
+
+    std::mutex ringsMutex;
+    vector<std::unique_ptr<ThreadRing>> rings;
+    std::mutex internMutex;
+    std::unordered_set<string> interned; // nodes don't move, so their strings don't either
+    thread_local ThreadSlot slot;
+
+    // only touched on the thread with the context
+    vector<TraceEvent> events;
+    vector<GLuint> freeQueries;
+    std::deque<PendingGpuZone> pendingGpu;
+    std::int64_t sessionStart = 0;
+    std::int64_t gpuOffset = 0; // steady clock minus GPU clock, both in nanoseconds
+
+    ThreadRing *claimRing() {
+        std::lock_guard<std::mutex> lock { ringsMutex };
+        auto free = std::find_if(rings.begin(), rings.end(), [](auto const &ring) { return ring->Free; });
+        ThreadRing *ring;
+        if (free != rings.end()) {
+            ring = free->get();
+            ring->Free = false;
+            ring->Exited.store(false, std::memory_order_relaxed);
+        } else {
+            rings.push_back(std::make_unique<ThreadRing>());
+            ring = rings.back().get();
+            ring->Track = static_cast<unsigned int>(rings.size());
+        }
+        ring->Name.store(slot.Name != nullptr ? slot.Name : "thread", std::memory_order_relaxed);
+        return ring;
+    }
+
+    void collectCpu(bool keep) {
+        std::lock_guard<std::mutex> lock { ringsMutex };
+        for (auto &ring : rings) {
+            // a thread that exited pushed everything before saying so
+            bool exited = ring->Exited.load(std::memory_order_acquire);
+            std::uint64_t head = ring->Head.load(std::memory_order_acquire);
+            for (std::uint64_t tail = ring->Tail.load(std::memory_order_relaxed); tail != head; tail++) {
+                CpuEvent const &event = ring->Events[tail % ThreadRing::CAPACITY];
+                // zones that started before the recording belong to an earlier one
+                if (keep && event.Start >= sessionStart) {
+                    events.push_back(TraceEvent { event.Name, "cpu", event.Start, event.End, ring->Track });
+                }
+            }
+            ring->Tail.store(head, std::memory_order_release);
+            if (exited) {
+                ring->Free = true;
+            }
+        }
+    }
+
+    void collectGpu(bool keep) {
+        // the GPU finishes the queries in order, so the first one not ready ends the readback
+        while (!pendingGpu.empty()) {
+            PendingGpuZone const &zone = pendingGpu.front();
+            GLint available = 0;
+            glGetQueryObjectiv(zone.Queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                break;
+            }
+            GLuint64 start = 0, end = 0;
+            glGetQueryObjectui64v(zone.Queries[0], GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(zone.Queries[1], GL_QUERY_RESULT, &end);
+            if (keep) {
+                events.push_back(TraceEvent { zone.Name, "gpu", static_cast<std::int64_t>(start) + gpuOffset, static_cast<std::int64_t>(end) + gpuOffset, 0 });
+            }
+            freeQueries.push_back(zone.Queries[0]);
+            freeQueries.push_back(zone.Queries[1]);
+            pendingGpu.pop_front();
+        }
+    }
+
+    void writeString(std::ostream &out, char const *text) {
+        out << '"';
+        for (; *text != '\0'; text++) {
+            unsigned char c = static_cast<unsigned char>(*text);
+            if (c == '"' || c == '\\') {
+                out << '\\' << *text;
+            } else if (c < 0x20) {
+                out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec << std::setfill(' ');
+            } else {
+                out << *text;
+            }
+        }
+        out << '"';
+    }
+
+    void writeThreadName(std::ostream &out, unsigned int track, char const *name) {
+        out << "{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << track << ", \"args\": { \"name\": ";
+        writeString(out, name);
+        out << " } }";
+    }
+}
+
+std::int64_t Profiler::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::recordCpu(char const *name, std::int64_t start, std::int64_t end) {
+    if (slot.Ring == nullptr) {
+        slot.Ring = claimRing();
+    }
+    ThreadRing &ring = *slot.Ring;
+    std::uint64_t head = ring.Head.load(std::memory_order_relaxed);
+    if (head - ring.Tail.load(std::memory_order_acquire) >= ThreadRing::CAPACITY) {
+        ring.Dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    ring.Events[head % ThreadRing::CAPACITY] = CpuEvent { name, start, end };
+    ring.Head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::beginGpu(GLuint queries[2]) {
+    if (freeQueries.size() < 2) {
+        size_t size = freeQueries.size();
+        freeQueries.resize(size + QUERY_BATCH);
+        glGenQueries(QUERY_BATCH, freeQueries.data() + size);
+    }
+    queries[1] = freeQueries.back();
+    freeQueries.pop_back();
+    queries[0] = freeQueries.back();
+    freeQueries.pop_back();
+    glQueryCounter(queries[0], GL_TIMESTAMP);
+}
+
+void Profiler::endGpu(char const *name, GLuint const queries[2]) {
+    glQueryCounter(queries[1], GL_TIMESTAMP);
+    pendingGpu.push_back(PendingGpuZone { name, { queries[0], queries[1] } });
+}
+
+void Profiler::Start() {
+    collectCpu(false);
+    collectGpu(false);
+    {
+        std::lock_guard<std::mutex> lock { ringsMutex };
+        for (auto &ring : rings) {
+            ring->Dropped.store(0, std::memory_order_relaxed);
+        }
+    }
+    events.clear();
+    sessionStart = now();
+    // the GPU clock has its own origin; line it up with the steady clock once per recording
+    GLint64 gpuNow = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+    gpuOffset = now() - gpuNow;
+    recording.store(true, std::memory_order_relaxed);
+}
+
+void Profiler::Stop() {
+    if (!IsRecording()) {
+        return;
+    }
+    glFinish();
+    collectCpu(true);
+    collectGpu(true);
+    recording.store(false, std::memory_order_relaxed);
+}
+
+void Profiler::EndFrame() {
+    if (!IsRecording() && pendingGpu.empty()) {
+        return;
+    }
+    collectCpu(IsRecording());
+    collectGpu(IsRecording());
+}
+
+char const *Profiler::Intern(string const &name) {
+    std::lock_guard<std::mutex> lock { internMutex };
+    return interned.insert(name).first->c_str();
+}
+
+void Profiler::SetThreadName(char const *name) {
+    slot.Name = name;
+    if (slot.Ring != nullptr) {
+        slot.Ring->Name.store(name, std::memory_order_relaxed);
+    }
+}
+
+bool Profiler::WriteChromeTrace(string const &path) {
+    // parents before their children, so viewers nest zones that share a start
+    vector<TraceEvent> sorted = events;
+    std::stable_sort(sorted.begin(), sorted.end(), [](TraceEvent const &a, TraceEvent const &b) {
+        return a.Start != b.Start ? a.Start < b.Start : a.End > b.End;
+    });
+
+    std::ofstream out { path };
+    out << std::fixed << std::setprecision(3);
+    out << "{ \"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    writeThreadName(out, 0, "GPU");
+    {
+        std::lock_guard<std::mutex> lock { ringsMutex };
+        for (auto const &ring : rings) {
+            out << ",\n";
+            writeThreadName(out, ring->Track, ring->Name.load(std::memory_order_relaxed));
+        }
+    }
+    // timestamps in microseconds from the start of the recording
+    for (auto const &event : sorted) {
+        out << ",\n{ \"name\": ";
+        writeString(out, event.Name);
+        out << ", \"cat\": \"" << event.Category << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << event.Track
+            << ", \"ts\": " << (event.Start - sessionStart) / 1e3 << ", \"dur\": " << std::max<std::int64_t>(event.End - event.Start, 0) / 1e3 << " }";
+    }
+    out << "\n] }\n";
+    return static_cast<bool>(out);
+}
+
+std::uint64_t Profiler::GetDroppedCount() {
+    std::lock_guard<std::mutex> lock { ringsMutex };
+    std::uint64_t dropped = 0;
+    for (auto const &ring : rings) {
+        dropped += ring->Dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// A frame profiler recording nested CPU and GPU zones into a trace that chrome://tracing and ui.perfetto.dev open.
+//
+// - CPU zones are timed on a steady clock and pushed into a ring buffer owned by the thread, which only that thread
+//   writes and EndFrame drains, so recording takes no lock. A full ring drops zones instead of waiting, and counts
+//   them. Rings of threads that exited are handed to the next new thread, so short-lived workers don't pile up.
+// - GPU zones write a GL_TIMESTAMP query at either end, from a pool that grows to the number of queries in flight
+//   and is recycled from then on. EndFrame reads back the zones whose queries are available and leaves the rest for
+//   a later frame, so it never waits for the GPU. Timestamps rather than GL_TIME_ELAPSED, as those can't nest.
+//   GPU zones must be opened on the thread the context is current on.
+//
+// Zone names are kept as pointers until the trace is written, so they have to be literals or come from Intern.
+// While not recording, a zone costs a relaxed atomic load; build with -DNO_PROFILER to remove the zones entirely.
+class Profiler {
+    private:
+        inline static std::atomic<bool> recording { false };
+
+        friend class CpuZone;
+        friend class GpuZone;
+        static std::int64_t now();
+        static void recordCpu(char const *name, std::int64_t start, std::int64_t end);
+        static void beginGpu(GLuint queries[2]);
+        static void endGpu(char const *name, GLuint const queries[2]);
+    public:
+        // Starts a new recording, dropping the previous one
+        static void Start();
+        // Waits for the GPU zones still in flight and stops recording
+        static void Stop();
+        static bool IsRecording() { return recording.load(std::memory_order_relaxed); }
+        // Collects the zones finished so far; call once per frame on the thread with the context
+        static void EndFrame();
+
+        // A copy of the name that lives as long as the program, for zone names built at runtime
+        static char const *Intern(std::string const &name);
+        // Names the calling thread's track in the trace; name must be a literal or interned
+        static void SetThreadName(char const *name);
+
+        // Writes the recording in the Chrome trace event format
+        static bool WriteChromeTrace(std::string const &path);
+        // zones lost to full rings since Start
+        static std::uint64_t GetDroppedCount();
+};
+
+class CpuZone {
+    private:
+        char const *name;
+        std::int64_t start; // negative when the zone started while not recording
+    public:
+        explicit CpuZone(char const *name) : name { name }, start { Profiler::IsRecording() ? Profiler::now() : -1 } {}
+        ~CpuZone() {
+            if (start >= 0) {
+                Profiler::recordCpu(name, start, Profiler::now());
+            }
+        }
+        CpuZone(CpuZone const &) = delete;
+        CpuZone &operator=(CpuZone const &) = delete;
+};
+
+class GpuZone {
+    private:
+        char const *name;
+        GLuint queries[2];
+        bool active;
+    public:
+        explicit GpuZone(char const *name) : name { name }, queries { 0, 0 }, active { Profiler::IsRecording() } {
+            if (active) {
+                Profiler::beginGpu(queries);
+            }
+        }
+        ~GpuZone() {
+            if (active) {
+                Profiler::endGpu(name, queries);
+            }
+        }
+        GpuZone(GpuZone const &) = delete;
+        GpuZone &operator=(GpuZone const &) = delete;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#if defined(NO_PROFILER)
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_GPU_ZONE(name) ((void)0)
+#else
+// times the rest of the enclosing scope
+#define PROFILE_ZONE(name) CpuZone PROFILE_CONCAT(profileZone, __LINE__) { name }
+#define PROFILE_GPU_ZONE(name) GpuZone PROFILE_CONCAT(profileGpuZone, __LINE__) { name }
+#endif
@@ -0,0 +1,98 @@
+#include "scenegraph.hpp"
+
+#include <algorithm>
+
+using std::string;
+
+SceneGraph::SceneGraph() : subtreesValid(true) {}
+
+void SceneGraph::Clear() {
+    parents.clear();
+    subtreeEnds.clear();
+    names.clear();
+    localTransforms.clear();
+    worldTransforms.clear();
+    dirty.clear();
+    dirtyNodes.clear();
+    subtreesValid = true;
+}
+
+void SceneGraph::Reserve(size_t count) {
+    parents.reserve(count);
+    subtreeEnds.reserve(count);
+    names.reserve(count);
+    localTransforms.reserve(count);
+    worldTransforms.reserve(count);
+    dirty.reserve(count);
+}
+
+unsigned int SceneGraph::AddNode(int parent, glm::mat4 const &localTransform, string name) {
+    unsigned int node = static_cast<unsigned int>(parents.size());
+    parents.push_back(parent);
+    subtreeEnds.push_back(node + 1);
+    names.push_back(std::move(name));
+    localTransforms.push_back(localTransform);
+    worldTransforms.push_back(localTransform);
+    dirty.push_back(0);
+    markDirty(node);
+    // the ancestors' ranges grow, fixed up lazily so building stays linear for deep hierarchies
+    subtreesValid = subtreesValid && parent == NO_PARENT;
+    return node;
+}
+
+void SceneGraph::SetLocalTransform(unsigned int node, glm::mat4 const &localTransform) {
+    localTransforms[node] = localTransform;
+    markDirty(node);
+}
+
+void SceneGraph::markDirty(unsigned int node) {
+    if (!dirty[node]) {
+        dirty[node] = 1;
+        dirtyNodes.push_back(node);
+    }
+}
+
+void SceneGraph::computeSubtreeEnds() {
+    // children come after their parents, so a backward pass sees every subtree complete before its parent
+    for (size_t i = parents.size(); i-- > 0;) {
+        subtreeEnds[i] = std::max(subtreeEnds[i], static_cast<unsigned int>(i + 1));
+        if (parents[i] != NO_PARENT) {
+            subtreeEnds[parents[i]] = std::max(subtreeEnds[parents[i]], subtreeEnds[i]);
+        }
+    }
+    subtreesValid = true;
+}
+
+unsigned int SceneGraph::UpdateWorldTransforms() {
+    if (dirtyNodes.empty()) {
+        return 0;
+    }
+    if (!subtreesValid) {
+        computeSubtreeEnds();
+    }
+
+    // in index order a dirty node inside an already recomputed range is covered by its ancestor
+    std::sort(dirtyNodes.begin(), dirtyNodes.end());
+    unsigned int updated = 0;
+    unsigned int coveredEnd = 0;
+    for (unsigned int root : dirtyNodes) {
+        dirty[root] = 0;
+        if (root < coveredEnd) {
+            continue;
+        }
+        unsigned int end = subtreeEnds[root];
+        for (unsigned int i = root; i < end; i++) {
+            int parent = parents[i];
+            worldTransforms[i] = parent == NO_PARENT ? localTransforms[i] : worldTransforms[parent] * localTransforms[i];
+        }
+        updated += end - root;
+        coveredEnd = end;
+    }
+    dirtyNodes.clear();
+    return updated;
+}
+
+int SceneGraph::FindNode(string const &name) const {
+    auto found = std::find(names.begin(), names.end(), name);
+    return found == names.end() ? NO_PARENT : static_cast<int>(found - names.begin());
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+// Node hierarchy flattened into arrays. Nodes are stored depth-first, so every parent comes before its children
+// and each subtree occupies the contiguous range [node, subtree end). Local and world transforms live in separate
+// arrays; changing a local transform only marks its node, and the next update walks the ranges of the marked
+// subtrees instead of the whole hierarchy.
+class SceneGraph {
+    public:
+        static constexpr int NO_PARENT = -1;
+    private:
+        std::vector<int> parents;
+        std::vector<unsigned int> subtreeEnds; // one past the last descendant
+        std::vector<std::string> names;
+        std::vector<glm::mat4> localTransforms;
+        std::vector<glm::mat4> worldTransforms;
+        std::vector<unsigned char> dirty;
+        std::vector<unsigned int> dirtyNodes; // roots of the subtrees to recompute, in no particular order
+        bool subtreesValid;
+
+        void markDirty(unsigned int node);
+        void computeSubtreeEnds();
+    public:
+        SceneGraph();
+        void Clear();
+        void Reserve(size_t count);
+        // Appends a node; nodes must be added depth-first, i.e. the parent is the previous node or one of its ancestors
+        unsigned int AddNode(int parent, glm::mat4 const &localTransform, std::string name = "");
+        void SetLocalTransform(unsigned int node, glm::mat4 const &localTransform);
+        // Recomputes the world transforms below every changed node and returns how many were recomputed
+        unsigned int UpdateWorldTransforms();
+        // First node with the given name, or NO_PARENT when there is none
+        int FindNode(std::string const &name) const;
+
+        size_t Size() const { return parents.size(); }
+        bool IsDirty() const { return !dirtyNodes.empty(); }
+        int GetParent(unsigned int node) const { return parents[node]; }
+        std::string const &GetName(unsigned int node) const { return names[node]; }
+        glm::mat4 const &GetLocalTransform(unsigned int node) const { return localTransforms[node]; }
+        // Valid as of the last UpdateWorldTransforms
+        glm::mat4 const &GetWorldTransform(unsigned int node) const { return worldTransforms[node]; }
+        glm::mat4 const *GetWorldTransforms() const { return worldTransforms.data(); }
+};
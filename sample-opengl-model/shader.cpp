@@ -86,6 +86,48 @@ Shader::Shader(string vertexShaderPath, string fragmentShaderPath) {
     glDeleteShader(fragmentShader);
 }
 
+Shader::Shader(string vertexShaderPath, std::vector<string> const &feedbackVaryings) {
+    string vertexCode;
+    ifstream vertexShaderFile;
+    vertexShaderFile.exceptions(ifstream::failbit | ifstream::badbit);
+    try {
+        vertexShaderFile.open(vertexShaderPath);
+        stringstream vertexShaderStream;
+        vertexShaderStream << vertexShaderFile.rdbuf();
+        vertexShaderFile.close();
+        vertexCode = vertexShaderStream.str();
+    } catch (ifstream::failure e) {
+        cout << "Unable to read shader file" << endl;
+    }
+    char const *vShaderCode = vertexCode.c_str();
+
+    GLint success;
+    GLchar infoLog[512];
+    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertexShader, 1, &vShaderCode, nullptr);
+    glCompileShader(vertexShader);
+    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(vertexShader, 512, nullptr, infoLog);
+        cout << "Vertex shader compilation error" << infoLog << endl;
+    }
+    program_id = glCreateProgram();
+    glAttachShader(program_id, vertexShader);
+    // the captured outputs have to be declared before linking
+    std::vector<char const *> varyings;
+    for (auto const &varying : feedbackVaryings) {
+        varyings.push_back(varying.c_str());
+    }
+    glTransformFeedbackVaryings(program_id, static_cast<GLsizei>(varyings.size()), varyings.data(), GL_INTERLEAVED_ATTRIBS);
+    glLinkProgram(program_id);
+    glGetProgramiv(program_id, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(program_id, 512, nullptr, infoLog);
+        cout << "Shader program link error" << infoLog << endl;
+    }
+    glDeleteShader(vertexShader);
+}
+
 Shader::~Shader() {
     glDeleteProgram(program_id);
 }
@@ -94,26 +136,26 @@ void Shader::Use() const {
     glUseProgram(program_id);
 }
 
-void Shader::SetBool(string const &uniform, bool value) const {
-    glUniform1i(glGetUniformLocation(program_id, uniform.c_str()), (int)value);
+void Shader::SetBool(char const *uniform, bool value) const {
+    glUniform1i(glGetUniformLocation(program_id, uniform), (int)value);
 }
 
-void Shader::SetInt(string const &uniform, int value) const {
-    glUniform1i(glGetUniformLocation(program_id, uniform.c_str()), value);
+void Shader::SetInt(char const *uniform, int value) const {
+    glUniform1i(glGetUniformLocation(program_id, uniform), value);
 }
 
-void Shader::SetFloat(string const &uniform, float value) const {
-    glUniform1f(glGetUniformLocation(program_id, uniform.c_str()), value);
+void Shader::SetFloat(char const *uniform, float value) const {
+    glUniform1f(glGetUniformLocation(program_id, uniform), value);
 }
 
-void Shader::SetFloatMatrix(string const &uniform, glm::mat4 matrix) const {
-    glUniformMatrix4fv(glGetUniformLocation(program_id, uniform.c_str()), 1, GL_FALSE, &matrix[0][0]);
+void Shader::SetFloatMatrix(char const *uniform, glm::mat4 matrix) const {
+    glUniformMatrix4fv(glGetUniformLocation(program_id, uniform), 1, GL_FALSE, &matrix[0][0]);
 }
 
-void Shader::SetFloatVec3(std::string const &uniform, float x, float y, float z) const {
-    glUniform3f(glGetUniformLocation(program_id, uniform.c_str()), x, y, z);
+void Shader::SetFloatVec3(char const *uniform, float x, float y, float z) const {
+    glUniform3f(glGetUniformLocation(program_id, uniform), x, y, z);
 }
 
-void Shader::SetFloatVec3(std::string const &uniform, glm::vec3 vector) const {
-    glUniform3fv(glGetUniformLocation(program_id, uniform.c_str()), 1, &vector[0]);
+void Shader::SetFloatVec3(char const *uniform, glm::vec3 vector) const {
+    glUniform3fv(glGetUniformLocation(program_id, uniform), 1, &vector[0]);
 }
\ No newline at end of file
@@ -1,22 +1,28 @@
+#pragma once
+
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <string>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <vector>
 
 class Shader {
     private:
         int program_id;
     public:
         Shader(std::string vertexShaderPath, std::string fragmentShaderPath);
+        // Vertex-only program whose outputs are captured, interleaved, with transform feedback
+        Shader(std::string vertexShaderPath, std::vector<std::string> const &feedbackVaryings);
         ~Shader();
         int GetProgramId() const { return program_id; }
         void Use() const;
-        void SetFloat(std::string const &uniform, float value) const;
-        void SetInt(std::string const &uniform, int value) const;
-        void SetBool(std::string const &uniform, bool value) const;
-        void SetFloatMatrix(std::string const &uniform, glm::mat4 matrix) const;
-        void SetFloatVec3(std::string const &uniform, float x, float y, float z) const;
-        void SetFloatVec3(std::string const &uniform, glm::vec3 vector) const;
+        // names are C strings so that literals don't build a std::string on every call
+        void SetFloat(char const *uniform, float value) const;
+        void SetInt(char const *uniform, int value) const;
+        void SetBool(char const *uniform, bool value) const;
+        void SetFloatMatrix(char const *uniform, glm::mat4 matrix) const;
+        void SetFloatVec3(char const *uniform, float x, float y, float z) const;
+        void SetFloatVec3(char const *uniform, glm::vec3 vector) const;
 };
\ No newline at end of file
@@ -3,6 +3,7 @@
 struct Material {
     sampler2D texture_diffuse1;
     sampler2D texture_specular1;
+    sampler2D texture_normal1;
     float shininess;
 };
 
@@ -28,16 +29,22 @@ out vec4 FragColor;
 in vec3 Normal;
 in vec2 TexCoords;
 in vec3 FragPos;
+in mat3 TBN;
 
 uniform Material material;
 uniform DirectionalLight directionalLight;
 uniform PointLight pointLight;
+uniform bool normalMapped;
 
 vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 viewDir);
 
 void main() {
     vec3 normal = normalize(Normal);
+    if (normalMapped) {
+        vec3 tangentNormal = texture(material.texture_normal1, TexCoords).rgb * 2.0 - 1.0;
+        normal = normalize(TBN * tangentNormal);
+    }
     vec3 viewDir = normalize(-FragPos);
 
     vec3 result = CalcDirectionalLight(directionalLight, normal, viewDir);
@@ -3,18 +3,36 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNorm;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec4 aQTangent;
 
 out vec3 Normal;
 out vec2 TexCoords;
 out vec3 FragPos;
+out mat3 TBN; // view space
 
 uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
 
+// tangent frame from the quaternion packed in aQTangent: columns tangent, bitangent, normal (see tangents.hpp)
+vec3 rotate(vec4 q, vec3 v) {
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+mat3 decodeQTangent(vec4 quaternion) {
+    vec4 q = normalize(quaternion);
+    vec3 tangent = rotate(q, vec3(1.0, 0.0, 0.0));
+    vec3 normal = rotate(q, vec3(0.0, 0.0, 1.0));
+    return mat3(tangent, (q.w < 0.0 ? -1.0 : 1.0) * cross(normal, tangent), normal);
+}
+
 void main() {
     gl_Position = projection * view * model * vec4(aPos, 1.0);
     TexCoords = aTexCoords;
-    Normal = mat3(transpose(inverse(view * model))) * aNorm;
+    mat3 normalMatrix = mat3(transpose(inverse(view * model)));
+    Normal = normalMatrix * aNorm;
+    // tangents lie in the surface and move with it, the normal needs the inverse transpose
+    mat3 frame = decodeQTangent(aQTangent);
+    TBN = mat3(mat3(view * model) * frame[0], mat3(view * model) * frame[1], normalMatrix * frame[2]);
     FragPos = vec3(view * model * vec4(aPos, 1.0));
 }
\ No newline at end of file
@@ -0,0 +1,90 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNorm;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec4 aQTangent;
+layout (location = 5) in ivec4 aBoneIds;
+layout (location = 6) in vec4 aWeights;
+
+// captured with transform feedback, in this order
+out vec3 SkinnedPosition;
+out vec3 SkinnedNormal;
+out vec2 SkinnedTexCoords;
+out vec4 SkinnedQTangent;
+
+// same palette layout as skinned.vs
+uniform samplerBuffer bonePalette;
+uniform int paletteStride;
+uniform int firstInstance;
+// transform of the mesh's node, for vertices no bone moves
+uniform mat4 nodeTransform;
+
+mat4 paletteMatrix(int index) {
+    int texel = index * 4;
+    return mat4(texelFetch(bonePalette, texel), texelFetch(bonePalette, texel + 1),
+                texelFetch(bonePalette, texel + 2), texelFetch(bonePalette, texel + 3));
+}
+
+// tangent frame from the quaternion packed in aQTangent: columns tangent, bitangent, normal (see tangents.hpp)
+vec3 rotate(vec4 q, vec3 v) {
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+mat3 decodeQTangent(vec4 quaternion) {
+    vec4 q = normalize(quaternion);
+    vec3 tangent = rotate(q, vec3(1.0, 0.0, 0.0));
+    vec3 normal = rotate(q, vec3(0.0, 0.0, 1.0));
+    return mat3(tangent, (q.w < 0.0 ? -1.0 : 1.0) * cross(normal, tangent), normal);
+}
+
+// the inverse of decodeQTangent, for a frame whose tangent and normal are unit length and orthogonal
+vec4 encodeQTangent(vec3 tangent, vec3 normal, float handedness) {
+    mat3 m = mat3(tangent, cross(normal, tangent), normal);
+    float trace = m[0][0] + m[1][1] + m[2][2];
+    vec4 q;
+    if (trace > 0.0) {
+        float s = 0.5 / sqrt(trace + 1.0);
+        q = vec4((m[1][2] - m[2][1]) * s, (m[2][0] - m[0][2]) * s, (m[0][1] - m[1][0]) * s, 0.25 / s);
+    } else if (m[0][0] > m[1][1] && m[0][0] > m[2][2]) {
+        float s = 2.0 * sqrt(1.0 + m[0][0] - m[1][1] - m[2][2]);
+        q = vec4(0.25 * s, (m[1][0] + m[0][1]) / s, (m[2][0] + m[0][2]) / s, (m[1][2] - m[2][1]) / s);
+    } else if (m[1][1] > m[2][2]) {
+        float s = 2.0 * sqrt(1.0 + m[1][1] - m[0][0] - m[2][2]);
+        q = vec4((m[1][0] + m[0][1]) / s, 0.25 * s, (m[2][1] + m[1][2]) / s, (m[2][0] - m[0][2]) / s);
+    } else {
+        float s = 2.0 * sqrt(1.0 + m[2][2] - m[0][0] - m[1][1]);
+        q = vec4((m[2][0] + m[0][2]) / s, (m[2][1] + m[1][2]) / s, 0.25 * s, (m[0][1] - m[1][0]) / s);
+    }
+    q = normalize(q) * (q.w < 0.0 ? -1.0 : 1.0);
+    // keep w away from zero so its sign can carry the handedness
+    q.w = max(q.w, 1e-4);
+    return normalize(q) * handedness;
+}
+
+void main() {
+    int block = (firstInstance + gl_InstanceID) * paletteStride;
+    mat4 skin = mat4(0.0);
+    float total = 0.0;
+    for (int i = 0; i < 4; i++) {
+        if (aBoneIds[i] >= 0 && aWeights[i] > 0.0) {
+            skin += aWeights[i] * paletteMatrix(block + 1 + aBoneIds[i]);
+            total += aWeights[i];
+        }
+    }
+    if (total == 0.0) {
+        skin = nodeTransform;
+    }
+    mat4 model = paletteMatrix(block) * skin;
+
+    // world space, so later passes draw with an identity model matrix
+    SkinnedPosition = vec3(model * vec4(aPos, 1.0));
+    mat3 normalMatrix = mat3(transpose(inverse(model)));
+    SkinnedNormal = normalize(normalMatrix * aNorm);
+    SkinnedTexCoords = aTexCoords;
+    mat3 frame = decodeQTangent(aQTangent);
+    vec3 normal = normalize(normalMatrix * frame[2]);
+    vec3 tangent = mat3(model) * frame[0];
+    tangent = normalize(tangent - normal * dot(normal, tangent));
+    SkinnedQTangent = encodeQTangent(tangent, normal, aQTangent.w < 0.0 ? -1.0 : 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNorm;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec4 aQTangent;
+layout (location = 5) in ivec4 aBoneIds;
+layout (location = 6) in vec4 aWeights;
+
+out vec3 Normal;
+out vec2 TexCoords;
+out vec3 FragPos;
+out mat3 TBN; // view space
+
+uniform mat4 projection;
+uniform mat4 view;
+
+// per instance: the model matrix followed by the bone matrices, four texels each
+uniform samplerBuffer bonePalette;
+uniform int paletteStride;
+uniform int firstInstance;
+// transform of the mesh's node, for vertices no bone moves
+uniform mat4 nodeTransform;
+
+mat4 paletteMatrix(int index) {
+    int texel = index * 4;
+    return mat4(texelFetch(bonePalette, texel), texelFetch(bonePalette, texel + 1),
+                texelFetch(bonePalette, texel + 2), texelFetch(bonePalette, texel + 3));
+}
+
+// tangent frame from the quaternion packed in aQTangent: columns tangent, bitangent, normal (see tangents.hpp)
+vec3 rotate(vec4 q, vec3 v) {
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+mat3 decodeQTangent(vec4 quaternion) {
+    vec4 q = normalize(quaternion);
+    vec3 tangent = rotate(q, vec3(1.0, 0.0, 0.0));
+    vec3 normal = rotate(q, vec3(0.0, 0.0, 1.0));
+    return mat3(tangent, (q.w < 0.0 ? -1.0 : 1.0) * cross(normal, tangent), normal);
+}
+
+void main() {
+    int block = (firstInstance + gl_InstanceID) * paletteStride;
+    mat4 skin = mat4(0.0);
+    float total = 0.0;
+    for (int i = 0; i < 4; i++) {
+        if (aBoneIds[i] >= 0 && aWeights[i] > 0.0) {
+            skin += aWeights[i] * paletteMatrix(block + 1 + aBoneIds[i]);
+            total += aWeights[i];
+        }
+    }
+    // vertices without bones follow their node
+    if (total == 0.0) {
+        skin = nodeTransform;
+    }
+    mat4 model = paletteMatrix(block) * skin;
+
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    TexCoords = aTexCoords;
+    mat3 normalMatrix = mat3(transpose(inverse(view * model)));
+    Normal = normalMatrix * aNorm;
+    mat3 frame = decodeQTangent(aQTangent);
+    TBN = mat3(mat3(view * model) * frame[0], mat3(view * model) * frame[1], normalMatrix * frame[2]);
+    FragPos = vec3(view * model * vec4(aPos, 1.0));
+}
\ No newline at end of file
@@ -0,0 +1,185 @@
+// GPU skinning benchmark: hundreds of procedurally animated characters drawn in several passes (as a shadow,
+// depth prepass and color pass would), either skinned in the vertex shader of every pass or pre-skinned once per
+// frame with transform feedback. Needs no model files; build with `make skinbench` and run ./skinbench from this
+// directory so the shaders are found.
+
+#include <glad/glad.h>
+
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "mesh.hpp"
+#include "shader.h"
+#include "skinning.hpp"
+#include "tangents.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+unsigned int const WIDTH = 800;
+unsigned int const HEIGHT = 600;
+unsigned int const BONES = 8;
+unsigned int const RINGS = 32;
+unsigned int const SEGMENTS = 24;
+float const CHARACTER_HEIGHT = 2.0f;
+unsigned int const PASSES = 3;
+unsigned int const FRAMES = 100;
+unsigned int const WARMUP_FRAMES = 5; // not timed, they include shader compilation and buffer growth
+
+// a capped-less cylinder standing on the origin, each ring weighted between the two nearest bones
+static Mesh makeCharacter() {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    float boneLength = CHARACTER_HEIGHT / BONES;
+    for (unsigned int ring = 0; ring <= RINGS; ring++) {
+        float y = CHARACTER_HEIGHT * ring / RINGS;
+        float along = y / boneLength - 0.5f;
+        int lower = std::max(0, std::min(static_cast<int>(std::floor(along)), static_cast<int>(BONES) - 1));
+        int upper = std::min(lower + 1, static_cast<int>(BONES) - 1);
+        float blend = glm::clamp(along - lower, 0.0f, 1.0f);
+        for (unsigned int segment = 0; segment <= SEGMENTS; segment++) {
+            float angle = 2.0f * glm::pi<float>() * segment / SEGMENTS;
+            Vertex vertex {};
+            vertex.Normal = glm::vec3 { std::cos(angle), 0.0f, std::sin(angle) };
+            vertex.Position = vertex.Normal * 0.2f + glm::vec3 { 0.0f, y, 0.0f };
+            vertex.TexCoords = glm::vec2 { static_cast<float>(segment) / SEGMENTS, static_cast<float>(ring) / RINGS };
+            EncodeQTangent(vertex.Normal, glm::vec4 { -std::sin(angle), 0.0f, std::cos(angle), 1.0f }, vertex.QTangent);
+            for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+                vertex.m_BoneIDs[i] = -1;
+                vertex.m_Weights[i] = 0.0f;
+            }
+            vertex.m_BoneIDs[0] = lower;
+            vertex.m_Weights[0] = 1.0f - blend;
+            if (upper != lower) {
+                vertex.m_BoneIDs[1] = upper;
+                vertex.m_Weights[1] = blend;
+            } else {
+                vertex.m_Weights[0] = 1.0f;
+            }
+            vertices.push_back(vertex);
+        }
+    }
+    for (unsigned int ring = 0; ring < RINGS; ring++) {
+        for (unsigned int segment = 0; segment < SEGMENTS; segment++) {
+            unsigned int a = ring * (SEGMENTS + 1) + segment;
+            unsigned int b = a + SEGMENTS + 1;
+            indices.insert(indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+        }
+    }
+    return Mesh { vertices, indices, {} };
+}
+
+// bones sway with a per-instance phase; the bind pose has bone j standing at j * boneLength
+static void animate(float time, float phase, glm::mat4 *bones) {
+    float boneLength = CHARACTER_HEIGHT / BONES;
+    glm::mat4 global { 1.0f };
+    for (unsigned int j = 0; j < BONES; j++) {
+        glm::mat4 local = glm::translate(glm::mat4 { 1.0f }, glm::vec3 { 0.0f, j == 0 ? 0.0f : boneLength, 0.0f });
+        local = glm::rotate(local, 0.25f * std::sin(2.0f * time + phase + 0.5f * j), glm::vec3 { 0.0f, 0.0f, 1.0f });
+        global = global * local;
+        glm::mat4 offset = glm::translate(glm::mat4 { 1.0f }, glm::vec3 { 0.0f, -boneLength * j, 0.0f });
+        bones[j] = global * offset;
+    }
+}
+
+int main() {
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    auto window = glfwCreateWindow(WIDTH, HEIGHT, "Skinning benchmark", nullptr, nullptr);
+    if (window == nullptr) {
+        std::printf("Failed to create GLFW window\n");
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::printf("Unable to initialize GLAD\n");
+        return -1;
+    }
+
+    {
+        Shader skinnedShader { "./shader/skinned.vs", "./shader/model.fs" };
+        Shader preSkinShader { "./shader/preskin.vs", { "SkinnedPosition", "SkinnedNormal", "SkinnedTexCoords", "SkinnedQTangent" } };
+        Shader staticShader { "./shader/model.vs", "./shader/model.fs" };
+        Mesh character = makeCharacter();
+        character.Upload();
+        BonePalette palette;
+        glm::mat4 bones[BONES];
+        GLuint query;
+        glGenQueries(1, &query);
+
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)WIDTH / (float)HEIGHT, 0.1f, 200.0f);
+        glm::mat4 view = glm::lookAt(glm::vec3 { 0.0f, 20.0f, 40.0f }, glm::vec3 { 0.0f }, glm::vec3 { 0.0f, 1.0f, 0.0f });
+        for (Shader const *shader : { &skinnedShader, &staticShader }) {
+            shader->Use();
+            shader->SetFloatMatrix("projection", projection);
+            shader->SetFloatMatrix("view", view);
+        }
+        glEnable(GL_DEPTH_TEST);
+
+        std::printf("%u vertices per character, %u bones, %u passes per frame\n", static_cast<unsigned int>(character.GetVertexCount()), BONES, PASSES);
+        for (unsigned int count : { 100u, 300u, 1000u }) {
+            palette.Resize(count, BONES);
+            unsigned int columns = static_cast<unsigned int>(std::ceil(std::sqrt(static_cast<float>(count))));
+            for (int preSkinned = 0; preSkinned < 2; preSkinned++) {
+                double cpuMs = 0.0;
+                double gpuMs = 0.0;
+                for (unsigned int frame = 0; frame < WARMUP_FRAMES + FRAMES; frame++) {
+                    auto start = Clock::now();
+                    float time = frame / 60.0f;
+                    for (unsigned int i = 0; i < count; i++) {
+                        glm::vec3 position { 1.5f * (i % columns) - 0.75f * columns, 0.0f, 1.5f * (i / columns) - 0.75f * columns };
+                        animate(time, 0.37f * i, bones);
+                        palette.SetInstance(i, glm::translate(glm::mat4 { 1.0f }, position), bones, BONES);
+                    }
+                    palette.Upload();
+                    double frameCpuMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+                    glBeginQuery(GL_TIME_ELAPSED, query);
+                    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                    if (preSkinned) {
+                        preSkinShader.Use();
+                        palette.Bind(preSkinShader, 8);
+                        preSkinShader.SetFloatMatrix("nodeTransform", glm::mat4 { 1.0f });
+                        character.PreSkin(preSkinShader, count);
+                        staticShader.Use();
+                        staticShader.SetFloatMatrix("model", glm::mat4 { 1.0f });
+                        for (unsigned int pass = 0; pass < PASSES; pass++) {
+                            character.DrawPreSkinned(staticShader, count);
+                        }
+                    } else {
+                        skinnedShader.Use();
+                        palette.Bind(skinnedShader, 8);
+                        skinnedShader.SetFloatMatrix("nodeTransform", glm::mat4 { 1.0f });
+                        for (unsigned int pass = 0; pass < PASSES; pass++) {
+                            character.DrawInstanced(skinnedShader, count);
+                        }
+                    }
+                    glEndQuery(GL_TIME_ELAPSED);
+                    GLuint64 elapsed = 0;
+                    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+                    if (frame >= WARMUP_FRAMES) {
+                        cpuMs += frameCpuMs;
+                        gpuMs += elapsed / 1e6;
+                    }
+                    glfwSwapBuffers(window);
+                }
+                std::printf("%5u characters %-26s cpu %6.3f ms/frame  gpu %7.3f ms/frame\n", count,
+                            preSkinned ? "pre-skinned once" : "skinned in every pass", cpuMs / FRAMES, gpuMs / FRAMES);
+            }
+        }
+        glDeleteQueries(1, &query);
+    }
+
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,49 @@
+#include "skinning.hpp"
+
+#include <algorithm>
+
+BonePalette::BonePalette() : instanceCount(0), boneCount(0), capacity(0) {
+    glGenBuffers(1, &buffer);
+    glGenTextures(1, &texture);
+}
+
+BonePalette::~BonePalette() {
+    glDeleteTextures(1, &texture);
+    glDeleteBuffers(1, &buffer);
+}
+
+void BonePalette::Resize(unsigned int instanceCount, unsigned int boneCount) {
+    this->instanceCount = instanceCount;
+    this->boneCount = boneCount;
+    matrices.assign(static_cast<size_t>(instanceCount) * GetStride(), glm::mat4 { 1.0f });
+}
+
+void BonePalette::SetInstance(unsigned int instance, glm::mat4 const &model, glm::mat4 const *bones, unsigned int count) {
+    glm::mat4 *block = &matrices[instance * GetStride()];
+    block[0] = model;
+    std::copy(bones, bones + std::min(count, boneCount), block + 1);
+}
+
+void BonePalette::Upload() {
+    bool grow = matrices.size() > capacity;
+    capacity = std::max(capacity, matrices.size());
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, capacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+    if (grow) {
+        // re-attach so the texture sees the new size
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, matrices.size() * sizeof(glm::mat4), matrices.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void BonePalette::Bind(Shader const &shader, unsigned int textureUnit, unsigned int firstInstance) const {
+    glActiveTexture(GL_TEXTURE0 + textureUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glActiveTexture(GL_TEXTURE0);
+    shader.SetInt("bonePalette", static_cast<int>(textureUnit));
+    shader.SetInt("paletteStride", static_cast<int>(GetStride()));
+    shader.SetInt("firstInstance", static_cast<int>(firstInstance));
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "shader.h"
+
+// A bone of a skinned model: its index in the palette and the offset (inverse bind) matrix that takes a vertex
+// from mesh space into the bone's space
+struct BoneInfo {
+    int Id;
+    glm::mat4 Offset;
+};
+
+// Bone matrices of many skinned instances packed into one texture buffer, so a single instanced draw can skin all
+// of them. Each instance owns a block of 1 + boneCount matrices: its model matrix followed by its bone matrices
+// (bone global transform times offset). The shaders read the block of instance `firstInstance + gl_InstanceID`.
+class BonePalette {
+    private:
+        GLuint buffer;
+        GLuint texture;
+        unsigned int instanceCount;
+        unsigned int boneCount;
+        size_t capacity; // matrices the buffer can hold without reallocating
+        std::vector<glm::mat4> matrices;
+    public:
+        BonePalette();
+        ~BonePalette();
+        BonePalette(BonePalette const &) = delete;
+        BonePalette &operator=(BonePalette const &) = delete;
+
+        void Resize(unsigned int instanceCount, unsigned int boneCount);
+        // bones may be shorter than the bone count, the rest keep their previous matrices
+        void SetInstance(unsigned int instance, glm::mat4 const &model, glm::mat4 const *bones, unsigned int count);
+        glm::mat4 *GetBones(unsigned int instance) { return &matrices[instance * GetStride() + 1]; }
+        // Sends this frame's matrices to the GPU; orphans the old storage so frames in flight are not waited on
+        void Upload();
+        // Binds the palette to a texture unit and sets the uniforms skinned.vs and preskin.vs read it through
+        void Bind(Shader const &shader, unsigned int textureUnit, unsigned int firstInstance = 0) const;
+
+        unsigned int GetInstanceCount() const { return instanceCount; }
+        unsigned int GetBoneCount() const { return boneCount; }
+        unsigned int GetStride() const { return boneCount + 1; }
+};
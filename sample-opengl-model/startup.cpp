@@ -0,0 +1,111 @@
+#include "startup.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using std::endl;
+using std::vector;
+
+namespace {
+    struct PhaseRecord {
+        char const *Name;
+        std::int64_t WallStart, WallEnd, Cpu;
+        std::thread::id Thread;
+    };
+
+    std::mutex phasesMutex;
+    vector<PhaseRecord> phases;
+    std::int64_t start = 0;
+    std::int64_t processCpuStart = 0;
+    std::thread::id mainThread;
+    bool finished = false;
+
+    std::int64_t cpuClock(clockid_t clock) {
+        timespec time;
+        clock_gettime(clock, &time);
+        return static_cast<std::int64_t>(time.tv_sec) * 1000000 + time.tv_nsec / 1000;
+    }
+
+    double milliseconds(std::int64_t microseconds) {
+        return microseconds / 1000.0;
+    }
+}
+
+std::int64_t StartupTrace::WallNow() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::int64_t StartupTrace::CpuNow() {
+    return cpuClock(CLOCK_THREAD_CPUTIME_ID);
+}
+
+void StartupTrace::Start() {
+    std::lock_guard<std::mutex> lock { phasesMutex };
+    phases.clear();
+    start = WallNow();
+    processCpuStart = cpuClock(CLOCK_PROCESS_CPUTIME_ID);
+    mainThread = std::this_thread::get_id();
+    finished = false;
+}
+
+void StartupTrace::record(char const *name, std::int64_t wallStart, std::int64_t wallEnd, std::int64_t cpu) {
+    std::lock_guard<std::mutex> lock { phasesMutex };
+    if (!finished) {
+        phases.push_back(PhaseRecord { name, wallStart - start, wallEnd - start, cpu, std::this_thread::get_id() });
+    }
+}
+
+bool StartupTrace::IsFinished() {
+    std::lock_guard<std::mutex> lock { phasesMutex };
+    return finished;
+}
+
+void StartupTrace::Finish(std::ostream &log) {
+    std::int64_t total = WallNow() - start;
+    std::int64_t processCpu = cpuClock(CLOCK_PROCESS_CPUTIME_ID) - processCpuStart;
+    vector<PhaseRecord> sorted;
+    {
+        std::lock_guard<std::mutex> lock { phasesMutex };
+        finished = true;
+        sorted = phases;
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](PhaseRecord const &a, PhaseRecord const &b) { return a.WallStart < b.WallStart; });
+
+    // threads are numbered in the order their first phase started, the main thread is 0
+    vector<std::thread::id> threads { mainThread };
+    size_t nameWidth = 5;
+    for (auto const &phase : sorted) {
+        if (std::find(threads.begin(), threads.end(), phase.Thread) == threads.end()) {
+            threads.push_back(phase.Thread);
+        }
+        nameWidth = std::max(nameWidth, std::strlen(phase.Name));
+    }
+
+    log << std::fixed << std::setprecision(1);
+    log << std::left << std::setw(static_cast<int>(nameWidth)) << "phase" << std::right
+        << std::setw(8) << "thread" << std::setw(11) << "start ms" << std::setw(11) << "wall ms" << std::setw(11) << "cpu ms" << endl;
+    for (auto const &phase : sorted) {
+        size_t thread = std::find(threads.begin(), threads.end(), phase.Thread) - threads.begin();
+        log << std::left << std::setw(static_cast<int>(nameWidth)) << phase.Name << std::right
+            << std::setw(8) << thread << std::setw(11) << milliseconds(phase.WallStart)
+            << std::setw(11) << milliseconds(phase.WallEnd - phase.WallStart) << std::setw(11) << milliseconds(phase.Cpu) << endl;
+    }
+    log << "Time to first frame " << milliseconds(total) << " ms, " << milliseconds(processCpu) << " ms of CPU on all threads" << endl;
+    log << std::defaultfloat;
+}
+
+StartupPhase::StartupPhase(char const *name)
+    : name { name }, wallStart { StartupTrace::WallNow() }, cpuStart { StartupTrace::CpuNow() }, ended { false } {}
+
+void StartupPhase::End() {
+    if (!ended) {
+        ended = true;
+        StartupTrace::record(name, wallStart, StartupTrace::WallNow(), StartupTrace::CpuNow() - cpuStart);
+    }
+}
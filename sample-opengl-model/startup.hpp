@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+// Wall-clock and CPU time of the startup phases, on whichever thread they run, up to the first frame on screen.
+// The CPU time is the thread's own, so a phase that mostly waits on a file, the driver or another thread shows
+// much less CPU than wall time. Phases that end after Finish are not recorded.
+class StartupTrace {
+    private:
+        friend class StartupPhase;
+        static void record(char const *name, std::int64_t wallStart, std::int64_t wallEnd, std::int64_t cpu);
+    public:
+        // Call first thing in main; the phases are timed from here
+        static void Start();
+        // Stops recording and prints every phase and the time to first frame; call once the first frame is swapped
+        static void Finish(std::ostream &log);
+        static bool IsFinished();
+        // microseconds on the steady clock, and of CPU time on the calling thread
+        static std::int64_t WallNow();
+        static std::int64_t CpuNow();
+};
+
+// Times the rest of the enclosing scope, or up to End; the name must be a literal or interned
+class StartupPhase {
+    private:
+        char const *name;
+        std::int64_t wallStart, cpuStart;
+        bool ended;
+    public:
+        explicit StartupPhase(char const *name);
+        ~StartupPhase() { End(); }
+        StartupPhase(StartupPhase const &) = delete;
+        StartupPhase &operator=(StartupPhase const &) = delete;
+        void End();
+};
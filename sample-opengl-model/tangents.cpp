@@ -0,0 +1,152 @@
+#include "tangents.hpp"
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <thread>
+
+using std::vector;
+
+namespace {
+    float const SNORM16_MAX = 32767.0f;
+    // below this many items per thread the threads cost more than they save
+    size_t const MIN_ITEMS_PER_THREAD = 4096;
+
+    // calls work(begin, end) over contiguous ranges of [0, count) on up to threadCount threads
+    template <typename Work>
+    void parallelFor(size_t count, unsigned int threadCount, Work work) {
+        size_t threads = std::max<size_t>(1, std::min<size_t>(threadCount, count / MIN_ITEMS_PER_THREAD));
+        size_t range = (count + threads - 1) / threads;
+        vector<std::future<void>> jobs;
+        for (size_t begin = range; begin < count; begin += range) {
+            jobs.push_back(std::async(std::launch::async, work, begin, std::min(count, begin + range)));
+        }
+        work(0, std::min(count, range));
+        for (auto &job : jobs) {
+            job.wait();
+        }
+    }
+
+    // any unit vector perpendicular to n, for vertices whose texture coordinates give no direction
+    glm::vec3 perpendicular(glm::vec3 const &n) {
+        glm::vec3 axis = std::abs(n.x) < 0.9f ? glm::vec3 { 1.0f, 0.0f, 0.0f } : glm::vec3 { 0.0f, 1.0f, 0.0f };
+        return glm::normalize(axis - n * glm::dot(n, axis));
+    }
+
+    glm::vec3 rotate(glm::quat const &q, glm::vec3 const &v) {
+        glm::vec3 axis { q.x, q.y, q.z };
+        return v + 2.0f * glm::cross(axis, glm::cross(axis, v) + q.w * v);
+    }
+}
+
+vector<glm::vec4> GenerateTangents(vector<glm::vec3> const &positions, vector<glm::vec3> const &normals, vector<glm::vec2> const &texCoords,
+                                   vector<unsigned int> const &indices, unsigned int threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t triangleCount = indices.size() / 3;
+
+    // every corner's tangent, projected onto its normal and scaled by the corner angle, and its signed weight
+    vector<glm::vec3> cornerTangents(triangleCount * 3);
+    vector<float> cornerSigns(triangleCount * 3);
+    parallelFor(triangleCount, threadCount, [&](size_t begin, size_t end) {
+        for (size_t triangle = begin; triangle < end; triangle++) {
+            unsigned int const *corner = &indices[triangle * 3];
+            glm::vec3 edge1 = positions[corner[1]] - positions[corner[0]];
+            glm::vec3 edge2 = positions[corner[2]] - positions[corner[0]];
+            glm::vec2 uv1 = texCoords[corner[1]] - texCoords[corner[0]];
+            glm::vec2 uv2 = texCoords[corner[2]] - texCoords[corner[0]];
+            // the direction of increasing u on the face; mirrored texture space flips the area's sign
+            float signedArea = uv1.x * uv2.y - uv1.y * uv2.x;
+            glm::vec3 faceTangent = edge1 * uv2.y - edge2 * uv1.y;
+            if (signedArea < 0.0f) {
+                faceTangent = -faceTangent;
+            }
+            float faceSign = signedArea < 0.0f ? -1.0f : 1.0f;
+            bool degenerate = glm::dot(faceTangent, faceTangent) < 1e-20f || signedArea == 0.0f;
+
+            for (int i = 0; i < 3; i++) {
+                glm::vec3 n = normals[corner[i]];
+                glm::vec3 toNext = positions[corner[(i + 1) % 3]] - positions[corner[i]];
+                glm::vec3 toPrevious = positions[corner[(i + 2) % 3]] - positions[corner[i]];
+                float lengths = glm::length(toNext) * glm::length(toPrevious);
+                float angle = lengths > 0.0f ? std::acos(glm::clamp(glm::dot(toNext, toPrevious) / lengths, -1.0f, 1.0f)) : 0.0f;
+                glm::vec3 projected = faceTangent - n * glm::dot(n, faceTangent);
+                float projectedLength = glm::length(projected);
+                if (degenerate || projectedLength < 1e-12f) {
+                    cornerTangents[triangle * 3 + i] = glm::vec3 { 0.0f };
+                    cornerSigns[triangle * 3 + i] = 0.0f;
+                } else {
+                    cornerTangents[triangle * 3 + i] = projected / projectedLength * angle;
+                    cornerSigns[triangle * 3 + i] = faceSign * angle;
+                }
+            }
+        }
+    });
+
+    // corners of each vertex, so vertices can be gathered independently instead of scattered into with locks
+    vector<unsigned int> cornerStarts(positions.size() + 1, 0);
+    for (unsigned int index : indices) {
+        cornerStarts[index + 1]++;
+    }
+    for (size_t i = 0; i < positions.size(); i++) {
+        cornerStarts[i + 1] += cornerStarts[i];
+    }
+    vector<unsigned int> vertexCorners(indices.size());
+    vector<unsigned int> fill(cornerStarts.begin(), cornerStarts.end() - 1);
+    for (unsigned int corner = 0; corner < triangleCount * 3; corner++) {
+        vertexCorners[fill[indices[corner]]++] = corner;
+    }
+
+    vector<glm::vec4> tangents(positions.size());
+    parallelFor(positions.size(), threadCount, [&](size_t begin, size_t end) {
+        for (size_t vertex = begin; vertex < end; vertex++) {
+            glm::vec3 sum { 0.0f };
+            float sign = 0.0f;
+            for (unsigned int i = cornerStarts[vertex]; i < cornerStarts[vertex + 1]; i++) {
+                sum += cornerTangents[vertexCorners[i]];
+                sign += cornerSigns[vertexCorners[i]];
+            }
+            // corners of both handedness can share a vertex where a mirrored UV seam was welded; the larger side wins
+            glm::vec3 n = normals[vertex];
+            glm::vec3 tangent = sum - n * glm::dot(n, sum);
+            float length = glm::length(tangent);
+            tangent = length > 1e-12f ? tangent / length : perpendicular(n);
+            tangents[vertex] = glm::vec4 { tangent, sign < 0.0f ? -1.0f : 1.0f };
+        }
+    });
+    return tangents;
+}
+
+void EncodeQTangent(glm::vec3 const &normal, glm::vec4 const &tangent, std::int16_t *out) {
+    glm::vec3 n = glm::dot(normal, normal) > 0.0f ? glm::normalize(normal) : glm::vec3 { 0.0f, 0.0f, 1.0f };
+    glm::vec3 t = glm::vec3 { tangent } - n * glm::dot(n, glm::vec3 { tangent });
+    t = glm::dot(t, t) > 1e-20f ? glm::normalize(t) : perpendicular(n);
+    glm::quat q = glm::normalize(glm::quat_cast(glm::mat3 { t, glm::cross(n, t), n }));
+    if (q.w < 0.0f) {
+        q = -q;
+    }
+    // w = 0 has no sign once quantized, so lift it to the smallest step and shrink xyz to stay unit length
+    float const bias = 1.0f / SNORM16_MAX;
+    if (q.w < bias) {
+        float scale = std::sqrt(1.0f - bias * bias) / glm::length(glm::vec3 { q.x, q.y, q.z });
+        q = glm::quat { bias, q.x * scale, q.y * scale, q.z * scale };
+    }
+    if (tangent.w < 0.0f) {
+        q = -q;
+    }
+    float const components[4] = { q.x, q.y, q.z, q.w };
+    for (int i = 0; i < 4; i++) {
+        out[i] = static_cast<std::int16_t>(std::lround(glm::clamp(components[i], -1.0f, 1.0f) * SNORM16_MAX));
+    }
+}
+
+glm::mat3 DecodeQTangent(std::int16_t const *in) {
+    glm::quat q = glm::normalize(glm::quat { in[3] / SNORM16_MAX, in[0] / SNORM16_MAX, in[1] / SNORM16_MAX, in[2] / SNORM16_MAX });
+    glm::vec3 tangent = rotate(q, glm::vec3 { 1.0f, 0.0f, 0.0f });
+    glm::vec3 normal = rotate(q, glm::vec3 { 0.0f, 0.0f, 1.0f });
+    float handedness = in[3] < 0 ? -1.0f : 1.0f;
+    return glm::mat3 { tangent, handedness * glm::cross(normal, tangent), normal };
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Per-vertex tangents in the MikkTSpace convention: xyz is the unit tangent, orthogonal to the vertex normal, and
+// w = +-1 the handedness, so the bitangent is w * cross(normal, tangent). Face tangents come from the texture
+// coordinate gradients, are projected onto each corner's normal and summed weighted by the corner angle. Faces are
+// processed, then vertices gathered, in parallel ranges; threadCount 0 uses the hardware concurrency.
+std::vector<glm::vec4> GenerateTangents(std::vector<glm::vec3> const &positions, std::vector<glm::vec3> const &normals,
+                                        std::vector<glm::vec2> const &texCoords, std::vector<unsigned int> const &indices,
+                                        unsigned int threadCount = 0);
+
+// A tangent frame packed as a unit quaternion in four snorm16 values (8 bytes instead of 24 for a float tangent
+// and bitangent). The quaternion rotates (1,0,0) to the tangent and (0,0,1) to the normal; q and -q are the same
+// rotation, so the sign of w is free to store the handedness, negative for a mirrored bitangent. |w| is kept
+// above the smallest snorm16 step so the sign survives quantization.
+void EncodeQTangent(glm::vec3 const &normal, glm::vec4 const &tangent, std::int16_t *out);
+// Columns are tangent, bitangent and normal, as the shaders decode it
+glm::mat3 DecodeQTangent(std::int16_t const *in);
@@ -0,0 +1,555 @@
+#include <glad/glad.h>
+
+#include "texturestream.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "gpumemory.hpp"
+#include "stb_image.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+namespace {
+    // mip file: the header, then every level from the finest, rows bottom up like GL takes them
+    struct MipHeader {
+        char Magic[4];
+        std::uint32_t Version;
+        std::uint32_t Width, Height, Channels, Levels;
+    };
+    char const MIP_MAGIC[4] = { 'M', 'I', 'P', 'S' };
+    std::uint32_t const MIP_VERSION = 1;
+
+    // reads in flight at once, and frames a fine level stays after its last request
+    unsigned int const MAX_PENDING_READS = 2;
+    std::uint64_t const KEEP_FRAMES = 120;
+
+    struct StreamedTexture {
+        bool Used = false; // false for a free slot
+        string MipPath;
+        int Width = 0, Height = 0, Channels = 0;
+        int Levels = 0;
+        int TailLevel = 0; // coarsest level that always stays resident
+        GLuint Id = 0;
+        int ResidentBase = 0; // finest resident level
+        int Wanted = 0; // finest level requested this frame
+        std::uint64_t LastNeeded = 0; // last frame ResidentBase was requested
+        std::unique_ptr<std::ifstream> MipFile; // open for the reader, which only touches it during this texture's read
+        int ReadSlot = -1; // staging slot of the read in flight
+        int ReadLevel = -1;
+        std::uint64_t Bytes = 0; // resident
+        GpuMemory::Handle Memory = 0;
+    };
+
+    vector<StreamedTexture> textures; // by handle - 1
+    vector<TextureStream::Handle> freeHandles;
+    std::uint64_t budget = 0;
+    std::uint64_t frame = 0;
+    std::uint64_t levelsIn = 0, levelsOut = 0;
+
+    enum class SlotState { Free, Queued, Reading, Done };
+
+    // a level on its way from a mip file into a staging buffer, which the reader owns from Queued until Done
+    struct ReadSlot {
+        SlotState State = SlotState::Free;
+        std::ifstream *File = nullptr;
+        std::uint64_t Offset = 0, Size = 0;
+        bool Succeeded = false;
+        vector<unsigned char> Pixels; // as large as the finest level of any texture added
+    };
+
+    // One thread reads every level, into staging buffers sized when the textures are added, so streaming
+    // allocates nothing once the textures are in
+    struct Reader {
+        std::mutex Mutex;
+        std::condition_variable Wake;
+        ReadSlot Slots[MAX_PENDING_READS];
+        bool Stopping = false;
+        std::thread Thread;
+
+        ~Reader() {
+            if (Thread.joinable()) {
+                {
+                    std::lock_guard<std::mutex> lock { Mutex };
+                    Stopping = true;
+                }
+                Wake.notify_all();
+                Thread.join();
+            }
+        }
+    };
+    Reader reader;
+
+    void readLevels() {
+        std::unique_lock<std::mutex> lock { reader.Mutex };
+        while (true) {
+            ReadSlot *slot = nullptr;
+            reader.Wake.wait(lock, [&] {
+                for (auto &queued : reader.Slots) {
+                    if (queued.State == SlotState::Queued) {
+                        slot = &queued;
+                        return true;
+                    }
+                }
+                return reader.Stopping;
+            });
+            if (reader.Stopping) {
+                return;
+            }
+            slot->State = SlotState::Reading;
+            lock.unlock();
+            // reads this large go straight from the file to the buffer, without the stream's own buffer
+            slot->File->clear();
+            slot->File->seekg(static_cast<std::streamoff>(slot->Offset));
+            slot->File->read(reinterpret_cast<char *>(slot->Pixels.data()), static_cast<std::streamsize>(slot->Size));
+            bool succeeded = static_cast<bool>(*slot->File);
+            lock.lock();
+            slot->Succeeded = succeeded;
+            slot->State = SlotState::Done;
+            reader.Wake.notify_all();
+        }
+    }
+
+    int levelSize(int size, int level) {
+        return std::max(size >> level, 1);
+    }
+
+    int levelCount(int width, int height) {
+        int levels = 1;
+        while (levelSize(width, levels - 1) > 1 || levelSize(height, levels - 1) > 1) {
+            levels++;
+        }
+        return levels;
+    }
+
+    int tailLevel(int width, int height) {
+        int level = 0;
+        while (std::max(levelSize(width, level), levelSize(height, level)) > TextureStream::TAIL_SIZE) {
+            level++;
+        }
+        return level;
+    }
+
+    std::uint64_t levelBytes(int width, int height, int channels, int level) {
+        return static_cast<std::uint64_t>(levelSize(width, level)) * levelSize(height, level) * channels;
+    }
+
+    std::uint64_t levelOffset(int width, int height, int channels, int level) {
+        std::uint64_t offset = sizeof(MipHeader);
+        for (int i = 0; i < level; i++) {
+            offset += levelBytes(width, height, channels, i);
+        }
+        return offset;
+    }
+
+    // 2x2 box filter; an odd last row or column is averaged with itself
+    vector<unsigned char> downsample(vector<unsigned char> const &pixels, int width, int height, int channels) {
+        int halfWidth = levelSize(width, 1);
+        int halfHeight = levelSize(height, 1);
+        vector<unsigned char> half(static_cast<size_t>(halfWidth) * halfHeight * channels);
+        for (int y = 0; y < halfHeight; y++) {
+            int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+            for (int x = 0; x < halfWidth; x++) {
+                int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+                for (int c = 0; c < channels; c++) {
+                    unsigned int sum = pixels[(static_cast<size_t>(y0) * width + x0) * channels + c] + pixels[(static_cast<size_t>(y0) * width + x1) * channels + c]
+                                     + pixels[(static_cast<size_t>(y1) * width + x0) * channels + c] + pixels[(static_cast<size_t>(y1) * width + x1) * channels + c];
+                    half[(static_cast<size_t>(y) * halfWidth + x) * channels + c] = static_cast<unsigned char>((sum + 2) / 4);
+                }
+            }
+        }
+        return half;
+    }
+
+    vector<unsigned char> readRange(string const &path, std::uint64_t offset, std::uint64_t size) {
+        std::ifstream file { path, std::ios::binary };
+        vector<unsigned char> data(size);
+        file.seekg(static_cast<std::streamoff>(offset));
+        file.read(reinterpret_cast<char *>(data.data()), static_cast<std::streamsize>(size));
+        if (!file) {
+            data.clear();
+        }
+        return data;
+    }
+
+    bool readHeader(string const &path, MipHeader &header) {
+        std::ifstream file { path, std::ios::binary };
+        file.read(reinterpret_cast<char *>(&header), sizeof(header));
+        return file && std::memcmp(header.Magic, MIP_MAGIC, sizeof(MIP_MAGIC)) == 0 && header.Version == MIP_VERSION && header.Width > 0 && header.Height > 0
+            && header.Levels == static_cast<std::uint32_t>(levelCount(static_cast<int>(header.Width), static_cast<int>(header.Height)));
+    }
+
+    GLenum pixelFormat(int channels) {
+        return channels == 1 ? GL_RED : channels == 3 ? GL_RGB : GL_RGBA;
+    }
+
+    void specifyLevel(StreamedTexture const &texture, int level, unsigned char const *pixels) {
+        GLenum format = pixelFormat(texture.Channels);
+        // rows of the small levels aren't padded to 4 bytes
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (pixels != nullptr) {
+            glTexImage2D(GL_TEXTURE_2D, level, format, levelSize(texture.Width, level), levelSize(texture.Height, level), 0, format, GL_UNSIGNED_BYTE, pixels);
+        } else {
+            // a 0x0 image holds no storage
+            glTexImage2D(GL_TEXTURE_2D, level, format, 0, 0, 0, format, GL_UNSIGNED_BYTE, nullptr);
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+
+    // Makes the GL texture from levels firstLevel to the last, packed one after the other
+    void create(StreamedTexture &texture, int firstLevel, unsigned char const *pixels) {
+        glGenTextures(1, &texture.Id);
+        glBindTexture(GL_TEXTURE_2D, texture.Id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        texture.Bytes = 0;
+        for (int level = firstLevel; level < texture.Levels; level++) {
+            specifyLevel(texture, level, pixels);
+            std::uint64_t bytes = levelBytes(texture.Width, texture.Height, texture.Channels, level);
+            pixels += bytes;
+            texture.Bytes += bytes;
+        }
+        // the levels below the base are never sampled, nor needed for the texture to be complete
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, firstLevel);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture.Levels - 1);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        texture.ResidentBase = firstLevel;
+        texture.LastNeeded = frame;
+    }
+
+    void setBaseLevel(StreamedTexture &texture, int level) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+        texture.ResidentBase = level;
+        GpuMemory::Resize(texture.Memory, texture.Bytes);
+    }
+
+    void dropFinestLevel(StreamedTexture &texture) {
+        glBindTexture(GL_TEXTURE_2D, texture.Id);
+        specifyLevel(texture, texture.ResidentBase, nullptr);
+        texture.Bytes -= levelBytes(texture.Width, texture.Height, texture.Channels, texture.ResidentBase);
+        setBaseLevel(texture, texture.ResidentBase + 1);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        levelsOut++;
+    }
+
+    void startRead(StreamedTexture &texture, int level) {
+        std::lock_guard<std::mutex> lock { reader.Mutex };
+        for (int i = 0; i < static_cast<int>(MAX_PENDING_READS); i++) {
+            ReadSlot &slot = reader.Slots[i];
+            if (slot.State == SlotState::Free) {
+                slot.State = SlotState::Queued;
+                slot.File = texture.MipFile.get();
+                slot.Offset = levelOffset(texture.Width, texture.Height, texture.Channels, level);
+                slot.Size = levelBytes(texture.Width, texture.Height, texture.Channels, level);
+                texture.ReadSlot = i;
+                texture.ReadLevel = level;
+                break;
+            }
+        }
+        reader.Wake.notify_all();
+    }
+
+    bool readFinished(StreamedTexture const &texture) {
+        std::lock_guard<std::mutex> lock { reader.Mutex };
+        return reader.Slots[texture.ReadSlot].State == SlotState::Done;
+    }
+
+    // hands the staging slot back, after waiting for the read if it's still going
+    void waitForRead(StreamedTexture &texture) {
+        if (texture.ReadSlot >= 0) {
+            std::unique_lock<std::mutex> lock { reader.Mutex };
+            ReadSlot &slot = reader.Slots[texture.ReadSlot];
+            reader.Wake.wait(lock, [&] { return slot.State == SlotState::Done; });
+            slot.State = SlotState::Free;
+        }
+        texture.ReadSlot = -1;
+        texture.ReadLevel = -1;
+    }
+
+    // grows the staging buffers for a texture's finest level; only while adding textures, as it drops the reads in flight
+    void reserveStaging(std::uint64_t bytes) {
+        if (reader.Slots[0].Pixels.size() >= bytes) {
+            return;
+        }
+        for (auto &texture : textures) {
+            waitForRead(texture);
+        }
+        for (auto &slot : reader.Slots) {
+            slot.Pixels.resize(bytes);
+        }
+        if (!reader.Thread.joinable()) {
+            reader.Thread = std::thread { readLevels };
+        }
+    }
+
+    // evicted by GpuMemory as a whole, the coarse levels are read again by MakeResident
+    void drop(TextureStream::Handle handle) {
+        StreamedTexture &texture = textures[handle - 1];
+        waitForRead(texture);
+        glDeleteTextures(1, &texture.Id);
+        texture.Id = 0;
+        texture.Bytes = 0;
+        texture.ResidentBase = texture.Levels;
+    }
+
+    StreamedTexture *find(TextureStream::Handle handle) {
+        if (handle == 0 || handle > textures.size() || !textures[handle - 1].Used) {
+            return nullptr;
+        }
+        return &textures[handle - 1];
+    }
+}
+
+TextureStream::Prepared TextureStream::Prepare(string const &imagePath) {
+    Prepared prepared;
+    string mipPath = imagePath + ".mips";
+    std::error_code error;
+    auto imageTime = std::filesystem::last_write_time(imagePath, error);
+    bool imageFound = !error;
+    auto mipTime = std::filesystem::last_write_time(mipPath, error);
+    MipHeader header;
+    if (!error && (!imageFound || mipTime >= imageTime) && readHeader(mipPath, header)) {
+        prepared.Width = static_cast<int>(header.Width);
+        prepared.Height = static_cast<int>(header.Height);
+        prepared.Channels = static_cast<int>(header.Channels);
+        prepared.Levels = static_cast<int>(header.Levels);
+        prepared.FirstLevel = tailLevel(prepared.Width, prepared.Height);
+        std::uint64_t offset = levelOffset(prepared.Width, prepared.Height, prepared.Channels, prepared.FirstLevel);
+        std::uint64_t end = levelOffset(prepared.Width, prepared.Height, prepared.Channels, prepared.Levels);
+        prepared.Pixels = readRange(mipPath, offset, end - offset);
+        if (!prepared.Pixels.empty()) {
+            prepared.MipPath = mipPath;
+            return prepared;
+        }
+    }
+
+    // no usable mip file, so make the levels from the image
+    int width, height, channels;
+    unsigned char *imageData = stbi_load(imagePath.c_str(), &width, &height, &channels, 0);
+    if (!imageData) {
+        return Prepared {};
+    }
+    prepared.Width = width;
+    prepared.Height = height;
+    prepared.Channels = channels;
+    prepared.Levels = levelCount(width, height);
+    vector<vector<unsigned char>> levels;
+    levels.emplace_back(imageData, imageData + static_cast<size_t>(width) * height * channels);
+    stbi_image_free(imageData);
+    for (int level = 1; level < prepared.Levels; level++) {
+        levels.push_back(downsample(levels.back(), levelSize(width, level - 1), levelSize(height, level - 1), channels));
+    }
+
+    std::ofstream output { mipPath, std::ios::binary };
+    MipHeader written { { MIP_MAGIC[0], MIP_MAGIC[1], MIP_MAGIC[2], MIP_MAGIC[3] }, MIP_VERSION, static_cast<std::uint32_t>(width),
+                        static_cast<std::uint32_t>(height), static_cast<std::uint32_t>(channels), static_cast<std::uint32_t>(prepared.Levels) };
+    output.write(reinterpret_cast<char const *>(&written), sizeof(written));
+    for (auto const &level : levels) {
+        output.write(reinterpret_cast<char const *>(level.data()), static_cast<std::streamsize>(level.size()));
+    }
+    output.close();
+    // without the file every level stays resident
+    if (output) {
+        prepared.MipPath = mipPath;
+        prepared.FirstLevel = tailLevel(width, height);
+    } else {
+        cout << "Unable to write mip file " << mipPath << endl;
+    }
+    for (int level = prepared.FirstLevel; level < prepared.Levels; level++) {
+        prepared.Pixels.insert(prepared.Pixels.end(), levels[level].begin(), levels[level].end());
+    }
+    return prepared;
+}
+
+TextureStream::Handle TextureStream::Add(Prepared const &prepared, char const *owner) {
+    if (prepared.Width == 0) {
+        return 0;
+    }
+    if (!prepared.MipPath.empty()) {
+        reserveStaging(levelBytes(prepared.Width, prepared.Height, prepared.Channels, 0));
+    }
+    Handle handle;
+    if (!freeHandles.empty()) {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+    } else {
+        textures.emplace_back();
+        handle = static_cast<Handle>(textures.size());
+    }
+    StreamedTexture &texture = textures[handle - 1];
+    texture.Used = true;
+    texture.MipPath = prepared.MipPath;
+    if (!texture.MipPath.empty()) {
+        texture.MipFile = std::make_unique<std::ifstream>(texture.MipPath, std::ios::binary);
+    }
+    texture.Width = prepared.Width;
+    texture.Height = prepared.Height;
+    texture.Channels = prepared.Channels;
+    texture.Levels = prepared.Levels;
+    texture.TailLevel = prepared.FirstLevel;
+    texture.Wanted = texture.TailLevel;
+    create(texture, prepared.FirstLevel, prepared.Pixels.data());
+    // without a mip file the texture couldn't be made again
+    if (texture.MipPath.empty()) {
+        texture.Memory = GpuMemory::Register(owner, GpuMemory::Kind::Texture, texture.Bytes);
+    } else {
+        texture.Memory = GpuMemory::Register(owner, GpuMemory::Kind::Texture, texture.Bytes, [handle] { drop(handle); });
+    }
+    return handle;
+}
+
+void TextureStream::Remove(Handle handle) {
+    StreamedTexture *texture = find(handle);
+    if (texture == nullptr) {
+        return;
+    }
+    waitForRead(*texture);
+    glDeleteTextures(1, &texture->Id);
+    GpuMemory::Unregister(texture->Memory);
+    *texture = StreamedTexture {};
+    freeHandles.push_back(handle);
+}
+
+unsigned int TextureStream::GetTexture(Handle handle) {
+    StreamedTexture *texture = find(handle);
+    return texture != nullptr ? texture->Id : 0;
+}
+
+int TextureStream::GetSize(Handle handle) {
+    StreamedTexture *texture = find(handle);
+    return texture != nullptr ? std::max(texture->Width, texture->Height) : 0;
+}
+
+bool TextureStream::MakeResident(Handle handle) {
+    StreamedTexture *texture = find(handle);
+    if (texture == nullptr || GpuMemory::Touch(texture->Memory)) {
+        return false;
+    }
+    std::uint64_t offset = levelOffset(texture->Width, texture->Height, texture->Channels, texture->TailLevel);
+    std::uint64_t end = levelOffset(texture->Width, texture->Height, texture->Channels, texture->Levels);
+    vector<unsigned char> pixels = readRange(texture->MipPath, offset, end - offset);
+    if (pixels.empty()) {
+        cout << "Unable to read mip file " << texture->MipPath << endl;
+        return false;
+    }
+    create(*texture, texture->TailLevel, pixels.data());
+    GpuMemory::Restored(texture->Memory, texture->Bytes);
+    return true;
+}
+
+void TextureStream::Request(Handle handle, float level) {
+    StreamedTexture *texture = find(handle);
+    if (texture != nullptr) {
+        texture->Wanted = std::min(texture->Wanted, std::clamp(static_cast<int>(std::floor(level)), 0, texture->TailLevel));
+    }
+}
+
+void TextureStream::Update() {
+    frame++;
+    unsigned int pending = 0;
+    std::uint64_t committed = 0; // resident and in flight, against the budget
+    for (auto &texture : textures) {
+        if (!texture.Used || texture.Id == 0) {
+            continue;
+        }
+        // upload the reads that finished, if the level still goes right above the resident ones
+        if (texture.ReadSlot >= 0 && readFinished(texture)) {
+            // the reader is done with the slot, so its buffer can be read without the lock
+            ReadSlot const &slot = reader.Slots[texture.ReadSlot];
+            if (texture.ReadLevel == texture.ResidentBase - 1 && slot.Succeeded) {
+                glBindTexture(GL_TEXTURE_2D, texture.Id);
+                specifyLevel(texture, texture.ReadLevel, slot.Pixels.data());
+                texture.Bytes += slot.Size;
+                setBaseLevel(texture, texture.ReadLevel);
+                glBindTexture(GL_TEXTURE_2D, 0);
+                levelsIn++;
+            }
+            waitForRead(texture);
+        }
+
+        // drop the finest level once it hasn't been asked for in a while, a level a frame
+        if (texture.Wanted <= texture.ResidentBase) {
+            texture.LastNeeded = frame;
+        } else if (frame - texture.LastNeeded > KEEP_FRAMES && texture.ResidentBase < texture.TailLevel) {
+            dropFinestLevel(texture);
+        }
+
+        committed += texture.Bytes;
+        if (texture.ReadSlot >= 0) {
+            pending++;
+            committed += levelBytes(texture.Width, texture.Height, texture.Channels, texture.ReadLevel);
+        }
+    }
+
+    // read the next finer level of the textures furthest from what they were asked for
+    while (pending < MAX_PENDING_READS) {
+        StreamedTexture *next = nullptr;
+        for (auto &texture : textures) {
+            if (texture.Used && texture.Id != 0 && !texture.MipPath.empty() && texture.ReadSlot < 0 && texture.Wanted < texture.ResidentBase
+                && (next == nullptr || texture.ResidentBase - texture.Wanted > next->ResidentBase - next->Wanted)) {
+                next = &texture;
+            }
+        }
+        if (next == nullptr) {
+            break;
+        }
+        int level = next->ResidentBase - 1;
+        std::uint64_t bytes = levelBytes(next->Width, next->Height, next->Channels, level);
+        // make room from the levels finer than their textures need right now
+        while (budget != 0 && committed + bytes > budget) {
+            StreamedTexture *victim = nullptr;
+            for (auto &texture : textures) {
+                if (texture.Used && texture.Id != 0 && texture.ResidentBase < texture.Wanted && (victim == nullptr || texture.Wanted - texture.ResidentBase > victim->Wanted - victim->ResidentBase)) {
+                    victim = &texture;
+                }
+            }
+            if (victim == nullptr) {
+                break;
+            }
+            committed -= levelBytes(victim->Width, victim->Height, victim->Channels, victim->ResidentBase);
+            dropFinestLevel(*victim);
+        }
+        if (budget != 0 && committed + bytes > budget) {
+            break;
+        }
+        startRead(*next, level);
+        committed += bytes;
+        pending++;
+    }
+
+    // the next frame's requests start from the coarse levels
+    for (auto &texture : textures) {
+        texture.Wanted = texture.TailLevel;
+    }
+}
+
+void TextureStream::SetBudget(std::uint64_t bytes) {
+    budget = bytes;
+}
+
+TextureStream::Stats TextureStream::GetStats() {
+    Stats stats;
+    for (auto const &texture : textures) {
+        if (texture.Used) {
+            stats.Textures++;
+            stats.ResidentBytes += texture.Bytes;
+            stats.PendingReads += texture.ReadSlot >= 0 ? 1 : 0;
+        }
+    }
+    stats.Budget = budget;
+    stats.LevelsStreamedIn = levelsIn;
+    stats.LevelsStreamedOut = levelsOut;
+    return stats;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Streams the fine mip levels of textures in and out as the view needs them. Every texture keeps its coarse levels,
+// up to TAIL_SIZE texels across, resident; the finer ones are read on a reader thread, into staging buffers sized
+// when the textures are added, from a mip file written next to the image the first time it loads, "<image>.mips",
+// which holds every level ready to upload.
+//
+// Without sparse textures in GL 3.3 the levels are those of an ordinary texture: a level that isn't resident is
+// specified at 0x0, which holds no storage, and GL_TEXTURE_BASE_LEVEL is kept at the finest resident level, so
+// sampling never reaches the missing ones and the texture stays complete.
+//
+// Each frame the draws Request the level they would sample, Update then starts reads for textures whose resident
+// levels are coarser than requested, uploads the reads that finished and drops levels that haven't been requested
+// for a while, all within the budget. The textures are registered with GpuMemory at their resident size, and can
+// be evicted from there as a whole. Only for the thread with the context, besides Prepare.
+class TextureStream {
+    public:
+        static constexpr int TAIL_SIZE = 128;
+        using Handle = unsigned int; // 0 is no texture
+
+        // The coarse levels of an image's mip file, read on any thread
+        struct Prepared {
+            std::string MipPath; // empty when the file couldn't be written, then all levels are in Pixels
+            int Width = 0, Height = 0, Channels = 0;
+            int Levels = 0;
+            int FirstLevel = 0; // finest level in Pixels
+            std::vector<unsigned char> Pixels; // levels FirstLevel to Levels - 1, one after the other
+        };
+
+        struct Stats {
+            unsigned int Textures = 0;
+            std::uint64_t ResidentBytes = 0;
+            std::uint64_t Budget = 0;
+            unsigned int PendingReads = 0;
+            std::uint64_t LevelsStreamedIn = 0; // since the start
+            std::uint64_t LevelsStreamedOut = 0;
+        };
+
+        // Reads the coarse levels of the image's mip file, writing the file first if it's missing or older than
+        // the image. Width is 0 if the image couldn't be read. CPU only.
+        static Prepared Prepare(std::string const &imagePath);
+        // Makes the texture with the prepared levels and registers it with GpuMemory under owner
+        static Handle Add(Prepared const &prepared, char const *owner);
+        // Deletes the texture, waiting for a read in flight
+        static void Remove(Handle handle);
+        static unsigned int GetTexture(Handle handle);
+        // Marks the texture used this frame and makes it again, at its coarse levels, if GpuMemory evicted it;
+        // true when that gave it another GL name
+        static bool MakeResident(Handle handle);
+        // Largest of the texture's width and height
+        static int GetSize(Handle handle);
+
+        // The texture will be sampled at this level, fractions included, this frame
+        static void Request(Handle handle, float level);
+        // Once per frame, after the requests
+        static void Update();
+        // Bytes the textures may take at once, coarse levels included; 0, the default, is no budget
+        static void SetBudget(std::uint64_t bytes);
+        static Stats GetStats();
+};
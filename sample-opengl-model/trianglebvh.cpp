@@ -0,0 +1,511 @@
+#include "trianglebvh.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+    unsigned int const BIN_COUNT = 12;
+    // the traversal stacks hold at most one node per level, plus one
+    unsigned int const MAX_DEPTH = 128;
+    // below this depth splits halve the triangles, which reaches leaves within 30 levels for any 32-bit count
+    unsigned int const MEDIAN_DEPTH = MAX_DEPTH - 32;
+    std::uint32_t const CACHE_MAGIC = 0x48564254; // "TBVH"
+    std::uint32_t const CACHE_VERSION = 2;
+
+    float surfaceArea(AABB const &box) {
+        glm::vec3 size = box.Max - box.Min;
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    void grow(AABB &box, AABB const &other) {
+        box.Min = glm::min(box.Min, other.Min);
+        box.Max = glm::max(box.Max, other.Max);
+    }
+
+    AABB emptyBox() {
+        return AABB { glm::vec3 { FLT_MAX }, glm::vec3 { -FLT_MAX } };
+    }
+
+    // slab test; returns the entry distance or FLT_MAX on a miss
+    float intersectBox(glm::vec3 const &min, glm::vec3 const &max, glm::vec3 const &origin,
+                       glm::vec3 const &inverseDirection, float maxDistance) {
+        glm::vec3 t0 = (min - origin) * inverseDirection;
+        glm::vec3 t1 = (max - origin) * inverseDirection;
+        glm::vec3 tNear = glm::min(t0, t1);
+        glm::vec3 tFar = glm::max(t0, t1);
+        float entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+        float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+        return entry <= exit ? entry : FLT_MAX;
+    }
+
+    // Earliest t in [0, maxT] at which a sphere of the given radius moving along origin + t * direction touches the point
+    bool sweepPoint(glm::vec3 const &origin, glm::vec3 const &direction, glm::vec3 const &point, float radius, float maxT, float &t) {
+        glm::vec3 offset = origin - point;
+        float a = glm::dot(direction, direction);
+        float b = glm::dot(offset, direction);
+        float c = glm::dot(offset, offset) - radius * radius;
+        float h = b * b - a * c;
+        if (h < 0.0f || a < 1e-12f) {
+            return false;
+        }
+        float hitT = (-b - std::sqrt(h)) / a;
+        if (hitT < 0.0f || hitT > maxT) {
+            return false;
+        }
+        t = hitT;
+        return true;
+    }
+
+    // Same for the cylindrical part of a capsule around the edge [from, to]
+    bool sweepEdge(glm::vec3 const &origin, glm::vec3 const &direction, glm::vec3 const &from, glm::vec3 const &to,
+                   float radius, float maxT, float &t) {
+        glm::vec3 edge = to - from;
+        glm::vec3 offset = origin - from;
+        float edgeEdge = glm::dot(edge, edge);
+        float edgeDir = glm::dot(edge, direction);
+        float edgeOffset = glm::dot(edge, offset);
+        float a = edgeEdge * glm::dot(direction, direction) - edgeDir * edgeDir;
+        float b = edgeEdge * glm::dot(direction, offset) - edgeOffset * edgeDir;
+        float c = edgeEdge * glm::dot(offset, offset) - edgeOffset * edgeOffset - radius * radius * edgeEdge;
+        float h = b * b - a * c;
+        if (h < 0.0f || a < 1e-12f) {
+            return false;
+        }
+        float hitT = (-b - std::sqrt(h)) / a;
+        float along = edgeOffset + hitT * edgeDir;
+        if (hitT < 0.0f || hitT > maxT || along < 0.0f || along > edgeEdge) {
+            return false;
+        }
+        t = hitT;
+        return true;
+    }
+
+    glm::vec3 closestPointOnSegment(glm::vec3 const &point, glm::vec3 const &from, glm::vec3 const &to) {
+        glm::vec3 edge = to - from;
+        float length2 = glm::dot(edge, edge);
+        float s = length2 > 0.0f ? glm::clamp(glm::dot(point - from, edge) / length2, 0.0f, 1.0f) : 0.0f;
+        return from + edge * s;
+    }
+}
+
+std::uint64_t TriangleBvh::HashGeometry(std::vector<glm::vec3> const &positions, std::vector<unsigned int> const &indices) {
+    // FNV-1a over the raw bytes; only needs to detect a model file that changed under an existing cache
+    std::uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](void const *data, size_t size) {
+        auto bytes = static_cast<unsigned char const *>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    };
+    mix(positions.data(), positions.size() * sizeof(glm::vec3));
+    mix(indices.data(), indices.size() * sizeof(unsigned int));
+    return hash;
+}
+
+void TriangleBvh::Build(std::vector<glm::vec3> const &positions, std::vector<unsigned int> const &indices) {
+    nodes.clear();
+    blocks.clear();
+    sourceHash = HashGeometry(positions, indices);
+
+    unsigned int triangleCount = static_cast<unsigned int>(indices.size() / 3);
+    if (triangleCount == 0) {
+        return;
+    }
+
+    std::vector<unsigned int> order(triangleCount);
+    std::vector<glm::vec3> centroids(triangleCount);
+    std::vector<AABB> triangleBounds(triangleCount);
+    for (unsigned int i = 0; i < triangleCount; i++) {
+        glm::vec3 const &a = positions[indices[3 * i + 0]];
+        glm::vec3 const &b = positions[indices[3 * i + 1]];
+        glm::vec3 const &c = positions[indices[3 * i + 2]];
+        order[i] = i;
+        centroids[i] = (a + b + c) / 3.0f;
+        triangleBounds[i] = AABB { glm::min(a, glm::min(b, c)), glm::max(a, glm::max(b, c)) };
+    }
+
+    // a binary tree with at least one triangle per leaf never has more than 2n - 1 nodes
+    nodes.reserve(2 * triangleCount);
+    blocks.reserve(triangleCount / 2 + 1);
+    nodes.push_back(Node {});
+    subdivide(0, 0, triangleCount, 0, order, centroids, triangleBounds, positions, indices);
+    nodes.shrink_to_fit();
+    blocks.shrink_to_fit();
+}
+
+void TriangleBvh::subdivide(unsigned int nodeIndex, unsigned int first, unsigned int count, unsigned int depth,
+                            std::vector<unsigned int> &order, std::vector<glm::vec3> const &centroids,
+                            std::vector<AABB> const &triangleBounds,
+                            std::vector<glm::vec3> const &positions, std::vector<unsigned int> const &indices) {
+    AABB bounds = emptyBox();
+    AABB centroidBounds = emptyBox();
+    for (unsigned int i = first; i < first + count; i++) {
+        grow(bounds, triangleBounds[order[i]]);
+        grow(centroidBounds, AABB { centroids[order[i]], centroids[order[i]] });
+    }
+    nodes[nodeIndex].Min = bounds.Min;
+    nodes[nodeIndex].Max = bounds.Max;
+
+    // find the cheapest binned split over all three axes
+    int bestAxis = -1;
+    unsigned int bestSplit = 0;
+    float bestCost = FLT_MAX;
+    glm::vec3 extent = centroidBounds.Max - centroidBounds.Min;
+    if (count > LEAF_SIZE && depth < MEDIAN_DEPTH) {
+        for (int axis = 0; axis < 3; axis++) {
+            if (extent[axis] <= 0.0f) {
+                continue;
+            }
+            AABB binBounds[BIN_COUNT];
+            unsigned int binCounts[BIN_COUNT] = {};
+            std::fill(binBounds, binBounds + BIN_COUNT, emptyBox());
+            float scale = BIN_COUNT / extent[axis];
+            for (unsigned int i = first; i < first + count; i++) {
+                unsigned int bin = std::min(BIN_COUNT - 1, static_cast<unsigned int>((centroids[order[i]][axis] - centroidBounds.Min[axis]) * scale));
+                binCounts[bin]++;
+                grow(binBounds[bin], triangleBounds[order[i]]);
+            }
+            // sweep from both sides to get the area and count on each side of every bin boundary
+            float leftArea[BIN_COUNT - 1], rightArea[BIN_COUNT - 1];
+            unsigned int leftCount[BIN_COUNT - 1], rightCount[BIN_COUNT - 1];
+            AABB leftBox = emptyBox(), rightBox = emptyBox();
+            unsigned int leftSum = 0, rightSum = 0;
+            for (unsigned int i = 0; i < BIN_COUNT - 1; i++) {
+                leftSum += binCounts[i];
+                leftCount[i] = leftSum;
+                grow(leftBox, binBounds[i]);
+                leftArea[i] = leftSum ? surfaceArea(leftBox) : 0.0f;
+                rightSum += binCounts[BIN_COUNT - 1 - i];
+                rightCount[BIN_COUNT - 2 - i] = rightSum;
+                grow(rightBox, binBounds[BIN_COUNT - 1 - i]);
+                rightArea[BIN_COUNT - 2 - i] = rightSum ? surfaceArea(rightBox) : 0.0f;
+            }
+            for (unsigned int i = 0; i < BIN_COUNT - 1; i++) {
+                if (leftCount[i] == 0 || rightCount[i] == 0) {
+                    continue;
+                }
+                float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = i;
+                }
+            }
+        }
+    }
+
+    if (count <= LEAF_SIZE) {
+        TriangleBlock block {};
+        for (unsigned int lane = 0; lane < LEAF_SIZE; lane++) {
+            if (lane >= count) {
+                block.Triangles[lane] = ~0u;
+                continue;
+            }
+            unsigned int triangle = order[first + lane];
+            glm::vec3 const &a = positions[indices[3 * triangle + 0]];
+            glm::vec3 const &b = positions[indices[3 * triangle + 1]];
+            glm::vec3 const &c = positions[indices[3 * triangle + 2]];
+            for (int axis = 0; axis < 3; axis++) {
+                block.V0[axis][lane] = a[axis];
+                block.Edge1[axis][lane] = b[axis] - a[axis];
+                block.Edge2[axis][lane] = c[axis] - a[axis];
+            }
+            block.Triangles[lane] = triangle;
+        }
+        nodes[nodeIndex].Offset = static_cast<unsigned int>(blocks.size());
+        nodes[nodeIndex].Count = count;
+        blocks.push_back(block);
+        return;
+    }
+
+    unsigned int leftCount;
+    if (bestAxis >= 0) {
+        float scale = BIN_COUNT / extent[bestAxis];
+        auto middle = std::partition(order.begin() + first, order.begin() + first + count, [&](unsigned int triangle) {
+            unsigned int bin = std::min(BIN_COUNT - 1, static_cast<unsigned int>((centroids[triangle][bestAxis] - centroidBounds.Min[bestAxis]) * scale));
+            return bin <= bestSplit;
+        });
+        leftCount = static_cast<unsigned int>(middle - (order.begin() + first));
+    } else {
+        // too deep to keep looking for the cheapest split, or every centroid coincides; halving along the longest
+        // axis still bounds the depth
+        int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+        leftCount = count / 2;
+        std::nth_element(order.begin() + first, order.begin() + first + leftCount, order.begin() + first + count,
+                         [&](unsigned int a, unsigned int b) { return centroids[a][axis] < centroids[b][axis]; });
+    }
+
+    unsigned int left = static_cast<unsigned int>(nodes.size());
+    nodes.push_back(Node {});
+    nodes.push_back(Node {});
+    nodes[nodeIndex].Offset = left;
+    nodes[nodeIndex].Count = 0;
+    subdivide(left, first, leftCount, depth + 1, order, centroids, triangleBounds, positions, indices);
+    subdivide(left + 1, first + leftCount, count - leftCount, depth + 1, order, centroids, triangleBounds, positions, indices);
+}
+
+bool TriangleBvh::Raycast(Ray const &ray, RayHit &hit) const {
+    if (nodes.empty()) {
+        return false;
+    }
+    glm::vec3 inverseDirection = 1.0f / ray.Direction;
+    float best = ray.MaxDistance;
+    bool found = false;
+
+    unsigned int stack[MAX_DEPTH];
+    unsigned int top = 0;
+    if (intersectBox(nodes[0].Min, nodes[0].Max, ray.Origin, inverseDirection, best) == FLT_MAX) {
+        return false;
+    }
+    stack[top++] = 0;
+    while (top > 0) {
+        Node const &node = nodes[stack[--top]];
+        if (node.IsLeaf()) {
+            TriangleBlock const &block = blocks[node.Offset];
+#if defined(__SSE2__)
+            // Moller-Trumbore against the four triangles of the leaf at once
+            __m128 ox = _mm_set1_ps(ray.Origin.x), oy = _mm_set1_ps(ray.Origin.y), oz = _mm_set1_ps(ray.Origin.z);
+            __m128 dx = _mm_set1_ps(ray.Direction.x), dy = _mm_set1_ps(ray.Direction.y), dz = _mm_set1_ps(ray.Direction.z);
+            __m128 e1x = _mm_loadu_ps(block.Edge1[0]), e1y = _mm_loadu_ps(block.Edge1[1]), e1z = _mm_loadu_ps(block.Edge1[2]);
+            __m128 e2x = _mm_loadu_ps(block.Edge2[0]), e2y = _mm_loadu_ps(block.Edge2[1]), e2z = _mm_loadu_ps(block.Edge2[2]);
+            // pvec = direction x edge2
+            __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+            __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+            __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+            __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+            __m128 absDet = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+            __m128 valid = _mm_cmpgt_ps(absDet, _mm_set1_ps(1e-12f));
+            __m128 inverseDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+            // tvec = origin - v0
+            __m128 tx = _mm_sub_ps(ox, _mm_loadu_ps(block.V0[0]));
+            __m128 ty = _mm_sub_ps(oy, _mm_loadu_ps(block.V0[1]));
+            __m128 tz = _mm_sub_ps(oz, _mm_loadu_ps(block.V0[2]));
+            __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), inverseDet);
+            // qvec = tvec x edge1
+            __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+            __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+            __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+            __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inverseDet);
+            __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverseDet);
+            __m128 zero = _mm_setzero_ps();
+            valid = _mm_and_ps(valid, _mm_cmpge_ps(u, zero));
+            valid = _mm_and_ps(valid, _mm_cmpge_ps(v, zero));
+            valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+            valid = _mm_and_ps(valid, _mm_cmpge_ps(t, zero));
+            valid = _mm_and_ps(valid, _mm_cmplt_ps(t, _mm_set1_ps(best)));
+            int mask = _mm_movemask_ps(valid);
+            if (mask) {
+                float distances[4];
+                _mm_storeu_ps(distances, t);
+                for (unsigned int lane = 0; lane < node.Count; lane++) {
+                    if ((mask & (1 << lane)) && distances[lane] < best) {
+                        best = distances[lane];
+                        hit.Triangle = block.Triangles[lane];
+                        hit.Normal = glm::cross(glm::vec3 { block.Edge1[0][lane], block.Edge1[1][lane], block.Edge1[2][lane] },
+                                                glm::vec3 { block.Edge2[0][lane], block.Edge2[1][lane], block.Edge2[2][lane] });
+                        found = true;
+                    }
+                }
+            }
+#else
+            for (unsigned int lane = 0; lane < node.Count; lane++) {
+                glm::vec3 v0 { block.V0[0][lane], block.V0[1][lane], block.V0[2][lane] };
+                glm::vec3 edge1 { block.Edge1[0][lane], block.Edge1[1][lane], block.Edge1[2][lane] };
+                glm::vec3 edge2 { block.Edge2[0][lane], block.Edge2[1][lane], block.Edge2[2][lane] };
+                glm::vec3 p = glm::cross(ray.Direction, edge2);
+                float det = glm::dot(edge1, p);
+                if (std::abs(det) <= 1e-12f) {
+                    continue;
+                }
+                float inverseDet = 1.0f / det;
+                glm::vec3 tvec = ray.Origin - v0;
+                float u = glm::dot(tvec, p) * inverseDet;
+                glm::vec3 q = glm::cross(tvec, edge1);
+                float v = glm::dot(ray.Direction, q) * inverseDet;
+                float t = glm::dot(edge2, q) * inverseDet;
+                if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t >= 0.0f && t < best) {
+                    best = t;
+                    hit.Triangle = block.Triangles[lane];
+                    hit.Normal = glm::cross(edge1, edge2);
+                    found = true;
+                }
+            }
+#endif
+            continue;
+        }
+
+        // visit the nearer child first so the closest hit shrinks the ray early
+        Node const &left = nodes[node.Offset];
+        Node const &right = nodes[node.Offset + 1];
+        float leftDistance = intersectBox(left.Min, left.Max, ray.Origin, inverseDirection, best);
+        float rightDistance = intersectBox(right.Min, right.Max, ray.Origin, inverseDirection, best);
+        unsigned int nearChild = node.Offset, farChild = node.Offset + 1;
+        if (rightDistance < leftDistance) {
+            std::swap(leftDistance, rightDistance);
+            std::swap(nearChild, farChild);
+        }
+        if (rightDistance != FLT_MAX) {
+            assert(top < MAX_DEPTH);
+            stack[top++] = farChild;
+        }
+        if (leftDistance != FLT_MAX) {
+            assert(top < MAX_DEPTH);
+            stack[top++] = nearChild;
+        }
+    }
+
+    if (found) {
+        hit.Distance = best;
+        hit.Normal = glm::normalize(hit.Normal);
+        if (glm::dot(hit.Normal, ray.Direction) > 0.0f) {
+            hit.Normal = -hit.Normal;
+        }
+    }
+    return found;
+}
+
+void TriangleBvh::sweepBlock(TriangleBlock const &block, unsigned int count, glm::vec3 const &center, float radius,
+                             glm::vec3 const &motion, RayHit &hit, bool &found) const {
+    for (unsigned int lane = 0; lane < count; lane++) {
+        glm::vec3 a { block.V0[0][lane], block.V0[1][lane], block.V0[2][lane] };
+        glm::vec3 edge1 { block.Edge1[0][lane], block.Edge1[1][lane], block.Edge1[2][lane] };
+        glm::vec3 edge2 { block.Edge2[0][lane], block.Edge2[1][lane], block.Edge2[2][lane] };
+        glm::vec3 normal = glm::cross(edge1, edge2);
+        float normalLength = glm::length(normal);
+        if (normalLength < 1e-12f) {
+            continue;
+        }
+        normal /= normalLength;
+        glm::vec3 b = a + edge1;
+        glm::vec3 c = a + edge2;
+        float best = hit.Distance;
+
+        // two-sided: face the normal towards the sphere
+        float distance = glm::dot(center - a, normal);
+        if (distance < 0.0f) {
+            normal = -normal;
+            distance = -distance;
+        }
+        float approach = glm::dot(motion, normal);
+        if (approach >= 0.0f) {
+            continue; // moving away from or parallel to the plane never starts a new contact
+        }
+
+        auto insideTriangle = [&](glm::vec3 const &point) {
+            glm::vec3 v0 = b - a, v1 = c - a, v2 = point - a;
+            float d00 = glm::dot(v0, v0), d01 = glm::dot(v0, v1), d11 = glm::dot(v1, v1);
+            float d20 = glm::dot(v2, v0), d21 = glm::dot(v2, v1);
+            float denominator = d00 * d11 - d01 * d01;
+            float v = (d11 * d20 - d01 * d21) / denominator;
+            float w = (d00 * d21 - d01 * d20) / denominator;
+            return v >= 0.0f && w >= 0.0f && v + w <= 1.0f;
+        };
+
+        // the face: the sphere touches the plane when its center is one radius away from it, and the contact
+        // is on the face if the center projected onto the plane at that time lands inside the triangle
+        float t = std::max((distance - radius) / -approach, 0.0f);
+        if (t <= best) {
+            glm::vec3 contactCenter = center + motion * t;
+            if (insideTriangle(contactCenter - normal * glm::dot(contactCenter - a, normal))) {
+                hit.Distance = t;
+                hit.Normal = normal;
+                hit.Triangle = block.Triangles[lane];
+                found = true;
+                continue;
+            }
+        }
+
+        // otherwise the first contact is on an edge or a vertex
+        float candidate;
+        glm::vec3 const edges[3][2] = { { a, b }, { b, c }, { c, a } };
+        for (auto const &edge : edges) {
+            if (sweepEdge(center, motion, edge[0], edge[1], radius, best, candidate)) {
+                glm::vec3 contactCenter = center + motion * candidate;
+                best = candidate;
+                hit.Distance = candidate;
+                hit.Normal = glm::normalize(contactCenter - closestPointOnSegment(contactCenter, edge[0], edge[1]));
+                hit.Triangle = block.Triangles[lane];
+                found = true;
+            }
+        }
+        for (glm::vec3 const &vertex : { a, b, c }) {
+            if (sweepPoint(center, motion, vertex, radius, best, candidate)) {
+                best = candidate;
+                hit.Distance = candidate;
+                hit.Normal = glm::normalize(center + motion * candidate - vertex);
+                hit.Triangle = block.Triangles[lane];
+                found = true;
+            }
+        }
+    }
+}
+
+bool TriangleBvh::SphereSweep(glm::vec3 const &center, float radius, glm::vec3 const &motion, RayHit &hit) const {
+    if (nodes.empty()) {
+        return false;
+    }
+    // traverse with the swept center against node boxes grown by the radius
+    glm::vec3 inverseDirection = 1.0f / motion;
+    glm::vec3 grow { radius };
+    bool found = false;
+    hit.Distance = 1.0f;
+
+    unsigned int stack[MAX_DEPTH];
+    unsigned int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        Node const &node = nodes[stack[--top]];
+        if (intersectBox(node.Min - grow, node.Max + grow, center, inverseDirection, hit.Distance) == FLT_MAX) {
+            continue;
+        }
+        if (node.IsLeaf()) {
+            sweepBlock(blocks[node.Offset], node.Count, center, radius, motion, hit, found);
+            continue;
+        }
+        assert(top + 1 < MAX_DEPTH);
+        stack[top++] = node.Offset + 1;
+        stack[top++] = node.Offset;
+    }
+    return found;
+}
+
+bool TriangleBvh::Save(std::ostream &stream) const {
+    std::uint32_t header[2] = { CACHE_MAGIC, CACHE_VERSION };
+    std::uint64_t counts[3] = { sourceHash, nodes.size(), blocks.size() };
+    stream.write(reinterpret_cast<char const *>(header), sizeof(header));
+    stream.write(reinterpret_cast<char const *>(counts), sizeof(counts));
+    stream.write(reinterpret_cast<char const *>(nodes.data()), nodes.size() * sizeof(Node));
+    stream.write(reinterpret_cast<char const *>(blocks.data()), blocks.size() * sizeof(TriangleBlock));
+    return stream.good();
+}
+
+bool TriangleBvh::Load(std::istream &stream, std::uint64_t expectedHash) {
+    std::uint32_t header[2];
+    std::uint64_t counts[3];
+    if (!stream.read(reinterpret_cast<char *>(header), sizeof(header)) ||
+        !stream.read(reinterpret_cast<char *>(counts), sizeof(counts))) {
+        return false;
+    }
+    if (header[0] != CACHE_MAGIC || header[1] != CACHE_VERSION || counts[0] != expectedHash) {
+        return false;
+    }
+    nodes.resize(counts[1]);
+    blocks.resize(counts[2]);
+    stream.read(reinterpret_cast<char *>(nodes.data()), nodes.size() * sizeof(Node));
+    stream.read(reinterpret_cast<char *>(blocks.data()), blocks.size() * sizeof(TriangleBlock));
+    if (!stream) {
+        nodes.clear();
+        blocks.clear();
+        return false;
+    }
+    sourceHash = expectedHash;
+    return true;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "culling.hpp"
+
+struct Ray {
+    glm::vec3 Origin;
+    glm::vec3 Direction; // need not be normalized, distances are measured in multiples of it
+    float MaxDistance; // a segment is a ray with a finite MaxDistance
+};
+
+struct RayHit {
+    float Distance; // ray parameter for raycasts, fraction of the motion for sweeps
+    unsigned int Triangle; // index into the mesh index buffer divided by 3
+    glm::vec3 Normal; // geometric normal facing against the query direction
+};
+
+// Bounding volume hierarchy over the triangles of one mesh, built with binned SAH.
+// Nodes are 32 bytes so two fit in a cache line, siblings are stored next to each other and leaves point at
+// blocks of four triangles in structure-of-arrays form so a ray can be tested against a whole leaf with SSE.
+class TriangleBvh {
+    public:
+        struct Node {
+            glm::vec3 Min;
+            unsigned int Offset; // first child for interior nodes (the second one is Offset + 1), block for leaves
+            glm::vec3 Max;
+            unsigned int Count; // number of triangles in a leaf, 0 for interior nodes
+            bool IsLeaf() const { return Count != 0; }
+        };
+        struct TriangleBlock {
+            float V0[3][4];
+            float Edge1[3][4];
+            float Edge2[3][4];
+            unsigned int Triangles[4]; // unused lanes hold degenerate triangles that never report a hit
+        };
+        static unsigned int const LEAF_SIZE = 4;
+    private:
+        std::vector<Node> nodes;
+        std::vector<TriangleBlock> blocks;
+        std::uint64_t sourceHash = 0; // identifies the geometry the tree was built from, used to validate caches
+
+        void subdivide(unsigned int nodeIndex, unsigned int first, unsigned int count, unsigned int depth,
+                       std::vector<unsigned int> &order, std::vector<glm::vec3> const &centroids,
+                       std::vector<AABB> const &triangleBounds,
+                       std::vector<glm::vec3> const &positions, std::vector<unsigned int> const &indices);
+        void sweepBlock(TriangleBlock const &block, unsigned int count, glm::vec3 const &center, float radius,
+                        glm::vec3 const &motion, RayHit &hit, bool &found) const;
+    public:
+        static std::uint64_t HashGeometry(std::vector<glm::vec3> const &positions, std::vector<unsigned int> const &indices);
+
+        void Build(std::vector<glm::vec3> const &positions, std::vector<unsigned int> const &indices);
+        // Closest hit along the ray up to ray.MaxDistance
+        bool Raycast(Ray const &ray, RayHit &hit) const;
+        // First contact of a sphere moving from center to center + motion; hit.Distance is in [0, 1]
+        bool SphereSweep(glm::vec3 const &center, float radius, glm::vec3 const &motion, RayHit &hit) const;
+
+        bool Save(std::ostream &stream) const;
+        // Fails if the stream is truncated or was written for different geometry
+        bool Load(std::istream &stream, std::uint64_t expectedHash);
+
+        bool Empty() const { return nodes.empty(); }
+        size_t GetNodeCount() const { return nodes.size(); }
+        size_t GetMemoryUsage() const { return nodes.size() * sizeof(Node) + blocks.size() * sizeof(TriangleBlock); }
+};